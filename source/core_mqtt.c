@@ -68,6 +68,24 @@
 #define MQTT_POST_STATE_UPDATE_HOOK(pContext)
 #endif /* !MQTT_POST_STATE_UPDATE_HOOK */
 
+#ifndef MQTT_PRE_OVERFLOW_POOL_HOOK
+
+/**
+ * @brief Hook called just before a buffer is taken from or given back to an
+ * overflow buffer pool, which may be shared by many contexts.
+ */
+#define MQTT_PRE_OVERFLOW_POOL_HOOK(pPool)
+#endif /* !MQTT_PRE_OVERFLOW_POOL_HOOK */
+
+#ifndef MQTT_POST_OVERFLOW_POOL_HOOK
+
+/**
+ * @brief Hook called just after a buffer has been taken from or given back to
+ * an overflow buffer pool.
+ */
+#define MQTT_POST_OVERFLOW_POOL_HOOK(pPool)
+#endif /* !MQTT_POST_OVERFLOW_POOL_HOOK */
+
 /**
  * @brief Bytes required to encode any string length in an MQTT packet header.
  * Length is always encoded in two bytes according to the MQTT specification.
@@ -89,6 +107,22 @@
  */
 #define CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH (2U)
 
+/**
+ * @brief The DUP flag in the first byte of a PUBLISH packet.
+ */
+#define CORE_MQTT_PUBLISH_DUP_FLAG (0x08U)
+
+/**
+ * @brief The QoS bits in the first byte of a PUBLISH packet.
+ */
+#define CORE_MQTT_PUBLISH_QOS_MASK (0x06U)
+
+/**
+ * @brief The remaining length of a publish ack which only holds a packet
+ * identifier.
+ */
+#define CORE_MQTT_SIMPLE_ACK_REMAINING_LENGTH (2U)
+
 #if (MQTT_VERSION_5_ENABLED)
 #define MQTT_USER_PROPERTY_ID (0x26)
 #define MQTT_AUTH_METHOD_ID (0x15)
@@ -107,6 +141,8 @@
  * @brief param[in] pContext Initialized MQTT context.
  * @brief param[in] pBufferToSend Buffer to be sent to network.
  * @brief param[in] bytesToSend Number of bytes to be sent.
+ * @brief param[in] fromLoop Whether the packet is sent by a loop function,
+ * which stamps it with the time of its pass, see #getSendTime.
  *
  * @note This operation may call the transport send function
  * repeatedly to send bytes over the network until either:
@@ -121,7 +157,30 @@
  */
 static int32_t sendBuffer(MQTTContext_t *pContext,
                           const uint8_t *pBufferToSend,
-                          size_t bytesToSend);
+                          size_t bytesToSend,
+                          bool fromLoop);
+
+/**
+ * @brief Send a packet from the receive loop without waiting for the
+ * transport.
+ *
+ * The packet is added to the transmit queue set by #MQTT_InitTransmitQueue,
+ * and the queue is flushed without waiting. The bytes which the transport does
+ * not take are sent by the next flush. If there is no queue, or it has no room
+ * for the packet, the packet is sent with #sendBuffer.
+ *
+ * @note The caller must hold the send hook.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pBufferToSend Buffer to be sent to network.
+ * @param[in] bytesToSend Number of bytes to be sent.
+ *
+ * @return @p bytesToSend once the packet is sent or queued, or a negative
+ * value on network error.
+ */
+static int32_t sendBufferFromLoop(MQTTContext_t *pContext,
+                                  const uint8_t *pBufferToSend,
+                                  size_t bytesToSend);
 
 /**
  * @brief Sends MQTT connect without copying the users data into any buffer.
@@ -175,6 +234,20 @@ static int32_t sendMessageVector(MQTTContext_t *pContext,
                                  TransportOutVector_t *pIoVec,
                                  size_t ioVecCount);
 
+/**
+ * @brief Copy runs of small vectors into the staging buffer set by
+ * #MQTT_InitSendStaging, replacing each run with one vector.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in,out] pIoVec The vector array to be sent. It is rewritten in place.
+ * @param[in] ioVecCount The number of elements in the array.
+ *
+ * @return The number of elements of the rewritten array.
+ */
+static size_t stageMessageVector(const MQTTContext_t *pContext,
+                                 TransportOutVector_t *pIoVec,
+                                 size_t ioVecCount);
+
 /**
  * @brief Add a string and its length after serializing it in a manner outlined by
  * the MQTT specification.
@@ -227,6 +300,33 @@ static MQTTStatus_t sendUnsubscribeWithoutCopy(MQTTContext_t *pContext,
                                                uint16_t packetId,
                                                size_t remainingLength);
 
+/**
+ * @brief Send a list of topic filters in as many SUBSCRIBE or UNSUBSCRIBE
+ * packets as needed to respect the size of a buffer and of the broker's
+ * maximum packet size.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList MQTT subscription info.
+ * @param[in] subscriptionCount The count of elements in the list.
+ * @param[in] pBuffer Buffer the packets are serialized into.
+ * @param[in] subscribe Send SUBSCRIBE packets if true, UNSUBSCRIBE otherwise.
+ * @param[out] pPackets The packets which were sent.
+ * @param[in] maxPackets The count of elements in @p pPackets.
+ * @param[out] pPacketCount The number of packets which were sent.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if a topic filter does not fit in a packet or @p pPackets is
+ * too short; #MQTTSendFailed if transport send failed; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendSubscribeUnsubscribeBulk(MQTTContext_t *pContext,
+                                                 const MQTTSubscribeInfo_t *pSubscriptionList,
+                                                 size_t subscriptionCount,
+                                                 const MQTTFixedBuffer_t *pBuffer,
+                                                 bool subscribe,
+                                                 MQTTBulkPacket_t *pPackets,
+                                                 size_t maxPackets,
+                                                 size_t *pPacketCount);
+
 /**
  * @brief Calculate the interval between two millisecond timestamps, including
  * when the later value has overflowed.
@@ -243,6 +343,59 @@ static MQTTStatus_t sendUnsubscribeWithoutCopy(MQTTContext_t *pContext,
 static uint32_t calculateElapsedTime(uint32_t later,
                                      uint32_t start);
 
+/**
+ * @brief Calculate the time elapsed from a timestamp to the time returned by
+ * #getCurrentTime. The sends read the clock, so a timestamp taken by a send
+ * during a loop pass can be later than the time of the pass; no time has
+ * elapsed then.
+ *
+ * @param[in] now The time returned by #getCurrentTime, in milliseconds.
+ * @param[in] start The timestamp, in milliseconds.
+ *
+ * @return now - start, or 0 if @p start is later than @p now.
+ */
+static uint32_t calculateElapsedTimeFrom(uint32_t now,
+                                         uint32_t start);
+
+/**
+ * @brief Get the current time: the time of the loop pass when one was
+ * sampled by the coarse clock mode or supplied by #MQTT_ProcessLoopAt, and the
+ * time returned by #MQTTContext_t.getTime otherwise. In the coarse clock mode,
+ * the first call of a pass samples the time of the pass.
+ *
+ * @note The time of the pass is not guarded by any hook, so this must only be
+ * called from the loop functions and the callbacks they invoke. The send
+ * functions, which other threads also call, use #getSendTime.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return The current time, in milliseconds.
+ */
+static uint32_t getCurrentTime(MQTTContext_t *pContext);
+
+/**
+ * @brief Get the time to stamp a send with: the time of the loop pass, from
+ * #getCurrentTime, for the acks and PINGREQs sent by the loop functions, and
+ * the time returned by #MQTTContext_t.getTime for the sends which other
+ * threads can make.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] fromLoop Whether the send is made by a loop function.
+ *
+ * @return The current time, in milliseconds.
+ */
+static uint32_t getSendTime(MQTTContext_t *pContext,
+                            bool fromLoop);
+
+/**
+ * @brief Start a loop pass in the coarse clock mode, so that the clock is
+ * read at most once for the whole pass. Nothing is done if the mode is not
+ * enabled.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ */
+static void startCoarseTimePass(MQTTContext_t *pContext);
+
 /**
  * @brief Convert a byte indicating a publish ack type to an #MQTTPubAckType_t.
  *
@@ -252,10 +405,28 @@ static uint32_t calculateElapsedTime(uint32_t later,
  */
 static MQTTPubAckType_t getAckFromPacketType(uint8_t packetType);
 
+/**
+ * @brief Block in the transport wait function until data can be received or
+ * sent, if the transport provides one.
+ *
+ * @param[in] pContext Initialized MQTT Context.
+ * @param[in] event Whether to wait until data can be received or sent.
+ * @param[in] startTimeMs The time from which the timeout is counted.
+ * @param[in] timeoutMs The timeout of the operation waiting for the transport.
+ *
+ * @return The return value of the transport wait function, or zero if there is
+ * none or the timeout has already expired.
+ */
+static int32_t waitForTransport(const MQTTContext_t *pContext,
+                                TransportWaitEvent_t event,
+                                uint32_t startTimeMs,
+                                uint32_t timeoutMs);
+
 /**
  * @brief Receive bytes into the network buffer.
  *
  * @param[in] pContext Initialized MQTT Context.
+ * @param[in] bufferOffset Offset in the network buffer to receive the bytes at.
  * @param[in] bytesToRecv Number of bytes to receive.
  *
  * @note This operation calls the transport receive function
@@ -267,12 +438,31 @@ static MQTTPubAckType_t getAckFromPacketType(uint8_t packetType);
  *                    OR
  * 3. There is an error in reading from the network.
  *
+ * If the transport has a wait function, it blocks in it between calls which
+ * received nothing.
  *
  * @return Number of bytes received, or negative number on network error.
  */
 static int32_t recvExact(const MQTTContext_t *pContext,
+                         size_t bufferOffset,
                          size_t bytesToRecv);
 
+/**
+ * @brief Discard an exact number of bytes from the network.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] bytesToDiscard Number of bytes to discard.
+ *
+ * @note If the transport has a skip function, the bytes are dropped with it
+ * without being copied. Otherwise they are received with #recvExact into the
+ * start of the network buffer, so @a bytesToDiscard must not be larger than
+ * the buffer.
+ *
+ * @return Number of bytes discarded, or negative number on network error.
+ */
+static int32_t discardExact(const MQTTContext_t *pContext,
+                            size_t bytesToDiscard);
+
 /**
  * @brief Discard a packet from the transport interface.
  *
@@ -298,15 +488,49 @@ static MQTTStatus_t discardStoredPacket(MQTTContext_t *pContext,
                                         const MQTTPacketInfo_t *pPacketInfo);
 
 /**
- * @brief Receive a packet from the transport interface.
+ * @brief Check whether the deadline of #MQTT_ProcessLoopUntil has passed.
+ *
+ * @param[in] pContext MQTT Connection context.
+ *
+ * @return true if a deadline is set and has passed; false otherwise.
+ */
+static bool loopDeadlinePassed(const MQTTContext_t *pContext);
+
+/**
+ * @brief Discard the rest of an oversized packet from the transport interface,
+ * without waiting for data which is not yet available and stopping at the
+ * deadline of #MQTT_ProcessLoopUntil.
+ *
+ * @param[in] pContext MQTT Connection context.
+ *
+ * @return #MQTTNoDataAvailable once the whole packet is discarded,
+ * #MQTTNeedMoreBytes if part of it remains, or #MQTTRecvFailed.
+ */
+static MQTTStatus_t discardPendingBytes(MQTTContext_t *pContext);
+
+/**
+ * @brief Send the ack of a PUBLISH rejected by the filter once the discard of
+ * its payload has completed, or remove its record if the discard failed.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] discardStatus Status returned by #discardPendingBytes.
+ *
+ * @return @p discardStatus, or the status of sending the ack if it failed.
+ */
+static MQTTStatus_t completeDiscardAck(MQTTContext_t *pContext,
+                                       MQTTStatus_t discardStatus);
+
+/**
+ * @brief Receive the rest of a packet whose fixed header is in the network
+ * buffer from the transport interface.
  *
  * @param[in] pContext MQTT Connection context.
- * @param[in] incomingPacket packet struct with remaining length.
+ * @param[in] incomingPacket packet struct with header and remaining length.
  * @param[in] remainingTimeMs Time remaining to receive the packet.
  *
  * @return #MQTTSuccess or #MQTTRecvFailed.
  */
-static MQTTStatus_t receivePacket(const MQTTContext_t *pContext,
+static MQTTStatus_t receivePacket(MQTTContext_t *pContext,
                                   MQTTPacketInfo_t incomingPacket,
                                   uint32_t remainingTimeMs);
 
@@ -334,331 +558,845 @@ static MQTTStatus_t sendPublishAcks(MQTTContext_t *pContext,
                                     MQTTPublishState_t publishState);
 
 /**
- * @brief Send a keep alive PINGREQ if the keep alive interval has elapsed.
+ * @brief Serialize an ack into the ack buffer set by #MQTT_InitAckCoalescing,
+ * sending the buffer first if it is full.
  *
- * @param[in] pContext Initialized MQTT Context.
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetTypeByte Type of the ack.
+ * @param[in] packetId packet ID of original PUBLISH.
  *
- * @return #MQTTKeepAliveTimeout if a PINGRESP is not received in time,
- * #MQTTSendFailed if the PINGREQ cannot be sent, or #MQTTSuccess.
+ * @return #MQTTSuccess, #MQTTIllegalState or #MQTTSendFailed.
  */
-static MQTTStatus_t handleKeepAlive(MQTTContext_t *pContext);
+static MQTTStatus_t stageAck(MQTTContext_t *pContext,
+                             uint8_t packetTypeByte,
+                             uint16_t packetId);
 
 /**
- * @brief Handle received MQTT PUBLISH packet.
+ * @brief Send the acks collected in the ack buffer and update the state of
+ * their publishes.
  *
  * @param[in] pContext MQTT Connection context.
- * @param[in] pIncomingPacket Incoming packet.
  *
- * @return MQTTSuccess, MQTTIllegalState or deserialization error.
+ * @return #MQTTSuccess, #MQTTIllegalState or #MQTTSendFailed.
  */
-static MQTTStatus_t handleIncomingPublish(MQTTContext_t *pContext,
-                                          MQTTPacketInfo_t *pIncomingPacket);
+static MQTTStatus_t flushAcks(MQTTContext_t *pContext);
 
 /**
- * @brief Handle received MQTT publish acks.
+ * @brief Copy a PUBLISH packet into the transmit queue set by
+ * #MQTT_InitTransmitQueue.
+ *
+ * @note The caller must hold the send hook.
  *
  * @param[in] pContext MQTT Connection context.
- * @param[in] pIncomingPacket Incoming packet.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] pMqttHeader The serialized MQTT header with the header byte; the
+ * encoded length of the packet; and the encoded length of the topic string.
+ * @param[in] headerSize Size of the serialized PUBLISH header.
+ * @param[in] packetId Packet Id of the publish packet.
  *
- * @return MQTTSuccess, MQTTIllegalState, or deserialization error.
+ * @return #MQTTNoMemory if the packet does not fit in the free space of the
+ * queue; #MQTTSuccess otherwise.
  */
-static MQTTStatus_t handlePublishAcks(MQTTContext_t *pContext,
-                                      MQTTPacketInfo_t *pIncomingPacket);
+static MQTTStatus_t enqueuePublish(MQTTContext_t *pContext,
+                                   const MQTTPublishInfo_t *pPublishInfo,
+                                   const uint8_t *pMqttHeader,
+                                   size_t headerSize,
+                                   uint16_t packetId);
 
 /**
- * @brief Handle received MQTT ack.
+ * @brief Make room at the end of the transmit queue for a packet, by moving
+ * the packets which have not been completely sent to the front of the queue.
+ *
+ * @note The caller must hold the send hook.
  *
  * @param[in] pContext MQTT Connection context.
- * @param[in] pIncomingPacket Incoming packet.
- * @param[in] manageKeepAlive Flag indicating if PINGRESPs should not be given
- * to the application
+ * @param[in] packetSize Size of the packet.
  *
- * @return MQTTSuccess, MQTTIllegalState, or deserialization error.
+ * @return true if the packet fits in the free space of the queue;
+ * false otherwise.
  */
-static MQTTStatus_t handleIncomingAck(MQTTContext_t *pContext,
-                                      MQTTPacketInfo_t *pIncomingPacket,
-                                      bool manageKeepAlive);
+static bool reserveTransmitQueue(MQTTContext_t *pContext,
+                                 size_t packetSize);
 
 /**
- * @brief Run a single iteration of the receive loop.
+ * @brief Get the size of a packet in the transmit queue from its fixed
+ * header.
  *
- * @param[in] pContext MQTT Connection context.
- * @param[in] manageKeepAlive Flag indicating if keep alive should be handled.
+ * @param[in] pPacket The first byte of the packet.
  *
- * @return #MQTTRecvFailed if a network error occurs during reception;
- * #MQTTSendFailed if a network error occurs while sending an ACK or PINGREQ;
- * #MQTTBadResponse if an invalid packet is received;
- * #MQTTKeepAliveTimeout if the server has not sent a PINGRESP before
- * #MQTT_PINGRESP_TIMEOUT_MS milliseconds;
- * #MQTTIllegalState if an incoming QoS 1/2 publish or ack causes an
- * invalid transition for the internal state machine;
- * #MQTTSuccess on success.
+ * @return The size of the packet, in bytes.
  */
-static MQTTStatus_t receiveSingleIteration(MQTTContext_t *pContext,
-                                           bool manageKeepAlive);
+static size_t getQueuedPacketSize(const uint8_t *pPacket);
 
 /**
- * @brief Validates parameters of #MQTT_Subscribe or #MQTT_Unsubscribe.
+ * @brief Move #MQTTContext_t.transmitQueuePacketStart past the packets of the
+ * transmit queue which have been completely sent.
  *
- * @param[in] pContext Initialized MQTT context.
- * @param[in] pSubscriptionList List of MQTT subscription info.
- * @param[in] subscriptionCount The number of elements in pSubscriptionList.
- * @param[in] packetId Packet identifier.
+ * @note The caller must hold the send hook.
  *
- * @return #MQTTBadParameter if invalid parameters are passed;
- * #MQTTSuccess otherwise.
+ * @param[in] pContext MQTT Connection context.
  */
-static MQTTStatus_t validateSubscribeUnsubscribeParams(const MQTTContext_t *pContext,
-                                                       const MQTTSubscribeInfo_t *pSubscriptionList,
-                                                       size_t subscriptionCount,
-                                                       uint16_t packetId);
+static void skipSentPackets(MQTTContext_t *pContext);
 
 /**
- * @brief Receives a CONNACK MQTT packet.
+ * @brief Empty the transmit queue without sending it.
  *
- * @param[in] pContext Initialized MQTT context.
- * @param[in] timeoutMs Timeout for waiting for CONNACK packet.
- * @param[in] cleanSession Clean session flag set by application.
- * @param[out] pIncomingPacket List of MQTT subscription info.
- * @param[out] pSessionPresent Whether a previous session was present.
- * Only relevant if not establishing a clean session.
+ * @note The caller must hold the send hook.
  *
- * @return #MQTTBadResponse if a bad response is received;
- * #MQTTNoDataAvailable if no data available for transport recv;
- * ##MQTTRecvFailed if transport recv failed;
- * #MQTTSuccess otherwise.
+ * @param[in] pContext MQTT Connection context.
+ *
+ * @return The number of QoS 0 publishes which had not been completely sent.
  */
-static MQTTStatus_t receiveConnack(const MQTTContext_t *pContext,
-                                   uint32_t timeoutMs,
-                                   bool cleanSession,
-                                   MQTTPacketInfo_t *pIncomingPacket,
-                                   bool *pSessionPresent);
+static size_t dropTransmitQueue(MQTTContext_t *pContext);
 
 /**
- * @brief Resends pending acks for a re-established MQTT session, or
- * clears existing state records for a clean session.
+ * @brief Send as many bytes of the transmit queue as the transport accepts
+ * without waiting. The bytes which are not sent stay in the queue.
  *
- * @param[in] pContext Initialized MQTT context.
- * @param[in] sessionPresent Session present flag received from the MQTT broker.
+ * @note The caller must hold the send hook.
  *
- * @return #MQTTSendFailed if transport send during resend failed;
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] fromLoop Whether the queue is sent by a loop function, see
+ * #getSendTime.
+ *
+ * @return #MQTTSendFailed if the transport returned an error;
  * #MQTTSuccess otherwise.
  */
-static MQTTStatus_t handleSessionResumption(MQTTContext_t *pContext,
-                                            bool sessionPresent);
+static MQTTStatus_t sendTransmitQueue(MQTTContext_t *pContext,
+                                      bool fromLoop);
 
 /**
- * @brief Send the publish packet without copying the topic string and payload in
- * the buffer.
+ * @brief Send as many bytes of the transmit queue as the transport accepts
+ * without waiting, taking the send hook.
  *
- * @brief param[in] pContext Initialized MQTT context.
- * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters.
- * @brief param[in] pMqttHeader the serialized MQTT header with the header byte;
- * the encoded length of the packet; and the encoded length of the topic string.
- * @brief param[in] headerSize Size of the serialized PUBLISH header.
- * @brief param[in] packetId Packet Id of the publish packet.
+ * @param[in] pContext MQTT Connection context.
  *
- * @return #MQTTSendFailed if transport send during resend failed;
+ * @return #MQTTSendFailed if the transport returned an error;
  * #MQTTSuccess otherwise.
  */
-static MQTTStatus_t sendPublishWithoutCopy(MQTTContext_t *pContext,
-                                           const MQTTPublishInfo_t *pPublishInfo,
-                                           const uint8_t *pMqttHeader,
-                                           size_t headerSize,
-                                           uint16_t packetId);
+static MQTTStatus_t flushTransmitQueue(MQTTContext_t *pContext);
 
 /**
- * @brief Function to validate #MQTT_Publish parameters.
+ * @brief Empty the transmit queue before another packet is sent.
  *
- * @brief param[in] pContext Initialized MQTT context.
- * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters.
- * @brief param[in] packetId Packet Id for the MQTT PUBLISH packet.
+ * The queue is flushed without waiting, and the transport is waited on only
+ * while it takes no bytes. The wait fails once the transport has taken no
+ * bytes for #MQTT_SEND_TIMEOUT_MS. The bytes which are not sent stay in the
+ * queue for the next flush.
  *
- * @return #MQTTBadParameter if invalid parameters are passed;
+ * @note The caller must hold the send hook.
+ *
+ * @param[in] pContext MQTT Connection context.
+ *
+ * @return #MQTTSendFailed if the queue could not be emptied;
  * #MQTTSuccess otherwise.
  */
-static MQTTStatus_t validatePublishParams(const MQTTContext_t *pContext,
-                                          const MQTTPublishInfo_t *pPublishInfo,
-                                          uint16_t packetId);
+static MQTTStatus_t drainTransmitQueue(MQTTContext_t *pContext);
 
 /**
- * @brief Performs matching for special cases when a topic filter ends
- * with a wildcard character.
+ * @brief Send the queued publishes and the collected acks at the end of a
+ * receive loop call.
  *
- * When the topic name has been consumed but there are remaining characters to
- * to match in topic filter, this function handles the following 2 cases:
- * - When the topic filter ends with "/+" or "/#" characters, but the topic
- * name only ends with '/'.
- * - When the topic filter ends with "/#" characters, but the topic name
- * ends at the parent level.
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] loopStatus Status of the receive loop.
  *
- * @note This function ASSUMES that the topic name been consumed in linear
- * matching with the topic filer, but the topic filter has remaining characters
- * to be matched.
+ * @return @p loopStatus, unless the receive loop succeeded and the publishes
+ * or the acks could not be sent.
+ */
+static MQTTStatus_t completeReceiveLoop(MQTTContext_t *pContext,
+                                        MQTTStatus_t loopStatus);
+
+/**
+ * @brief Send a keep alive PINGREQ if the keep alive interval has elapsed.
  *
- * @param[in] pTopicFilter The topic filter containing the wildcard.
- * @param[in] topicFilterLength Length of the topic filter being examined.
- * @param[in] filterIndex Index of the topic filter being examined.
+ * @param[in] pContext Initialized MQTT Context.
  *
- * @return Returns whether the topic filter and the topic name match.
+ * @return #MQTTKeepAliveTimeout if a PINGRESP is not received in time,
+ * #MQTTSendFailed if the PINGREQ cannot be sent, or #MQTTSuccess.
  */
-static bool matchEndWildcardsSpecialCases(const char *pTopicFilter,
-                                          uint16_t topicFilterLength,
-                                          uint16_t filterIndex);
+static MQTTStatus_t handleKeepAlive(MQTTContext_t *pContext);
 
 /**
- * @brief Attempt to match topic name with a topic filter starting with a wildcard.
- *
- * If the topic filter starts with a '+' (single-level) wildcard, the function
- * advances the @a pNameIndex by a level in the topic name.
- * If the topic filter starts with a '#' (multi-level) wildcard, the function
- * concludes that both the topic name and topic filter match.
+ * @brief Serialize and send a PINGREQ.
  *
- * @param[in] pTopicName The topic name to match.
- * @param[in] topicNameLength Length of the topic name.
- * @param[in] pTopicFilter The topic filter to match.
- * @param[in] topicFilterLength Length of the topic filter.
- * @param[in,out] pNameIndex Current index in the topic name being examined. It is
- * advanced by one level for `+` wildcards.
- * @param[in, out] pFilterIndex Current index in the topic filter being examined.
- * It is advanced to position of '/' level separator for '+' wildcard.
- * @param[out] pMatch Whether the topic filter and topic name match.
+ * @param[in] pContext Initialized MQTT Context.
+ * @param[in] fromLoop Whether the PINGREQ is sent by the receive loop, which
+ * does not wait for the transport, see #sendBufferFromLoop.
  *
- * @return `true` if the caller of this function should exit; `false` if the
- * caller should continue parsing the topics.
+ * @return #MQTTSendFailed if the PINGREQ cannot be sent, or #MQTTSuccess.
  */
-static bool matchWildcards(const char *pTopicName,
-                           uint16_t topicNameLength,
-                           const char *pTopicFilter,
-                           uint16_t topicFilterLength,
-                           uint16_t *pNameIndex,
-                           uint16_t *pFilterIndex,
-                           bool *pMatch);
+static MQTTStatus_t sendPingreq(MQTTContext_t *pContext,
+                                bool fromLoop);
 
 /**
- * @brief Match a topic name and topic filter allowing the use of wildcards.
+ * @brief Update the state engine for a received MQTT PUBLISH packet.
  *
- * @param[in] pTopicName The topic name to check.
- * @param[in] topicNameLength Length of the topic name.
- * @param[in] pTopicFilter The topic filter to check.
- * @param[in] topicFilterLength Length of topic filter.
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetIdentifier Packet ID of the PUBLISH.
+ * @param[in] pPublishInfo Deserialized PUBLISH.
+ * @param[out] pPublishRecordState State of the publish record after the update.
+ * @param[out] pDuplicatePublish Whether the PUBLISH is a duplicate of a
+ * PUBLISH which was already given to the application.
  *
- * @return `true` if the topic name and topic filter match; `false` otherwise.
+ * @return MQTTSuccess, MQTTRecvFailed, MQTTIllegalState, MQTTNoMemory or
+ * MQTTSendFailed if the staged acks cannot be sent to free a record.
  */
-static bool matchTopicFilter(const char *pTopicName,
-                             uint16_t topicNameLength,
-                             const char *pTopicFilter,
-                             uint16_t topicFilterLength);
-
-size_t addEncodedStringToVector(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
-                                const char *const string,
-                                uint16_t length,
-                                TransportOutVector_t *iterator,
-                                size_t *updatedLength);
+static MQTTStatus_t updateIncomingPublishState(MQTTContext_t *pContext,
+                                               uint16_t packetIdentifier,
+                                               const MQTTPublishInfo_t *pPublishInfo,
+                                               MQTTPublishState_t *pPublishRecordState,
+                                               bool *pDuplicatePublish);
 
-#if (MQTT_VERSION_5_ENABLED)
+/**
+ * @brief Handle received MQTT PUBLISH packet.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ *
+ * @return MQTTSuccess, MQTTIllegalState or deserialization error.
+ */
+static MQTTStatus_t handleIncomingPublish(MQTTContext_t *pContext,
+                                          MQTTPacketInfo_t *pIncomingPacket);
 
-size_t addEncodedStringToVectorWithId(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
-                                      const char *const string,
-                                      uint16_t length,
-                                      TransportOutVector_t *iterator,
-                                      size_t *updatedLength, uint8_t* packetId);
+/**
+ * @brief Give an incoming PUBLISH, whose state has been updated, to the
+ * application or to the batch of #MQTT_InitPublishBatch, and send its ack.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ * @param[in] packetIdentifier Packet ID of the PUBLISH.
+ * @param[in] pPublishInfo Deserialized PUBLISH, with its whole payload.
+ * @param[in] publishRecordState State of the publish record after the update.
+ * @param[in] duplicatePublish Whether the PUBLISH was already received.
+ * @param[in] dropPublish Whether the PUBLISH is only acked, because it is a
+ * duplicate or was rejected by the filter.
+ *
+ * @return #MQTTSuccess, #MQTTIllegalState or #MQTTSendFailed.
+ */
+static MQTTStatus_t dispatchIncomingPublish(MQTTContext_t *pContext,
+                                            MQTTPacketInfo_t *pIncomingPacket,
+                                            uint16_t packetIdentifier,
+                                            MQTTPublishInfo_t *pPublishInfo,
+                                            MQTTPublishState_t publishRecordState,
+                                            bool duplicatePublish,
+                                            bool dropPublish);
 
+/**
+ * @brief Hash the topic name and payload of a PUBLISH with 32-bit FNV-1a.
+ *
+ * @param[in] pPublishInfo Deserialized PUBLISH.
+ *
+ * @return The hash.
+ */
+static uint32_t hashPublish(const MQTTPublishInfo_t *pPublishInfo);
 
-size_t addEncodedStringToVectorWithId(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
-                                      const char *const string,
-                                      uint16_t length,
-                                      TransportOutVector_t *iterator,
-                                      size_t *updatedLength, uint8_t* packetId)
-{
-    size_t packetLength = 0U;
-    TransportOutVector_t *pLocalIterator = iterator;
-    size_t vectorsAdded = 0U;
+/**
+ * @brief Check whether an incoming QoS 1 PUBLISH is a redelivery of one in the
+ * cache set by #MQTT_InitQoS1Dedup, and add it to the cache if it is not.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetIdentifier Packet ID of the PUBLISH.
+ * @param[in] pPublishInfo Deserialized PUBLISH.
+ *
+ * @return true if the PUBLISH has already been received, else false.
+ */
+static bool checkQoS1Duplicate(MQTTContext_t *pContext,
+                               uint16_t packetIdentifier,
+                               const MQTTPublishInfo_t *pPublishInfo);
 
-    /* When length is non-zero, the string must be non-NULL. */
-    assert((length != 0U) ? (string != NULL) : true);
+/**
+ * @brief Give the batched incoming PUBLISH packets to the application and send
+ * their acks.
+ *
+ * @param[in] pContext MQTT Connection context.
+ *
+ * @return #MQTTSuccess, #MQTTIllegalState or #MQTTSendFailed.
+ */
+static MQTTStatus_t deliverPublishBatch(MQTTContext_t *pContext);
 
-    serializedLength[0] = ((uint8_t)((length) >> 8));
-    serializedLength[1] = ((uint8_t)((length) & 0x00ffU));
+/**
+ * @brief Receive bytes from the transport interface until the network buffer
+ * holds the requested number of bytes.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] bytesInBuffer Number of bytes the network buffer must hold. This
+ * must not be more than the size of the network buffer.
+ *
+ * @return #MQTTSuccess or #MQTTRecvFailed.
+ */
+static MQTTStatus_t receiveIntoBuffer(MQTTContext_t *pContext,
+                                      size_t bytesInBuffer);
 
-    /* Add the packet id first. */
-    pLocalIterator[0].iov_base = packetId;
-    pLocalIterator[0].iov_len = CORE_MQTT_ID_SIZE;
-    vectorsAdded++;
-    packetLength = CORE_MQTT_ID_SIZE;
+/**
+ * @brief Receive the fixed and variable header of a PUBLISH packet which is
+ * larger than the network buffer.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ * @param[out] pPublishHeaderLength Length of the fixed and variable header.
+ *
+ * @return #MQTTSuccess, #MQTTRecvFailed, #MQTTBadResponse if the topic name
+ * does not fit in the packet, or #MQTTNoMemory if the header does not fit in
+ * the network buffer.
+ */
+static MQTTStatus_t receivePublishHeader(MQTTContext_t *pContext,
+                                         const MQTTPacketInfo_t *pIncomingPacket,
+                                         size_t *pPublishHeaderLength);
 
-    /* Add the serialized length of the string. */
-    pLocalIterator[1].iov_base = serializedLength;
-    pLocalIterator[1].iov_len = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
-    vectorsAdded++;
-    packetLength += CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+/**
+ * @brief Receive the payload of a PUBLISH packet which is larger than the
+ * network buffer and give it to the application in fragments.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pDeserializedInfo Deserialized header of the PUBLISH.
+ * @param[in] publishHeaderLength Length of the fixed and variable header.
+ * @param[in] giveToApplication Whether to give the fragments to the
+ * application, or only read them from the network.
+ *
+ * @return #MQTTSuccess or #MQTTRecvFailed.
+ */
+static MQTTStatus_t receivePublishFragments(MQTTContext_t *pContext,
+                                            MQTTDeserializedInfo_t *pDeserializedInfo,
+                                            size_t publishHeaderLength,
+                                            bool giveToApplication);
 
-    /* Sometimes the string can be NULL that is, of 0 length. In that case,
-     * only the length field should be encoded in the vector. */
-    if ((string != NULL) && (length != 0U))
-    {
-        /* Then add the pointer to the string itself. */
-        pLocalIterator[2].iov_base = string;
-        pLocalIterator[2].iov_len = length;
-        vectorsAdded++;
-        packetLength += length;
-    }
+/**
+ * @brief Receive the payload of a PUBLISH packet into the buffer supplied by
+ * the application.
+ *
+ * The payload bytes already in the network buffer are copied to the buffer,
+ * and the rest is received from the transport interface. When the transport
+ * interface has a readv function, data following the PUBLISH is received with
+ * the payload and left in the network buffer after the PUBLISH header.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] publishHeaderLength Length of the fixed and variable header.
+ * @param[in] payloadLength Length of the payload.
+ * @param[out] pDestination Buffer to receive the payload into.
+ * @param[out] pBytesAfterPacket Number of bytes received after the PUBLISH.
+ *
+ * @return #MQTTSuccess or #MQTTRecvFailed.
+ */
+static MQTTStatus_t receivePayloadDirect(MQTTContext_t *pContext,
+                                         size_t publishHeaderLength,
+                                         size_t payloadLength,
+                                         uint8_t *pDestination,
+                                         size_t *pBytesAfterPacket);
 
-    (*updatedLength) = (*updatedLength) + packetLength;
+/**
+ * @brief Receive a PUBLISH packet which is not yet complete in the network
+ * buffer, and give it to the application without receiving all of it into the
+ * network buffer first when possible.
+ *
+ * The payload is received into the buffer supplied by the payload destination
+ * callback if there is one. Otherwise the packet is received into the network
+ * buffer if it fits, or its payload is given to the application in fragments.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ *
+ * @return #MQTTSuccess, #MQTTRecvFailed, #MQTTSendFailed, #MQTTIllegalState
+ * or deserialization error.
+ */
+static MQTTStatus_t receiveStreamedPublish(MQTTContext_t *pContext,
+                                           MQTTPacketInfo_t *pIncomingPacket);
 
-    return vectorsAdded;
-}
+/**
+ * @brief Handle received MQTT publish acks.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ *
+ * @return MQTTSuccess, MQTTIllegalState, or deserialization error.
+ */
+static MQTTStatus_t handlePublishAcks(MQTTContext_t *pContext,
+                                      MQTTPacketInfo_t *pIncomingPacket);
 
-#endif
+/**
+ * @brief Find the entry of the completion table registered for a packet ID.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetId Packet ID of the PUBLISH, or #MQTT_PACKET_ID_INVALID to
+ * find a free entry.
+ *
+ * @return The entry, or NULL if there is none.
+ */
+static MQTTPublishCompletion_t *findPublishCompletion(const MQTTContext_t *pContext,
+                                                      uint16_t packetId);
 
-/*-----------------------------------------------------------*/
+/**
+ * @brief Remove the completion registered by #MQTT_PublishWithCompletion for
+ * an acknowledged PUBLISH.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[out] pCompletion Copy of the completion which was registered.
+ *
+ * @return true if a completion was registered for @p packetId; false otherwise.
+ */
+static bool takePublishCompletion(MQTTContext_t *pContext,
+                                  uint16_t packetId,
+                                  MQTTPublishCompletion_t *pCompletion);
 
-size_t addEncodedStringToVector(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
-                                const char *const string,
-                                uint16_t length,
-                                TransportOutVector_t *iterator,
-                                size_t *updatedLength)
-{
-    size_t packetLength = 0U;
-    TransportOutVector_t *pLocalIterator = iterator;
-    size_t vectorsAdded = 0U;
+/**
+ * @brief Invoke with #MQTTIllegalState the completions of the publishes which
+ * will never be acknowledged because a new session was started, and clear them.
+ *
+ * @param[in] pContext MQTT Connection context.
+ */
+static void failPublishCompletions(MQTTContext_t *pContext);
 
-    /* When length is non-zero, the string must be non-NULL. */
-    assert((length != 0U) ? (string != NULL) : true);
+/**
+ * @brief Handle received MQTT ack.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket Incoming packet.
+ * @param[in] manageKeepAlive Flag indicating if PINGRESPs should not be given
+ * to the application
+ *
+ * @return MQTTSuccess, MQTTIllegalState, or deserialization error.
+ */
+static MQTTStatus_t handleIncomingAck(MQTTContext_t *pContext,
+                                      MQTTPacketInfo_t *pIncomingPacket,
+                                      bool manageKeepAlive);
 
-    serializedLength[0] = ((uint8_t)((length) >> 8));
-    serializedLength[1] = ((uint8_t)((length) & 0x00ffU));
+/**
+ * @brief Move the unprocessed bytes of the network buffer to its front.
+ *
+ * In the ring buffer receive mode, this is how the receive window wraps around
+ * once it reaches the end of the network buffer. It does nothing when the
+ * unprocessed bytes already start at the front of the buffer.
+ *
+ * @param[in] pContext MQTT Connection context.
+ */
+static void wrapReceiveWindow(MQTTContext_t *pContext);
 
-    /* Add the serialized length of the string first. */
-    pLocalIterator[0].iov_base = serializedLength;
-    pLocalIterator[0].iov_len = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
-    vectorsAdded++;
-    packetLength = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+/**
+ * @brief Replace the network buffer, which the application has taken ownership
+ * of, with the spare buffer taken from the receive buffer pool.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pRemainingBytes The bytes received after the loaned packet. These
+ * are copied to the new network buffer.
+ */
+static void switchReceiveBuffer(MQTTContext_t *pContext,
+                                const uint8_t *pRemainingBytes);
 
-    /* Sometimes the string can be NULL that is, of 0 length. In that case,
-     * only the length field should be encoded in the vector. */
-    if ((string != NULL) && (length != 0U))
-    {
-        /* Then add the pointer to the string itself. */
-        pLocalIterator[1].iov_base = string;
-        pLocalIterator[1].iov_len = length;
-        vectorsAdded++;
-        packetLength += length;
-    }
+/**
+ * @brief Replace the network buffer with a buffer from the overflow buffer
+ * pool which can hold a packet, copying the bytes of the packet received so far.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] packetLength Length of the packet to receive.
+ *
+ * @return true if a buffer was taken from the pool; false if none of its free
+ * buffers is large enough.
+ */
+static bool takeOverflowBuffer(MQTTContext_t *pContext,
+                               size_t packetLength);
 
-    (*updatedLength) = (*updatedLength) + packetLength;
+/**
+ * @brief Receive the rest of a packet into the buffer taken with
+ * #takeOverflowBuffer, handle it, and give the buffer back to the pool.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pIncomingPacket The packet, whose fixed header has been decoded.
+ * @param[in] manageKeepAlive Flag indicating if PINGRESPs should not be given
+ * to the application.
+ *
+ * @return #MQTTRecvFailed if the rest of the packet could not be received;
+ * otherwise the status of handling the packet.
+ */
+static MQTTStatus_t receiveOverflowPacket(MQTTContext_t *pContext,
+                                          MQTTPacketInfo_t *pIncomingPacket,
+                                          bool manageKeepAlive);
 
-    return vectorsAdded;
-}
+/**
+ * @brief Run a single iteration of the receive loop.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] manageKeepAlive Flag indicating if keep alive should be handled.
+ * @param[in] readTransport Whether to call the transport receive function
+ * before processing the data held in the network buffer.
+ * @param[out] pPacketLength Set to the length of the packet handled by this
+ * iteration, or zero if no packet was handled.
+ *
+ * @return #MQTTRecvFailed if a network error occurs during reception;
+ * #MQTTSendFailed if a network error occurs while sending an ACK or PINGREQ;
+ * #MQTTBadResponse if an invalid packet is received;
+ * #MQTTKeepAliveTimeout if the server has not sent a PINGRESP before
+ * #MQTT_PINGRESP_TIMEOUT_MS milliseconds;
+ * #MQTTIllegalState if an incoming QoS 1/2 publish or ack causes an
+ * invalid transition for the internal state machine;
+ * #MQTTSuccess on success.
+ */
+static MQTTStatus_t receiveSingleIteration(MQTTContext_t *pContext,
+                                           bool manageKeepAlive,
+                                           bool readTransport,
+                                           size_t *pPacketLength);
 
-static bool matchEndWildcardsSpecialCases(const char *pTopicFilter,
-                                          uint16_t topicFilterLength,
-                                          uint16_t filterIndex)
-{
-    bool matchFound = false;
+/**
+ * @brief Handle packets until the drain budget of the context is used up or
+ * no more data is available.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] manageKeepAlive Flag indicating if keep alive should be handled.
+ * @param[out] pByteCount Number of bytes of the packets handled by the batch.
+ *
+ * @return Status of the last iteration of the receive loop. See
+ * #receiveSingleIteration.
+ */
+static MQTTStatus_t receiveDrain(MQTTContext_t *pContext,
+                                 bool manageKeepAlive,
+                                 size_t *pByteCount);
 
-    assert(pTopicFilter != NULL);
-    assert(topicFilterLength != 0U);
+/**
+ * @brief Validates parameters of #MQTT_Subscribe or #MQTT_Unsubscribe.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in pSubscriptionList.
+ * @param[in] packetId Packet identifier.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t validateSubscribeUnsubscribeParams(const MQTTContext_t *pContext,
+                                                       const MQTTSubscribeInfo_t *pSubscriptionList,
+                                                       size_t subscriptionCount,
+                                                       uint16_t packetId);
+
+/**
+ * @brief Reset the receive state left by an earlier connection, before the
+ * CONNACK of a new one is received.
+ *
+ * The overflow buffer in use, if any, is returned to its pool, the publishes
+ * of an undelivered batch are dropped and their records removed so that their
+ * redelivery is not taken as a duplicate, and the network buffer is cleared.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ */
+static void resetReceiveState(MQTTContext_t *pContext);
+
+/**
+ * @brief Receives a CONNACK MQTT packet.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] timeoutMs Timeout for waiting for CONNACK packet.
+ * @param[in] cleanSession Clean session flag set by application.
+ * @param[out] pIncomingPacket List of MQTT subscription info.
+ * @param[out] pSessionPresent Whether a previous session was present.
+ * Only relevant if not establishing a clean session.
+ *
+ * @return #MQTTBadResponse if a bad response is received;
+ * #MQTTNoDataAvailable if no data available for transport recv;
+ * ##MQTTRecvFailed if transport recv failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t receiveConnack(MQTTContext_t *pContext,
+                                   uint32_t timeoutMs,
+                                   bool cleanSession,
+                                   MQTTPacketInfo_t *pIncomingPacket,
+                                   bool *pSessionPresent);
+
+/**
+ * @brief Resends pending acks for a re-established MQTT session, or
+ * clears existing state records for a clean session.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] sessionPresent Session present flag received from the MQTT broker.
+ *
+ * @return #MQTTSendFailed if transport send during resend failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t handleSessionResumption(MQTTContext_t *pContext,
+                                            bool sessionPresent);
+
+/**
+ * @brief Send the publish packet without copying the topic string and payload in
+ * the buffer.
+ *
+ * @brief param[in] pContext Initialized MQTT context.
+ * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @brief param[in] pMqttHeader the serialized MQTT header with the header byte;
+ * the encoded length of the packet; and the encoded length of the topic string.
+ * @brief param[in] headerSize Size of the serialized PUBLISH header.
+ * @brief param[in] packetId Packet Id of the publish packet.
+ *
+ * @return #MQTTSendFailed if transport send during resend failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendPublishWithoutCopy(MQTTContext_t *pContext,
+                                           const MQTTPublishInfo_t *pPublishInfo,
+                                           const uint8_t *pMqttHeader,
+                                           size_t headerSize,
+                                           uint16_t packetId);
+
+/**
+ * @brief Reserve the state of a PUBLISH whose header has been serialized, then
+ * send or queue the packet and update its state.
+ *
+ * @brief param[in] pContext Initialized MQTT context.
+ * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @brief param[in] pMqttHeader the serialized MQTT header with the header byte;
+ * the encoded length of the packet; and the encoded length of the topic string.
+ * @brief param[in] headerSize Size of the serialized PUBLISH header.
+ * @brief param[in] packetId Packet Id of the publish packet.
+ *
+ * @return #MQTTNoMemory if the transmit queue is full; #MQTTSendFailed if
+ * transport send failed; the state engine status if the state could not be
+ * reserved or updated; #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendSerializedPublish(MQTTContext_t *pContext,
+                                          const MQTTPublishInfo_t *pPublishInfo,
+                                          const uint8_t *pMqttHeader,
+                                          size_t headerSize,
+                                          uint16_t packetId);
+
+/**
+ * @brief Serialize one PUBLISH of a #MQTT_PublishBatch call, reserve its state
+ * and append its vectors to the batch.
+ *
+ * @brief param[in] pContext Initialized MQTT context.
+ * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @brief param[in] packetId Packet Id of the publish packet.
+ * @brief param[in] remainingLength Remaining length of the PUBLISH packet.
+ * @brief param[out] pMqttHeader Storage for the serialized PUBLISH header.
+ * @brief param[out] pSerializedPacketId Storage for the serialized packet Id.
+ * @brief param[out] pIoVector Vectors of the batch.
+ * @brief param[in,out] pIoVectorLength Number of vectors used in @p pIoVector.
+ * @brief param[in,out] pTotalMessageLength Number of bytes in the batch vectors.
+ *
+ * @return #MQTTSuccess if the packet was added to the batch; the serializer or
+ * state engine status otherwise.
+ */
+static MQTTStatus_t addPublishToBatch(MQTTContext_t *pContext,
+                                      const MQTTPublishInfo_t *pPublishInfo,
+                                      uint16_t packetId,
+                                      size_t remainingLength,
+                                      uint8_t *pMqttHeader,
+                                      uint8_t *pSerializedPacketId,
+                                      TransportOutVector_t *pIoVector,
+                                      size_t *pIoVectorLength,
+                                      size_t *pTotalMessageLength);
+
+/**
+ * @brief Send the vectors gathered by #MQTT_PublishBatch and update the state
+ * of the packets they hold.
+ *
+ * @brief param[in] pContext Initialized MQTT context.
+ * @brief param[in] pIoVector Vectors of the packets in the chunk.
+ * @brief param[in] ioVectorLength Number of vectors in the chunk.
+ * @brief param[in] totalMessageLength Number of bytes in the chunk.
+ * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters of the chunk.
+ * @brief param[in] pPacketIds Packet Ids of the chunk.
+ * @brief param[in,out] pStatuses Statuses of the chunk.
+ * @brief param[in] publishCount Number of messages in the chunk.
+ *
+ * @return #MQTTSendFailed if transport send failed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t sendPublishBatchChunk(MQTTContext_t *pContext,
+                                          TransportOutVector_t *pIoVector,
+                                          size_t ioVectorLength,
+                                          size_t totalMessageLength,
+                                          const MQTTPublishInfo_t *pPublishInfo,
+                                          const uint16_t *pPacketIds,
+                                          MQTTStatus_t *pStatuses,
+                                          size_t publishCount);
+
+/**
+ * @brief Function to validate #MQTT_Publish parameters.
+ *
+ * @brief param[in] pContext Initialized MQTT context.
+ * @brief param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @brief param[in] packetId Packet Id for the MQTT PUBLISH packet.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ */
+static MQTTStatus_t validatePublishParams(const MQTTContext_t *pContext,
+                                          const MQTTPublishInfo_t *pPublishInfo,
+                                          uint16_t packetId);
+
+/**
+ * @brief Performs matching for special cases when a topic filter ends
+ * with a wildcard character.
+ *
+ * When the topic name has been consumed but there are remaining characters to
+ * to match in topic filter, this function handles the following 2 cases:
+ * - When the topic filter ends with "/+" or "/#" characters, but the topic
+ * name only ends with '/'.
+ * - When the topic filter ends with "/#" characters, but the topic name
+ * ends at the parent level.
+ *
+ * @note This function ASSUMES that the topic name been consumed in linear
+ * matching with the topic filer, but the topic filter has remaining characters
+ * to be matched.
+ *
+ * @param[in] pTopicFilter The topic filter containing the wildcard.
+ * @param[in] topicFilterLength Length of the topic filter being examined.
+ * @param[in] filterIndex Index of the topic filter being examined.
+ *
+ * @return Returns whether the topic filter and the topic name match.
+ */
+static bool matchEndWildcardsSpecialCases(const char *pTopicFilter,
+                                          uint16_t topicFilterLength,
+                                          uint16_t filterIndex);
+
+/**
+ * @brief Attempt to match topic name with a topic filter starting with a wildcard.
+ *
+ * If the topic filter starts with a '+' (single-level) wildcard, the function
+ * advances the @a pNameIndex by a level in the topic name.
+ * If the topic filter starts with a '#' (multi-level) wildcard, the function
+ * concludes that both the topic name and topic filter match.
+ *
+ * @param[in] pTopicName The topic name to match.
+ * @param[in] topicNameLength Length of the topic name.
+ * @param[in] pTopicFilter The topic filter to match.
+ * @param[in] topicFilterLength Length of the topic filter.
+ * @param[in,out] pNameIndex Current index in the topic name being examined. It is
+ * advanced by one level for `+` wildcards.
+ * @param[in, out] pFilterIndex Current index in the topic filter being examined.
+ * It is advanced to position of '/' level separator for '+' wildcard.
+ * @param[out] pMatch Whether the topic filter and topic name match.
+ *
+ * @return `true` if the caller of this function should exit; `false` if the
+ * caller should continue parsing the topics.
+ */
+static bool matchWildcards(const char *pTopicName,
+                           uint16_t topicNameLength,
+                           const char *pTopicFilter,
+                           uint16_t topicFilterLength,
+                           uint16_t *pNameIndex,
+                           uint16_t *pFilterIndex,
+                           bool *pMatch);
+
+/**
+ * @brief Match a topic name and topic filter allowing the use of wildcards.
+ *
+ * @param[in] pTopicName The topic name to check.
+ * @param[in] topicNameLength Length of the topic name.
+ * @param[in] pTopicFilter The topic filter to check.
+ * @param[in] topicFilterLength Length of topic filter.
+ *
+ * @return `true` if the topic name and topic filter match; `false` otherwise.
+ */
+static bool matchTopicFilter(const char *pTopicName,
+                             uint16_t topicNameLength,
+                             const char *pTopicFilter,
+                             uint16_t topicFilterLength);
+
+size_t addEncodedStringToVector(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
+                                const char *const string,
+                                uint16_t length,
+                                TransportOutVector_t *iterator,
+                                size_t *updatedLength);
+
+#if (MQTT_VERSION_5_ENABLED)
+
+size_t addEncodedStringToVectorWithId(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
+                                      const char *const string,
+                                      uint16_t length,
+                                      TransportOutVector_t *iterator,
+                                      size_t *updatedLength, uint8_t* packetId);
+
+
+size_t addEncodedStringToVectorWithId(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
+                                      const char *const string,
+                                      uint16_t length,
+                                      TransportOutVector_t *iterator,
+                                      size_t *updatedLength, uint8_t* packetId)
+{
+    size_t packetLength = 0U;
+    TransportOutVector_t *pLocalIterator = iterator;
+    size_t vectorsAdded = 0U;
+
+    /* When length is non-zero, the string must be non-NULL. */
+    assert((length != 0U) ? (string != NULL) : true);
+
+    serializedLength[0] = ((uint8_t)((length) >> 8));
+    serializedLength[1] = ((uint8_t)((length) & 0x00ffU));
+
+    /* Add the packet id first. */
+    pLocalIterator[0].iov_base = packetId;
+    pLocalIterator[0].iov_len = CORE_MQTT_ID_SIZE;
+    vectorsAdded++;
+    packetLength = CORE_MQTT_ID_SIZE;
+
+    /* Add the serialized length of the string. */
+    pLocalIterator[1].iov_base = serializedLength;
+    pLocalIterator[1].iov_len = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+    vectorsAdded++;
+    packetLength += CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+
+    /* Sometimes the string can be NULL that is, of 0 length. In that case,
+     * only the length field should be encoded in the vector. */
+    if ((string != NULL) && (length != 0U))
+    {
+        /* Then add the pointer to the string itself. */
+        pLocalIterator[2].iov_base = string;
+        pLocalIterator[2].iov_len = length;
+        vectorsAdded++;
+        packetLength += length;
+    }
+
+    (*updatedLength) = (*updatedLength) + packetLength;
+
+    return vectorsAdded;
+}
+
+#endif
+
+/*-----------------------------------------------------------*/
+
+size_t addEncodedStringToVector(uint8_t serializedLength[CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES],
+                                const char *const string,
+                                uint16_t length,
+                                TransportOutVector_t *iterator,
+                                size_t *updatedLength)
+{
+    size_t packetLength = 0U;
+    TransportOutVector_t *pLocalIterator = iterator;
+    size_t vectorsAdded = 0U;
+
+    /* When length is non-zero, the string must be non-NULL. */
+    assert((length != 0U) ? (string != NULL) : true);
+
+    serializedLength[0] = ((uint8_t)((length) >> 8));
+    serializedLength[1] = ((uint8_t)((length) & 0x00ffU));
+
+    /* Add the serialized length of the string first. */
+    pLocalIterator[0].iov_base = serializedLength;
+    pLocalIterator[0].iov_len = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+    vectorsAdded++;
+    packetLength = CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES;
+
+    /* Sometimes the string can be NULL that is, of 0 length. In that case,
+     * only the length field should be encoded in the vector. */
+    if ((string != NULL) && (length != 0U))
+    {
+        /* Then add the pointer to the string itself. */
+        pLocalIterator[1].iov_base = string;
+        pLocalIterator[1].iov_len = length;
+        vectorsAdded++;
+        packetLength += length;
+    }
+
+    (*updatedLength) = (*updatedLength) + packetLength;
+
+    return vectorsAdded;
+}
+
+static bool matchEndWildcardsSpecialCases(const char *pTopicFilter,
+                                          uint16_t topicFilterLength,
+                                          uint16_t filterIndex)
+{
+    bool matchFound = false;
+
+    assert(pTopicFilter != NULL);
+    assert(topicFilterLength != 0U);
 
     /* Check if the topic filter has 2 remaining characters and it ends in
      * "/#". This check handles the case to match filter "sport/#" with topic
@@ -670,823 +1408,4144 @@ static bool matchEndWildcardsSpecialCases(const char *pTopicFilter,
         (pTopicFilter[filterIndex + 2U] == '#'))
 
     {
-        matchFound = true;
+        matchFound = true;
+    }
+
+    /* Check if the next character is "#" or "+" and the topic filter ends in
+     * "/#" or "/+". This check handles the cases to match:
+     *
+     * - Topic filter "sport/+" with topic "sport/".
+     * - Topic filter "sport/#" with topic "sport/".
+     */
+    if ((filterIndex == (topicFilterLength - 2U)) &&
+        (pTopicFilter[filterIndex] == '/'))
+    {
+        /* Check that the last character is a wildcard. */
+        matchFound = (pTopicFilter[filterIndex + 1U] == '+') ||
+                     (pTopicFilter[filterIndex + 1U] == '#');
+    }
+
+    return matchFound;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool matchWildcards(const char *pTopicName,
+                           uint16_t topicNameLength,
+                           const char *pTopicFilter,
+                           uint16_t topicFilterLength,
+                           uint16_t *pNameIndex,
+                           uint16_t *pFilterIndex,
+                           bool *pMatch)
+{
+    bool shouldStopMatching = false;
+    bool locationIsValidForWildcard;
+
+    assert(pTopicName != NULL);
+    assert(topicNameLength != 0U);
+    assert(pTopicFilter != NULL);
+    assert(topicFilterLength != 0U);
+    assert(pNameIndex != NULL);
+    assert(pFilterIndex != NULL);
+    assert(pMatch != NULL);
+
+    /* Wild card in a topic filter is only valid either at the starting position
+     * or when it is preceded by a '/'.*/
+    locationIsValidForWildcard = (*pFilterIndex == 0u) ||
+                                 (pTopicFilter[*pFilterIndex - 1U] == '/');
+
+    if ((pTopicFilter[*pFilterIndex] == '+') && (locationIsValidForWildcard == true))
+    {
+        bool nextLevelExistsInTopicName = false;
+        bool nextLevelExistsinTopicFilter = false;
+
+        /* Move topic name index to the end of the current level. The end of the
+         * current level is identified by the last character before the next level
+         * separator '/'. */
+        while (*pNameIndex < topicNameLength)
+        {
+            /* Exit the loop if we hit the level separator. */
+            if (pTopicName[*pNameIndex] == '/')
+            {
+                nextLevelExistsInTopicName = true;
+                break;
+            }
+
+            (*pNameIndex)++;
+        }
+
+        /* Determine if the topic filter contains a child level after the current level
+         * represented by the '+' wildcard. */
+        if ((*pFilterIndex < (topicFilterLength - 1U)) &&
+            (pTopicFilter[*pFilterIndex + 1U] == '/'))
+        {
+            nextLevelExistsinTopicFilter = true;
+        }
+
+        /* If the topic name contains a child level but the topic filter ends at
+         * the current level, then there does not exist a match. */
+        if ((nextLevelExistsInTopicName == true) &&
+            (nextLevelExistsinTopicFilter == false))
+        {
+            *pMatch = false;
+            shouldStopMatching = true;
+        }
+
+        /* If the topic name and topic filter have child levels, then advance the
+         * filter index to the level separator in the topic filter, so that match
+         * can be performed in the next level.
+         * Note: The name index already points to the level separator in the topic
+         * name. */
+        else if (nextLevelExistsInTopicName == true)
+        {
+            (*pFilterIndex)++;
+        }
+        else
+        {
+            /* If we have reached here, the the loop terminated on the
+             * ( *pNameIndex < topicNameLength) condition, which means that have
+             * reached past the end of the topic name, and thus, we decrement the
+             * index to the last character in the topic name.*/
+            (*pNameIndex)--;
+        }
+    }
+
+    /* '#' matches everything remaining in the topic name. It must be the
+     * last character in a topic filter. */
+    else if ((pTopicFilter[*pFilterIndex] == '#') &&
+             (*pFilterIndex == (topicFilterLength - 1U)) &&
+             (locationIsValidForWildcard == true))
+    {
+        /* Subsequent characters don't need to be checked for the
+         * multi-level wildcard. */
+        *pMatch = true;
+        shouldStopMatching = true;
+    }
+    else
+    {
+        /* Any character mismatch other than '+' or '#' means the topic
+         * name does not match the topic filter. */
+        *pMatch = false;
+        shouldStopMatching = true;
+    }
+
+    return shouldStopMatching;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool matchTopicFilter(const char *pTopicName,
+                             uint16_t topicNameLength,
+                             const char *pTopicFilter,
+                             uint16_t topicFilterLength)
+{
+    bool matchFound = false, shouldStopMatching = false;
+    uint16_t nameIndex = 0, filterIndex = 0;
+
+    assert(pTopicName != NULL);
+    assert(topicNameLength != 0);
+    assert(pTopicFilter != NULL);
+    assert(topicFilterLength != 0);
+
+    while ((nameIndex < topicNameLength) && (filterIndex < topicFilterLength))
+    {
+        /* Check if the character in the topic name matches the corresponding
+         * character in the topic filter string. */
+        if (pTopicName[nameIndex] == pTopicFilter[filterIndex])
+        {
+            /* If the topic name has been consumed but the topic filter has not
+             * been consumed, match for special cases when the topic filter ends
+             * with wildcard character. */
+            if (nameIndex == (topicNameLength - 1U))
+            {
+                matchFound = matchEndWildcardsSpecialCases(pTopicFilter,
+                                                           topicFilterLength,
+                                                           filterIndex);
+            }
+        }
+        else
+        {
+            /* Check for matching wildcards. */
+            shouldStopMatching = matchWildcards(pTopicName,
+                                                topicNameLength,
+                                                pTopicFilter,
+                                                topicFilterLength,
+                                                &nameIndex,
+                                                &filterIndex,
+                                                &matchFound);
+        }
+
+        if ((matchFound == true) || (shouldStopMatching == true))
+        {
+            break;
+        }
+
+        /* Increment indexes. */
+        nameIndex++;
+        filterIndex++;
+    }
+
+    if (matchFound == false)
+    {
+        /* If the end of both strings has been reached, they match. This represents the
+         * case when the topic filter contains the '+' wildcard at a non-starting position.
+         * For example, when matching either of "sport/+/player" OR "sport/hockey/+" topic
+         * filters with "sport/hockey/player" topic name. */
+        matchFound = (nameIndex == topicNameLength) &&
+                     (filterIndex == topicFilterLength);
+    }
+
+    return matchFound;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t sendMessageVector(MQTTContext_t *pContext,
+                                 TransportOutVector_t *pIoVec,
+                                 size_t ioVecCount)
+{
+    int32_t sendResult;
+    uint32_t startTime;
+    TransportOutVector_t *pIoVectIterator;
+    size_t vectorsToBeSent = ioVecCount;
+    size_t bytesToSend = 0U;
+    int32_t bytesSentOrError = 0;
+    int32_t waitResult = 0;
+
+    assert(pContext != NULL);
+    assert(pIoVec != NULL);
+    assert(pContext->getTime != NULL);
+    /* Send must always be defined */
+    assert(pContext->transportInterface.send != NULL);
+
+    /* Without writev each vector takes a send call, so gather the small ones
+     * first. */
+    if ((pContext->transportInterface.writev == NULL) &&
+        (pContext->pSendStagingBuffer != NULL))
+    {
+        vectorsToBeSent = stageMessageVector(pContext, pIoVec, ioVecCount);
+        ioVecCount = vectorsToBeSent;
+    }
+
+    /* Count the total number of bytes to be sent as outlined in the vector. */
+    for (pIoVectIterator = pIoVec; pIoVectIterator <= &(pIoVec[ioVecCount - 1U]); pIoVectIterator++)
+    {
+        bytesToSend += pIoVectIterator->iov_len;
+    }
+
+    /* Reset the iterator to point to the first entry in the array. */
+    pIoVectIterator = pIoVec;
+
+    /* Queued publishes go out first so that packets do not interleave on the
+     * connection. */
+    if (drainTransmitQueue(pContext) != MQTTSuccess)
+    {
+        bytesSentOrError = -1;
+    }
+
+    /* Note the start time. */
+    startTime = pContext->getTime();
+
+    while ((bytesSentOrError < (int32_t)bytesToSend) && (bytesSentOrError >= 0))
+    {
+        if (pContext->transportInterface.writev != NULL)
+        {
+            sendResult = pContext->transportInterface.writev(pContext->transportInterface.pNetworkContext,
+                                                             pIoVectIterator,
+                                                             vectorsToBeSent);
+        }
+        else
+        {
+            sendResult = pContext->transportInterface.send(pContext->transportInterface.pNetworkContext,
+                                                           pIoVectIterator->iov_base,
+                                                           pIoVectIterator->iov_len);
+        }
+
+        if (sendResult > 0)
+        {
+            /* It is a bug in the application's transport send implementation if
+             * more bytes than expected are sent. */
+            assert(sendResult <= ((int32_t)bytesToSend - bytesSentOrError));
+
+            bytesSentOrError += sendResult;
+
+            /* Set last transmission time. */
+            pContext->lastPacketTxTime = pContext->getTime();
+
+            LogDebug(("sendMessageVector: Bytes Sent=%ld, Bytes Remaining=%lu",
+                      (long int)sendResult,
+                      (unsigned long)(bytesToSend - (size_t)bytesSentOrError)));
+        }
+        else if (sendResult < 0)
+        {
+            bytesSentOrError = sendResult;
+            LogError(("sendMessageVector: Unable to send packet: Network Error."));
+        }
+        else
+        {
+            /* Nothing was sent. Block until the transport can take more data
+             * instead of retrying right away. */
+            waitResult = waitForTransport(pContext, TransportWaitSend, startTime, MQTT_SEND_TIMEOUT_MS);
+
+            if (waitResult < 0)
+            {
+                bytesSentOrError = waitResult;
+                LogError(("sendMessageVector: Unable to send packet: Transport wait failed."));
+            }
+        }
+
+        /* Check for timeout. The clock is only read again when the transport
+         * did not take the whole packet. */
+        if ((bytesSentOrError >= 0) && (bytesSentOrError < (int32_t)bytesToSend) &&
+            (calculateElapsedTime(pContext->getTime(), startTime) > MQTT_SEND_TIMEOUT_MS))
+        {
+            LogError(("sendMessageVector: Unable to send packet: Timed out."));
+            break;
+        }
+
+        /* Update the send pointer to the correct vector and offset. */
+        while ((pIoVectIterator <= &(pIoVec[ioVecCount - 1U])) &&
+               (sendResult >= (int32_t)pIoVectIterator->iov_len))
+        {
+            sendResult -= (int32_t)pIoVectIterator->iov_len;
+            pIoVectIterator++;
+            /* Update the number of vector which are yet to be sent. */
+            vectorsToBeSent--;
+        }
+
+        /* Some of the bytes from this vector were sent as well, update the length
+         * and the pointer to data in this vector. */
+        if ((sendResult > 0) &&
+            (pIoVectIterator <= &(pIoVec[ioVecCount - 1U])))
+        {
+            pIoVectIterator->iov_base = (const void *)&(((const uint8_t *)pIoVectIterator->iov_base)[sendResult]);
+            pIoVectIterator->iov_len -= (size_t)sendResult;
+        }
+    }
+
+    return bytesSentOrError;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t stageMessageVector(const MQTTContext_t *pContext,
+                                 TransportOutVector_t *pIoVec,
+                                 size_t ioVecCount)
+{
+    size_t readIndex;
+    size_t writeIndex = 0U;
+    size_t stagedBytes = 0U;
+    bool runStarted = false;
+    TransportOutVector_t current;
+
+    for (readIndex = 0U; readIndex < ioVecCount; readIndex++)
+    {
+        /* Entries up to readIndex may be overwritten below. */
+        current = pIoVec[readIndex];
+
+        if ((current.iov_len <= MQTT_SEND_STAGING_THRESHOLD) &&
+            (current.iov_len <= (pContext->sendStagingBufferSize - stagedBytes)))
+        {
+            if (runStarted == false)
+            {
+                pIoVec[writeIndex].iov_base = &(pContext->pSendStagingBuffer[stagedBytes]);
+                pIoVec[writeIndex].iov_len = 0U;
+                writeIndex++;
+                runStarted = true;
+            }
+
+            if (current.iov_len > 0U)
+            {
+                (void)memcpy(&(pContext->pSendStagingBuffer[stagedBytes]),
+                             current.iov_base,
+                             current.iov_len);
+            }
+
+            stagedBytes += current.iov_len;
+            pIoVec[writeIndex - 1U].iov_len += current.iov_len;
+        }
+        else
+        {
+            /* Large vectors are sent from where they are. */
+            pIoVec[writeIndex] = current;
+            writeIndex++;
+            runStarted = false;
+        }
+    }
+
+    return writeIndex;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t sendBuffer(MQTTContext_t *pContext,
+                          const uint8_t *pBufferToSend,
+                          size_t bytesToSend,
+                          bool fromLoop)
+{
+    int32_t sendResult;
+    uint32_t startTime;
+    int32_t bytesSentOrError = 0;
+    int32_t waitResult = 0;
+    const uint8_t *pIndex = pBufferToSend;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+    assert(pContext->transportInterface.send != NULL);
+    assert(pIndex != NULL);
+
+    /* Queued publishes go out first so that packets do not interleave on the
+     * connection. */
+    if (drainTransmitQueue(pContext) != MQTTSuccess)
+    {
+        bytesSentOrError = -1;
+    }
+
+    /* Set the timeout. */
+    startTime = getSendTime(pContext, fromLoop);
+
+    while ((bytesSentOrError < (int32_t)bytesToSend) && (bytesSentOrError >= 0))
+    {
+        sendResult = pContext->transportInterface.send(pContext->transportInterface.pNetworkContext,
+                                                       pIndex,
+                                                       bytesToSend - (size_t)bytesSentOrError);
+
+        if (sendResult > 0)
+        {
+            /* It is a bug in the application's transport send implementation if
+             * more bytes than expected are sent. */
+            assert(sendResult <= ((int32_t)bytesToSend - bytesSentOrError));
+
+            bytesSentOrError += sendResult;
+            pIndex = &pIndex[sendResult];
+
+            /* Set last transmission time. */
+            pContext->lastPacketTxTime = getSendTime(pContext, fromLoop);
+
+            LogDebug(("sendBuffer: Bytes Sent=%ld, Bytes Remaining=%lu",
+                      (long int)sendResult,
+                      (unsigned long)(bytesToSend - (size_t)bytesSentOrError)));
+        }
+        else if (sendResult < 0)
+        {
+            bytesSentOrError = sendResult;
+            LogError(("sendBuffer: Unable to send packet: Network Error."));
+        }
+        else
+        {
+            /* Nothing was sent. Block until the transport can take more data
+             * instead of retrying right away. */
+            waitResult = waitForTransport(pContext, TransportWaitSend, startTime, MQTT_SEND_TIMEOUT_MS);
+
+            if (waitResult < 0)
+            {
+                bytesSentOrError = waitResult;
+                LogError(("sendBuffer: Unable to send packet: Transport wait failed."));
+            }
+        }
+
+        /* Check for timeout. The clock is only read again when the transport
+         * did not take the whole packet. */
+        if ((bytesSentOrError >= 0) && (bytesSentOrError < (int32_t)bytesToSend) &&
+            (calculateElapsedTime(pContext->getTime(), startTime) >= (MQTT_SEND_TIMEOUT_MS)))
+        {
+            LogError(("sendBuffer: Unable to send packet: Timed out."));
+            break;
+        }
+    }
+
+    return bytesSentOrError;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t sendBufferFromLoop(MQTTContext_t *pContext,
+                                  const uint8_t *pBufferToSend,
+                                  size_t bytesToSend)
+{
+    int32_t bytesSentOrError = 0;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+    assert(pBufferToSend != NULL);
+
+    if ((pContext->pTransmitQueue == NULL) ||
+        (reserveTransmitQueue(pContext, bytesToSend) == false))
+    {
+        bytesSentOrError = sendBuffer(pContext, pBufferToSend, bytesToSend, true);
+    }
+    else
+    {
+        /* The packet is queued behind the bytes already there, so that it is
+         * sent whole and in order, as far as the transport takes it. */
+        (void)memcpy(&(pContext->pTransmitQueue[pContext->transmitQueueTail]),
+                     pBufferToSend,
+                     bytesToSend);
+        pContext->transmitQueueTail += bytesToSend;
+
+        if (sendTransmitQueue(pContext, true) != MQTTSuccess)
+        {
+            bytesSentOrError = -1;
+        }
+        else
+        {
+            /* The packet is committed to the connection, so the keep alive
+             * and PINGRESP timeouts start now. */
+            pContext->lastPacketTxTime = getCurrentTime(pContext);
+            bytesSentOrError = (int32_t)bytesToSend;
+        }
+    }
+
+    return bytesSentOrError;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t calculateElapsedTime(uint32_t later,
+                                     uint32_t start)
+{
+    return later - start;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t calculateElapsedTimeFrom(uint32_t now,
+                                         uint32_t start)
+{
+    uint32_t elapsed = now - start;
+
+    /* A difference of more than half the range is a negative one. */
+    if (elapsed > 0x7FFFFFFFU)
+    {
+        elapsed = 0U;
+    }
+
+    return elapsed;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t getCurrentTime(MQTTContext_t *pContext)
+{
+    uint32_t now;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    if (pContext->coarseTimeValid == true)
+    {
+        now = pContext->coarseTimeMs;
+    }
+    else
+    {
+        now = pContext->getTime();
+
+        /* A pass which does not need the time does not read the clock. */
+        if (pContext->coarseTimePass == true)
+        {
+            pContext->coarseTimeMs = now;
+            pContext->coarseTimeValid = true;
+        }
+    }
+
+    return now;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t getSendTime(MQTTContext_t *pContext,
+                            bool fromLoop)
+{
+    uint32_t now;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    /* Only the loop thread may read the time of its pass. */
+    if (fromLoop == true)
+    {
+        now = getCurrentTime(pContext);
+    }
+    else
+    {
+        now = pContext->getTime();
+    }
+
+    return now;
+}
+
+/*-----------------------------------------------------------*/
+
+static void startCoarseTimePass(MQTTContext_t *pContext)
+{
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    pContext->coarseTimePass = pContext->coarseClock;
+    pContext->coarseTimeValid = false;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTPubAckType_t getAckFromPacketType(uint8_t packetType)
+{
+    MQTTPubAckType_t ackType = MQTTPuback;
+
+    switch (packetType)
+    {
+    case MQTT_PACKET_TYPE_PUBACK:
+        ackType = MQTTPuback;
+        break;
+
+    case MQTT_PACKET_TYPE_PUBREC:
+        ackType = MQTTPubrec;
+        break;
+
+    case MQTT_PACKET_TYPE_PUBREL:
+        ackType = MQTTPubrel;
+        break;
+
+    case MQTT_PACKET_TYPE_PUBCOMP:
+    default:
+
+        /* This function is only called after checking the type is one of
+         * the above four values, so packet type must be PUBCOMP here. */
+        assert(packetType == MQTT_PACKET_TYPE_PUBCOMP);
+        ackType = MQTTPubcomp;
+        break;
+    }
+
+    return ackType;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t recvExact(const MQTTContext_t *pContext,
+                         size_t bufferOffset,
+                         size_t bytesToRecv)
+{
+    uint8_t *pIndex = NULL;
+    size_t bytesRemaining = bytesToRecv;
+    int32_t totalBytesRecvd = 0, bytesRecvd;
+    uint32_t lastDataRecvTimeMs = 0U, timeSinceLastRecvMs = 0U;
+    TransportRecv_t recvFunc = NULL;
+    MQTTGetCurrentTimeFunc_t getTimeStampMs = NULL;
+    bool receiveError = false;
+
+    assert(pContext != NULL);
+    assert(bufferOffset <= pContext->networkBuffer.size);
+    assert(bytesToRecv <= (pContext->networkBuffer.size - bufferOffset));
+    assert(pContext->getTime != NULL);
+    assert(pContext->transportInterface.recv != NULL);
+    assert(pContext->networkBuffer.pBuffer != NULL);
+
+    pIndex = &(pContext->networkBuffer.pBuffer[bufferOffset]);
+    recvFunc = pContext->transportInterface.recv;
+    getTimeStampMs = pContext->getTime;
+
+    /* Part of the MQTT packet has been read before calling this function. */
+    lastDataRecvTimeMs = getTimeStampMs();
+
+    while ((bytesRemaining > 0U) && (receiveError == false))
+    {
+        bytesRecvd = recvFunc(pContext->transportInterface.pNetworkContext,
+                              pIndex,
+                              bytesRemaining);
+
+        if (bytesRecvd < 0)
+        {
+            LogError(("Network error while receiving packet: ReturnCode=%ld.",
+                      (long int)bytesRecvd));
+            totalBytesRecvd = bytesRecvd;
+            receiveError = true;
+        }
+        else if (bytesRecvd > 0)
+        {
+            /* Reset the starting time as we have received some data from the network. */
+            lastDataRecvTimeMs = getTimeStampMs();
+
+            /* It is a bug in the application's transport receive implementation
+             * if more bytes than expected are received. To avoid a possible
+             * overflow in converting bytesRemaining from unsigned to signed,
+             * this assert must exist after the check for bytesRecvd being
+             * negative. */
+            assert((size_t)bytesRecvd <= bytesRemaining);
+
+            bytesRemaining -= (size_t)bytesRecvd;
+            totalBytesRecvd += (int32_t)bytesRecvd;
+            /* Increment the index. */
+            pIndex = &pIndex[bytesRecvd];
+            LogDebug(("BytesReceived=%ld, BytesRemaining=%lu, TotalBytesReceived=%ld.",
+                      (long int)bytesRecvd,
+                      (unsigned long)bytesRemaining,
+                      (long int)totalBytesRecvd));
+        }
+        else
+        {
+            /* No bytes were read from the network. */
+            timeSinceLastRecvMs = calculateElapsedTime(getTimeStampMs(), lastDataRecvTimeMs);
+
+            /* Check for timeout if we have been waiting to receive any byte on the network. */
+            if (timeSinceLastRecvMs >= MQTT_RECV_POLLING_TIMEOUT_MS)
+            {
+                LogError(("Unable to receive packet: Timed out in transport recv."));
+                receiveError = true;
+            }
+            /* Block until more data arrives instead of polling. */
+            else if (waitForTransport(pContext,
+                                      TransportWaitRecv,
+                                      lastDataRecvTimeMs,
+                                      MQTT_RECV_POLLING_TIMEOUT_MS) < 0)
+            {
+                LogError(("Unable to receive packet: Transport wait failed."));
+                totalBytesRecvd = -1;
+                receiveError = true;
+            }
+            else
+            {
+                /* MISRA Empty body */
+            }
+        }
+    }
+
+    return totalBytesRecvd;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t discardExact(const MQTTContext_t *pContext,
+                            size_t bytesToDiscard)
+{
+    size_t bytesRemaining = bytesToDiscard;
+    int32_t totalBytesSkipped = 0, bytesSkipped;
+    uint32_t lastDataRecvTimeMs = 0U, timeSinceLastRecvMs = 0U;
+    TransportSkip_t skipFunc = NULL;
+    bool receiveError = false;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    skipFunc = pContext->transportInterface.skip;
+
+    if (skipFunc == NULL)
+    {
+        totalBytesSkipped = recvExact(pContext, 0U, bytesToDiscard);
+    }
+    else
+    {
+        lastDataRecvTimeMs = pContext->getTime();
+
+        while ((bytesRemaining > 0U) && (receiveError == false))
+        {
+            bytesSkipped = skipFunc(pContext->transportInterface.pNetworkContext,
+                                    bytesRemaining);
+
+            if (bytesSkipped < 0)
+            {
+                LogError(("Network error while skipping packet: ReturnCode=%ld.",
+                          (long int)bytesSkipped));
+                totalBytesSkipped = bytesSkipped;
+                receiveError = true;
+            }
+            else if (bytesSkipped > 0)
+            {
+                lastDataRecvTimeMs = pContext->getTime();
+
+                assert((size_t)bytesSkipped <= bytesRemaining);
+
+                bytesRemaining -= (size_t)bytesSkipped;
+                totalBytesSkipped += bytesSkipped;
+            }
+            else
+            {
+                timeSinceLastRecvMs = calculateElapsedTime(pContext->getTime(), lastDataRecvTimeMs);
+
+                if (timeSinceLastRecvMs >= MQTT_RECV_POLLING_TIMEOUT_MS)
+                {
+                    LogError(("Unable to skip packet: Timed out in transport skip."));
+                    receiveError = true;
+                }
+                else if (waitForTransport(pContext,
+                                          TransportWaitRecv,
+                                          lastDataRecvTimeMs,
+                                          MQTT_RECV_POLLING_TIMEOUT_MS) < 0)
+                {
+                    LogError(("Unable to skip packet: Transport wait failed."));
+                    totalBytesSkipped = -1;
+                    receiveError = true;
+                }
+                else
+                {
+                    /* MISRA Empty body */
+                }
+            }
+        }
+    }
+
+    return totalBytesSkipped;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t waitForTransport(const MQTTContext_t *pContext,
+                                TransportWaitEvent_t event,
+                                uint32_t startTimeMs,
+                                uint32_t timeoutMs)
+{
+    int32_t waitResult = 0;
+    uint32_t elapsedTimeMs = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    if (pContext->transportInterface.wait != NULL)
+    {
+        elapsedTimeMs = calculateElapsedTime(pContext->getTime(), startTimeMs);
+
+        if (elapsedTimeMs < timeoutMs)
+        {
+            waitResult = pContext->transportInterface.wait(pContext->transportInterface.pNetworkContext,
+                                                           event,
+                                                           timeoutMs - elapsedTimeMs);
+        }
+    }
+
+    return waitResult;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t discardPacket(const MQTTContext_t *pContext,
+                                  size_t remainingLength,
+                                  uint32_t timeoutMs)
+{
+    MQTTStatus_t status = MQTTRecvFailed;
+    int32_t bytesReceived = 0;
+    size_t bytesToReceive = 0U;
+    uint32_t totalBytesReceived = 0U;
+    uint32_t entryTimeMs = 0U;
+    uint32_t elapsedTimeMs = 0U;
+    MQTTGetCurrentTimeFunc_t getTimeStampMs = NULL;
+    bool receiveError = false;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    /* Without a skip function, the packet is received through the network
+     * buffer in chunks of its size. */
+    bytesToReceive = (pContext->transportInterface.skip != NULL) ? remainingLength : pContext->networkBuffer.size;
+    getTimeStampMs = pContext->getTime;
+
+    entryTimeMs = getTimeStampMs();
+
+    while ((totalBytesReceived < remainingLength) && (receiveError == false))
+    {
+        if ((remainingLength - totalBytesReceived) < bytesToReceive)
+        {
+            bytesToReceive = remainingLength - totalBytesReceived;
+        }
+
+        bytesReceived = discardExact(pContext, bytesToReceive);
+
+        if (bytesReceived != (int32_t)bytesToReceive)
+        {
+            LogError(("Receive error while discarding packet."
+                      "ReceivedBytes=%ld, ExpectedBytes=%lu.",
+                      (long int)bytesReceived,
+                      (unsigned long)bytesToReceive));
+            receiveError = true;
+        }
+        else
+        {
+            totalBytesReceived += (uint32_t)bytesReceived;
+
+            elapsedTimeMs = calculateElapsedTime(getTimeStampMs(), entryTimeMs);
+
+            /* Check for timeout. */
+            if (elapsedTimeMs >= timeoutMs)
+            {
+                LogError(("Time expired while discarding packet."));
+                receiveError = true;
+            }
+        }
+    }
+
+    if (totalBytesReceived == remainingLength)
+    {
+        LogError(("Dumped packet. DumpedBytes=%lu.",
+                  (unsigned long)totalBytesReceived));
+        /* Packet dumped, so no data is available. */
+        status = MQTTNoDataAvailable;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t discardStoredPacket(MQTTContext_t *pContext,
+                                        const MQTTPacketInfo_t *pPacketInfo)
+{
+    MQTTStatus_t status = MQTTRecvFailed;
+    int32_t bytesReceived = 0;
+    size_t bytesToReceive = 0U;
+    uint32_t totalBytesReceived = 0U;
+    bool receiveError = false;
+    size_t mqttPacketSize = 0;
+    size_t remainingLength;
+
+    assert(pContext != NULL);
+    assert(pPacketInfo != NULL);
+
+    mqttPacketSize = pPacketInfo->remainingLength + pPacketInfo->headerLength;
+
+    /* Assert that the packet being discarded is not complete in the
+     * receive buffer. */
+    assert(mqttPacketSize >= pContext->index);
+
+    /* Number of bytes depicted by 'index' have already been received. */
+    remainingLength = mqttPacketSize - pContext->index;
+
+    /* Discard these many bytes at a time. */
+    bytesToReceive = (pContext->transportInterface.skip != NULL) ? remainingLength : pContext->networkBuffer.size;
+
+    if (pContext->loopDeadlineSet == true)
+    {
+        /* Discard what is available now, and the rest in later calls. */
+        pContext->index = 0U;
+        pContext->discardRemaining = remainingLength;
+        status = discardPendingBytes(pContext);
+    }
+    else
+    {
+        while ((totalBytesReceived < remainingLength) && (receiveError == false))
+        {
+            if ((remainingLength - totalBytesReceived) < bytesToReceive)
+            {
+                bytesToReceive = remainingLength - totalBytesReceived;
+            }
+
+            bytesReceived = discardExact(pContext, bytesToReceive);
+
+            if (bytesReceived != (int32_t)bytesToReceive)
+            {
+                LogError(("Receive error while discarding packet."
+                          "ReceivedBytes=%ld, ExpectedBytes=%lu.",
+                          (long int)bytesReceived,
+                          (unsigned long)bytesToReceive));
+                receiveError = true;
+            }
+            else
+            {
+                totalBytesReceived += (uint32_t)bytesReceived;
+            }
+        }
+
+        if (totalBytesReceived == remainingLength)
+        {
+            LogError(("Dumped packet. DumpedBytes=%lu.",
+                      (unsigned long)totalBytesReceived));
+            /* Packet dumped, so no data is available. */
+            status = MQTTNoDataAvailable;
+        }
+    }
+
+    /* Clear the buffer, unless the skip function left it untouched. */
+    if (pContext->transportInterface.skip == NULL)
+    {
+        (void)memset(pContext->networkBuffer.pBuffer,
+                     0,
+                     pContext->networkBuffer.size);
+    }
+
+    /* Reset the index. */
+    pContext->index = 0;
+    pContext->readIndex = 0;
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool loopDeadlinePassed(const MQTTContext_t *pContext)
+{
+    bool deadlinePassed = false;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    if (pContext->loopDeadlineSet == true)
+    {
+        /* The deadline has passed when it is at most half the range of the
+         * timer behind the current time, which keeps working across overflow. */
+        deadlinePassed = (calculateElapsedTime(pContext->getTime(), pContext->loopDeadlineMs) < 0x80000000U);
+    }
+
+    return deadlinePassed;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t discardPendingBytes(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTNeedMoreBytes;
+    int32_t bytesReceived = 0;
+    size_t bytesToReceive = 0U;
+    bool discardMore = true;
+
+    assert(pContext != NULL);
+    assert(pContext->networkBuffer.pBuffer != NULL);
+    assert(pContext->index == 0U);
+
+    while ((pContext->discardRemaining > 0U) && (discardMore == true))
+    {
+        bytesToReceive = pContext->discardRemaining;
+
+        if (pContext->transportInterface.skip != NULL)
+        {
+            bytesReceived = pContext->transportInterface.skip(pContext->transportInterface.pNetworkContext,
+                                                              bytesToReceive);
+        }
+        else
+        {
+            if (bytesToReceive > pContext->networkBuffer.size)
+            {
+                bytesToReceive = pContext->networkBuffer.size;
+            }
+
+            bytesReceived = pContext->transportInterface.recv(pContext->transportInterface.pNetworkContext,
+                                                              pContext->networkBuffer.pBuffer,
+                                                              bytesToReceive);
+        }
+
+        if (bytesReceived < 0)
+        {
+            LogError(("Receive error while discarding packet: ReturnCode=%ld.",
+                      (long int)bytesReceived));
+            status = MQTTRecvFailed;
+            discardMore = false;
+        }
+        else if (bytesReceived == 0)
+        {
+            /* Continue once more data is available. */
+            discardMore = false;
+        }
+        else
+        {
+            assert((size_t)bytesReceived <= bytesToReceive);
+            pContext->discardRemaining -= (size_t)bytesReceived;
+            discardMore = !loopDeadlinePassed(pContext);
+        }
+    }
+
+    if (status == MQTTRecvFailed)
+    {
+        pContext->discardRemaining = 0U;
+    }
+    else if (pContext->discardRemaining == 0U)
+    {
+        LogError(("Dumped packet."));
+        /* Packet dumped, so no data is available. */
+        status = MQTTNoDataAvailable;
+    }
+    else
+    {
+        LogDebug(("Discarding packet: RemainingBytes=%lu.",
+                  (unsigned long)pContext->discardRemaining));
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t completeDiscardAck(MQTTContext_t *pContext,
+                                       MQTTStatus_t discardStatus)
+{
+    MQTTStatus_t status = discardStatus;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+
+    assert(pContext != NULL);
+    assert(pContext->discardRemaining == 0U);
+
+    packetId = pContext->discardAckPacketId;
+    pContext->discardAckPacketId = MQTT_PACKET_ID_INVALID;
+
+    if (packetId == MQTT_PACKET_ID_INVALID)
+    {
+        /* No ack waits for the discard. */
+    }
+    else if (discardStatus == MQTTNoDataAvailable)
+    {
+        status = sendPublishAcks(pContext, packetId, pContext->discardAckState);
+
+        if (status == MQTTSuccess)
+        {
+            status = discardStatus;
+        }
+    }
+    else
+    {
+        /* The publish is redelivered after the connection is established
+         * again, and filtered again. */
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+        (void)MQTT_RemoveIncomingStateRecord(pContext, packetId);
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receivePacket(MQTTContext_t *pContext,
+                                  MQTTPacketInfo_t incomingPacket,
+                                  uint32_t remainingTimeMs)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    int32_t bytesReceived = 0;
+    size_t bytesToReceive = 0U;
+    size_t packetLength = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->networkBuffer.pBuffer != NULL);
+    assert(pContext->index >= incomingPacket.headerLength);
+
+    packetLength = incomingPacket.headerLength + incomingPacket.remainingLength;
+
+    if (packetLength > pContext->networkBuffer.size)
+    {
+        LogError(("Incoming packet will be dumped: "
+                  "Packet length exceeds network buffer size."
+                  "PacketSize=%lu, NetworkBufferSize=%lu.",
+                  (unsigned long)packetLength,
+                  (unsigned long)pContext->networkBuffer.size));
+
+        /* All the bytes in the buffer belong to this packet. */
+        status = discardPacket(pContext,
+                               packetLength - pContext->index,
+                               remainingTimeMs);
+        pContext->index = 0U;
+    }
+    else if (pContext->index < packetLength)
+    {
+        /* Some of the packet may have been received along with the fixed
+         * header. */
+        bytesToReceive = packetLength - pContext->index;
+        bytesReceived = recvExact(pContext, pContext->index, bytesToReceive);
+
+        if (bytesReceived == (int32_t)bytesToReceive)
+        {
+            /* Receive successful, bytesReceived == bytesToReceive. */
+            LogDebug(("Packet received. ReceivedBytes=%ld.",
+                      (long int)bytesReceived));
+            pContext->index += bytesToReceive;
+        }
+        else
+        {
+            LogError(("Packet reception failed. ReceivedBytes=%ld, "
+                      "ExpectedBytes=%lu.",
+                      (long int)bytesReceived,
+                      (unsigned long)bytesToReceive));
+            status = MQTTRecvFailed;
+        }
+    }
+    else
+    {
+        LogDebug(("Packet was received along with its fixed header."));
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t getAckTypeToSend(MQTTPublishState_t state)
+{
+    uint8_t packetTypeByte = 0U;
+
+    switch (state)
+    {
+    case MQTTPubAckSend:
+        packetTypeByte = MQTT_PACKET_TYPE_PUBACK;
+        break;
+
+    case MQTTPubRecSend:
+        packetTypeByte = MQTT_PACKET_TYPE_PUBREC;
+        break;
+
+    case MQTTPubRelSend:
+        packetTypeByte = MQTT_PACKET_TYPE_PUBREL;
+        break;
+
+    case MQTTPubCompSend:
+        packetTypeByte = MQTT_PACKET_TYPE_PUBCOMP;
+        break;
+
+    case MQTTPubAckPending:
+    case MQTTPubCompPending:
+    case MQTTPubRecPending:
+    case MQTTPubRelPending:
+    case MQTTPublishDone:
+    case MQTTPublishSend:
+    case MQTTStateNull:
+    default:
+        /* Take no action for states that do not require sending an ack. */
+        break;
+    }
+
+    return packetTypeByte;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPublishAcks(MQTTContext_t *pContext,
+                                    uint16_t packetId,
+                                    MQTTPublishState_t publishState)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishState_t newState = MQTTStateNull;
+    int32_t sendResult = 0;
+    uint8_t packetTypeByte = 0U;
+    MQTTPubAckType_t packetType;
+    MQTTFixedBuffer_t localBuffer;
+    uint8_t pubAckPacket[MQTT_PUBLISH_ACK_PACKET_SIZE];
+
+    localBuffer.pBuffer = pubAckPacket;
+    localBuffer.size = MQTT_PUBLISH_ACK_PACKET_SIZE;
+
+    assert(pContext != NULL);
+
+    packetTypeByte = getAckTypeToSend(publishState);
+
+    if ((packetTypeByte != 0U) && (pContext->pAckBuffer != NULL))
+    {
+        /* The ack is sent, and the state updated, with the other collected
+         * acks. */
+        status = stageAck(pContext, packetTypeByte, packetId);
+    }
+    else if (packetTypeByte != 0U)
+    {
+        packetType = getAckFromPacketType(packetTypeByte);
+
+        status = MQTT_SerializeAck(&localBuffer,
+                                   packetTypeByte,
+                                   packetId);
+
+        if (status == MQTTSuccess)
+        {
+            MQTT_PRE_SEND_HOOK(pContext);
+
+            /* Here, we are not using the vector approach for efficiency. There is just one buffer
+             * to be sent which can be achieved with a normal send call. */
+            sendResult = sendBufferFromLoop(pContext,
+                                            localBuffer.pBuffer,
+                                            MQTT_PUBLISH_ACK_PACKET_SIZE);
+
+            MQTT_POST_SEND_HOOK(pContext);
+        }
+
+        if (sendResult == (int32_t)MQTT_PUBLISH_ACK_PACKET_SIZE)
+        {
+            pContext->controlPacketSent = true;
+
+            MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+            status = MQTT_UpdateStateAck(pContext,
+                                         packetId,
+                                         packetType,
+                                         MQTT_SEND,
+                                         &newState);
+
+            MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+            if (status != MQTTSuccess)
+            {
+                LogError(("Failed to update state of publish %hu.",
+                          (unsigned short)packetId));
+            }
+        }
+        else
+        {
+            LogError(("Failed to send ACK packet: PacketType=%02x, SentBytes=%ld, "
+                      "PacketSize=%lu.",
+                      (unsigned int)packetTypeByte, (long int)sendResult,
+                      MQTT_PUBLISH_ACK_PACKET_SIZE));
+            status = MQTTSendFailed;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t stageAck(MQTTContext_t *pContext,
+                             uint8_t packetTypeByte,
+                             uint16_t packetId)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTFixedBuffer_t localBuffer;
+    size_t offset = 0U;
+    const uint8_t *pAck = NULL;
+    bool ackStaged = false;
+
+    assert(pContext != NULL);
+    assert(pContext->pAckBuffer != NULL);
+
+    /* The ack of a duplicate PUBLISH may already be waiting to be sent, and
+     * the state of its publish can only be updated once. */
+    for (offset = 0U; offset < pContext->ackBufferIndex; offset += MQTT_PUBLISH_ACK_PACKET_SIZE)
+    {
+        pAck = &(pContext->pAckBuffer[offset]);
+
+        if ((pAck[0] == packetTypeByte) &&
+            (pAck[2] == (uint8_t)(packetId >> 8)) &&
+            (pAck[3] == (uint8_t)(packetId & 0x00FFU)))
+        {
+            ackStaged = true;
+            break;
+        }
+    }
+
+    if (ackStaged == true)
+    {
+        /* Nothing to do. */
+    }
+    else if ((pContext->ackBufferIndex + MQTT_PUBLISH_ACK_PACKET_SIZE) > pContext->ackBufferSize)
+    {
+        status = flushAcks(pContext);
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    if ((status == MQTTSuccess) && (ackStaged == false))
+    {
+        localBuffer.pBuffer = &(pContext->pAckBuffer[pContext->ackBufferIndex]);
+        localBuffer.size = MQTT_PUBLISH_ACK_PACKET_SIZE;
+
+        status = MQTT_SerializeAck(&localBuffer,
+                                   packetTypeByte,
+                                   packetId);
+    }
+
+    if ((status == MQTTSuccess) && (ackStaged == false))
+    {
+        pContext->ackBufferIndex += MQTT_PUBLISH_ACK_PACKET_SIZE;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t flushAcks(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t ackStatus = MQTTSuccess;
+    MQTTPublishState_t newState = MQTTStateNull;
+    int32_t sendResult = 0;
+    size_t ackBytes = 0U;
+    size_t offset = 0U;
+    const uint8_t *pAck = NULL;
+    uint16_t packetId = 0U;
+
+    assert(pContext != NULL);
+
+    ackBytes = pContext->ackBufferIndex;
+
+    if (ackBytes > 0U)
+    {
+        /* The buffer is emptied whether or not it can be sent. The publishes of
+         * acks which are not sent keep their state. */
+        pContext->ackBufferIndex = 0U;
+
+        MQTT_PRE_SEND_HOOK(pContext);
+
+        sendResult = sendBufferFromLoop(pContext,
+                                        pContext->pAckBuffer,
+                                        ackBytes);
+
+        MQTT_POST_SEND_HOOK(pContext);
+
+        if (sendResult == (int32_t)ackBytes)
+        {
+            pContext->controlPacketSent = true;
+
+            MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+            for (offset = 0U; offset < ackBytes; offset += MQTT_PUBLISH_ACK_PACKET_SIZE)
+            {
+                /* Each ack is the packet type, a remaining length of 2, and the
+                 * packet ID. */
+                pAck = &(pContext->pAckBuffer[offset]);
+                packetId = (uint16_t)(((uint16_t)pAck[2] << 8) | (uint16_t)pAck[3]);
+
+                ackStatus = MQTT_UpdateStateAck(pContext,
+                                                packetId,
+                                                getAckFromPacketType(pAck[0]),
+                                                MQTT_SEND,
+                                                &newState);
+
+                if (ackStatus != MQTTSuccess)
+                {
+                    LogError(("Failed to update state of publish %hu.",
+                              (unsigned short)packetId));
+
+                    /* Report the first failure, and update the other
+                     * publishes. */
+                    if (status == MQTTSuccess)
+                    {
+                        status = ackStatus;
+                    }
+                }
+            }
+
+            MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        }
+        else
+        {
+            LogError(("Failed to send acks: SentBytes=%ld, Size=%lu.",
+                      (long int)sendResult,
+                      (unsigned long)ackBytes));
+            status = MQTTSendFailed;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t completeReceiveLoop(MQTTContext_t *pContext,
+                                        MQTTStatus_t loopStatus)
+{
+    MQTTStatus_t status = loopStatus;
+    MQTTStatus_t flushStatus = MQTTSuccess;
+
+    assert(pContext != NULL);
+
+    flushStatus = flushTransmitQueue(pContext);
+
+    if (flushStatus == MQTTSuccess)
+    {
+        flushStatus = flushAcks(pContext);
+    }
+
+    if ((flushStatus != MQTTSuccess) &&
+        ((status == MQTTSuccess) || (status == MQTTNeedMoreBytes) ||
+         (status == MQTTNoDataAvailable)))
+    {
+        status = flushStatus;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t enqueuePublish(MQTTContext_t *pContext,
+                                   const MQTTPublishInfo_t *pPublishInfo,
+                                   const uint8_t *pMqttHeader,
+                                   size_t headerSize,
+                                   uint16_t packetId)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t packetSize;
+    uint8_t *pIndex;
+
+    assert(pContext != NULL);
+    assert(pContext->pTransmitQueue != NULL);
+
+    packetSize = headerSize + pPublishInfo->topicNameLength + pPublishInfo->payloadLength;
+
+    if (pPublishInfo->qos > MQTTQoS0)
+    {
+        packetSize += 2U;
+    }
+
+    if (reserveTransmitQueue(pContext, packetSize) == false)
+    {
+        LogError(("Transmit queue is full: PacketSize=%lu, FreeSpace=%lu.",
+                  (unsigned long)packetSize,
+                  (unsigned long)(pContext->transmitQueueSize - pContext->transmitQueueTail)));
+        status = MQTTNoMemory;
+    }
+    else
+    {
+        pIndex = &(pContext->pTransmitQueue[pContext->transmitQueueTail]);
+
+        (void)memcpy(pIndex, pMqttHeader, headerSize);
+        pIndex = &pIndex[headerSize];
+        (void)memcpy(pIndex, pPublishInfo->pTopicName, pPublishInfo->topicNameLength);
+        pIndex = &pIndex[pPublishInfo->topicNameLength];
+
+        if (pPublishInfo->qos > MQTTQoS0)
+        {
+            pIndex[0] = ((uint8_t)((packetId) >> 8));
+            pIndex[1] = ((uint8_t)((packetId) & 0x00ffU));
+            pIndex = &pIndex[2U];
+        }
+
+        if (pPublishInfo->payloadLength > 0U)
+        {
+            (void)memcpy(pIndex, pPublishInfo->pPayload, pPublishInfo->payloadLength);
+        }
+
+        pContext->transmitQueueTail += packetSize;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool reserveTransmitQueue(MQTTContext_t *pContext,
+                                 size_t packetSize)
+{
+    size_t packetStart = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->pTransmitQueue != NULL);
+
+    if ((packetSize > (pContext->transmitQueueSize - pContext->transmitQueueTail)) &&
+        (pContext->transmitQueueHead > 0U))
+    {
+        /* A partly sent packet is moved whole, so that the queue still starts
+         * with a packet. */
+        skipSentPackets(pContext);
+        packetStart = pContext->transmitQueuePacketStart;
+
+        if (packetStart > 0U)
+        {
+            (void)memmove(pContext->pTransmitQueue,
+                          &(pContext->pTransmitQueue[packetStart]),
+                          pContext->transmitQueueTail - packetStart);
+            pContext->transmitQueueHead -= packetStart;
+            pContext->transmitQueueTail -= packetStart;
+            pContext->transmitQueuePacketStart = 0U;
+        }
+    }
+
+    return (packetSize <= (pContext->transmitQueueSize - pContext->transmitQueueTail));
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t getQueuedPacketSize(const uint8_t *pPacket)
+{
+    size_t remainingLength = 0U;
+    size_t multiplier = 1U;
+    size_t index = 1U;
+    uint8_t encodedByte = 0U;
+
+    assert(pPacket != NULL);
+
+    /* The packets were serialized by this library, so the remaining length
+     * is at most four bytes. */
+    do
+    {
+        encodedByte = pPacket[index];
+        remainingLength += ((size_t)encodedByte & 0x7FU) * multiplier;
+        multiplier *= 128U;
+        index++;
+    } while (((encodedByte & 0x80U) != 0U) && (index < 5U));
+
+    return index + remainingLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static void skipSentPackets(MQTTContext_t *pContext)
+{
+    size_t packetSize = 0U;
+    bool packetSent = true;
+
+    assert(pContext != NULL);
+
+    while ((pContext->transmitQueuePacketStart < pContext->transmitQueueHead) &&
+           (packetSent == true))
+    {
+        packetSize = getQueuedPacketSize(&(pContext->pTransmitQueue[pContext->transmitQueuePacketStart]));
+
+        if ((pContext->transmitQueuePacketStart + packetSize) <= pContext->transmitQueueHead)
+        {
+            pContext->transmitQueuePacketStart += packetSize;
+        }
+        else
+        {
+            packetSent = false;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t dropTransmitQueue(MQTTContext_t *pContext)
+{
+    size_t droppedCount = 0U;
+    size_t offset = 0U;
+    uint8_t packetType = 0U;
+
+    assert(pContext != NULL);
+
+    if (pContext->transmitQueueHead < pContext->transmitQueueTail)
+    {
+        LogWarn(("Dropping the unsent bytes of the transmit queue: QueuedBytes=%lu.",
+                 (unsigned long)(pContext->transmitQueueTail - pContext->transmitQueueHead)));
+
+        skipSentPackets(pContext);
+
+        for (offset = pContext->transmitQueuePacketStart;
+             offset < pContext->transmitQueueTail;
+             offset += getQueuedPacketSize(&(pContext->pTransmitQueue[offset])))
+        {
+            packetType = pContext->pTransmitQueue[offset];
+
+            if (((packetType & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH) &&
+                ((packetType & CORE_MQTT_PUBLISH_QOS_MASK) == 0U))
+            {
+                droppedCount++;
+            }
+        }
+    }
+
+    pContext->transmitQueueHead = 0U;
+    pContext->transmitQueueTail = 0U;
+    pContext->transmitQueuePacketStart = 0U;
+
+    return droppedCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendTransmitQueue(MQTTContext_t *pContext,
+                                      bool fromLoop)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    int32_t sendResult = 1;
+    bool bytesSent = false;
+
+    assert(pContext != NULL);
+
+    while ((pContext->transmitQueueHead < pContext->transmitQueueTail) && (sendResult > 0))
+    {
+        sendResult = pContext->transportInterface.send(pContext->transportInterface.pNetworkContext,
+                                                       &(pContext->pTransmitQueue[pContext->transmitQueueHead]),
+                                                       pContext->transmitQueueTail - pContext->transmitQueueHead);
+
+        if (sendResult > 0)
+        {
+            /* It is a bug in the application's transport send implementation if
+             * more bytes than expected are sent. */
+            assert((size_t)sendResult <= (pContext->transmitQueueTail - pContext->transmitQueueHead));
+
+            pContext->transmitQueueHead += (size_t)sendResult;
+            bytesSent = true;
+        }
+        else if (sendResult < 0)
+        {
+            LogError(("Failed to send the transmit queue: Network Error."));
+            status = MQTTSendFailed;
+        }
+        else
+        {
+            /* The transport is full. The rest is sent by the next call. */
+        }
+    }
+
+    /* The clock is read once for all the bytes sent. */
+    if (bytesSent == true)
+    {
+        pContext->lastPacketTxTime = getSendTime(pContext, fromLoop);
+    }
+
+    if (pContext->transmitQueueHead == pContext->transmitQueueTail)
+    {
+        pContext->transmitQueueHead = 0U;
+        pContext->transmitQueueTail = 0U;
+        pContext->transmitQueuePacketStart = 0U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t flushTransmitQueue(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    assert(pContext != NULL);
+
+    if (pContext->pTransmitQueue != NULL)
+    {
+        MQTT_PRE_SEND_HOOK(pContext);
+
+        status = sendTransmitQueue(pContext, true);
+
+        MQTT_POST_SEND_HOOK(pContext);
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t drainTransmitQueue(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t startTime;
+    size_t queuedBytes = 0U;
+    int32_t waitResult = 0;
+
+    assert(pContext != NULL);
+
+    if ((pContext->pTransmitQueue != NULL) &&
+        (pContext->transmitQueueHead < pContext->transmitQueueTail))
+    {
+        startTime = pContext->getTime();
+        queuedBytes = pContext->transmitQueueTail - pContext->transmitQueueHead;
+        status = sendTransmitQueue(pContext, false);
+
+        while ((status == MQTTSuccess) &&
+               (pContext->transmitQueueHead < pContext->transmitQueueTail))
+        {
+            /* The timeout is for a transport which takes nothing, so it
+             * starts again whenever some bytes are sent. */
+            if ((pContext->transmitQueueTail - pContext->transmitQueueHead) < queuedBytes)
+            {
+                startTime = pContext->getTime();
+                queuedBytes = pContext->transmitQueueTail - pContext->transmitQueueHead;
+            }
+
+            /* Another packet cannot be sent before the queued bytes. Wait
+             * for the transport to take more of them. */
+            if (calculateElapsedTime(pContext->getTime(), startTime) >= (MQTT_SEND_TIMEOUT_MS))
+            {
+                LogError(("Failed to send the transmit queue: Timed out, "
+                          "QueuedBytes=%lu.",
+                          (unsigned long)queuedBytes));
+                status = MQTTSendFailed;
+            }
+            else
+            {
+                waitResult = waitForTransport(pContext, TransportWaitSend, startTime, MQTT_SEND_TIMEOUT_MS);
+
+                if (waitResult < 0)
+                {
+                    LogError(("Failed to send the transmit queue: Transport wait failed."));
+                    status = MQTTSendFailed;
+                }
+                else
+                {
+                    status = sendTransmitQueue(pContext, false);
+                }
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleKeepAlive(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t now = 0U;
+    uint32_t packetTxTimeoutMs = 0U;
+    uint32_t lastPacketTxTime = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+
+    now = getCurrentTime(pContext);
+
+    packetTxTimeoutMs = 1000U * (uint32_t)pContext->keepAliveIntervalSec;
+
+    if (PACKET_TX_TIMEOUT_MS < packetTxTimeoutMs)
+    {
+        packetTxTimeoutMs = PACKET_TX_TIMEOUT_MS;
+    }
+
+    /* If keep alive interval is 0, it is disabled. The PINGRESP cannot be
+     * received while the reception is paused, so its timeout is not checked. */
+    if ((pContext->waitingForPingResp == true) &&
+        (pContext->receivePaused == false))
+    {
+        /* Has time expired? */
+        if (calculateElapsedTimeFrom(now, pContext->pingReqSendTimeMs) >
+            MQTT_PINGRESP_TIMEOUT_MS)
+        {
+            status = MQTTKeepAliveTimeout;
+        }
+    }
+    else
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+        lastPacketTxTime = pContext->lastPacketTxTime;
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        if ((packetTxTimeoutMs != 0U) && (calculateElapsedTimeFrom(now, lastPacketTxTime) >= packetTxTimeoutMs))
+        {
+            status = sendPingreq(pContext, true);
+        }
+        else if (pContext->waitingForPingResp == true)
+        {
+            /* A PINGREQ is already outstanding while the reception is paused. */
+        }
+        else
+        {
+            const uint32_t timeElapsed = calculateElapsedTimeFrom(now, pContext->lastPacketRxTime);
+
+            if ((timeElapsed != 0U) && (timeElapsed >= PACKET_RX_TIMEOUT_MS))
+            {
+                status = sendPingreq(pContext, true);
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPingreq(MQTTContext_t *pContext,
+                                bool fromLoop)
+{
+    int32_t sendResult = 0;
+    MQTTStatus_t status = MQTTSuccess;
+    size_t packetSize = 0U;
+    /* MQTT ping packets are of fixed length. */
+    uint8_t pingreqPacket[2U];
+    MQTTFixedBuffer_t localBuffer;
+
+    assert(pContext != NULL);
+
+    localBuffer.pBuffer = pingreqPacket;
+    localBuffer.size = sizeof(pingreqPacket);
+
+    /* Get MQTT PINGREQ packet size. */
+    status = MQTT_GetPingreqPacketSize(&packetSize);
+
+    if (status == MQTTSuccess)
+    {
+        assert(packetSize == localBuffer.size);
+        LogDebug(("MQTT PINGREQ packet size is %lu.",
+                  (unsigned long)packetSize));
+    }
+    else
+    {
+        LogError(("Failed to get the PINGREQ packet size."));
+    }
+
+    if (status == MQTTSuccess)
+    {
+        /* Serialize MQTT PINGREQ. */
+        status = MQTT_SerializePingreq(&localBuffer);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        /* Take the mutex as the send call should not be interrupted in
+         * between. */
+        MQTT_PRE_SEND_HOOK(pContext);
+
+        /* Send the serialized PINGREQ packet to transport layer.
+         * Here, we do not use the vectored IO approach for efficiency as the
+         * Ping packet does not have numerous fields which need to be copied
+         * from the user provided buffers. Thus it can be sent directly. */
+        if (fromLoop == true)
+        {
+            sendResult = sendBufferFromLoop(pContext,
+                                            localBuffer.pBuffer,
+                                            packetSize);
+        }
+        else
+        {
+            sendResult = sendBuffer(pContext,
+                                    localBuffer.pBuffer,
+                                    packetSize,
+                                    false);
+        }
+
+        /* Give the mutex away. */
+        MQTT_POST_SEND_HOOK(pContext);
+
+        /* It is an error to not send the entire PINGREQ packet. */
+        if (sendResult < (int32_t)packetSize)
+        {
+            LogError(("Transport send failed for PINGREQ packet."));
+            status = MQTTSendFailed;
+        }
+        else
+        {
+            pContext->pingReqSendTimeMs = pContext->lastPacketTxTime;
+            pContext->waitingForPingResp = true;
+            LogDebug(("Sent %ld bytes of PINGREQ packet.",
+                      (long int)sendResult));
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t updateIncomingPublishState(MQTTContext_t *pContext,
+                                               uint16_t packetIdentifier,
+                                               const MQTTPublishInfo_t *pPublishInfo,
+                                               MQTTPublishState_t *pPublishRecordState,
+                                               bool *pDuplicatePublish)
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    assert(pContext != NULL);
+    assert(pPublishInfo != NULL);
+    assert(pPublishRecordState != NULL);
+    assert(pDuplicatePublish != NULL);
+
+    *pDuplicatePublish = false;
+
+    if ((pContext->incomingPublishRecords == NULL) &&
+        (pPublishInfo->qos > MQTTQoS0))
+    {
+        LogError(("Incoming publish has QoS > MQTTQoS0 but incoming "
+                  "publish records have not been initialized. Dropping the "
+                  "incoming publish. Please call MQTT_InitStatefulQoS to enable "
+                  "use of QoS1 and QoS2 publishes."));
+        status = MQTTRecvFailed;
+    }
+
+    if (status == MQTTSuccess)
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+        status = MQTT_UpdateStatePublish(pContext,
+                                         packetIdentifier,
+                                         MQTT_RECEIVE,
+                                         pPublishInfo->qos,
+                                         pPublishRecordState);
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        /* The records of the publishes with a staged ack are only released
+         * when the acks are sent, so send them to make room. */
+        if ((status == MQTTNoMemory) && (pContext->ackBufferIndex > 0U))
+        {
+            status = flushAcks(pContext);
+
+            if (status == MQTTSuccess)
+            {
+                MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+                status = MQTT_UpdateStatePublish(pContext,
+                                                 packetIdentifier,
+                                                 MQTT_RECEIVE,
+                                                 pPublishInfo->qos,
+                                                 pPublishRecordState);
+
+                MQTT_POST_STATE_UPDATE_HOOK(pContext);
+            }
+        }
+
+        if (status == MQTTSuccess)
+        {
+            LogInfo(("State record updated. New state=%s.",
+                     MQTT_State_strerror(*pPublishRecordState)));
+        }
+        /* Different cases in which an incoming publish with duplicate flag is
+         * handled are as listed below.
+         * 1. No collision - This is the first instance of the incoming publish
+         *    packet received or an earlier received packet state is lost. This
+         *    will be handled as a new incoming publish for both QoS1 and QoS2
+         *    publishes.
+         * 2. Collision - The incoming packet was received before and a state
+         *    record is present in the state engine. For QoS1 and QoS2 publishes
+         *    this case can happen at 2 different cases and handling is
+         *    different.
+         *    a. QoS1 - If a PUBACK is not successfully sent for the incoming
+         *       publish due to a connection issue, it can result in broker
+         *       sending out a duplicate publish with dup flag set, when a
+         *       session is reestablished. It can result in a collision in
+         *       state engine. This will be handled by processing the incoming
+         *       publish as a new publish ignoring the
+         *       #MQTTStateCollision status from the state engine. The publish
+         *       data is not passed to the application.
+         *    b. QoS2 - If a PUBREC is not successfully sent for the incoming
+         *       publish or the PUBREC sent is not successfully received by the
+         *       broker due to a connection issue, it can result in broker
+         *       sending out a duplicate publish with dup flag set, when a
+         *       session is reestablished. It can result in a collision in
+         *       state engine. This will be handled by ignoring the
+         *       #MQTTStateCollision status from the state engine. The publish
+         *       data is not passed to the application. */
+        else if (status == MQTTStateCollision)
+        {
+            status = MQTTSuccess;
+            *pDuplicatePublish = true;
+
+            /* Calculate the state for the ack packet that needs to be sent out
+             * for the duplicate incoming publish. */
+            *pPublishRecordState = MQTT_CalculateStatePublish(MQTT_RECEIVE,
+                                                              pPublishInfo->qos);
+
+            LogDebug(("Incoming publish packet with packet id %hu already exists.",
+                      (unsigned short)packetIdentifier));
+
+            if (pPublishInfo->dup == false)
+            {
+                LogError(("DUP flag is 0 for duplicate packet (MQTT-3.3.1.-1)."));
+            }
+        }
+        else
+        {
+            LogError(("Error in updating publish state for incoming publish with packet id %hu."
+                      " Error is %s",
+                      (unsigned short)packetIdentifier,
+                      MQTT_Status_strerror(status)));
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleIncomingPublish(MQTTContext_t *pContext,
+                                          MQTTPacketInfo_t *pIncomingPacket)
+{
+    MQTTStatus_t status = MQTTBadParameter;
+    MQTTPublishState_t publishRecordState = MQTTStateNull;
+    uint16_t packetIdentifier = 0U;
+    MQTTPublishInfo_t publishInfo;
+    MQTTDeserializedInfo_t deserializedInfo;
+    bool duplicatePublish = false;
+    bool dropPublish = false;
+
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pContext->appCallback != NULL);
+
+    status = MQTT_DeserializePublish(pIncomingPacket, &packetIdentifier, &publishInfo);
+    LogInfo(("De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
+             MQTT_Status_strerror(status)));
+
+    if (status == MQTTSuccess)
+    {
+        status = updateIncomingPublishState(pContext,
+                                            packetIdentifier,
+                                            &publishInfo,
+                                            &publishRecordState,
+                                            &duplicatePublish);
+    }
+
+    /* The state record of a QoS 1 publish is removed once it is acknowledged,
+     * so its redeliveries are looked up in the cache. */
+    if ((status == MQTTSuccess) && (duplicatePublish == false) &&
+        (publishInfo.qos == MQTTQoS1) && (pContext->pQoS1DedupCache != NULL))
+    {
+        duplicatePublish = checkQoS1Duplicate(pContext, packetIdentifier, &publishInfo);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        deserializedInfo.packetIdentifier = packetIdentifier;
+        deserializedInfo.pPublishInfo = &publishInfo;
+        deserializedInfo.deserializationResult = status;
+
+        /* Duplicates and publishes rejected by the filter are only acked. */
+        dropPublish = (duplicatePublish == true) ||
+                      ((pContext->publishFilterCallback != NULL) &&
+                       (pContext->publishFilterCallback(pContext, &deserializedInfo) == false));
+
+        status = dispatchIncomingPublish(pContext,
+                                         pIncomingPacket,
+                                         packetIdentifier,
+                                         &publishInfo,
+                                         publishRecordState,
+                                         duplicatePublish,
+                                         dropPublish);
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t dispatchIncomingPublish(MQTTContext_t *pContext,
+                                            MQTTPacketInfo_t *pIncomingPacket,
+                                            uint16_t packetIdentifier,
+                                            MQTTPublishInfo_t *pPublishInfo,
+                                            MQTTPublishState_t publishRecordState,
+                                            bool duplicatePublish,
+                                            bool dropPublish)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTDeserializedInfo_t deserializedInfo;
+    MQTTPublishBatchEntry_t *pEntry = NULL;
+    bool originalInBatch = false;
+    size_t i = 0U;
+
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pPublishInfo != NULL);
+    assert(pContext->appCallback != NULL);
+
+    deserializedInfo.packetIdentifier = packetIdentifier;
+    deserializedInfo.pPublishInfo = pPublishInfo;
+    deserializedInfo.deserializationResult = MQTTSuccess;
+
+    if (pContext->publishBatchCallback != NULL)
+    {
+        if (dropPublish == false)
+        {
+            pEntry = &(pContext->pPublishBatch[pContext->publishBatchCount]);
+            pEntry->publishInfo = *pPublishInfo;
+            pEntry->deserializedInfo.packetIdentifier = packetIdentifier;
+            pEntry->deserializedInfo.pPublishInfo = &(pEntry->publishInfo);
+            pEntry->deserializedInfo.deserializationResult = MQTTSuccess;
+            pEntry->publishRecordState = publishRecordState;
+            pContext->publishBatchCount++;
+        }
+        else if ((duplicatePublish == true) && (pPublishInfo->qos == MQTTQoS1))
+        {
+            /* The PUBACK of the original PUBLISH, if it is still in the batch,
+             * also acknowledges the duplicate. The record of the publish is
+             * removed once it is sent, so a second PUBACK could not be sent. */
+            for (i = 0U; i < pContext->publishBatchCount; i++)
+            {
+                if (pContext->pPublishBatch[i].deserializedInfo.packetIdentifier == packetIdentifier)
+                {
+                    originalInBatch = true;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            /* A PUBREC is sent again for a duplicate QoS 2 PUBLISH. */
+        }
+
+        /* Acks are sent in the order the PUBLISH packets were received, so the
+         * batch is delivered before a dropped publish is acknowledged. */
+        if ((dropPublish == true) ||
+            (pContext->publishBatchCount == pContext->publishBatchSize))
+        {
+            status = deliverPublishBatch(pContext);
+        }
+
+        if ((status == MQTTSuccess) && (dropPublish == true) &&
+            (originalInBatch == false))
+        {
+            status = sendPublishAcks(pContext,
+                                     packetIdentifier,
+                                     publishRecordState);
+        }
+    }
+    else
+    {
+        /* Invoke application callback to hand the buffer over to application
+         * before sending acks.
+         * Application callback will be invoked for all publishes, except for
+         * duplicate incoming publishes and those rejected by the filter. */
+        if (dropPublish == false)
+        {
+            pContext->appCallback(pContext,
+                                  pIncomingPacket,
+                                  &deserializedInfo);
+        }
+
+        /* Send PUBACK or PUBREC if necessary. */
+        status = sendPublishAcks(pContext,
+                                 packetIdentifier,
+                                 publishRecordState);
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t hashPublish(const MQTTPublishInfo_t *pPublishInfo)
+{
+    uint32_t hash = 2166136261U;
+    const uint8_t *pBytes = NULL;
+    size_t i = 0U;
+
+    assert(pPublishInfo != NULL);
+
+    pBytes = (const uint8_t *)pPublishInfo->pTopicName;
+
+    for (i = 0U; i < pPublishInfo->topicNameLength; i++)
+    {
+        hash = (hash ^ (uint32_t)pBytes[i]) * 16777619U;
+    }
+
+    pBytes = (const uint8_t *)pPublishInfo->pPayload;
+
+    for (i = 0U; i < pPublishInfo->payloadLength; i++)
+    {
+        hash = (hash ^ (uint32_t)pBytes[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool checkQoS1Duplicate(MQTTContext_t *pContext,
+                               uint16_t packetIdentifier,
+                               const MQTTPublishInfo_t *pPublishInfo)
+{
+    bool duplicatePublish = false;
+    uint32_t hash = 0U;
+    uint32_t now = 0U;
+    MQTTQoS1DedupEntry_t *pEntry = NULL;
+    size_t i = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->pQoS1DedupCache != NULL);
+    assert(pPublishInfo != NULL);
+
+    hash = hashPublish(pPublishInfo);
+    now = getCurrentTime(pContext);
+
+    /* Only a redelivery has the DUP flag set. */
+    if (pPublishInfo->dup == true)
+    {
+        for (i = 0U; i < pContext->qos1DedupCacheSize; i++)
+        {
+            pEntry = &(pContext->pQoS1DedupCache[i]);
+
+            if ((pEntry->packetId == packetIdentifier) &&
+                (pEntry->hash == hash) &&
+                ((pContext->qos1DedupWindowMs == 0U) ||
+                 (calculateElapsedTime(now, pEntry->receiveTimeMs) <= pContext->qos1DedupWindowMs)))
+            {
+                LogInfo(("Suppressing redelivered QoS 1 publish: PacketId=%hu.",
+                         (unsigned short)packetIdentifier));
+                pEntry->receiveTimeMs = now;
+                duplicatePublish = true;
+                break;
+            }
+        }
+    }
+
+    if (duplicatePublish == false)
+    {
+        /* Replace the oldest entry. */
+        pEntry = &(pContext->pQoS1DedupCache[pContext->qos1DedupCacheNext]);
+        pEntry->packetId = packetIdentifier;
+        pEntry->hash = hash;
+        pEntry->receiveTimeMs = now;
+
+        pContext->qos1DedupCacheNext++;
+
+        if (pContext->qos1DedupCacheNext == pContext->qos1DedupCacheSize)
+        {
+            pContext->qos1DedupCacheNext = 0U;
+        }
+    }
+
+    return duplicatePublish;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t deliverPublishBatch(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const MQTTPublishBatchEntry_t *pEntry = NULL;
+    size_t i = 0U;
+    bool receiveBufferLoanable = false;
+    bool callbackRunning = false;
+
+    assert(pContext != NULL);
+
+    if (pContext->publishBatchCount > 0U)
+    {
+        LogDebug(("Delivering batch of incoming PUBLISH packets: BatchLength=%lu.",
+                  (unsigned long)pContext->publishBatchCount));
+
+        /* The application may take the buffer holding the batch while its
+         * callback runs, unless it is borrowed from the overflow pool. */
+        receiveBufferLoanable = pContext->receiveBufferLoanable;
+        callbackRunning = pContext->callbackRunning;
+        pContext->receiveBufferLoanable = (pContext->primaryNetworkBuffer.pBuffer == NULL);
+        pContext->callbackRunning = true;
+
+        pContext->publishBatchCallback(pContext,
+                                       pContext->pPublishBatch,
+                                       pContext->publishBatchCount);
+
+        pContext->receiveBufferLoanable = receiveBufferLoanable;
+        pContext->callbackRunning = callbackRunning;
+
+        if (pContext->receiveBufferLoaned == true)
+        {
+            /* Continue with a buffer from the pool while the application
+             * handles the batch. The bytes not yet consumed, which may include
+             * the packet being handled, are copied to it. */
+            switchReceiveBuffer(pContext,
+                                &(pContext->networkBuffer.pBuffer[pContext->readIndex]));
+        }
+
+        /* Send PUBACK or PUBREC if necessary, once for the whole batch. */
+        for (i = 0U; (i < pContext->publishBatchCount) && (status == MQTTSuccess); i++)
+        {
+            pEntry = &(pContext->pPublishBatch[i]);
+            status = sendPublishAcks(pContext,
+                                     pEntry->deserializedInfo.packetIdentifier,
+                                     pEntry->publishRecordState);
+        }
+
+        pContext->publishBatchCount = 0U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receiveIntoBuffer(MQTTContext_t *pContext,
+                                      size_t bytesInBuffer)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    int32_t bytesReceived = 0;
+    size_t bytesToReceive = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->readIndex == 0U);
+    assert(bytesInBuffer <= pContext->networkBuffer.size);
+
+    if (pContext->index < bytesInBuffer)
+    {
+        bytesToReceive = bytesInBuffer - pContext->index;
+        bytesReceived = recvExact(pContext, pContext->index, bytesToReceive);
+
+        if (bytesReceived == (int32_t)bytesToReceive)
+        {
+            pContext->index += bytesToReceive;
+        }
+        else
+        {
+            LogError(("Packet reception failed. ReceivedBytes=%ld, "
+                      "ExpectedBytes=%lu.",
+                      (long int)bytesReceived,
+                      (unsigned long)bytesToReceive));
+            status = MQTTRecvFailed;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receivePublishHeader(MQTTContext_t *pContext,
+                                         const MQTTPacketInfo_t *pIncomingPacket,
+                                         size_t *pPublishHeaderLength)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t packetLength = 0U;
+    size_t headerLength = 0U;
+    const uint8_t *pTopicNameLength = NULL;
+
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pPublishHeaderLength != NULL);
+
+    packetLength = pIncomingPacket->headerLength + pIncomingPacket->remainingLength;
+
+    /* The topic name length is the first field of the variable header. */
+    headerLength = pIncomingPacket->headerLength + sizeof(uint16_t);
+
+    if (headerLength > packetLength)
+    {
+        status = MQTTBadResponse;
+    }
+    else
+    {
+        status = receiveIntoBuffer(pContext, headerLength);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        pTopicNameLength = &(pContext->networkBuffer.pBuffer[pIncomingPacket->headerLength]);
+        headerLength += ((size_t)pTopicNameLength[0] << 8) | (size_t)pTopicNameLength[1];
+
+        /* QoS 1 and 2 PUBLISH packets have a packet identifier after the
+         * topic name. The QoS is in bits 1 and 2 of the first byte. */
+        if ((pIncomingPacket->type & 0x06U) != 0U)
+        {
+            headerLength += sizeof(uint16_t);
+        }
+
+        if (headerLength > packetLength)
+        {
+            LogError(("Topic name of PUBLISH exceeds the packet length."));
+            status = MQTTBadResponse;
+        }
+        else if (headerLength > pContext->networkBuffer.size)
+        {
+            LogError(("Header of PUBLISH does not fit in the network buffer: "
+                      "HeaderLength=%lu, NetworkBufferSize=%lu.",
+                      (unsigned long)headerLength,
+                      (unsigned long)pContext->networkBuffer.size));
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            status = receiveIntoBuffer(pContext, headerLength);
+        }
+    }
+
+    *pPublishHeaderLength = headerLength;
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receivePublishFragments(MQTTContext_t *pContext,
+                                            MQTTDeserializedInfo_t *pDeserializedInfo,
+                                            size_t publishHeaderLength,
+                                            bool giveToApplication)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishInfo_t *pPublishInfo = NULL;
+    size_t payloadOffset = 0U;
+    size_t fragmentLength = 0U;
+    int32_t bytesReceived = 0;
+    const uint8_t *pFragment = NULL;
+
+    assert(pContext != NULL);
+    assert(pDeserializedInfo != NULL);
+    assert(pDeserializedInfo->pPublishInfo != NULL);
+
+    pPublishInfo = pDeserializedInfo->pPublishInfo;
+
+    /* Fill the rest of the network buffer so that the first fragment, which
+     * carries the topic name, is never empty. The packet is larger than the
+     * buffer, so this never reads past its end. */
+    status = receiveIntoBuffer(pContext, pContext->networkBuffer.size);
+
+    if (status == MQTTSuccess)
+    {
+        /* The payload bytes after the header are the first fragment. */
+        pFragment = &(pContext->networkBuffer.pBuffer[publishHeaderLength]);
+        fragmentLength = pContext->index - publishHeaderLength;
+
+        do
+        {
+            /* Duplicates are not given to the application, but their payload
+             * still has to be read from the network. */
+            if (giveToApplication == true)
+            {
+                pContext->publishFragmentCallback(pContext,
+                                                  pDeserializedInfo,
+                                                  pFragment,
+                                                  fragmentLength,
+                                                  payloadOffset);
+            }
+
+            payloadOffset += fragmentLength;
+
+            /* The following fragments overwrite the topic name. */
+            pPublishInfo->pTopicName = NULL;
+            pPublishInfo->topicNameLength = 0U;
+
+            if (payloadOffset < pPublishInfo->payloadLength)
+            {
+                fragmentLength = pPublishInfo->payloadLength - payloadOffset;
+
+                if ((giveToApplication == true) || (pContext->transportInterface.skip == NULL))
+                {
+                    if (fragmentLength > pContext->networkBuffer.size)
+                    {
+                        fragmentLength = pContext->networkBuffer.size;
+                    }
+
+                    bytesReceived = recvExact(pContext, 0U, fragmentLength);
+                }
+                else
+                {
+                    /* The rest of a payload nobody reads is skipped at once. */
+                    bytesReceived = discardExact(pContext, fragmentLength);
+                }
+
+                if (bytesReceived != (int32_t)fragmentLength)
+                {
+                    LogError(("Receive error while streaming PUBLISH payload. "
+                              "ReceivedBytes=%ld, ExpectedBytes=%lu.",
+                              (long int)bytesReceived,
+                              (unsigned long)fragmentLength));
+                    status = MQTTRecvFailed;
+                }
+
+                pFragment = pContext->networkBuffer.pBuffer;
+            }
+        } while ((status == MQTTSuccess) && (payloadOffset < pPublishInfo->payloadLength));
+
+        /* Tell the application that the rest of the payload will not come. */
+        if ((status != MQTTSuccess) && (giveToApplication == true))
+        {
+            pDeserializedInfo->deserializationResult = status;
+            pContext->publishFragmentCallback(pContext,
+                                              pDeserializedInfo,
+                                              NULL,
+                                              0U,
+                                              payloadOffset);
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receivePayloadDirect(MQTTContext_t *pContext,
+                                         size_t publishHeaderLength,
+                                         size_t payloadLength,
+                                         uint8_t *pDestination,
+                                         size_t *pBytesAfterPacket)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint8_t *pIndex = pDestination;
+    size_t bytesBuffered = 0U;
+    size_t bytesRemaining = 0U;
+    int32_t bytesRecvd = 0;
+    uint32_t lastDataRecvTimeMs = 0U;
+    TransportInVector_t ioVec[2];
+
+    assert(pContext != NULL);
+    assert(pContext->getTime != NULL);
+    assert(pDestination != NULL);
+    assert(pBytesAfterPacket != NULL);
+    assert(pContext->index >= publishHeaderLength);
+
+    /* The start of the payload may already be in the network buffer. */
+    bytesBuffered = pContext->index - publishHeaderLength;
+    assert(bytesBuffered <= payloadLength);
+
+    (void)memcpy(pDestination,
+                 &(pContext->networkBuffer.pBuffer[publishHeaderLength]),
+                 bytesBuffered);
+    pIndex = &pDestination[bytesBuffered];
+    bytesRemaining = payloadLength - bytesBuffered;
+    pContext->index = publishHeaderLength;
+    *pBytesAfterPacket = 0U;
+
+    lastDataRecvTimeMs = pContext->getTime();
+
+    while ((bytesRemaining > 0U) && (status == MQTTSuccess))
+    {
+        if (pContext->transportInterface.readv != NULL)
+        {
+            /* Receive whatever follows the PUBLISH behind its header, which
+             * is no longer needed in the network buffer. */
+            ioVec[0].iov_base = pIndex;
+            ioVec[0].iov_len = bytesRemaining;
+            ioVec[1].iov_base = &(pContext->networkBuffer.pBuffer[publishHeaderLength]);
+            ioVec[1].iov_len = pContext->networkBuffer.size - publishHeaderLength;
+
+            bytesRecvd = pContext->transportInterface.readv(pContext->transportInterface.pNetworkContext,
+                                                            ioVec,
+                                                            2U);
+        }
+        else
+        {
+            bytesRecvd = pContext->transportInterface.recv(pContext->transportInterface.pNetworkContext,
+                                                           pIndex,
+                                                           bytesRemaining);
+        }
+
+        if (bytesRecvd < 0)
+        {
+            LogError(("Network error while receiving PUBLISH payload: ReturnCode=%ld.",
+                      (long int)bytesRecvd));
+            status = MQTTRecvFailed;
+        }
+        else if (bytesRecvd > 0)
+        {
+            lastDataRecvTimeMs = pContext->getTime();
+
+            if ((size_t)bytesRecvd > bytesRemaining)
+            {
+                /* The payload is complete and the next packet has started. */
+                *pBytesAfterPacket = (size_t)bytesRecvd - bytesRemaining;
+                assert(*pBytesAfterPacket <= (pContext->networkBuffer.size - publishHeaderLength));
+                bytesRecvd = (int32_t)bytesRemaining;
+            }
+
+            bytesRemaining -= (size_t)bytesRecvd;
+            pIndex = &pIndex[bytesRecvd];
+        }
+        else if (calculateElapsedTime(pContext->getTime(), lastDataRecvTimeMs) >= MQTT_RECV_POLLING_TIMEOUT_MS)
+        {
+            LogError(("Unable to receive PUBLISH payload: Timed out in transport recv."));
+            status = MQTTRecvFailed;
+        }
+        /* Block until more data arrives instead of polling. */
+        else if (waitForTransport(pContext,
+                                  TransportWaitRecv,
+                                  lastDataRecvTimeMs,
+                                  MQTT_RECV_POLLING_TIMEOUT_MS) < 0)
+        {
+            LogError(("Unable to receive PUBLISH payload: Transport wait failed."));
+            status = MQTTRecvFailed;
+        }
+        else
+        {
+            /* MISRA Empty body */
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receiveStreamedPublish(MQTTContext_t *pContext,
+                                           MQTTPacketInfo_t *pIncomingPacket)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishState_t publishRecordState = MQTTStateNull;
+    uint16_t packetIdentifier = 0U;
+    MQTTPublishInfo_t publishInfo;
+    MQTTDeserializedInfo_t deserializedInfo;
+    bool duplicatePublish = false;
+    bool rejectedPublish = false;
+    bool recordAdded = false;
+    size_t packetLength = 0U;
+    size_t publishHeaderLength = 0U;
+    size_t bytesAfterPacket = 0U;
+    uint8_t *pDestination = NULL;
+
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pContext->appCallback != NULL);
+
+    packetLength = pIncomingPacket->headerLength + pIncomingPacket->remainingLength;
+
+    /* The packet is received from the front of the network buffer. */
+    wrapReceiveWindow(pContext);
+
+    status = receivePublishHeader(pContext, pIncomingPacket, &publishHeaderLength);
+
+    if (status == MQTTSuccess)
+    {
+        pIncomingPacket->pRemainingData = &(pContext->networkBuffer.pBuffer[pIncomingPacket->headerLength]);
+
+        status = MQTT_DeserializePublish(pIncomingPacket, &packetIdentifier, &publishInfo);
+        LogInfo(("De-serialized header of streamed incoming PUBLISH packet: DeserializerResult=%s.",
+                 MQTT_Status_strerror(status)));
+    }
+
+    if (status == MQTTSuccess)
+    {
+        status = updateIncomingPublishState(pContext,
+                                            packetIdentifier,
+                                            &publishInfo,
+                                            &publishRecordState,
+                                            &duplicatePublish);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        recordAdded = (duplicatePublish == false) && (publishInfo.qos > MQTTQoS0);
+
+        deserializedInfo.packetIdentifier = packetIdentifier;
+        deserializedInfo.pPublishInfo = &publishInfo;
+        deserializedInfo.deserializationResult = status;
+        publishInfo.pPayload = NULL;
+
+        if ((duplicatePublish == false) && (pContext->publishFilterCallback != NULL))
+        {
+            rejectedPublish = !pContext->publishFilterCallback(pContext, &deserializedInfo);
+        }
+
+        if ((duplicatePublish == false) && (rejectedPublish == false) &&
+            (pContext->payloadDestinationCallback != NULL))
+        {
+            pDestination = pContext->payloadDestinationCallback(pContext, &deserializedInfo);
+        }
+
+        if (rejectedPublish == true)
+        {
+            /* The payload is dropped without being received into a buffer. */
+            LogDebug(("Discarding payload of incoming PUBLISH rejected by the "
+                      "filter: PayloadLength=%lu.",
+                      (unsigned long)publishInfo.payloadLength));
+            status = discardStoredPacket(pContext, pIncomingPacket);
+
+            /* The rest of the payload may still be discarded in the following
+             * calls of #MQTT_ProcessLoopUntil, and the ack is sent once it
+             * is. */
+            if (status == MQTTNeedMoreBytes)
+            {
+                pContext->discardAckPacketId = packetIdentifier;
+                pContext->discardAckState = publishRecordState;
+                status = MQTTSuccess;
+            }
+            else if (status == MQTTNoDataAvailable)
+            {
+                status = MQTTSuccess;
+            }
+            else
+            {
+                /* The receive failed. */
+            }
+        }
+        else if (pDestination != NULL)
+        {
+            status = receivePayloadDirect(pContext,
+                                          publishHeaderLength,
+                                          publishInfo.payloadLength,
+                                          pDestination,
+                                          &bytesAfterPacket);
+            publishInfo.pPayload = pDestination;
+        }
+        else if (packetLength <= pContext->networkBuffer.size)
+        {
+            status = receiveIntoBuffer(pContext, packetLength);
+            publishInfo.pPayload = &(pContext->networkBuffer.pBuffer[publishHeaderLength]);
+        }
+        else
+        {
+            if ((duplicatePublish == false) && (pContext->publishFragmentCallback == NULL))
+            {
+                LogWarn(("Discarding payload of incoming PUBLISH which does not fit "
+                         "in the network buffer: PayloadLength=%lu.",
+                         (unsigned long)publishInfo.payloadLength));
+            }
+
+            status = receivePublishFragments(pContext,
+                                             &deserializedInfo,
+                                             publishHeaderLength,
+                                             (duplicatePublish == false) &&
+                                                 (pContext->publishFragmentCallback != NULL));
+        }
+
+        /* The publish was not received, so its redelivery must not be taken
+         * as a duplicate. */
+        if ((status != MQTTSuccess) && (recordAdded == true))
+        {
+            MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+            (void)MQTT_RemoveIncomingStateRecord(pContext, packetIdentifier);
+            MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        }
+    }
+
+    if ((status == MQTTSuccess) && (publishInfo.pPayload != NULL))
+    {
+        /* A loan of the network buffer by the batch callback moves the bytes
+         * received after the packet with the header. */
+        pContext->index = publishHeaderLength + bytesAfterPacket;
+
+        /* A publish with a complete payload is delivered as in
+         * #handleIncomingPublish, once it has been checked against the QoS 1
+         * redelivery cache. */
+        if ((duplicatePublish == false) && (publishInfo.qos == MQTTQoS1) &&
+            (pContext->pQoS1DedupCache != NULL))
+        {
+            duplicatePublish = checkQoS1Duplicate(pContext, packetIdentifier, &publishInfo);
+        }
+
+        status = dispatchIncomingPublish(pContext,
+                                         pIncomingPacket,
+                                         packetIdentifier,
+                                         &publishInfo,
+                                         publishRecordState,
+                                         duplicatePublish,
+                                         duplicatePublish);
+
+        /* The network buffer holding the topic name is reused for the next
+         * packet, so the batch cannot wait for it. */
+        if (status == MQTTSuccess)
+        {
+            status = deliverPublishBatch(pContext);
+        }
+    }
+    else if ((status == MQTTSuccess) && (pContext->discardRemaining == 0U))
+    {
+        /* Send PUBACK or PUBREC only after the whole payload is received or
+         * discarded. */
+        status = sendPublishAcks(pContext,
+                                 packetIdentifier,
+                                 publishRecordState);
+    }
+    else
+    {
+        /* MISRA else. */
+    }
+
+    if (status == MQTTNoMemory)
+    {
+        /* The topic name is too long to be streamed. */
+        status = discardStoredPacket(pContext, pIncomingPacket);
+    }
+    else
+    {
+        /* The whole packet has been consumed. Keep the bytes received after it,
+         * which are behind the PUBLISH header. */
+        if (bytesAfterPacket > 0U)
+        {
+            (void)memmove(pContext->networkBuffer.pBuffer,
+                          &(pContext->networkBuffer.pBuffer[publishHeaderLength]),
+                          bytesAfterPacket);
+        }
+
+        pContext->index = bytesAfterPacket;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handlePublishAcks(MQTTContext_t *pContext,
+                                      MQTTPacketInfo_t *pIncomingPacket)
+{
+    MQTTStatus_t status = MQTTBadResponse;
+    MQTTPublishState_t publishRecordState = MQTTStateNull;
+    uint16_t packetIdentifier;
+    MQTTPubAckType_t ackType;
+    MQTTEventCallback_t appCallback;
+    MQTTDeserializedInfo_t deserializedInfo;
+    MQTTPublishCompletion_t completion = {0};
+    bool completed = false;
+
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pContext->appCallback != NULL);
+
+    appCallback = pContext->appCallback;
+
+    ackType = getAckFromPacketType(pIncomingPacket->type);
+
+    /* An ack which only holds the packet identifier is decoded here. The
+     * packet type, with its fixed flags, was checked by the caller. */
+    if ((pIncomingPacket->remainingLength == CORE_MQTT_SIMPLE_ACK_REMAINING_LENGTH) &&
+        (pIncomingPacket->pRemainingData != NULL))
+    {
+        packetIdentifier = (uint16_t)(((uint16_t)pIncomingPacket->pRemainingData[0] << 8) |
+                                      (uint16_t)pIncomingPacket->pRemainingData[1]);
+
+        if (packetIdentifier != MQTT_PACKET_ID_INVALID)
+        {
+            status = MQTTSuccess;
+        }
+        else
+        {
+            LogError(("Packet identifier cannot be 0."));
+            status = MQTTBadResponse;
+        }
+    }
+    else
+    {
+        status = MQTT_DeserializeAck(pIncomingPacket, &packetIdentifier, NULL);
     }
 
-    /* Check if the next character is "#" or "+" and the topic filter ends in
-     * "/#" or "/+". This check handles the cases to match:
-     *
-     * - Topic filter "sport/+" with topic "sport/".
-     * - Topic filter "sport/#" with topic "sport/".
-     */
-    if ((filterIndex == (topicFilterLength - 2U)) &&
-        (pTopicFilter[filterIndex] == '/'))
+    LogInfo(("Ack packet deserialized with result: %s.",
+             MQTT_Status_strerror(status)));
+
+    if (status == MQTTSuccess)
     {
-        /* Check that the last character is a wildcard. */
-        matchFound = (pTopicFilter[filterIndex + 1U] == '+') ||
-                     (pTopicFilter[filterIndex + 1U] == '#');
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+        status = MQTT_UpdateStateAck(pContext,
+                                     packetIdentifier,
+                                     ackType,
+                                     MQTT_RECEIVE,
+                                     &publishRecordState);
+
+        /* Only the PUBACK or PUBCOMP of an outgoing PUBLISH completes it. */
+        if ((status == MQTTSuccess) && (publishRecordState == MQTTPublishDone))
+        {
+            completed = takePublishCompletion(pContext, packetIdentifier, &completion);
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        if (status == MQTTSuccess)
+        {
+            LogInfo(("State record updated. New state=%s.",
+                     MQTT_State_strerror(publishRecordState)));
+        }
+        else
+        {
+            LogError(("Updating the state engine for packet id %hu"
+                      " failed with error %s.",
+                      (unsigned short)packetIdentifier,
+                      MQTT_Status_strerror(status)));
+        }
     }
 
-    return matchFound;
+    if (status == MQTTSuccess)
+    {
+        /* Set fields of deserialized struct. */
+        deserializedInfo.packetIdentifier = packetIdentifier;
+        deserializedInfo.deserializationResult = status;
+        deserializedInfo.pPublishInfo = NULL;
+
+        /* Invoke application callback to hand the buffer over to application
+         * before sending acks. */
+        appCallback(pContext, pIncomingPacket, &deserializedInfo);
+
+        if (completed == true)
+        {
+            completion.completeCallback(pContext,
+                                        packetIdentifier,
+                                        MQTTSuccess,
+                                        calculateElapsedTimeFrom(getCurrentTime(pContext),
+                                                                 completion.sendTimeMs),
+                                        completion.pUserContext);
+        }
+
+        /* Send PUBREL or PUBCOMP if necessary. */
+        status = sendPublishAcks(pContext,
+                                 packetIdentifier,
+                                 publishRecordState);
+    }
+
+    return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static bool matchWildcards(const char *pTopicName,
-                           uint16_t topicNameLength,
-                           const char *pTopicFilter,
-                           uint16_t topicFilterLength,
-                           uint16_t *pNameIndex,
-                           uint16_t *pFilterIndex,
-                           bool *pMatch)
+static MQTTPublishCompletion_t *findPublishCompletion(const MQTTContext_t *pContext,
+                                                      uint16_t packetId)
 {
-    bool shouldStopMatching = false;
-    bool locationIsValidForWildcard;
+    MQTTPublishCompletion_t *pCompletion = NULL;
+    size_t i;
 
-    assert(pTopicName != NULL);
-    assert(topicNameLength != 0U);
-    assert(pTopicFilter != NULL);
-    assert(topicFilterLength != 0U);
-    assert(pNameIndex != NULL);
-    assert(pFilterIndex != NULL);
-    assert(pMatch != NULL);
+    assert(pContext != NULL);
 
-    /* Wild card in a topic filter is only valid either at the starting position
-     * or when it is preceded by a '/'.*/
-    locationIsValidForWildcard = (*pFilterIndex == 0u) ||
-                                 (pTopicFilter[*pFilterIndex - 1U] == '/');
+    for (i = 0U; (i < pContext->publishCompletionCount) && (pCompletion == NULL); i++)
+    {
+        if (pContext->pPublishCompletions[i].packetId == packetId)
+        {
+            pCompletion = &(pContext->pPublishCompletions[i]);
+        }
+    }
 
-    if ((pTopicFilter[*pFilterIndex] == '+') && (locationIsValidForWildcard == true))
+    return pCompletion;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool takePublishCompletion(MQTTContext_t *pContext,
+                                  uint16_t packetId,
+                                  MQTTPublishCompletion_t *pCompletion)
+{
+    MQTTPublishCompletion_t *pEntry = NULL;
+
+    assert(pContext != NULL);
+    assert(pCompletion != NULL);
+
+    if (pContext->pPublishCompletions != NULL)
     {
-        bool nextLevelExistsInTopicName = false;
-        bool nextLevelExistsinTopicFilter = false;
+        pEntry = findPublishCompletion(pContext, packetId);
+    }
 
-        /* Move topic name index to the end of the current level. The end of the
-         * current level is identified by the last character before the next level
-         * separator '/'. */
-        while (*pNameIndex < topicNameLength)
+    if (pEntry != NULL)
+    {
+        *pCompletion = *pEntry;
+        pEntry->packetId = MQTT_PACKET_ID_INVALID;
+    }
+
+    return (pEntry != NULL);
+}
+
+/*-----------------------------------------------------------*/
+
+static void failPublishCompletions(MQTTContext_t *pContext)
+{
+    MQTTPublishCompletion_t completion;
+    uint32_t now;
+    size_t i;
+
+    assert(pContext != NULL);
+
+    if (pContext->pPublishCompletions != NULL)
+    {
+        now = pContext->getTime();
+
+        for (i = 0U; i < pContext->publishCompletionCount; i++)
         {
-            /* Exit the loop if we hit the level separator. */
-            if (pTopicName[*pNameIndex] == '/')
+            if (pContext->pPublishCompletions[i].packetId != MQTT_PACKET_ID_INVALID)
             {
-                nextLevelExistsInTopicName = true;
-                break;
+                completion = pContext->pPublishCompletions[i];
+                pContext->pPublishCompletions[i].packetId = MQTT_PACKET_ID_INVALID;
+
+                completion.completeCallback(pContext,
+                                            completion.packetId,
+                                            MQTTIllegalState,
+                                            calculateElapsedTime(now, completion.sendTimeMs),
+                                            completion.pUserContext);
             }
-
-            (*pNameIndex)++;
         }
+    }
+}
 
-        /* Determine if the topic filter contains a child level after the current level
-         * represented by the '+' wildcard. */
-        if ((*pFilterIndex < (topicFilterLength - 1U)) &&
-            (pTopicFilter[*pFilterIndex + 1U] == '/'))
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t handleIncomingAck(MQTTContext_t *pContext,
+                                      MQTTPacketInfo_t *pIncomingPacket,
+                                      bool manageKeepAlive)
+{
+    MQTTStatus_t status = MQTTBadResponse;
+    uint16_t packetIdentifier = MQTT_PACKET_ID_INVALID;
+    MQTTDeserializedInfo_t deserializedInfo;
+
+    /* We should always invoke the app callback unless we receive a PINGRESP
+     * and are managing keep alive, or if we receive an unknown packet. We
+     * initialize this to false since the callback must be invoked before
+     * sending any PUBREL or PUBCOMP. However, for other cases, we invoke it
+     * at the end to reduce the complexity of this function. */
+    bool invokeAppCallback = false;
+    MQTTEventCallback_t appCallback = NULL;
+
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pContext->appCallback != NULL);
+
+    appCallback = pContext->appCallback;
+
+    LogDebug(("Received packet of type %02x.",
+              (unsigned int)pIncomingPacket->type));
+
+    switch (pIncomingPacket->type)
+    {
+    case MQTT_PACKET_TYPE_PUBACK:
+    case MQTT_PACKET_TYPE_PUBREC:
+    case MQTT_PACKET_TYPE_PUBREL:
+    case MQTT_PACKET_TYPE_PUBCOMP:
+
+        /* Handle all the publish acks. The app callback is invoked here. */
+        status = handlePublishAcks(pContext, pIncomingPacket);
+
+        break;
+
+    case MQTT_PACKET_TYPE_PINGRESP:
+
+        /* A PINGRESP has no remaining data, so it is valid once its length
+         * is checked. */
+        if (pIncomingPacket->remainingLength == 0U)
         {
-            nextLevelExistsinTopicFilter = true;
+            status = MQTTSuccess;
+        }
+        else
+        {
+            status = MQTT_DeserializeAck(pIncomingPacket, &packetIdentifier, NULL);
         }
 
-        /* If the topic name contains a child level but the topic filter ends at
-         * the current level, then there does not exist a match. */
-        if ((nextLevelExistsInTopicName == true) &&
-            (nextLevelExistsinTopicFilter == false))
+        invokeAppCallback = (status == MQTTSuccess) && !manageKeepAlive;
+
+        if ((status == MQTTSuccess) && (manageKeepAlive == true))
         {
-            *pMatch = false;
-            shouldStopMatching = true;
+            pContext->waitingForPingResp = false;
         }
 
-        /* If the topic name and topic filter have child levels, then advance the
-         * filter index to the level separator in the topic filter, so that match
-         * can be performed in the next level.
-         * Note: The name index already points to the level separator in the topic
-         * name. */
-        else if (nextLevelExistsInTopicName == true)
-        {
-            (*pFilterIndex)++;
-        }
-        else
+        break;
+
+    case MQTT_PACKET_TYPE_SUBACK:
+    case MQTT_PACKET_TYPE_UNSUBACK:
+        /* Deserialize and give these to the app provided callback. */
+        status = MQTT_DeserializeAck(pIncomingPacket, &packetIdentifier, NULL);
+        invokeAppCallback = (status == MQTTSuccess) || (status == MQTTServerRefused);
+        break;
+
+    default:
+        /* Bad response from the server. */
+        LogError(("Unexpected packet type from server: PacketType=%02x.",
+                  (unsigned int)pIncomingPacket->type));
+        status = MQTTBadResponse;
+        break;
+    }
+
+    if (invokeAppCallback == true)
+    {
+        /* Set fields of deserialized struct. */
+        deserializedInfo.packetIdentifier = packetIdentifier;
+        deserializedInfo.deserializationResult = status;
+        deserializedInfo.pPublishInfo = NULL;
+        appCallback(pContext, pIncomingPacket, &deserializedInfo);
+        /* In case a SUBACK indicated refusal, reset the status to continue the loop. */
+        status = MQTTSuccess;
+    }
+
+    return status;
+}
+/*-----------------------------------------------------------*/
+
+static void wrapReceiveWindow(MQTTContext_t *pContext)
+{
+    assert(pContext != NULL);
+    assert(pContext->networkBuffer.pBuffer != NULL);
+
+    if (pContext->readIndex > 0U)
+    {
+        LogDebug(("Wrapping receive window: ReadIndex=%lu, PendingBytes=%lu.",
+                  (unsigned long)pContext->readIndex,
+                  (unsigned long)pContext->index));
+
+        (void)memmove(pContext->networkBuffer.pBuffer,
+                      &(pContext->networkBuffer.pBuffer[pContext->readIndex]),
+                      pContext->index);
+
+        pContext->readIndex = 0U;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void switchReceiveBuffer(MQTTContext_t *pContext,
+                                const uint8_t *pRemainingBytes)
+{
+    assert(pContext != NULL);
+    assert(pContext->spareReceiveBuffer.pBuffer != NULL);
+    assert(pContext->index <= pContext->spareReceiveBuffer.size);
+
+    LogDebug(("Switching to a new network buffer: PendingBytes=%lu.",
+              (unsigned long)pContext->index));
+
+    (void)memcpy(pContext->spareReceiveBuffer.pBuffer,
+                 pRemainingBytes,
+                 pContext->index);
+
+    pContext->networkBuffer = pContext->spareReceiveBuffer;
+    pContext->spareReceiveBuffer.pBuffer = NULL;
+    pContext->spareReceiveBuffer.size = 0U;
+    pContext->readIndex = 0U;
+    pContext->receiveBufferLoaned = false;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool takeOverflowBuffer(MQTTContext_t *pContext,
+                               size_t packetLength)
+{
+    MQTTOverflowBufferPool_t *pPool = NULL;
+    MQTTFixedBuffer_t overflowBuffer = {NULL, 0U};
+    size_t i = 0U;
+
+    assert(pContext != NULL);
+    assert(pContext->pOverflowBufferPool != NULL);
+    assert(pContext->primaryNetworkBuffer.pBuffer == NULL);
+
+    pPool = pContext->pOverflowBufferPool;
+
+    MQTT_PRE_OVERFLOW_POOL_HOOK(pPool);
+
+    for (i = 0U; i < pPool->bufferCount; i++)
+    {
+        if ((pPool->pBuffers[i].pBuffer != NULL) &&
+            (pPool->pBuffers[i].size >= packetLength))
         {
-            /* If we have reached here, the the loop terminated on the
-             * ( *pNameIndex < topicNameLength) condition, which means that have
-             * reached past the end of the topic name, and thus, we decrement the
-             * index to the last character in the topic name.*/
-            (*pNameIndex)--;
+            overflowBuffer = pPool->pBuffers[i];
+            pPool->pBuffers[i].pBuffer = NULL;
+            break;
         }
     }
 
-    /* '#' matches everything remaining in the topic name. It must be the
-     * last character in a topic filter. */
-    else if ((pTopicFilter[*pFilterIndex] == '#') &&
-             (*pFilterIndex == (topicFilterLength - 1U)) &&
-             (locationIsValidForWildcard == true))
+    MQTT_POST_OVERFLOW_POOL_HOOK(pPool);
+
+    if (overflowBuffer.pBuffer != NULL)
     {
-        /* Subsequent characters don't need to be checked for the
-         * multi-level wildcard. */
-        *pMatch = true;
-        shouldStopMatching = true;
+        LogDebug(("Receiving packet into an overflow buffer: PacketLength=%lu, "
+                  "BufferSize=%lu.",
+                  (unsigned long)packetLength,
+                  (unsigned long)overflowBuffer.size));
+
+        (void)memcpy(overflowBuffer.pBuffer,
+                     &(pContext->networkBuffer.pBuffer[pContext->readIndex]),
+                     pContext->index);
+
+        pContext->primaryNetworkBuffer = pContext->networkBuffer;
+        pContext->networkBuffer = overflowBuffer;
+        pContext->readIndex = 0U;
     }
     else
     {
-        /* Any character mismatch other than '+' or '#' means the topic
-         * name does not match the topic filter. */
-        *pMatch = false;
-        shouldStopMatching = true;
+        LogWarn(("No free overflow buffer can hold the packet: PacketLength=%lu.",
+                 (unsigned long)packetLength));
     }
 
-    return shouldStopMatching;
+    return (overflowBuffer.pBuffer != NULL);
 }
 
 /*-----------------------------------------------------------*/
 
-static bool matchTopicFilter(const char *pTopicName,
-                             uint16_t topicNameLength,
-                             const char *pTopicFilter,
-                             uint16_t topicFilterLength)
+static MQTTStatus_t receiveOverflowPacket(MQTTContext_t *pContext,
+                                          MQTTPacketInfo_t *pIncomingPacket,
+                                          bool manageKeepAlive)
 {
-    bool matchFound = false, shouldStopMatching = false;
-    uint16_t nameIndex = 0, filterIndex = 0;
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTOverflowBufferPool_t *pPool = NULL;
+    size_t packetLength = 0U;
+    size_t i = 0U;
 
-    assert(pTopicName != NULL);
-    assert(topicNameLength != 0);
-    assert(pTopicFilter != NULL);
-    assert(topicFilterLength != 0);
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pContext->primaryNetworkBuffer.pBuffer != NULL);
 
-    while ((nameIndex < topicNameLength) && (filterIndex < topicFilterLength))
+    pPool = pContext->pOverflowBufferPool;
+    packetLength = pIncomingPacket->headerLength + pIncomingPacket->remainingLength;
+
+    status = receiveIntoBuffer(pContext, packetLength);
+
+    if (status == MQTTSuccess)
     {
-        /* Check if the character in the topic name matches the corresponding
-         * character in the topic filter string. */
-        if (pTopicName[nameIndex] == pTopicFilter[filterIndex])
+        pIncomingPacket->pRemainingData = &(pContext->networkBuffer.pBuffer[pIncomingPacket->headerLength]);
+
+        if ((pIncomingPacket->type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH)
         {
-            /* If the topic name has been consumed but the topic filter has not
-             * been consumed, match for special cases when the topic filter ends
-             * with wildcard character. */
-            if (nameIndex == (topicNameLength - 1U))
-            {
-                matchFound = matchEndWildcardsSpecialCases(pTopicFilter,
-                                                           topicFilterLength,
-                                                           filterIndex);
-            }
+            status = handleIncomingPublish(pContext, pIncomingPacket);
         }
         else
         {
-            /* Check for matching wildcards. */
-            shouldStopMatching = matchWildcards(pTopicName,
-                                                topicNameLength,
-                                                pTopicFilter,
-                                                topicFilterLength,
-                                                &nameIndex,
-                                                &filterIndex,
-                                                &matchFound);
+            status = handleIncomingAck(pContext, pIncomingPacket, manageKeepAlive);
         }
 
-        if ((matchFound == true) || (shouldStopMatching == true))
+        /* A batched publish points into the overflow buffer. */
+        if (status == MQTTSuccess)
         {
-            break;
+            status = deliverPublishBatch(pContext);
         }
-
-        /* Increment indexes. */
-        nameIndex++;
-        filterIndex++;
     }
 
-    if (matchFound == false)
+    MQTT_PRE_OVERFLOW_POOL_HOOK(pPool);
+
+    /* The slot of a buffer taken from the pool is free. */
+    for (i = 0U; i < pPool->bufferCount; i++)
     {
-        /* If the end of both strings has been reached, they match. This represents the
-         * case when the topic filter contains the '+' wildcard at a non-starting position.
-         * For example, when matching either of "sport/+/player" OR "sport/hockey/+" topic
-         * filters with "sport/hockey/player" topic name. */
-        matchFound = (nameIndex == topicNameLength) &&
-                     (filterIndex == topicFilterLength);
+        if (pPool->pBuffers[i].pBuffer == NULL)
+        {
+            pPool->pBuffers[i] = pContext->networkBuffer;
+            break;
+        }
     }
 
-    return matchFound;
+    MQTT_POST_OVERFLOW_POOL_HOOK(pPool);
+
+    /* The whole packet has been consumed. */
+    pContext->networkBuffer = pContext->primaryNetworkBuffer;
+    pContext->primaryNetworkBuffer.pBuffer = NULL;
+    pContext->primaryNetworkBuffer.size = 0U;
+    pContext->index = 0U;
+    pContext->readIndex = 0U;
+
+    return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static int32_t sendMessageVector(MQTTContext_t *pContext,
-                                 TransportOutVector_t *pIoVec,
-                                 size_t ioVecCount)
+static MQTTStatus_t receiveSingleIteration(MQTTContext_t *pContext,
+                                           bool manageKeepAlive,
+                                           bool readTransport,
+                                           size_t *pPacketLength)
 {
-    int32_t sendResult;
-    uint32_t startTime;
-    TransportOutVector_t *pIoVectIterator;
-    size_t vectorsToBeSent = ioVecCount;
-    size_t bytesToSend = 0U;
-    int32_t bytesSentOrError = 0;
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = {0};
+    int32_t recvBytes = 0;
+    size_t totalMQTTPacketLength = 0;
+    uint8_t *pPacketStart = NULL;
+    bool packetStreamed = false;
 
     assert(pContext != NULL);
-    assert(pIoVec != NULL);
-    assert(pContext->getTime != NULL);
-    /* Send must always be defined */
-    assert(pContext->transportInterface.send != NULL);
+    assert(pContext->networkBuffer.pBuffer != NULL);
+    assert(pPacketLength != NULL);
 
-    /* Count the total number of bytes to be sent as outlined in the vector. */
-    for (pIoVectIterator = pIoVec; pIoVectIterator <= &(pIoVec[ioVecCount - 1U]); pIoVectIterator++)
+    *pPacketLength = 0U;
+
+    /* The receive window has reached the end of the buffer, wrap it around so
+     * that there is space for new data. */
+    if ((readTransport == true) &&
+        ((pContext->readIndex + pContext->index) == pContext->networkBuffer.size))
     {
-        bytesToSend += pIoVectIterator->iov_len;
+        wrapReceiveWindow(pContext);
     }
 
-    /* Reset the iterator to point to the first entry in the array. */
-    pIoVectIterator = pIoVec;
+    pPacketStart = &(pContext->networkBuffer.pBuffer[pContext->readIndex]);
 
-    /* Note the start time. */
-    startTime = pContext->getTime();
+    if (pContext->receivePaused == true)
+    {
+        /* Leave the data in the buffer and in the transport until the
+         * application resumes the reception. */
+        status = MQTTNoDataAvailable;
+    }
+    else if (pContext->discardRemaining > 0U)
+    {
+        /* Finish discarding an oversized packet before the next one. */
+        status = discardPendingBytes(pContext);
 
-    while ((bytesSentOrError < (int32_t)bytesToSend) && (bytesSentOrError >= 0))
+        if (pContext->discardRemaining == 0U)
+        {
+            status = completeDiscardAck(pContext, status);
+        }
+    }
+    else if (readTransport == true)
     {
-        if (pContext->transportInterface.writev != NULL)
+        /* Read as many bytes as possible into the network buffer. */
+        recvBytes = pContext->transportInterface.recv(pContext->transportInterface.pNetworkContext,
+                                                      &(pPacketStart[pContext->index]),
+                                                      pContext->networkBuffer.size - (pContext->readIndex + pContext->index));
+    }
+
+    if (status != MQTTSuccess)
+    {
+        /* The status of the discard is bubbled up to the user. */
+    }
+    else if (recvBytes < 0)
+    {
+        /* The receive function has failed. Bubble up the error up to the user. */
+        status = MQTTRecvFailed;
+    }
+    else if ((recvBytes == 0) && (pContext->index == 0U))
+    {
+        /* No more bytes available since the last read and neither is anything in
+         * the buffer. */
+        status = MQTTNoDataAvailable;
+    }
+
+    /* Either something was received, or there is still data to be processed in the
+     * buffer, or both. */
+    else
+    {
+        /* Update the number of bytes in the MQTT fixed buffer. */
+        pContext->index += (size_t)recvBytes;
+
+        if (pContext->pendingPacketLength > 0U)
         {
-            sendResult = pContext->transportInterface.writev(pContext->transportInterface.pNetworkContext,
-                                                             pIoVectIterator,
-                                                             vectorsToBeSent);
+            /* The header of this packet was decoded by an earlier call, only
+             * the number of received bytes has to be checked. */
+            incomingPacket = pContext->pendingPacket;
+            totalMQTTPacketLength = pContext->pendingPacketLength;
+            pContext->pendingPacketLength = 0U;
         }
         else
         {
-            sendResult = pContext->transportInterface.send(pContext->transportInterface.pNetworkContext,
-                                                           pIoVectIterator->iov_base,
-                                                           pIoVectIterator->iov_len);
+            status = MQTT_ProcessIncomingPacketTypeAndLength(pPacketStart,
+                                                             &(pContext->index),
+                                                             &incomingPacket);
+
+            totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
         }
+    }
 
-        if (sendResult > 0)
+    /* No data was received, check for keep alive timeout. */
+    if ((recvBytes == 0) && (readTransport == true))
+    {
+        if (manageKeepAlive == true)
         {
-            /* It is a bug in the application's transport send implementation if
-             * more bytes than expected are sent. */
-            assert(sendResult <= ((int32_t)bytesToSend - bytesSentOrError));
+            /* Keep the copy of the status to be reset later. */
+            MQTTStatus_t statusCopy = status;
 
-            bytesSentOrError += sendResult;
+            /* Assign status so an error can be bubbled up to application,
+             * but reset it on success. */
+            status = handleKeepAlive(pContext);
 
-            /* Set last transmission time. */
-            pContext->lastPacketTxTime = pContext->getTime();
+            if (status == MQTTSuccess)
+            {
+                /* Reset the status. */
+                status = statusCopy;
+            }
+            else
+            {
+                LogError(("Handling of keep alive failed. Status=%s",
+                          MQTT_Status_strerror(status)));
+            }
+        }
+    }
 
-            LogDebug(("sendMessageVector: Bytes Sent=%ld, Bytes Remaining=%lu",
-                      (long int)sendResult,
-                      (unsigned long)(bytesToSend - (size_t)bytesSentOrError)));
+    /* The application callbacks for the packet run from here on. */
+    pContext->callbackRunning = true;
+
+    /* Check whether there is data available before processing the packet further. */
+    if ((status == MQTTNeedMoreBytes) || (status == MQTTNoDataAvailable))
+    {
+        /* Do nothing as there is nothing to be processed right now. The proper
+         * error code will be bubbled up to the user. */
+    }
+    /* Any other error code. */
+    else if (status != MQTTSuccess)
+    {
+        LogError(("Call to receiveSingleIteration failed. Status=%s",
+                  MQTT_Status_strerror(status)));
+    }
+    /* If the MQTT Packet size is bigger than the buffer itself. */
+    else if (totalMQTTPacketLength > pContext->networkBuffer.size)
+    {
+        /* The network buffer is reused for this packet, so the batched
+         * publishes which point into it are delivered first. */
+        status = deliverPublishBatch(pContext);
+
+        if (status != MQTTSuccess)
+        {
+            /* The error is bubbled up to the application. */
         }
-        else if (sendResult < 0)
+        else if (((incomingPacket.type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH) &&
+                 ((pContext->publishFragmentCallback != NULL) ||
+                  (pContext->payloadDestinationCallback != NULL)))
         {
-            bytesSentOrError = sendResult;
-            LogError(("sendMessageVector: Unable to send packet: Network Error."));
+            /* Give the payload to the application in fragments or in its own
+             * buffer, or drop it if the filter rejects the topic. */
+            status = receiveStreamedPublish(pContext, &incomingPacket);
+            packetStreamed = true;
+        }
+        else if ((pContext->pOverflowBufferPool != NULL) &&
+                 (takeOverflowBuffer(pContext, totalMQTTPacketLength) == true))
+        {
+            /* Receive and handle the packet in a larger buffer. The filter is
+             * applied once it has been received. */
+            status = receiveOverflowPacket(pContext, &incomingPacket, manageKeepAlive);
+            packetStreamed = true;
+        }
+        else if (((incomingPacket.type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH) &&
+                 (pContext->publishFilterCallback != NULL))
+        {
+            /* The payload cannot be given to the application, but the filter
+             * decides whether the PUBLISH is dropped or discarded with a
+             * warning. */
+            status = receiveStreamedPublish(pContext, &incomingPacket);
+            packetStreamed = true;
         }
         else
         {
-            /* MISRA Empty body */
+            /* Discard the packet from the receive buffer and drain the pending
+             * data from the socket buffer. */
+            status = discardStoredPacket(pContext,
+                                         &incomingPacket);
         }
+    }
+    /* Receive the rest of the payload straight into the application buffer,
+     * or skip it if the filter rejects the topic. */
+    else if ((totalMQTTPacketLength > pContext->index) &&
+             ((incomingPacket.type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH) &&
+             ((pContext->payloadDestinationCallback != NULL) ||
+              (pContext->publishFilterCallback != NULL)))
+    {
+        status = deliverPublishBatch(pContext);
 
-        /* Check for timeout. */
-        if (calculateElapsedTime(pContext->getTime(), startTime) > MQTT_SEND_TIMEOUT_MS)
+        if (status == MQTTSuccess)
         {
-            LogError(("sendMessageVector: Unable to send packet: Timed out."));
-            break;
+            status = receiveStreamedPublish(pContext, &incomingPacket);
+            packetStreamed = true;
         }
-
-        /* Update the send pointer to the correct vector and offset. */
-        while ((pIoVectIterator <= &(pIoVec[ioVecCount - 1U])) &&
-               (sendResult >= (int32_t)pIoVectIterator->iov_len))
+    }
+    /* If the total packet is of more length than the bytes we have available. */
+    else if (totalMQTTPacketLength > pContext->index)
+    {
+        /* The rest of the packet does not fit between the read offset and the
+         * end of the buffer, so wrap the receive window around now. */
+        if ((pContext->readIndex + totalMQTTPacketLength) > pContext->networkBuffer.size)
         {
-            sendResult -= (int32_t)pIoVectIterator->iov_len;
-            pIoVectIterator++;
-            /* Update the number of vector which are yet to be sent. */
-            vectorsToBeSent--;
+            status = deliverPublishBatch(pContext);
+            wrapReceiveWindow(pContext);
         }
 
-        /* Some of the bytes from this vector were sent as well, update the length
-         * and the pointer to data in this vector. */
-        if ((sendResult > 0) &&
-            (pIoVectIterator <= &(pIoVec[ioVecCount - 1U])))
+        if (status == MQTTSuccess)
         {
-            pIoVectIterator->iov_base = (const void *)&(((const uint8_t *)pIoVectIterator->iov_base)[sendResult]);
-            pIoVectIterator->iov_len -= (size_t)sendResult;
+            /* Keep the decoded header for the calls which receive the rest of
+             * the packet. */
+            pContext->pendingPacket = incomingPacket;
+            pContext->pendingPacketLength = totalMQTTPacketLength;
+            status = MQTTNeedMoreBytes;
         }
     }
+    else
+    {
+        /* MISRA else. */
+    }
 
-    return bytesSentOrError;
-}
-
-static int32_t sendBuffer(MQTTContext_t *pContext,
-                          const uint8_t *pBufferToSend,
-                          size_t bytesToSend)
-{
-    int32_t sendResult;
-    uint32_t startTime;
-    int32_t bytesSentOrError = 0;
-    const uint8_t *pIndex = pBufferToSend;
-
-    assert(pContext != NULL);
-    assert(pContext->getTime != NULL);
-    assert(pContext->transportInterface.send != NULL);
-    assert(pIndex != NULL);
+    /* Handle received packet. If incomplete data was read then this will not execute. */
+    if ((status == MQTTSuccess) && (packetStreamed == false))
+    {
+        incomingPacket.pRemainingData = &pPacketStart[incomingPacket.headerLength];
 
-    /* Set the timeout. */
-    startTime = pContext->getTime();
+        /* The application may take the buffer while its callback runs. */
+        pContext->receiveBufferLoanable = true;
 
-    while ((bytesSentOrError < (int32_t)bytesToSend) && (bytesSentOrError >= 0))
-    {
-        sendResult = pContext->transportInterface.send(pContext->transportInterface.pNetworkContext,
-                                                       pIndex,
-                                                       bytesToSend - (size_t)bytesSentOrError);
+        /* PUBLISH packets allow flags in the lower four bits. For other
+         * packet types, they are reserved. */
+        if ((incomingPacket.type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH)
+        {
+            status = handleIncomingPublish(pContext, &incomingPacket);
+        }
+        else
+        {
+            status = handleIncomingAck(pContext, &incomingPacket, manageKeepAlive);
+        }
 
-        if (sendResult > 0)
+        pContext->receiveBufferLoanable = false;
+
+        /* Only a drain batch keeps publishes batched while it advances through
+         * the network buffer. */
+        if ((pContext->receiveBufferLoaned == true) ||
+            (pContext->drainInProgress == false))
         {
-            /* It is a bug in the application's transport send implementation if
-             * more bytes than expected are sent. */
-            assert(sendResult <= ((int32_t)bytesToSend - bytesSentOrError));
+            MQTTStatus_t batchStatus = deliverPublishBatch(pContext);
 
-            bytesSentOrError += sendResult;
-            pIndex = &pIndex[sendResult];
+            if (status == MQTTSuccess)
+            {
+                status = batchStatus;
+            }
+        }
 
-            /* Set last transmission time. */
-            pContext->lastPacketTxTime = pContext->getTime();
+        /* Update the index to reflect the remaining bytes in the buffer.  */
+        pContext->index -= totalMQTTPacketLength;
+        *pPacketLength = totalMQTTPacketLength;
 
-            LogDebug(("sendBuffer: Bytes Sent=%ld, Bytes Remaining=%lu",
-                      (long int)sendResult,
-                      (unsigned long)(bytesToSend - (size_t)bytesSentOrError)));
+        if (pContext->receiveBufferLoaned == true)
+        {
+            /* The application owns the buffer now. Continue with a buffer from
+             * the pool. */
+            switchReceiveBuffer(pContext, &pPacketStart[totalMQTTPacketLength]);
         }
-        else if (sendResult < 0)
+        /* A drain batch moves the remaining bytes once, when it is complete. */
+        else if ((pContext->ringBufferReceive == false) &&
+                 (pContext->drainInProgress == false))
         {
-            bytesSentOrError = sendResult;
-            LogError(("sendBuffer: Unable to send packet: Network Error."));
+            /* Move the remaining bytes to the front of the buffer. */
+            (void)memmove(pContext->networkBuffer.pBuffer,
+                          &(pContext->networkBuffer.pBuffer[totalMQTTPacketLength]),
+                          pContext->index);
+        }
+        else if (pContext->index == 0U)
+        {
+            /* Nothing is left to process, start again from the front. */
+            pContext->readIndex = 0U;
         }
         else
         {
-            /* MISRA Empty body */
+            /* Consume the packet in place. */
+            pContext->readIndex += totalMQTTPacketLength;
         }
 
-        /* Check for timeout. */
-        if (calculateElapsedTime(pContext->getTime(), startTime) >= (MQTT_SEND_TIMEOUT_MS))
+        /* A drain batch updates the timestamp once, when it is complete. */
+        if ((status == MQTTSuccess) && (pContext->drainInProgress == false))
         {
-            LogError(("sendBuffer: Unable to send packet: Timed out."));
-            break;
+            pContext->lastPacketRxTime = getCurrentTime(pContext);
         }
     }
-
-    return bytesSentOrError;
-}
-
-/*-----------------------------------------------------------*/
-
-static uint32_t calculateElapsedTime(uint32_t later,
-                                     uint32_t start)
-{
-    return later - start;
-}
-
-/*-----------------------------------------------------------*/
-
-static MQTTPubAckType_t getAckFromPacketType(uint8_t packetType)
-{
-    MQTTPubAckType_t ackType = MQTTPuback;
-
-    switch (packetType)
+    else if ((status == MQTTSuccess) && (packetStreamed == true))
     {
-    case MQTT_PACKET_TYPE_PUBACK:
-        ackType = MQTTPuback;
-        break;
-
-    case MQTT_PACKET_TYPE_PUBREC:
-        ackType = MQTTPubrec;
-        break;
+        *pPacketLength = totalMQTTPacketLength;
 
-    case MQTT_PACKET_TYPE_PUBREL:
-        ackType = MQTTPubrel;
-        break;
+        if (pContext->drainInProgress == false)
+        {
+            pContext->lastPacketRxTime = getCurrentTime(pContext);
+        }
+    }
+    else
+    {
+        /* MISRA else. */
+    }
 
-    case MQTT_PACKET_TYPE_PUBCOMP:
-    default:
+    pContext->callbackRunning = false;
 
-        /* This function is only called after checking the type is one of
-         * the above four values, so packet type must be PUBCOMP here. */
-        assert(packetType == MQTT_PACKET_TYPE_PUBCOMP);
-        ackType = MQTTPubcomp;
-        break;
+    if (status == MQTTNoDataAvailable)
+    {
+        /* No data available is not an error. Reset to MQTTSuccess so the
+         * return code will indicate success. */
+        status = MQTTSuccess;
     }
 
-    return ackType;
+    return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static int32_t recvExact(const MQTTContext_t *pContext,
-                         size_t bytesToRecv)
+static MQTTStatus_t receiveDrain(MQTTContext_t *pContext,
+                                 bool manageKeepAlive,
+                                 size_t *pByteCount)
 {
-    uint8_t *pIndex = NULL;
-    size_t bytesRemaining = bytesToRecv;
-    int32_t totalBytesRecvd = 0, bytesRecvd;
-    uint32_t lastDataRecvTimeMs = 0U, timeSinceLastRecvMs = 0U;
-    TransportRecv_t recvFunc = NULL;
-    MQTTGetCurrentTimeFunc_t getTimeStampMs = NULL;
-    bool receiveError = false;
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t batchStatus = MQTTSuccess;
+    size_t packetLength = 0U;
+    size_t packetCount = 0U;
+    size_t byteCount = 0U;
+    bool readTransport = true;
+    bool drainMore = true;
 
     assert(pContext != NULL);
-    assert(bytesToRecv <= pContext->networkBuffer.size);
-    assert(pContext->getTime != NULL);
-    assert(pContext->transportInterface.recv != NULL);
-    assert(pContext->networkBuffer.pBuffer != NULL);
-
-    pIndex = pContext->networkBuffer.pBuffer;
-    recvFunc = pContext->transportInterface.recv;
-    getTimeStampMs = pContext->getTime;
+    assert(pContext->drainPacketBudget > 0U);
+    assert(pByteCount != NULL);
 
-    /* Part of the MQTT packet has been read before calling this function. */
-    lastDataRecvTimeMs = getTimeStampMs();
+    pContext->drainInProgress = true;
 
-    while ((bytesRemaining > 0U) && (receiveError == false))
+    while (drainMore == true)
     {
-        bytesRecvd = recvFunc(pContext->transportInterface.pNetworkContext,
-                              pIndex,
-                              bytesRemaining);
+        /* The publishes parsed from the previous read are delivered before the
+         * next one. */
+        if (readTransport == true)
+        {
+            status = deliverPublishBatch(pContext);
+        }
 
-        if (bytesRecvd < 0)
+        if (status == MQTTSuccess)
         {
-            LogError(("Network error while receiving packet: ReturnCode=%ld.",
-                      (long int)bytesRecvd));
-            totalBytesRecvd = bytesRecvd;
-            receiveError = true;
+            status = receiveSingleIteration(pContext,
+                                            manageKeepAlive,
+                                            readTransport,
+                                            &packetLength);
         }
-        else if (bytesRecvd > 0)
+
+        if ((status == MQTTSuccess) && (packetLength > 0U))
         {
-            /* Reset the starting time as we have received some data from the network. */
-            lastDataRecvTimeMs = getTimeStampMs();
+            packetCount++;
+            byteCount += packetLength;
 
-            /* It is a bug in the application's transport receive implementation
-             * if more bytes than expected are received. To avoid a possible
-             * overflow in converting bytesRemaining from unsigned to signed,
-             * this assert must exist after the check for bytesRecvd being
-             * negative. */
-            assert((size_t)bytesRecvd <= bytesRemaining);
+            /* Only read from the network once the buffer is empty. */
+            readTransport = (pContext->index == 0U);
 
-            bytesRemaining -= (size_t)bytesRecvd;
-            totalBytesRecvd += (int32_t)bytesRecvd;
-            /* Increment the index. */
-            pIndex = &pIndex[bytesRecvd];
-            LogDebug(("BytesReceived=%ld, BytesRemaining=%lu, TotalBytesReceived=%ld.",
-                      (long int)bytesRecvd,
-                      (unsigned long)bytesRemaining,
-                      (long int)totalBytesRecvd));
+            if ((packetCount >= pContext->drainPacketBudget) ||
+                ((pContext->drainByteBudget != 0U) &&
+                 (byteCount >= pContext->drainByteBudget)) ||
+                (loopDeadlinePassed(pContext) == true) ||
+                (pContext->receivePaused == true))
+            {
+                drainMore = false;
+            }
+        }
+        else if ((status == MQTTNeedMoreBytes) && (readTransport == false))
+        {
+            /* The buffer holds only a part of the next packet. */
+            readTransport = true;
         }
         else
         {
-            /* No bytes were read from the network. */
-            timeSinceLastRecvMs = calculateElapsedTime(getTimeStampMs(), lastDataRecvTimeMs);
-
-            /* Check for timeout if we have been waiting to receive any byte on the network. */
-            if (timeSinceLastRecvMs >= MQTT_RECV_POLLING_TIMEOUT_MS)
-            {
-                LogError(("Unable to receive packet: Timed out in transport recv."));
-                receiveError = true;
-            }
+            drainMore = false;
         }
     }
 
-    return totalBytesRecvd;
-}
+    batchStatus = deliverPublishBatch(pContext);
 
-/*-----------------------------------------------------------*/
+    if ((status == MQTTSuccess) || (status == MQTTNeedMoreBytes) ||
+        (status == MQTTNoDataAvailable))
+    {
+        if (batchStatus != MQTTSuccess)
+        {
+            status = batchStatus;
+        }
+    }
 
-static MQTTStatus_t discardPacket(const MQTTContext_t *pContext,
-                                  size_t remainingLength,
-                                  uint32_t timeoutMs)
-{
-    MQTTStatus_t status = MQTTRecvFailed;
-    int32_t bytesReceived = 0;
-    size_t bytesToReceive = 0U;
-    uint32_t totalBytesReceived = 0U;
-    uint32_t entryTimeMs = 0U;
-    uint32_t elapsedTimeMs = 0U;
-    MQTTGetCurrentTimeFunc_t getTimeStampMs = NULL;
-    bool receiveError = false;
+    pContext->drainInProgress = false;
 
-    assert(pContext != NULL);
-    assert(pContext->getTime != NULL);
+    /* Move the remaining bytes to the front of the buffer, once for the whole
+     * batch. */
+    if (pContext->ringBufferReceive == false)
+    {
+        wrapReceiveWindow(pContext);
+    }
 
-    bytesToReceive = pContext->networkBuffer.size;
-    getTimeStampMs = pContext->getTime;
+    if (packetCount > 0U)
+    {
+        LogDebug(("Drained packets: PacketCount=%lu, ByteCount=%lu.",
+                  (unsigned long)packetCount,
+                  (unsigned long)byteCount));
 
-    entryTimeMs = getTimeStampMs();
+        pContext->lastPacketRxTime = getCurrentTime(pContext);
+    }
 
-    while ((totalBytesReceived < remainingLength) && (receiveError == false))
-    {
-        if ((remainingLength - totalBytesReceived) < bytesToReceive)
-        {
-            bytesToReceive = remainingLength - totalBytesReceived;
-        }
+    *pByteCount = byteCount;
 
-        bytesReceived = recvExact(pContext, bytesToReceive);
+    return status;
+}
 
-        if (bytesReceived != (int32_t)bytesToReceive)
-        {
-            LogError(("Receive error while discarding packet."
-                      "ReceivedBytes=%ld, ExpectedBytes=%lu.",
-                      (long int)bytesReceived,
-                      (unsigned long)bytesToReceive));
-            receiveError = true;
-        }
-        else
-        {
-            totalBytesReceived += (uint32_t)bytesReceived;
+/*-----------------------------------------------------------*/
 
-            elapsedTimeMs = calculateElapsedTime(getTimeStampMs(), entryTimeMs);
+static MQTTStatus_t validateSubscribeUnsubscribeParams(const MQTTContext_t *pContext,
+                                                       const MQTTSubscribeInfo_t *pSubscriptionList,
+                                                       size_t subscriptionCount,
+                                                       uint16_t packetId)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t iterator;
 
-            /* Check for timeout. */
-            if (elapsedTimeMs >= timeoutMs)
+    /* Validate all the parameters. */
+    if ((pContext == NULL) || (pSubscriptionList == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, "
+                  "pSubscriptionList=%p.",
+                  (void *)pContext,
+                  (void *)pSubscriptionList));
+        status = MQTTBadParameter;
+    }
+    else if (subscriptionCount == 0UL)
+    {
+        LogError(("Subscription count is 0."));
+        status = MQTTBadParameter;
+    }
+    else if (packetId == 0U)
+    {
+        LogError(("Packet Id for subscription packet is 0."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        if (pContext->incomingPublishRecords == NULL)
+        {
+            for (iterator = 0; iterator < subscriptionCount; iterator++)
             {
-                LogError(("Time expired while discarding packet."));
-                receiveError = true;
+                if (pSubscriptionList->qos > MQTTQoS0)
+                {
+                    LogError(("The incoming publish record list is not "
+                              "initialised for QoS1/QoS2 records. Please call "
+                              " MQTT_InitStatefulQoS to enable use of QoS1 and "
+                              " QoS2 packets."));
+                    status = MQTTBadParameter;
+                    break;
+                }
             }
         }
     }
 
-    if (totalBytesReceived == remainingLength)
-    {
-        LogError(("Dumped packet. DumpedBytes=%lu.",
-                  (unsigned long)totalBytesReceived));
-        /* Packet dumped, so no data is available. */
-        status = MQTTNoDataAvailable;
-    }
-
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t discardStoredPacket(MQTTContext_t *pContext,
-                                        const MQTTPacketInfo_t *pPacketInfo)
+static MQTTStatus_t sendSubscribeWithoutCopy(MQTTContext_t *pContext,
+                                             const MQTTSubscribeInfo_t *pSubscriptionList,
+                                             size_t subscriptionCount,
+                                             uint16_t packetId,
+                                             size_t remainingLength)
 {
-    MQTTStatus_t status = MQTTRecvFailed;
-    int32_t bytesReceived = 0;
-    size_t bytesToReceive = 0U;
-    uint32_t totalBytesReceived = 0U;
-    bool receiveError = false;
-    size_t mqttPacketSize = 0;
-    size_t remainingLength;
+    MQTTStatus_t status = MQTTSuccess;
+    uint8_t *pIndex;
+    TransportOutVector_t pIoVector[MQTT_SUB_UNSUB_MAX_VECTORS];
+    TransportOutVector_t *pIterator;
+    uint8_t serializedTopicFieldLength[MQTT_SUB_UNSUB_MAX_VECTORS][CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES];
+    size_t totalPacketLength = 0U;
+    size_t ioVectorLength = 0U;
+    size_t subscriptionsSent = 0U;
+    size_t vectorsAdded;
+    size_t topicFieldLengthIndex;
 
-    assert(pContext != NULL);
-    assert(pPacketInfo != NULL);
+    /* Maximum number of bytes required by the 'fixed' part of the SUBSCRIBE
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Packet ID                + 2 = 7 */
+    uint8_t subscribeheader[7U];
 
-    mqttPacketSize = pPacketInfo->remainingLength + pPacketInfo->headerLength;
+    /* The vector array should be at least three element long as the topic
+     * string needs these many vector elements to be stored. */
+    assert(MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH);
 
-    /* Assert that the packet being discarded is bigger than the
-     * receive buffer. */
-    assert(mqttPacketSize > pContext->networkBuffer.size);
+    pIndex = subscribeheader;
+    pIterator = pIoVector;
 
-    /* Discard these many bytes at a time. */
-    bytesToReceive = pContext->networkBuffer.size;
+    pIndex = MQTT_SerializeSubscribeHeader(remainingLength,
+                                           pIndex,
+                                           packetId);
 
-    /* Number of bytes depicted by 'index' have already been received. */
-    remainingLength = mqttPacketSize - pContext->index;
+    /* The header is to be sent first. */
+    pIterator->iov_base = subscribeheader;
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+    /* coverity[misra_c_2012_rule_18_2_violation] */
+    /* coverity[misra_c_2012_rule_10_8_violation] */
+    pIterator->iov_len = (size_t)(pIndex - subscribeheader);
+    totalPacketLength += pIterator->iov_len;
+    pIterator++;
+    ioVectorLength++;
 
-    while ((totalBytesReceived < remainingLength) && (receiveError == false))
+    while ((status == MQTTSuccess) && (subscriptionsSent < subscriptionCount))
     {
-        if ((remainingLength - totalBytesReceived) < bytesToReceive)
+        /* Reset the index for next iteration. */
+        topicFieldLengthIndex = 0;
+
+        /* Check whether the subscription topic (with QoS) will fit in the
+         * given vector. */
+        while ((ioVectorLength <= (MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH)) &&
+               (subscriptionsSent < subscriptionCount))
         {
-            bytesToReceive = remainingLength - totalBytesReceived;
-        }
+            /* The topic filter and the filter length gets sent next. */
+            vectorsAdded = addEncodedStringToVector(serializedTopicFieldLength[topicFieldLengthIndex],
+                                                    pSubscriptionList[subscriptionsSent].pTopicFilter,
+                                                    pSubscriptionList[subscriptionsSent].topicFilterLength,
+                                                    pIterator,
+                                                    &totalPacketLength);
 
-        bytesReceived = recvExact(pContext, bytesToReceive);
+            /* Update the pointer after the above operation. */
+            pIterator = &pIterator[vectorsAdded];
 
-        if (bytesReceived != (int32_t)bytesToReceive)
-        {
-            LogError(("Receive error while discarding packet."
-                      "ReceivedBytes=%ld, ExpectedBytes=%lu.",
-                      (long int)bytesReceived,
-                      (unsigned long)bytesToReceive));
-            receiveError = true;
+            /* Lastly, the QoS gets sent. */
+            pIterator->iov_base = &(pSubscriptionList[subscriptionsSent].qos);
+            pIterator->iov_len = 1U;
+            totalPacketLength += pIterator->iov_len;
+
+            /* Increment the pointer. */
+            pIterator++;
+
+            /* Two slots get used by the topic string length and topic string.
+             * One slot gets used by the quality of service. */
+            ioVectorLength += vectorsAdded + 1U;
+
+            subscriptionsSent++;
+
+            /* The index needs to be updated for next iteration. */
+            topicFieldLengthIndex++;
         }
-        else
+
+        if (sendMessageVector(pContext,
+                              pIoVector,
+                              ioVectorLength) != (int32_t)totalPacketLength)
         {
-            totalBytesReceived += (uint32_t)bytesReceived;
+            status = MQTTSendFailed;
         }
-    }
 
-    if (totalBytesReceived == remainingLength)
-    {
-        LogError(("Dumped packet. DumpedBytes=%lu.",
-                  (unsigned long)totalBytesReceived));
-        /* Packet dumped, so no data is available. */
-        status = MQTTNoDataAvailable;
+        /* Update the iterator for the next potential loop iteration. */
+        pIterator = pIoVector;
+        /* Reset the vector length for the next potential loop iteration. */
+        ioVectorLength = 0U;
+        /* Reset the packet length for the next potential loop iteration. */
+        totalPacketLength = 0U;
     }
 
-    /* Clear the buffer */
-    (void)memset(pContext->networkBuffer.pBuffer,
-                 0,
-                 pContext->networkBuffer.size);
-
-    /* Reset the index. */
-    pContext->index = 0;
-
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t receivePacket(const MQTTContext_t *pContext,
-                                  MQTTPacketInfo_t incomingPacket,
-                                  uint32_t remainingTimeMs)
+static MQTTStatus_t sendUnsubscribeWithoutCopy(MQTTContext_t *pContext,
+                                               const MQTTSubscribeInfo_t *pSubscriptionList,
+                                               size_t subscriptionCount,
+                                               uint16_t packetId,
+                                               size_t remainingLength)
 {
     MQTTStatus_t status = MQTTSuccess;
-    int32_t bytesReceived = 0;
-    size_t bytesToReceive = 0U;
-
-    assert(pContext != NULL);
-    assert(pContext->networkBuffer.pBuffer != NULL);
+    uint8_t *pIndex;
+    TransportOutVector_t pIoVector[MQTT_SUB_UNSUB_MAX_VECTORS];
+    TransportOutVector_t *pIterator;
+    uint8_t serializedTopicFieldLength[MQTT_SUB_UNSUB_MAX_VECTORS][CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES];
+    size_t totalPacketLength = 0U;
+    size_t unsubscriptionsSent = 0U;
+    size_t ioVectorLength = 0U;
+    size_t vectorsAdded;
+    size_t topicFieldLengthIndex;
 
-    if (incomingPacket.remainingLength > pContext->networkBuffer.size)
-    {
-        LogError(("Incoming packet will be dumped: "
-                  "Packet length exceeds network buffer size."
-                  "PacketSize=%lu, NetworkBufferSize=%lu.",
-                  (unsigned long)incomingPacket.remainingLength,
-                  (unsigned long)pContext->networkBuffer.size));
-        status = discardPacket(pContext,
-                               incomingPacket.remainingLength,
-                               remainingTimeMs);
-    }
-    else
-    {
-        bytesToReceive = incomingPacket.remainingLength;
-        bytesReceived = recvExact(pContext, bytesToReceive);
+    /* Maximum number of bytes required by the 'fixed' part of the UNSUBSCRIBE
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Packet ID                + 2 = 7  */
+    uint8_t unsubscribeheader[7U];
 
-        if (bytesReceived == (int32_t)bytesToReceive)
-        {
-            /* Receive successful, bytesReceived == bytesToReceive. */
-            LogDebug(("Packet received. ReceivedBytes=%ld.",
-                      (long int)bytesReceived));
-        }
-        else
-        {
-            LogError(("Packet reception failed. ReceivedBytes=%ld, "
-                      "ExpectedBytes=%lu.",
-                      (long int)bytesReceived,
-                      (unsigned long)bytesToReceive));
-            status = MQTTRecvFailed;
-        }
-    }
+    /* The vector array should be at least three element long as the topic
+     * string needs these many vector elements to be stored. */
+    assert(MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH);
 
-    return status;
-}
+    pIndex = unsubscribeheader;
+    pIterator = pIoVector;
 
-/*-----------------------------------------------------------*/
+    pIndex = MQTT_SerializeUnsubscribeHeader(remainingLength,
+                                             pIndex,
+                                             packetId);
 
-static uint8_t getAckTypeToSend(MQTTPublishState_t state)
-{
-    uint8_t packetTypeByte = 0U;
+    /* The header is to be sent first. */
+    pIterator->iov_base = unsubscribeheader;
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+    /* coverity[misra_c_2012_rule_18_2_violation] */
+    /* coverity[misra_c_2012_rule_10_8_violation] */
+    pIterator->iov_len = (size_t)(pIndex - unsubscribeheader);
+    totalPacketLength += pIterator->iov_len;
+    pIterator++;
+    ioVectorLength++;
 
-    switch (state)
+    while ((status == MQTTSuccess) && (unsubscriptionsSent < subscriptionCount))
     {
-    case MQTTPubAckSend:
-        packetTypeByte = MQTT_PACKET_TYPE_PUBACK;
-        break;
+        /* Reset the index for next iteration. */
+        topicFieldLengthIndex = 0;
 
-    case MQTTPubRecSend:
-        packetTypeByte = MQTT_PACKET_TYPE_PUBREC;
-        break;
+        /* Check whether the subscription topic will fit in the given vector. */
+        while ((ioVectorLength <= (MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH)) &&
+               (unsubscriptionsSent < subscriptionCount))
+        {
+            /* The topic filter gets sent next. */
+            vectorsAdded = addEncodedStringToVector(serializedTopicFieldLength[topicFieldLengthIndex],
+                                                    pSubscriptionList[unsubscriptionsSent].pTopicFilter,
+                                                    pSubscriptionList[unsubscriptionsSent].topicFilterLength,
+                                                    pIterator,
+                                                    &totalPacketLength);
 
-    case MQTTPubRelSend:
-        packetTypeByte = MQTT_PACKET_TYPE_PUBREL;
-        break;
+            /* Update the iterator to point to the next empty location. */
+            pIterator = &pIterator[vectorsAdded];
+            /* Update the total count based on how many vectors were added. */
+            ioVectorLength += vectorsAdded;
 
-    case MQTTPubCompSend:
-        packetTypeByte = MQTT_PACKET_TYPE_PUBCOMP;
-        break;
+            unsubscriptionsSent++;
 
-    case MQTTPubAckPending:
-    case MQTTPubCompPending:
-    case MQTTPubRecPending:
-    case MQTTPubRelPending:
-    case MQTTPublishDone:
-    case MQTTPublishSend:
-    case MQTTStateNull:
-    default:
-        /* Take no action for states that do not require sending an ack. */
-        break;
+            /* Update the index for next iteration. */
+            topicFieldLengthIndex++;
+        }
+
+        if (sendMessageVector(pContext, pIoVector, ioVectorLength) != (int32_t)totalPacketLength)
+        {
+            status = MQTTSendFailed;
+        }
+
+        /* Update the iterator for the next potential loop iteration. */
+        pIterator = pIoVector;
+        /* Reset the vector length for the next potential loop iteration. */
+        ioVectorLength = 0U;
+        /* Reset the packet length for the next potential loop iteration. */
+        totalPacketLength = 0U;
     }
 
-    return packetTypeByte;
+    return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendPublishAcks(MQTTContext_t *pContext,
-                                    uint16_t packetId,
-                                    MQTTPublishState_t publishState)
+static MQTTStatus_t sendSubscribeUnsubscribeBulk(MQTTContext_t *pContext,
+                                                 const MQTTSubscribeInfo_t *pSubscriptionList,
+                                                 size_t subscriptionCount,
+                                                 const MQTTFixedBuffer_t *pBuffer,
+                                                 bool subscribe,
+                                                 MQTTBulkPacket_t *pPackets,
+                                                 size_t maxPackets,
+                                                 size_t *pPacketCount)
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTPublishState_t newState = MQTTStateNull;
-    int32_t sendResult = 0;
-    uint8_t packetTypeByte = 0U;
-    MQTTPubAckType_t packetType;
-    MQTTFixedBuffer_t localBuffer;
-    uint8_t pubAckPacket[MQTT_PUBLISH_ACK_PACKET_SIZE];
+    size_t packetCount = 0U;
+    size_t firstIndex = 0U;
+    size_t filterCount;
+    size_t filterOverhead;
+    size_t maxPacketSize = 0U;
+    size_t estimatedSize;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    uint16_t packetId;
+    int32_t sendResult;
 
-    localBuffer.pBuffer = pubAckPacket;
-    localBuffer.size = MQTT_PUBLISH_ACK_PACKET_SIZE;
+    if ((pBuffer == NULL) || (pPackets == NULL) || (pPacketCount == NULL))
+    {
+        LogError(("Argument cannot be NULL: pBuffer=%p, pPackets=%p, "
+                  "pPacketCount=%p\n",
+                  (const void *)pBuffer,
+                  (void *)pPackets,
+                  (void *)pPacketCount));
+        status = MQTTBadParameter;
+    }
+    else if (pBuffer->pBuffer == NULL)
+    {
+        LogError(("pBuffer->pBuffer cannot be NULL.\n"));
+        status = MQTTBadParameter;
+    }
+    else if (maxPackets == 0U)
+    {
+        LogError(("maxPackets must be greater than 0.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The packet IDs are taken with MQTT_GetPacketId as the packets are
+         * serialized, so any non-zero ID passes the validation here. */
+        status = validateSubscribeUnsubscribeParams(pContext,
+                                                    pSubscriptionList,
+                                                    subscriptionCount,
+                                                    1U);
+    }
 
-    assert(pContext != NULL);
+    if (status == MQTTSuccess)
+    {
+        maxPacketSize = pBuffer->size;
 
-    packetTypeByte = getAckTypeToSend(publishState);
+#if (MQTT_VERSION_5_ENABLED)
+        if ((pContext->connectProperties != NULL) &&
+            (pContext->connectProperties->serverMaxPacketSize > 0U) &&
+            (pContext->connectProperties->serverMaxPacketSize < maxPacketSize))
+        {
+            maxPacketSize = pContext->connectProperties->serverMaxPacketSize;
+        }
+#endif
+    }
+
+    /* Each topic filter takes its 2 bytes of length and, in a SUBSCRIBE, its
+     * subscription options byte. */
+    filterOverhead = (subscribe == true) ? 3U : 2U;
 
-    if (packetTypeByte != 0U)
+    while ((status == MQTTSuccess) && (firstIndex < subscriptionCount))
     {
-        packetType = getAckFromPacketType(packetTypeByte);
+        /* Maximum number of bytes required by the 'fixed' part of the packet.
+         * MQTT Control Byte      0 + 1 = 1
+         * Remaining length (max)   + 4 = 5
+         * Packet ID                + 2 = 7
+         * Taking the maximum makes the estimate an upper bound of the size
+         * computed by the serializer. */
+        estimatedSize = 7U;
+        filterCount = 0U;
 
-        status = MQTT_SerializeAck(&localBuffer,
-                                   packetTypeByte,
-                                   packetId);
+        while (((firstIndex + filterCount) < subscriptionCount) &&
+               ((estimatedSize + filterOverhead +
+                 pSubscriptionList[firstIndex + filterCount].topicFilterLength) <= maxPacketSize))
+        {
+            estimatedSize += filterOverhead +
+                             pSubscriptionList[firstIndex + filterCount].topicFilterLength;
+            filterCount++;
+        }
 
-        if (status == MQTTSuccess)
+        if (packetCount == maxPackets)
         {
-            MQTT_PRE_SEND_HOOK(pContext);
+            LogError(("%lu packets cannot hold all of the %lu topic filters.",
+                      (unsigned long)maxPackets,
+                      (unsigned long)subscriptionCount));
+            status = MQTTNoMemory;
+        }
+        else if (filterCount == 0U)
+        {
+            LogError(("Topic filter %lu does not fit in a packet of %lu bytes.",
+                      (unsigned long)firstIndex,
+                      (unsigned long)maxPacketSize));
+            status = MQTTNoMemory;
+        }
+        else if (subscribe == true)
+        {
+            status = MQTT_GetSubscribePacketSize(&pSubscriptionList[firstIndex],
+                                                 filterCount,
+                                                 &remainingLength,
+                                                 &packetSize);
+        }
+        else
+        {
+            status = MQTT_GetUnsubscribePacketSize(&pSubscriptionList[firstIndex],
+                                                   filterCount,
+                                                   &remainingLength,
+                                                   &packetSize);
+        }
 
-            /* Here, we are not using the vector approach for efficiency. There is just one buffer
-             * to be sent which can be achieved with a normal send call. */
-            sendResult = sendBuffer(pContext,
-                                    localBuffer.pBuffer,
-                                    MQTT_PUBLISH_ACK_PACKET_SIZE);
+        if (status == MQTTSuccess)
+        {
+            packetId = MQTT_GetPacketId(pContext);
 
-            MQTT_POST_SEND_HOOK(pContext);
+            if (subscribe == true)
+            {
+                status = MQTT_SerializeSubscribe(&pSubscriptionList[firstIndex],
+                                                 filterCount,
+                                                 packetId,
+                                                 remainingLength,
+                                                 pBuffer);
+            }
+            else
+            {
+                status = MQTT_SerializeUnsubscribe(&pSubscriptionList[firstIndex],
+                                                   filterCount,
+                                                   packetId,
+                                                   remainingLength,
+                                                   pBuffer);
+            }
         }
 
-        if (sendResult == (int32_t)MQTT_PUBLISH_ACK_PACKET_SIZE)
+        if (status == MQTTSuccess)
         {
-            pContext->controlPacketSent = true;
-
-            MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+            MQTT_PRE_SEND_HOOK(pContext);
 
-            status = MQTT_UpdateStateAck(pContext,
-                                         packetId,
-                                         packetType,
-                                         MQTT_SEND,
-                                         &newState);
+            sendResult = sendBuffer(pContext,
+                                    pBuffer->pBuffer,
+                                    packetSize,
+                                    false);
 
-            MQTT_POST_STATE_UPDATE_HOOK(pContext);
+            MQTT_POST_SEND_HOOK(pContext);
 
-            if (status != MQTTSuccess)
+            if (sendResult < (int32_t)packetSize)
             {
-                LogError(("Failed to update state of publish %hu.",
-                          (unsigned short)packetId));
+                LogError(("Transport send failed for packet %lu of the topic filters.",
+                          (unsigned long)packetCount));
+                status = MQTTSendFailed;
+            }
+            else
+            {
+                pPackets[packetCount].packetId = packetId;
+                pPackets[packetCount].firstIndex = firstIndex;
+                pPackets[packetCount].count = filterCount;
+                packetCount++;
+                firstIndex += filterCount;
             }
-        }
-        else
-        {
-            LogError(("Failed to send ACK packet: PacketType=%02x, SentBytes=%ld, "
-                      "PacketSize=%lu.",
-                      (unsigned int)packetTypeByte, (long int)sendResult,
-                      MQTT_PUBLISH_ACK_PACKET_SIZE));
-            status = MQTTSendFailed;
         }
     }
 
+    if (pPacketCount != NULL)
+    {
+        *pPacketCount = packetCount;
+    }
+
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleKeepAlive(MQTTContext_t *pContext)
+static MQTTStatus_t sendPublishWithoutCopy(MQTTContext_t *pContext,
+                                           const MQTTPublishInfo_t *pPublishInfo,
+                                           const uint8_t *pMqttHeader,
+                                           size_t headerSize,
+                                           uint16_t packetId)
 {
     MQTTStatus_t status = MQTTSuccess;
-    uint32_t now = 0U;
-    uint32_t packetTxTimeoutMs = 0U;
-    uint32_t lastPacketTxTime = 0U;
+    size_t ioVectorLength;
+    size_t totalMessageLength;
 
-    assert(pContext != NULL);
-    assert(pContext->getTime != NULL);
+    /* Bytes required to encode the packet ID in an MQTT header according to
+     * the MQTT specification. */
+    uint8_t serializedPacketID[2U];
 
-    now = pContext->getTime();
+    /* Maximum number of vectors required to encode and send a publish
+     * packet. The breakdown is shown below.
+     * Fixed header (including topic string length)      0 + 1 = 1
+     * Topic string                                        + 1 = 2
+     * Packet ID (only when QoS > QoS0)                    + 1 = 3
+     * Payload                                             + 1 = 4  */
+    TransportOutVector_t pIoVector[4U];
 
-    packetTxTimeoutMs = 1000U * (uint32_t)pContext->keepAliveIntervalSec;
+    /* The header is sent first. */
+    pIoVector[0U].iov_base = pMqttHeader;
+    pIoVector[0U].iov_len = headerSize;
+    totalMessageLength = headerSize;
 
-    if (PACKET_TX_TIMEOUT_MS < packetTxTimeoutMs)
-    {
-        packetTxTimeoutMs = PACKET_TX_TIMEOUT_MS;
-    }
+    /* Then the topic name has to be sent. */
+    pIoVector[1U].iov_base = pPublishInfo->pTopicName;
+    pIoVector[1U].iov_len = pPublishInfo->topicNameLength;
+    totalMessageLength += pPublishInfo->topicNameLength;
+
+    /* The next field's index should be 2 as the first two fields
+     * have been filled in. */
+    ioVectorLength = 2U;
 
-    /* If keep alive interval is 0, it is disabled. */
-    if (pContext->waitingForPingResp == true)
+    if (pPublishInfo->qos > MQTTQoS0)
     {
-        /* Has time expired? */
-        if (calculateElapsedTime(now, pContext->pingReqSendTimeMs) >
-            MQTT_PINGRESP_TIMEOUT_MS)
-        {
-            status = MQTTKeepAliveTimeout;
-        }
+        /* Encode the packet ID. */
+        serializedPacketID[0] = ((uint8_t)((packetId) >> 8));
+        serializedPacketID[1] = ((uint8_t)((packetId) & 0x00ffU));
+
+        pIoVector[ioVectorLength].iov_base = serializedPacketID;
+        pIoVector[ioVectorLength].iov_len = sizeof(serializedPacketID);
+
+        ioVectorLength++;
+        totalMessageLength += sizeof(serializedPacketID);
     }
-    else
+
+    /* Publish packets are allowed to contain no payload. */
+    if (pPublishInfo->payloadLength > 0U)
     {
-        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
-        lastPacketTxTime = pContext->lastPacketTxTime;
-        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        pIoVector[ioVectorLength].iov_base = pPublishInfo->pPayload;
+        pIoVector[ioVectorLength].iov_len = pPublishInfo->payloadLength;
 
-        if ((packetTxTimeoutMs != 0U) && (calculateElapsedTime(now, lastPacketTxTime) >= packetTxTimeoutMs))
-        {
-            status = MQTT_Ping(pContext);
-        }
-        else
-        {
-            const uint32_t timeElapsed = calculateElapsedTime(now, pContext->lastPacketRxTime);
+        ioVectorLength++;
+        totalMessageLength += pPublishInfo->payloadLength;
+    }
 
-            if ((timeElapsed != 0U) && (timeElapsed >= PACKET_RX_TIMEOUT_MS))
-            {
-                status = MQTT_Ping(pContext);
-            }
-        }
+    if (sendMessageVector(pContext, pIoVector, ioVectorLength) != (int32_t)totalMessageLength)
+    {
+        status = MQTTSendFailed;
     }
 
     return status;
@@ -1494,128 +5553,98 @@ static MQTTStatus_t handleKeepAlive(MQTTContext_t *pContext)
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleIncomingPublish(MQTTContext_t *pContext,
-                                          MQTTPacketInfo_t *pIncomingPacket)
+static MQTTStatus_t sendSerializedPublish(MQTTContext_t *pContext,
+                                          const MQTTPublishInfo_t *pPublishInfo,
+                                          const uint8_t *pMqttHeader,
+                                          size_t headerSize,
+                                          uint16_t packetId)
 {
-    MQTTStatus_t status = MQTTBadParameter;
-    MQTTPublishState_t publishRecordState = MQTTStateNull;
-    uint16_t packetIdentifier = 0U;
-    MQTTPublishInfo_t publishInfo;
-    MQTTDeserializedInfo_t deserializedInfo;
-    bool duplicatePublish = false;
-
-    assert(pContext != NULL);
-    assert(pIncomingPacket != NULL);
-    assert(pContext->appCallback != NULL);
-
-    status = MQTT_DeserializePublish(pIncomingPacket, &packetIdentifier, &publishInfo);
-    LogInfo(("De-serialized incoming PUBLISH packet: DeserializerResult=%s.",
-             MQTT_Status_strerror(status)));
-
-    if ((status == MQTTSuccess) &&
-        (pContext->incomingPublishRecords == NULL) &&
-        (publishInfo.qos > MQTTQoS0))
-    {
-        LogError(("Incoming publish has QoS > MQTTQoS0 but incoming "
-                  "publish records have not been initialized. Dropping the "
-                  "incoming publish. Please call MQTT_InitStatefulQoS to enable "
-                  "use of QoS1 and QoS2 publishes."));
-        status = MQTTRecvFailed;
-    }
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishState_t publishStatus = MQTTStateNull;
+    bool stateUpdateHookExecuted = false;
+    bool stateReserved = false;
 
-    if (status == MQTTSuccess)
+    if (pPublishInfo->qos > MQTTQoS0)
     {
         MQTT_PRE_STATE_UPDATE_HOOK(pContext);
 
-        status = MQTT_UpdateStatePublish(pContext,
-                                         packetIdentifier,
-                                         MQTT_RECEIVE,
-                                         publishInfo.qos,
-                                         &publishRecordState);
+        /* Set the flag so that the corresponding hook can be called later. */
+        stateUpdateHookExecuted = true;
 
-        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        status = MQTT_ReserveState(pContext,
+                                   packetId,
+                                   pPublishInfo->qos);
 
-        if (status == MQTTSuccess)
-        {
-            LogInfo(("State record updated. New state=%s.",
-                     MQTT_State_strerror(publishRecordState)));
-        }
+        stateReserved = (status == MQTTSuccess);
 
-        /* Different cases in which an incoming publish with duplicate flag is
-         * handled are as listed below.
-         * 1. No collision - This is the first instance of the incoming publish
-         *    packet received or an earlier received packet state is lost. This
-         *    will be handled as a new incoming publish for both QoS1 and QoS2
-         *    publishes.
-         * 2. Collision - The incoming packet was received before and a state
-         *    record is present in the state engine. For QoS1 and QoS2 publishes
-         *    this case can happen at 2 different cases and handling is
-         *    different.
-         *    a. QoS1 - If a PUBACK is not successfully sent for the incoming
-         *       publish due to a connection issue, it can result in broker
-         *       sending out a duplicate publish with dup flag set, when a
-         *       session is reestablished. It can result in a collision in
-         *       state engine. This will be handled by processing the incoming
-         *       publish as a new publish ignoring the
-         *       #MQTTStateCollision status from the state engine. The publish
-         *       data is not passed to the application.
-         *    b. QoS2 - If a PUBREC is not successfully sent for the incoming
-         *       publish or the PUBREC sent is not successfully received by the
-         *       broker due to a connection issue, it can result in broker
-         *       sending out a duplicate publish with dup flag set, when a
-         *       session is reestablished. It can result in a collision in
-         *       state engine. This will be handled by ignoring the
-         *       #MQTTStateCollision status from the state engine. The publish
-         *       data is not passed to the application. */
-        else if (status == MQTTStateCollision)
+        /* State already exists for a duplicate packet.
+         * If a state doesn't exist, it will be handled as a new publish in
+         * state engine. */
+        if ((status == MQTTStateCollision) && (pPublishInfo->dup == true))
         {
             status = MQTTSuccess;
-            duplicatePublish = true;
-
-            /* Calculate the state for the ack packet that needs to be sent out
-             * for the duplicate incoming publish. */
-            publishRecordState = MQTT_CalculateStatePublish(MQTT_RECEIVE,
-                                                            publishInfo.qos);
+        }
+    }
 
-            LogDebug(("Incoming publish packet with packet id %hu already exists.",
-                      (unsigned short)packetIdentifier));
+    if (status == MQTTSuccess)
+    {
+        /* Take the mutex as multiple send calls are required for sending this
+         * packet. */
+        MQTT_PRE_SEND_HOOK(pContext);
 
-            if (publishInfo.dup == false)
-            {
-                LogError(("DUP flag is 0 for duplicate packet (MQTT-3.3.1.-1)."));
-            }
+        if (pContext->pTransmitQueue != NULL)
+        {
+            status = enqueuePublish(pContext,
+                                    pPublishInfo,
+                                    pMqttHeader,
+                                    headerSize,
+                                    packetId);
         }
         else
         {
-            LogError(("Error in updating publish state for incoming publish with packet id %hu."
-                      " Error is %s",
-                      (unsigned short)packetIdentifier,
-                      MQTT_Status_strerror(status)));
+            status = sendPublishWithoutCopy(pContext,
+                                            pPublishInfo,
+                                            pMqttHeader,
+                                            headerSize,
+                                            packetId);
+        }
+
+        /* Give the mutex away for the next taker. */
+        MQTT_POST_SEND_HOOK(pContext);
+
+        /* Nothing was queued, so the publish can be retried as a new one. */
+        if ((status == MQTTNoMemory) && (stateReserved == true))
+        {
+            (void)MQTT_RemoveStateRecord(pContext, packetId);
         }
     }
 
-    if (status == MQTTSuccess)
+    if ((status == MQTTSuccess) &&
+        (pPublishInfo->qos > MQTTQoS0))
     {
-        /* Set fields of deserialized struct. */
-        deserializedInfo.packetIdentifier = packetIdentifier;
-        deserializedInfo.pPublishInfo = &publishInfo;
-        deserializedInfo.deserializationResult = status;
+        /* Update state machine after PUBLISH is sent.
+         * Only to be done for QoS1 or QoS2. */
+        status = MQTT_UpdateStatePublish(pContext,
+                                         packetId,
+                                         MQTT_SEND,
+                                         pPublishInfo->qos,
+                                         &publishStatus);
 
-        /* Invoke application callback to hand the buffer over to application
-         * before sending acks.
-         * Application callback will be invoked for all publishes, except for
-         * duplicate incoming publishes. */
-        if (duplicatePublish == false)
+        if (status != MQTTSuccess)
         {
-            pContext->appCallback(pContext,
-                                  pIncomingPacket,
-                                  &deserializedInfo);
+            LogError(("Update state for publish failed with status %s."
+                      " However PUBLISH packet was sent to the broker."
+                      " Any further handling of ACKs for the packet Id"
+                      " will fail.",
+                      MQTT_Status_strerror(status)));
         }
+    }
 
-        /* Send PUBACK or PUBREC if necessary. */
-        status = sendPublishAcks(pContext,
-                                 packetIdentifier,
-                                 publishRecordState);
+    if (stateUpdateHookExecuted == true)
+    {
+        /* Regardless of the status, if the mutex was taken due to the
+         * packet being of QoS > QoS0, then it should be relinquished. */
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
     }
 
     return status;
@@ -1623,68 +5652,130 @@ static MQTTStatus_t handleIncomingPublish(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handlePublishAcks(MQTTContext_t *pContext,
-                                      MQTTPacketInfo_t *pIncomingPacket)
+static MQTTStatus_t addPublishToBatch(MQTTContext_t *pContext,
+                                      const MQTTPublishInfo_t *pPublishInfo,
+                                      uint16_t packetId,
+                                      size_t remainingLength,
+                                      uint8_t *pMqttHeader,
+                                      uint8_t *pSerializedPacketId,
+                                      TransportOutVector_t *pIoVector,
+                                      size_t *pIoVectorLength,
+                                      size_t *pTotalMessageLength)
 {
-    MQTTStatus_t status = MQTTBadResponse;
-    MQTTPublishState_t publishRecordState = MQTTStateNull;
-    uint16_t packetIdentifier;
-    MQTTPubAckType_t ackType;
-    MQTTEventCallback_t appCallback;
-    MQTTDeserializedInfo_t deserializedInfo;
+    MQTTStatus_t status;
+    size_t headerSize = 0U;
+    size_t ioVectorLength = *pIoVectorLength;
 
-    assert(pContext != NULL);
-    assert(pIncomingPacket != NULL);
-    assert(pContext->appCallback != NULL);
+    status = MQTT_SerializePublishHeaderWithoutTopic(pPublishInfo,
+                                                     remainingLength,
+                                                     pMqttHeader,
+                                                     &headerSize);
 
-    appCallback = pContext->appCallback;
+    if ((status == MQTTSuccess) && (pPublishInfo->qos > MQTTQoS0))
+    {
+        status = MQTT_ReserveState(pContext,
+                                   packetId,
+                                   pPublishInfo->qos);
 
-    ackType = getAckFromPacketType(pIncomingPacket->type);
-    status = MQTT_DeserializeAck(pIncomingPacket, &packetIdentifier, NULL);
-    LogInfo(("Ack packet deserialized with result: %s.",
-             MQTT_Status_strerror(status)));
+        /* State already exists for a duplicate packet. */
+        if ((status == MQTTStateCollision) && (pPublishInfo->dup == true))
+        {
+            status = MQTTSuccess;
+        }
+    }
 
     if (status == MQTTSuccess)
     {
-        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
-
-        status = MQTT_UpdateStateAck(pContext,
-                                     packetIdentifier,
-                                     ackType,
-                                     MQTT_RECEIVE,
-                                     &publishRecordState);
-
-        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        /* Same layout as sendPublishWithoutCopy. */
+        pIoVector[ioVectorLength].iov_base = pMqttHeader;
+        pIoVector[ioVectorLength].iov_len = headerSize;
+        ioVectorLength++;
+        pIoVector[ioVectorLength].iov_base = pPublishInfo->pTopicName;
+        pIoVector[ioVectorLength].iov_len = pPublishInfo->topicNameLength;
+        ioVectorLength++;
+        *pTotalMessageLength += headerSize + pPublishInfo->topicNameLength;
 
-        if (status == MQTTSuccess)
+        if (pPublishInfo->qos > MQTTQoS0)
         {
-            LogInfo(("State record updated. New state=%s.",
-                     MQTT_State_strerror(publishRecordState)));
+            pSerializedPacketId[0] = ((uint8_t)((packetId) >> 8));
+            pSerializedPacketId[1] = ((uint8_t)((packetId) & 0x00ffU));
+
+            pIoVector[ioVectorLength].iov_base = pSerializedPacketId;
+            pIoVector[ioVectorLength].iov_len = 2U;
+            ioVectorLength++;
+            *pTotalMessageLength += 2U;
         }
-        else
+
+        if (pPublishInfo->payloadLength > 0U)
         {
-            LogError(("Updating the state engine for packet id %hu"
-                      " failed with error %s.",
-                      (unsigned short)packetIdentifier,
-                      MQTT_Status_strerror(status)));
+            pIoVector[ioVectorLength].iov_base = pPublishInfo->pPayload;
+            pIoVector[ioVectorLength].iov_len = pPublishInfo->payloadLength;
+            ioVectorLength++;
+            *pTotalMessageLength += pPublishInfo->payloadLength;
         }
+
+        *pIoVectorLength = ioVectorLength;
+    }
+    else
+    {
+        LogError(("Unable to add PUBLISH with packet Id %hu to the batch: %s.",
+                  (unsigned short)packetId,
+                  MQTT_Status_strerror(status)));
     }
 
-    if (status == MQTTSuccess)
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendPublishBatchChunk(MQTTContext_t *pContext,
+                                          TransportOutVector_t *pIoVector,
+                                          size_t ioVectorLength,
+                                          size_t totalMessageLength,
+                                          const MQTTPublishInfo_t *pPublishInfo,
+                                          const uint16_t *pPacketIds,
+                                          MQTTStatus_t *pStatuses,
+                                          size_t publishCount)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishState_t publishStatus = MQTTStateNull;
+    size_t index;
+
+    if ((ioVectorLength > 0U) &&
+        (sendMessageVector(pContext, pIoVector, ioVectorLength) != (int32_t)totalMessageLength))
     {
-        /* Set fields of deserialized struct. */
-        deserializedInfo.packetIdentifier = packetIdentifier;
-        deserializedInfo.deserializationResult = status;
-        deserializedInfo.pPublishInfo = NULL;
+        status = MQTTSendFailed;
+    }
 
-        /* Invoke application callback to hand the buffer over to application
-         * before sending acks. */
-        appCallback(pContext, pIncomingPacket, &deserializedInfo);
+    for (index = 0U; index < publishCount; index++)
+    {
+        if (pStatuses[index] != MQTTSuccess)
+        {
+            /* This message was not part of the chunk. */
+        }
+        else if (status != MQTTSuccess)
+        {
+            pStatuses[index] = status;
+        }
+        else if (pPublishInfo[index].qos > MQTTQoS0)
+        {
+            pStatuses[index] = MQTT_UpdateStatePublish(pContext,
+                                                       pPacketIds[index],
+                                                       MQTT_SEND,
+                                                       pPublishInfo[index].qos,
+                                                       &publishStatus);
 
-        /* Send PUBREL or PUBCOMP if necessary. */
-        status = sendPublishAcks(pContext,
-                                 packetIdentifier,
-                                 publishRecordState);
+            if (pStatuses[index] != MQTTSuccess)
+            {
+                LogError(("Update state for publish failed with status %s."
+                          " However PUBLISH packet was sent to the broker.",
+                          MQTT_Status_strerror(pStatuses[index])));
+            }
+        }
+        else
+        {
+            /* MISRA Empty body */
+        }
     }
 
     return status;
@@ -1692,373 +5783,564 @@ static MQTTStatus_t handlePublishAcks(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleIncomingAck(MQTTContext_t *pContext,
-                                      MQTTPacketInfo_t *pIncomingPacket,
-                                      bool manageKeepAlive)
+static MQTTStatus_t sendConnectWithoutCopy(MQTTContext_t *pContext,
+                                           const MQTTConnectInfo_t *pConnectInfo,
+                                           const MQTTPublishInfo_t *pWillInfo,
+                                           size_t remainingLength)
 {
-    MQTTStatus_t status = MQTTBadResponse;
-    uint16_t packetIdentifier = MQTT_PACKET_ID_INVALID;
-    MQTTDeserializedInfo_t deserializedInfo;
-
-    /* We should always invoke the app callback unless we receive a PINGRESP
-     * and are managing keep alive, or if we receive an unknown packet. We
-     * initialize this to false since the callback must be invoked before
-     * sending any PUBREL or PUBCOMP. However, for other cases, we invoke it
-     * at the end to reduce the complexity of this function. */
-    bool invokeAppCallback = false;
-    MQTTEventCallback_t appCallback = NULL;
-
-    assert(pContext != NULL);
-    assert(pIncomingPacket != NULL);
-    assert(pContext->appCallback != NULL);
+    MQTTStatus_t status = MQTTSuccess;
+    TransportOutVector_t *iterator;
+    size_t ioVectorLength = 0U;
+    size_t totalMessageLength = 0U;
+    int32_t bytesSentOrError;
+    uint8_t *pIndex;
+    uint8_t serializedClientIDLength[2];
+    uint8_t serializedTopicLength[2];
+    uint8_t serializedPayloadLength[2];
+    uint8_t serializedUsernameLength[2];
+    uint8_t serializedPasswordLength[2];
+    size_t vectorsAdded;
 
-    appCallback = pContext->appCallback;
+#if (!MQTT_VERSION_5_ENABLED)
+    /* Maximum number of bytes required by the 'fixed' part of the CONNECT
+     * packet header according to the MQTT specification.
+     * MQTT Control Byte      0 + 1 = 1
+     * Remaining length (max)   + 4 = 5
+     * Protocol Name Length     + 2 = 7
+     * Protocol Name (MQTT)     + 4 = 11
+     * Protocol level           + 1 = 12
+     * Connect flags            + 1 = 13
+     * Keep alive               + 2 = 15 */
+    uint8_t connectPacketHeader[15U];
+    uint8_t serializedUserKeyLength[2];
+    uint8_t userId = MQTT_USER_PROPERTY_ID;
+    uint8_t serializedUserValueLength[2];
+    uint8_t serializedAuthMethodLength[2];
+    uint8_t authMethodId = MQTT_AUTH_METHOD_ID;
+    uint8_t serializedAuthDataLength[2];
+    uint8_t authDataId = MQTT_AUTH_DATA_ID;
+    uint8_t serializedContentTypeLength[2];
+    uint8_t contentTypeId = MQTT_CONTENT_TYPE_ID;
+    uint8_t serializedResponseTopicLength[2];
+    uint8_t responseTopicId = MQTT_RESPONSE_TOPIC_ID;
+    uint8_t serailizedCorrelationLength[2];
+    uint8_t correlationDataId = MQTT_CORRELATION_DATA_ID;
 
-    LogDebug(("Received packet of type %02x.",
-              (unsigned int)pIncomingPacket->type));
+#else
+    /*Properties
+     * Properties length- max- 4
+     *Session Expiry - 5
+     * receive Maximum - 3
+     * Max packet Size 5
+     * Topic Alias Maximum - 3
+     * Request response Information- 2
+     * Request problem Information-2
+     * User property- MAX USER PROPERTY- separate vector
+     * Authentication Data- UTF-8 so separate vector for method and data.
+     * Total- 24
+     */
+    
+    uint8_t connectPacketHeader[39U];
+    uint8_t fixedSizeProperties[20U];
 
-    switch (pIncomingPacket->type)
-    {
-    case MQTT_PACKET_TYPE_PUBACK:
-    case MQTT_PACKET_TYPE_PUBREC:
-    case MQTT_PACKET_TYPE_PUBREL:
-    case MQTT_PACKET_TYPE_PUBCOMP:
 
-        /* Handle all the publish acks. The app callback is invoked here. */
-        status = handlePublishAcks(pContext, pIncomingPacket);
+#endif
+    /* The maximum vectors required to encode and send a connect packet. The
+     * breakdown is shown below.
+     * Fixed header      0 + 1 = 1
+     * Client ID           + 2 = 3
+     * Will topic          + 2 = 5
+     * Will payload        + 2 = 7
+     * Username            + 2 = 9
+     * Password            + 2 = 11 */
+#if (MQTT_VERSION_5_ENABLED == 0)
+    TransportOutVector_t pIoVector[11U];
+#else
+    /*
+     *
+     * User Property- 5* Max userProperty
+     * Authentication- 6
+     * 10 + 5*Max user for wiill properties
+     *
+     */
+    TransportOutVector_t pIoVector[27 + 10 * MAX_USER_PROPERTY];
+#endif
 
-        break;
+    iterator = pIoVector;
+    pIndex = connectPacketHeader;
 
-    case MQTT_PACKET_TYPE_PINGRESP:
-        status = MQTT_DeserializeAck(pIncomingPacket, &packetIdentifier, NULL);
-        invokeAppCallback = (status == MQTTSuccess) && !manageKeepAlive;
+    /* Validate arguments. */
+    if ((pWillInfo != NULL) && (pWillInfo->pTopicName == NULL))
+    {
+        LogError(("pWillInfo->pTopicName cannot be NULL if Will is present."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pIndex = MQTT_SerializeConnectFixedHeader(pIndex,
+                                                  pConnectInfo,
+                                                  pWillInfo,
+                                                  remainingLength);
 
-        if ((status == MQTTSuccess) && (manageKeepAlive == true))
-        {
-            pContext->waitingForPingResp = false;
-        }
+#if (MQTT_VERSION_5_ENABLED)
 
-        break;
+        pIndex = MQTT_SerializeConnectProperties(pIndex, pContext->connectProperties);
 
-    case MQTT_PACKET_TYPE_SUBACK:
-    case MQTT_PACKET_TYPE_UNSUBACK:
-        /* Deserialize and give these to the app provided callback. */
-        status = MQTT_DeserializeAck(pIncomingPacket, &packetIdentifier, NULL);
-        invokeAppCallback = (status == MQTTSuccess) || (status == MQTTServerRefused);
-        break;
+#endif
+        assert(((size_t)(pIndex - connectPacketHeader)) <= sizeof(connectPacketHeader));
 
-    default:
-        /* Bad response from the server. */
-        LogError(("Unexpected packet type from server: PacketType=%02x.",
-                  (unsigned int)pIncomingPacket->type));
-        status = MQTTBadResponse;
-        break;
-    }
+        /* The header gets sent first. */
+        iterator->iov_base = connectPacketHeader;
+        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
+        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
+        /* coverity[misra_c_2012_rule_18_2_violation] */
+        /* coverity[misra_c_2012_rule_10_8_violation] */
+        iterator->iov_len = (size_t)(pIndex - connectPacketHeader);
+        totalMessageLength += iterator->iov_len;
+        iterator++;
+        ioVectorLength++;
 
-    if (invokeAppCallback == true)
-    {
-        /* Set fields of deserialized struct. */
-        deserializedInfo.packetIdentifier = packetIdentifier;
-        deserializedInfo.deserializationResult = status;
-        deserializedInfo.pPublishInfo = NULL;
-        appCallback(pContext, pIncomingPacket, &deserializedInfo);
-        /* In case a SUBACK indicated refusal, reset the status to continue the loop. */
-        status = MQTTSuccess;
-    }
+#if (MQTT_VERSION_5_ENABLED)
+        // User Properties
+        if (pContext->connectProperties->outgoingUserPropSize != 0)
+        {
+            
+            uint16_t i = 0;
+            uint16_t size = pContext->connectProperties->outgoingUserPropSize;
+            MQTTUserProperty_t *userProperty = pContext->connectProperties->outgoingUserProperty;
+            for (; i < size; i++)
+            {
+                vectorsAdded = addEncodedStringToVectorWithId(serializedUserKeyLength,
+                                                              userProperty[i].key,
+                                                              userProperty[i].keyLength,
+                                                              iterator,
+                                                              &totalMessageLength,&userId);
+                iterator = &iterator[vectorsAdded];
+                ioVectorLength += vectorsAdded;
 
-    return status;
-}
-/*-----------------------------------------------------------*/
+                vectorsAdded = addEncodedStringToVector(serializedUserValueLength,
+                                                        userProperty[i].value,
+                                                        userProperty[i].valueLength,
+                                                        iterator,
+                                                        &totalMessageLength);
+                iterator = &iterator[vectorsAdded];
+                ioVectorLength += vectorsAdded;
+            }
 
-static MQTTStatus_t receiveSingleIteration(MQTTContext_t *pContext,
-                                           bool manageKeepAlive)
-{
-    MQTTStatus_t status = MQTTSuccess;
-    MQTTPacketInfo_t incomingPacket = {0};
-    int32_t recvBytes;
-    size_t totalMQTTPacketLength = 0;
+            
+            MQTTAuthInfo_t *pAuthInfo = pContext->connectProperties->outgoingAuth;
+            if (pAuthInfo != NULL)
+            {
+                /* Serialize the authentication method  string. */
+                vectorsAdded = addEncodedStringToVectorWithId(serializedAuthMethodLength,
+                                                              pAuthInfo->authMethod,
+                                                              pAuthInfo->authMethodLength,
+                                                              iterator,
+                                                              &totalMessageLength, &authMethodId);
 
-    assert(pContext != NULL);
-    assert(pContext->networkBuffer.pBuffer != NULL);
+                /* Update the iterator to point to the next empty slot. */
+                iterator = &iterator[vectorsAdded];
+                ioVectorLength += vectorsAdded;
+                if (pAuthInfo->authDataLength != 0U)
+                {
+                    vectorsAdded = addEncodedStringToVectorWithId(serializedAuthDataLength,
+                                                                  pAuthInfo->authData,
+                                                                  pAuthInfo->authDataLength,
+                                                                  iterator,
+                                                                  &totalMessageLength, &authDataId);
 
-    /* Read as many bytes as possible into the network buffer. */
-    recvBytes = pContext->transportInterface.recv(pContext->transportInterface.pNetworkContext,
-                                                  &(pContext->networkBuffer.pBuffer[pContext->index]),
-                                                  pContext->networkBuffer.size - pContext->index);
+                    /* Update the iterator to point to the next empty slot. */
+                    iterator = &iterator[vectorsAdded];
+                    ioVectorLength += vectorsAdded;
+                }
+            }
 
-    if (recvBytes < 0)
-    {
-        /* The receive function has failed. Bubble up the error up to the user. */
-        status = MQTTRecvFailed;
-    }
-    else if ((recvBytes == 0) && (pContext->index == 0U))
-    {
-        /* No more bytes available since the last read and neither is anything in
-         * the buffer. */
-        status = MQTTNoDataAvailable;
-    }
+            // ioVectorLength += MQTT_SerializeUserProperty(pContext->connectProperties->outgoingUserProperty, pContext->connectProperties->outgoingUserPropSize, iterator, &totalMessageLength);
+        }
 
-    /* Either something was received, or there is still data to be processed in the
-     * buffer, or both. */
-    else
-    {
-        /* Update the number of bytes in the MQTT fixed buffer. */
-        pContext->index += (size_t)recvBytes;
+#endif
 
-        status = MQTT_ProcessIncomingPacketTypeAndLength(pContext->networkBuffer.pBuffer,
-                                                         &(pContext->index),
-                                                         &incomingPacket);
+        /* Serialize the client ID. */
+        vectorsAdded = addEncodedStringToVector(serializedClientIDLength,
+                                                pConnectInfo->pClientIdentifier,
+                                                pConnectInfo->clientIdentifierLength,
+                                                iterator,
+                                                &totalMessageLength);
 
-        totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
-    }
+        /* Update the iterator to point to the next empty slot. */
+        iterator = &iterator[vectorsAdded];
+        ioVectorLength += vectorsAdded;
 
-    /* No data was received, check for keep alive timeout. */
-    if (recvBytes == 0)
-    {
-        if (manageKeepAlive == true)
+        if (pWillInfo != NULL)
         {
-            /* Keep the copy of the status to be reset later. */
-            MQTTStatus_t statusCopy = status;
-
-            /* Assign status so an error can be bubbled up to application,
-             * but reset it on success. */
-            status = handleKeepAlive(pContext);
+#if (MQTT_VERSION_5_ENABLED)
+            // Add the will properties
+            
+            // 4 byte + 4 byte delay + 2 byte payload format + 6 byte
+            pIndex = fixedSizeProperties;
+            pIndex = MQTT_SerializePublishProperties(pWillInfo, pIndex, pContext->connectProperties->willDelay);
+            iterator->iov_base = fixedSizeProperties;
+            iterator->iov_len = (size_t)(pIndex - fixedSizeProperties);
+            totalMessageLength += iterator->iov_len;
+            iterator++;
+            ioVectorLength++;
 
-            if (status == MQTTSuccess)
+            if (pWillInfo->contentTypeLength != 0U)
             {
-                /* Reset the status. */
-                status = statusCopy;
+                vectorsAdded = addEncodedStringToVectorWithId(serializedContentTypeLength,
+                                                              pWillInfo->contentType,
+                                                              pWillInfo->contentTypeLength,
+                                                              iterator,
+                                                              &totalMessageLength, &contentTypeId);
+                iterator = &iterator[vectorsAdded];
+                ioVectorLength += vectorsAdded;
             }
-            else
+            if (pWillInfo->responseTopicLength != 0U)
             {
-                LogError(("Handling of keep alive failed. Status=%s",
-                          MQTT_Status_strerror(status)));
+                vectorsAdded = addEncodedStringToVectorWithId(serializedResponseTopicLength,
+                                                              pWillInfo->responseTopic,
+                                                              pWillInfo->responseTopicLength,
+                                                              iterator,
+                                                              &totalMessageLength, &responseTopicId);
+                iterator = &iterator[vectorsAdded];
+                ioVectorLength += vectorsAdded;
             }
-        }
-    }
+            if (pWillInfo->correlationLength != 0U)
+            {
+                vectorsAdded = addEncodedStringToVectorWithId(serailizedCorrelationLength,
+                                                              pWillInfo->correlationData,
+                                                              pWillInfo->correlationLength,
+                                                              iterator,
+                                                              &totalMessageLength, &correlationDataId);
+                iterator = &iterator[vectorsAdded];
+                ioVectorLength += vectorsAdded;
+            }
+            if (pWillInfo->userPropertySize != 0)
+            {
+                    uint16_t i = 0;
+                    uint16_t size = pWillInfo->usePropertySize;
+                    MQTTUserProperty_t* userProperty = pWillInfo->userProperty;
+                    for (; i < size; i++)
+                    {
+                        vectorsAdded = addEncodedStringToVectorWithId(serializedUserKeyLength,
+                            userProperty[i].key,
+                            userProperty[i].keyLength,
+                            iterator,
+                            &totalMessageLength, &userId);
+                        iterator = &iterator[vectorsAdded];
+                        ioVectorLength += vectorsAdded;
 
-    /* Check whether there is data available before processing the packet further. */
-    if ((status == MQTTNeedMoreBytes) || (status == MQTTNoDataAvailable))
-    {
-        /* Do nothing as there is nothing to be processed right now. The proper
-         * error code will be bubbled up to the user. */
-    }
-    /* Any other error code. */
-    else if (status != MQTTSuccess)
-    {
-        LogError(("Call to receiveSingleIteration failed. Status=%s",
-                  MQTT_Status_strerror(status)));
-    }
-    /* If the MQTT Packet size is bigger than the buffer itself. */
-    else if (totalMQTTPacketLength > pContext->networkBuffer.size)
-    {
-        /* Discard the packet from the receive buffer and drain the pending
-         * data from the socket buffer. */
-        status = discardStoredPacket(pContext,
-                                     &incomingPacket);
-    }
-    /* If the total packet is of more length than the bytes we have available. */
-    else if (totalMQTTPacketLength > pContext->index)
-    {
-        status = MQTTNeedMoreBytes;
-    }
-    else
-    {
-        /* MISRA else. */
-    }
+                        vectorsAdded = addEncodedStringToVector(serializedUserValueLength,
+                            userProperty[i].value,
+                            userProperty[i].valueLength,
+                            iterator,
+                            &totalMessageLength);
+                        iterator = &iterator[vectorsAdded];
+                        ioVectorLength += vectorsAdded;
+
+            }
+
+            // vectorsAdded= MQTT_SerializePublishProperties(pWillInfo,iterator,&totalMessageLength,pContext->connectProperties->willDelay);
+#endif
+            /* Serialize the topic. */
+            vectorsAdded = addEncodedStringToVector(serializedTopicLength,
+                                                    pWillInfo->pTopicName,
+                                                    pWillInfo->topicNameLength,
+                                                    iterator,
+                                                    &totalMessageLength);
 
-    /* Handle received packet. If incomplete data was read then this will not execute. */
-    if (status == MQTTSuccess)
-    {
-        incomingPacket.pRemainingData = &pContext->networkBuffer.pBuffer[incomingPacket.headerLength];
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[vectorsAdded];
+            ioVectorLength += vectorsAdded;
 
-        /* PUBLISH packets allow flags in the lower four bits. For other
-         * packet types, they are reserved. */
-        if ((incomingPacket.type & 0xF0U) == MQTT_PACKET_TYPE_PUBLISH)
-        {
-            status = handleIncomingPublish(pContext, &incomingPacket);
+            /* Serialize the payload. Payload of last will and testament can be NULL. */
+            vectorsAdded = addEncodedStringToVector(serializedPayloadLength,
+                                                    pWillInfo->pPayload,
+                                                    (uint16_t)pWillInfo->payloadLength,
+                                                    iterator,
+                                                    &totalMessageLength);
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[vectorsAdded];
+            ioVectorLength += vectorsAdded;
         }
-        else
+
+        /* Encode the user name if provided. */
+        if (pConnectInfo->pUserName != NULL)
         {
-            status = handleIncomingAck(pContext, &incomingPacket, manageKeepAlive);
+            /* Serialize the user name string. */
+            vectorsAdded = addEncodedStringToVector(serializedUsernameLength,
+                                                    pConnectInfo->pUserName,
+                                                    pConnectInfo->userNameLength,
+                                                    iterator,
+                                                    &totalMessageLength);
+
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[vectorsAdded];
+            ioVectorLength += vectorsAdded;
         }
 
-        /* Update the index to reflect the remaining bytes in the buffer.  */
-        pContext->index -= totalMQTTPacketLength;
+        /* Encode the password if provided. */
+        if (pConnectInfo->pPassword != NULL)
+        {
+            /* Serialize the user name string. */
+            vectorsAdded = addEncodedStringToVector(serializedPasswordLength,
+                                                    pConnectInfo->pPassword,
+                                                    pConnectInfo->passwordLength,
+                                                    iterator,
+                                                    &totalMessageLength);
+            /* Update the iterator to point to the next empty slot. */
+            iterator = &iterator[vectorsAdded];
+            ioVectorLength += vectorsAdded;
+        }
 
-        /* Move the remaining bytes to the front of the buffer. */
-        (void)memmove(pContext->networkBuffer.pBuffer,
-                      &(pContext->networkBuffer.pBuffer[totalMQTTPacketLength]),
-                      pContext->index);
+        bytesSentOrError = sendMessageVector(pContext, pIoVector, ioVectorLength);
 
-        if (status == MQTTSuccess)
+        if (bytesSentOrError != (int32_t)totalMessageLength)
         {
-            pContext->lastPacketRxTime = pContext->getTime();
+            status = MQTTSendFailed;
         }
     }
 
-    if (status == MQTTNoDataAvailable)
-    {
-        /* No data available is not an error. Reset to MQTTSuccess so the
-         * return code will indicate success. */
-        status = MQTTSuccess;
-    }
-
     return status;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t validateSubscribeUnsubscribeParams(const MQTTContext_t *pContext,
-                                                       const MQTTSubscribeInfo_t *pSubscriptionList,
-                                                       size_t subscriptionCount,
-                                                       uint16_t packetId)
+static void resetReceiveState(MQTTContext_t *pContext)
 {
-    MQTTStatus_t status = MQTTSuccess;
-    size_t iterator;
+    MQTTOverflowBufferPool_t *pPool = NULL;
+    const MQTTPublishInfo_t *pPublishInfo = NULL;
+    size_t i = 0U;
 
-    /* Validate all the parameters. */
-    if ((pContext == NULL) || (pSubscriptionList == NULL))
-    {
-        LogError(("Argument cannot be NULL: pContext=%p, "
-                  "pSubscriptionList=%p.",
-                  (void *)pContext,
-                  (void *)pSubscriptionList));
-        status = MQTTBadParameter;
-    }
-    else if (subscriptionCount == 0UL)
+    assert(pContext != NULL);
+
+    if (pContext->primaryNetworkBuffer.pBuffer != NULL)
     {
-        LogError(("Subscription count is 0."));
-        status = MQTTBadParameter;
+        pPool = pContext->pOverflowBufferPool;
+
+        MQTT_PRE_OVERFLOW_POOL_HOOK(pPool);
+
+        /* The slot of a buffer taken from the pool is free. */
+        for (i = 0U; i < pPool->bufferCount; i++)
+        {
+            if (pPool->pBuffers[i].pBuffer == NULL)
+            {
+                pPool->pBuffers[i] = pContext->networkBuffer;
+                break;
+            }
+        }
+
+        MQTT_POST_OVERFLOW_POOL_HOOK(pPool);
+
+        pContext->networkBuffer = pContext->primaryNetworkBuffer;
+        pContext->primaryNetworkBuffer.pBuffer = NULL;
+        pContext->primaryNetworkBuffer.size = 0U;
     }
-    else if (packetId == 0U)
+
+    if (pContext->receiveBufferLoaned == true)
     {
-        LogError(("Packet Id for subscription packet is 0."));
-        status = MQTTBadParameter;
+        /* The application owns the network buffer, none of its bytes are
+         * kept. */
+        pContext->index = 0U;
+        switchReceiveBuffer(pContext, pContext->networkBuffer.pBuffer);
     }
-    else
+
+    if (pContext->publishBatchCount > 0U)
     {
-        if (pContext->incomingPublishRecords == NULL)
+        LogWarn(("Dropping the undelivered publishes of an earlier connection: "
+                 "BatchLength=%lu.",
+                 (unsigned long)pContext->publishBatchCount));
+
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+        for (i = 0U; i < pContext->publishBatchCount; i++)
         {
-            for (iterator = 0; iterator < subscriptionCount; iterator++)
+            pPublishInfo = &(pContext->pPublishBatch[i].publishInfo);
+
+            if (pPublishInfo->qos > MQTTQoS0)
             {
-                if (pSubscriptionList->qos > MQTTQoS0)
-                {
-                    LogError(("The incoming publish record list is not "
-                              "initialised for QoS1/QoS2 records. Please call "
-                              " MQTT_InitStatefulQoS to enable use of QoS1 and "
-                              " QoS2 packets."));
-                    status = MQTTBadParameter;
-                    break;
-                }
+                (void)MQTT_RemoveIncomingStateRecord(pContext,
+                                                     pContext->pPublishBatch[i].deserializedInfo.packetIdentifier);
             }
         }
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        pContext->publishBatchCount = 0U;
     }
 
-    return status;
-}
+    pContext->index = 0U;
+    pContext->readIndex = 0U;
+    pContext->pendingPacketLength = 0U;
+    pContext->discardRemaining = 0U;
+    (void)completeDiscardAck(pContext, MQTTRecvFailed);
+    pContext->ackBufferIndex = 0U;
+    pContext->receivePaused = false;
+    pContext->receiveBufferLoanable = false;
+    pContext->callbackRunning = false;
+    pContext->drainInProgress = false;
 
-/*-----------------------------------------------------------*/
+    (void)memset(pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size);
+}
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendSubscribeWithoutCopy(MQTTContext_t *pContext,
-                                             const MQTTSubscribeInfo_t *pSubscriptionList,
-                                             size_t subscriptionCount,
-                                             uint16_t packetId,
-                                             size_t remainingLength)
+static MQTTStatus_t receiveConnack(MQTTContext_t *pContext,
+                                   uint32_t timeoutMs,
+                                   bool cleanSession,
+                                   MQTTPacketInfo_t *pIncomingPacket,
+                                   bool *pSessionPresent)
 {
     MQTTStatus_t status = MQTTSuccess;
-    uint8_t *pIndex;
-    TransportOutVector_t pIoVector[MQTT_SUB_UNSUB_MAX_VECTORS];
-    TransportOutVector_t *pIterator;
-    uint8_t serializedTopicFieldLength[MQTT_SUB_UNSUB_MAX_VECTORS][CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES];
-    size_t totalPacketLength = 0U;
-    size_t ioVectorLength = 0U;
-    size_t subscriptionsSent = 0U;
-    size_t vectorsAdded;
-    size_t topicFieldLengthIndex;
-
-    /* Maximum number of bytes required by the 'fixed' part of the SUBSCRIBE
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Packet ID                + 2 = 7 */
-    uint8_t subscribeheader[7U];
+    MQTTGetCurrentTimeFunc_t getTimeStamp = NULL;
+    uint32_t entryTimeMs = 0U, remainingTimeMs = 0U, timeTakenMs = 0U;
+    bool breakFromLoop = false;
+    uint16_t loopCount = 0U;
+    size_t packetLength = 0U;
 
-    /* The vector array should be at least three element long as the topic
-     * string needs these many vector elements to be stored. */
-    assert(MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH);
+    assert(pContext != NULL);
+    assert(pIncomingPacket != NULL);
+    assert(pContext->getTime != NULL);
 
-    pIndex = subscribeheader;
-    pIterator = pIoVector;
+    getTimeStamp = pContext->getTime;
 
-    pIndex = MQTT_SerializeSubscribeHeader(remainingLength,
-                                           pIndex,
-                                           packetId);
+    /* Get the entry time for the function. */
+    entryTimeMs = getTimeStamp();
 
-    /* The header is to be sent first. */
-    pIterator->iov_base = subscribeheader;
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-    /* coverity[misra_c_2012_rule_18_2_violation] */
-    /* coverity[misra_c_2012_rule_10_8_violation] */
-    pIterator->iov_len = (size_t)(pIndex - subscribeheader);
-    totalPacketLength += pIterator->iov_len;
-    pIterator++;
-    ioVectorLength++;
+    /* Bytes left in the buffer from an earlier connection are stale. */
+    resetReceiveState(pContext);
 
-    while ((status == MQTTSuccess) && (subscriptionsSent < subscriptionCount))
+    do
     {
-        /* Reset the index for next iteration. */
-        topicFieldLengthIndex = 0;
+        /* Transport read for incoming CONNACK packet type and length. The
+         * bytes are received into the network buffer in one call instead of
+         * one byte at a time. MQTT_GetIncomingPacketTypeAndLengthBuffered is a
+         * blocking call and it is returned after a transport receive timeout,
+         * an error, or a successful receive of packet type and length. */
+        status = MQTT_GetIncomingPacketTypeAndLengthBuffered(pContext->transportInterface.recv,
+                                                             pContext->transportInterface.pNetworkContext,
+                                                             pContext->networkBuffer.pBuffer,
+                                                             pContext->networkBuffer.size,
+                                                             &(pContext->index),
+                                                             pIncomingPacket);
 
-        /* Check whether the subscription topic (with QoS) will fit in the
-         * given vector. */
-        while ((ioVectorLength <= (MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_SUBSCRIBE_PER_TOPIC_VECTOR_LENGTH)) &&
-               (subscriptionsSent < subscriptionCount))
+        /* The loop times out based on 2 conditions.
+         * 1. If timeoutMs is greater than 0:
+         *    Loop times out based on the timeout calculated by getTime()
+         *    function.
+         * 2. If timeoutMs is 0:
+         *    Loop times out based on the maximum number of retries config
+         *    MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT. This config will control
+         *    maximum the number of retry attempts to read the CONNACK packet.
+         *    A value of 0 for the config will try once to read CONNACK. */
+        if (timeoutMs > 0U)
         {
-            /* The topic filter and the filter length gets sent next. */
-            vectorsAdded = addEncodedStringToVector(serializedTopicFieldLength[topicFieldLengthIndex],
-                                                    pSubscriptionList[subscriptionsSent].pTopicFilter,
-                                                    pSubscriptionList[subscriptionsSent].topicFilterLength,
-                                                    pIterator,
-                                                    &totalPacketLength);
+            breakFromLoop = calculateElapsedTime(getTimeStamp(), entryTimeMs) >= timeoutMs;
 
-            /* Update the pointer after the above operation. */
-            pIterator = &pIterator[vectorsAdded];
+            /* Block until more data arrives instead of polling. */
+            if ((breakFromLoop == false) &&
+                ((status == MQTTNoDataAvailable) || (status == MQTTNeedMoreBytes)) &&
+                (waitForTransport(pContext, TransportWaitRecv, entryTimeMs, timeoutMs) < 0))
+            {
+                LogError(("Transport wait failed while waiting for CONNACK."));
+                status = MQTTRecvFailed;
+            }
+        }
+        else
+        {
+            breakFromLoop = loopCount >= MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT;
+            loopCount++;
+        }
 
-            /* Lastly, the QoS gets sent. */
-            pIterator->iov_base = &(pSubscriptionList[subscriptionsSent].qos);
-            pIterator->iov_len = 1U;
-            totalPacketLength += pIterator->iov_len;
+        /* Loop until there is data to read or if we have exceeded the timeout/retries. */
+    } while (((status == MQTTNoDataAvailable) || (status == MQTTNeedMoreBytes)) &&
+             (breakFromLoop == false));
 
-            /* Increment the pointer. */
-            pIterator++;
+    if (status == MQTTNeedMoreBytes)
+    {
+        LogError(("Timed out while receiving the fixed header of CONNACK."));
+        status = MQTTRecvFailed;
+    }
 
-            /* Two slots get used by the topic string length and topic string.
-             * One slot gets used by the quality of service. */
-            ioVectorLength += vectorsAdded + 1U;
+    if (status == MQTTSuccess)
+    {
+        /* Time taken in this function so far. */
+        timeTakenMs = calculateElapsedTime(getTimeStamp(), entryTimeMs);
+
+        if (timeTakenMs < timeoutMs)
+        {
+            /* Calculate remaining time for receiving the remainder of
+             * the packet. */
+            remainingTimeMs = timeoutMs - timeTakenMs;
+        }
+
+        /* Reading the remainder of the packet by transport recv.
+         * Attempt to read once even if the timeout has expired.
+         * Invoking receivePacket with remainingTime as 0 would attempt to
+         * recv from network once. If using retries, the remainder of the
+         * CONNACK packet is tried to be read only once. Reading once would be
+         * good as the packet type and remaining length was already read. Hence,
+         * the probability of the remaining 2 bytes available to read is very high. */
+        if (pIncomingPacket->type == MQTT_PACKET_TYPE_CONNACK)
+        {
+            status = receivePacket(pContext,
+                                   *pIncomingPacket,
+                                   remainingTimeMs);
+        }
+        else
+        {
+            LogError(("Incorrect packet type %X received while expecting"
+                      " CONNACK(%X).",
+                      (unsigned int)pIncomingPacket->type,
+                      MQTT_PACKET_TYPE_CONNACK));
+            status = MQTTBadResponse;
+        }
+    }
 
-            subscriptionsSent++;
+    if (status == MQTTSuccess)
+    {
+        /* Update the packet info pointer to the buffer read. */
+        pIncomingPacket->pRemainingData = &(pContext->networkBuffer.pBuffer[pIncomingPacket->headerLength]);
 
-            /* The index needs to be updated for next iteration. */
-            topicFieldLengthIndex++;
-        }
+        /* Deserialize CONNACK. */
+#if (MQTT_VERSION_5_ENABLED == 0)
+        status = MQTT_DeserializeAck(pIncomingPacket, NULL, pSessionPresent);
+#else
+        status = MQTTV5_DeserializeConnack(pContext->connectProperties, pIncomingPacket, pSessionPresent);
+#endif
+    }
 
-        if (sendMessageVector(pContext,
-                              pIoVector,
-                              ioVectorLength) != (int32_t)totalPacketLength)
+    /* If a clean session is requested, a session present should not be set by
+     * broker. */
+    if (status == MQTTSuccess)
+    {
+        if ((cleanSession == true) && (*pSessionPresent == true))
         {
-            status = MQTTSendFailed;
+            LogError(("Unexpected session present flag in CONNACK response from broker."
+                      " CONNECT request with clean session was made with broker."));
+            status = MQTTBadResponse;
         }
+    }
 
-        /* Update the iterator for the next potential loop iteration. */
-        pIterator = pIoVector;
-        /* Reset the vector length for the next potential loop iteration. */
-        ioVectorLength = 0U;
-        /* Reset the packet length for the next potential loop iteration. */
-        totalPacketLength = 0U;
+    if (status == MQTTSuccess)
+    {
+        LogDebug(("Received MQTT CONNACK successfully from broker."));
+
+        /* The broker may send packets right after the CONNACK, and some of
+         * them may have been received along with it. Keep those for the
+         * receive loop. */
+        packetLength = pIncomingPacket->headerLength + pIncomingPacket->remainingLength;
+        pContext->index -= packetLength;
+        (void)memmove(pContext->networkBuffer.pBuffer,
+                      &(pContext->networkBuffer.pBuffer[packetLength]),
+                      pContext->index);
+    }
+    else
+    {
+        LogError(("CONNACK recv failed with status = %s.",
+                  MQTT_Status_strerror(status)));
+        pContext->index = 0U;
     }
 
     return status;
@@ -2066,90 +6348,101 @@ static MQTTStatus_t sendSubscribeWithoutCopy(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendUnsubscribeWithoutCopy(MQTTContext_t *pContext,
-                                               const MQTTSubscribeInfo_t *pSubscriptionList,
-                                               size_t subscriptionCount,
-                                               uint16_t packetId,
-                                               size_t remainingLength)
+static MQTTStatus_t handleSessionResumption(MQTTContext_t *pContext,
+                                            bool sessionPresent)
 {
     MQTTStatus_t status = MQTTSuccess;
-    uint8_t *pIndex;
-    TransportOutVector_t pIoVector[MQTT_SUB_UNSUB_MAX_VECTORS];
-    TransportOutVector_t *pIterator;
-    uint8_t serializedTopicFieldLength[MQTT_SUB_UNSUB_MAX_VECTORS][CORE_MQTT_SERIALIZED_LENGTH_FIELD_BYTES];
-    size_t totalPacketLength = 0U;
-    size_t unsubscriptionsSent = 0U;
-    size_t ioVectorLength = 0U;
-    size_t vectorsAdded;
-    size_t topicFieldLengthIndex;
-
-    /* Maximum number of bytes required by the 'fixed' part of the UNSUBSCRIBE
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Packet ID                + 2 = 7  */
-    uint8_t unsubscribeheader[7U];
-
-    /* The vector array should be at least three element long as the topic
-     * string needs these many vector elements to be stored. */
-    assert(MQTT_SUB_UNSUB_MAX_VECTORS >= CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH);
-
-    pIndex = unsubscribeheader;
-    pIterator = pIoVector;
+    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
+    uint16_t packetId = MQTT_PACKET_ID_INVALID;
+    MQTTPublishState_t state = MQTTStateNull;
 
-    pIndex = MQTT_SerializeUnsubscribeHeader(remainingLength,
-                                             pIndex,
-                                             packetId);
+    assert(pContext != NULL);
 
-    /* The header is to be sent first. */
-    pIterator->iov_base = unsubscribeheader;
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-    /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-    /* coverity[misra_c_2012_rule_18_2_violation] */
-    /* coverity[misra_c_2012_rule_10_8_violation] */
-    pIterator->iov_len = (size_t)(pIndex - unsubscribeheader);
-    totalPacketLength += pIterator->iov_len;
-    pIterator++;
-    ioVectorLength++;
+    /* The network buffer was reset before receiving the CONNACK, and now only
+     * holds packets received after it. */
 
-    while ((status == MQTTSuccess) && (unsubscriptionsSent < subscriptionCount))
+    if (sessionPresent == true)
     {
-        /* Reset the index for next iteration. */
-        topicFieldLengthIndex = 0;
+        /* Get the next packet ID for which a PUBREL need to be resent. */
+        packetId = MQTT_PubrelToResend(pContext, &cursor, &state);
 
-        /* Check whether the subscription topic will fit in the given vector. */
-        while ((ioVectorLength <= (MQTT_SUB_UNSUB_MAX_VECTORS - CORE_MQTT_UNSUBSCRIBE_PER_TOPIC_VECTOR_LENGTH)) &&
-               (unsubscriptionsSent < subscriptionCount))
+        /* Resend all the PUBREL acks after session is reestablished. */
+        while ((packetId != MQTT_PACKET_ID_INVALID) &&
+               (status == MQTTSuccess))
         {
-            /* The topic filter gets sent next. */
-            vectorsAdded = addEncodedStringToVector(serializedTopicFieldLength[topicFieldLengthIndex],
-                                                    pSubscriptionList[unsubscriptionsSent].pTopicFilter,
-                                                    pSubscriptionList[unsubscriptionsSent].topicFilterLength,
-                                                    pIterator,
-                                                    &totalPacketLength);
-
-            /* Update the iterator to point to the next empty location. */
-            pIterator = &pIterator[vectorsAdded];
-            /* Update the total count based on how many vectors were added. */
-            ioVectorLength += vectorsAdded;
+            status = sendPublishAcks(pContext, packetId, state);
 
-            unsubscriptionsSent++;
+            packetId = MQTT_PubrelToResend(pContext, &cursor, &state);
+        }
 
-            /* Update the index for next iteration. */
-            topicFieldLengthIndex++;
+        if (status == MQTTSuccess)
+        {
+            status = flushAcks(pContext);
+        }
+    }
+    else
+    {
+        /* Clear any existing records if a new session is established. */
+        if (pContext->outgoingPublishRecordMaxCount > 0U)
+        {
+            (void)memset(pContext->outgoingPublishRecords,
+                         0x00,
+                         pContext->outgoingPublishRecordMaxCount * sizeof(*pContext->outgoingPublishRecords));
         }
 
-        if (sendMessageVector(pContext, pIoVector, ioVectorLength) != (int32_t)totalPacketLength)
+        if (pContext->incomingPublishRecordMaxCount > 0U)
         {
-            status = MQTTSendFailed;
+            (void)memset(pContext->incomingPublishRecords,
+                         0x00,
+                         pContext->incomingPublishRecordMaxCount * sizeof(*pContext->incomingPublishRecords));
         }
 
-        /* Update the iterator for the next potential loop iteration. */
-        pIterator = pIoVector;
-        /* Reset the vector length for the next potential loop iteration. */
-        ioVectorLength = 0U;
-        /* Reset the packet length for the next potential loop iteration. */
-        totalPacketLength = 0U;
+        /* The publishes of the previous session will not be acknowledged. */
+        failPublishCompletions(pContext);
+    }
+
+    return status;
+}
+
+static MQTTStatus_t validatePublishParams(const MQTTContext_t *pContext,
+                                          const MQTTPublishInfo_t *pPublishInfo,
+                                          uint16_t packetId)
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    /* Validate arguments. */
+    if ((pContext == NULL) || (pPublishInfo == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, "
+                  "pPublishInfo=%p.",
+                  (void *)pContext,
+                  (void *)pPublishInfo));
+        status = MQTTBadParameter;
+    }
+    else if ((pPublishInfo->qos != MQTTQoS0) && (packetId == 0U))
+    {
+        LogError(("Packet Id is 0 for PUBLISH with QoS=%u.",
+                  (unsigned int)pPublishInfo->qos));
+        status = MQTTBadParameter;
+    }
+    else if ((pPublishInfo->payloadLength > 0U) && (pPublishInfo->pPayload == NULL))
+    {
+        LogError(("A nonzero payload length requires a non-NULL payload: "
+                  "payloadLength=%lu, pPayload=%p.",
+                  (unsigned long)pPublishInfo->payloadLength,
+                  pPublishInfo->pPayload));
+        status = MQTTBadParameter;
+    }
+    else if ((pContext->outgoingPublishRecords == NULL) && (pPublishInfo->qos > MQTTQoS0))
+    {
+        LogError(("Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
+                  "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
+                  "to initialize and enable the use of QoS1/QoS2 publishes."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* MISRA else */
     }
 
     return status;
@@ -2157,68 +6450,115 @@ static MQTTStatus_t sendUnsubscribeWithoutCopy(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendPublishWithoutCopy(MQTTContext_t *pContext,
-                                           const MQTTPublishInfo_t *pPublishInfo,
-                                           const uint8_t *pMqttHeader,
-                                           size_t headerSize,
-                                           uint16_t packetId)
+MQTTStatus_t MQTT_Init(MQTTContext_t *pContext,
+                       const TransportInterface_t *pTransportInterface,
+                       MQTTGetCurrentTimeFunc_t getTimeFunction,
+                       MQTTEventCallback_t userCallback,
+                       const MQTTFixedBuffer_t *pNetworkBuffer)
 {
     MQTTStatus_t status = MQTTSuccess;
-    size_t ioVectorLength;
-    size_t totalMessageLength;
-
-    /* Bytes required to encode the packet ID in an MQTT header according to
-     * the MQTT specification. */
-    uint8_t serializedPacketID[2U];
 
-    /* Maximum number of vectors required to encode and send a publish
-     * packet. The breakdown is shown below.
-     * Fixed header (including topic string length)      0 + 1 = 1
-     * Topic string                                        + 1 = 2
-     * Packet ID (only when QoS > QoS0)                    + 1 = 3
-     * Payload                                             + 1 = 4  */
-    TransportOutVector_t pIoVector[4U];
+    /* Validate arguments. */
+    if ((pContext == NULL) || (pTransportInterface == NULL) ||
+        (pNetworkBuffer == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, "
+                  "pTransportInterface=%p, "
+                  "pNetworkBuffer=%p",
+                  (void *)pContext,
+                  (void *)pTransportInterface,
+                  (void *)pNetworkBuffer));
+        status = MQTTBadParameter;
+    }
+    else if (getTimeFunction == NULL)
+    {
+        LogError(("Invalid parameter: getTimeFunction is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (userCallback == NULL)
+    {
+        LogError(("Invalid parameter: userCallback is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (pTransportInterface->recv == NULL)
+    {
+        LogError(("Invalid parameter: pTransportInterface->recv is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (pTransportInterface->send == NULL)
+    {
+        LogError(("Invalid parameter: pTransportInterface->send is NULL"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        (void)memset(pContext, 0x00, sizeof(MQTTContext_t));
 
-    /* The header is sent first. */
-    pIoVector[0U].iov_base = pMqttHeader;
-    pIoVector[0U].iov_len = headerSize;
-    totalMessageLength = headerSize;
+        pContext->connectStatus = MQTTNotConnected;
+        pContext->transportInterface = *pTransportInterface;
+        pContext->getTime = getTimeFunction;
+        pContext->appCallback = userCallback;
+        pContext->networkBuffer = *pNetworkBuffer;
 
-    /* Then the topic name has to be sent. */
-    pIoVector[1U].iov_base = pPublishInfo->pTopicName;
-    pIoVector[1U].iov_len = pPublishInfo->topicNameLength;
-    totalMessageLength += pPublishInfo->topicNameLength;
+        /* Zero is not a valid packet ID per MQTT spec. Start from 1. */
+        pContext->nextPacketId = 1;
+    }
 
-    /* The next field's index should be 2 as the first two fields
-     * have been filled in. */
-    ioVectorLength = 2U;
+    return status;
+}
 
-    if (pPublishInfo->qos > MQTTQoS0)
-    {
-        /* Encode the packet ID. */
-        serializedPacketID[0] = ((uint8_t)((packetId) >> 8));
-        serializedPacketID[1] = ((uint8_t)((packetId) & 0x00ffU));
+/*-----------------------------------------------------------*/
 
-        pIoVector[ioVectorLength].iov_base = serializedPacketID;
-        pIoVector[ioVectorLength].iov_len = sizeof(serializedPacketID);
+MQTTStatus_t MQTT_InitStatefulQoS(MQTTContext_t *pContext,
+                                  MQTTPubAckInfo_t *pOutgoingPublishRecords,
+                                  size_t outgoingPublishCount,
+                                  MQTTPubAckInfo_t *pIncomingPublishRecords,
+                                  size_t incomingPublishCount)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-        ioVectorLength++;
-        totalMessageLength += sizeof(serializedPacketID);
+    if (pContext == NULL)
+    {
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
     }
 
-    /* Publish packets are allowed to contain no payload. */
-    if (pPublishInfo->payloadLength > 0U)
+    /* Check whether the arguments make sense. Not equal here behaves
+     * like an exclusive-or operator for boolean values. */
+    else if ((outgoingPublishCount == 0U) !=
+             (pOutgoingPublishRecords == NULL))
     {
-        pIoVector[ioVectorLength].iov_base = pPublishInfo->pPayload;
-        pIoVector[ioVectorLength].iov_len = pPublishInfo->payloadLength;
-
-        ioVectorLength++;
-        totalMessageLength += pPublishInfo->payloadLength;
+        LogError(("Arguments do not match: pOutgoingPublishRecords=%p, "
+                  "outgoingPublishCount=%lu",
+                  (void *)pOutgoingPublishRecords,
+                  (unsigned long)outgoingPublishCount));
+        status = MQTTBadParameter;
     }
 
-    if (sendMessageVector(pContext, pIoVector, ioVectorLength) != (int32_t)totalMessageLength)
+    /* Check whether the arguments make sense. Not equal here behaves
+     * like an exclusive-or operator for boolean values. */
+    else if ((incomingPublishCount == 0U) !=
+             (pIncomingPublishRecords == NULL))
     {
-        status = MQTTSendFailed;
+        LogError(("Arguments do not match: pIncomingPublishRecords=%p, "
+                  "incomingPublishCount=%lu",
+                  (void *)pIncomingPublishRecords,
+                  (unsigned long)incomingPublishCount));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitStatefulQoS must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->incomingPublishRecordMaxCount = incomingPublishCount;
+        pContext->incomingPublishRecords = pIncomingPublishRecords;
+        pContext->outgoingPublishRecordMaxCount = outgoingPublishCount;
+        pContext->outgoingPublishRecords = pOutgoingPublishRecords;
     }
 
     return status;
@@ -2226,323 +6566,275 @@ static MQTTStatus_t sendPublishWithoutCopy(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t sendConnectWithoutCopy(MQTTContext_t *pContext,
-                                           const MQTTConnectInfo_t *pConnectInfo,
-                                           const MQTTPublishInfo_t *pWillInfo,
-                                           size_t remainingLength)
+MQTTStatus_t MQTT_InitRingBufferReceive(MQTTContext_t *pContext)
 {
     MQTTStatus_t status = MQTTSuccess;
-    TransportOutVector_t *iterator;
-    size_t ioVectorLength = 0U;
-    size_t totalMessageLength = 0U;
-    int32_t bytesSentOrError;
-    uint8_t *pIndex;
-    uint8_t serializedClientIDLength[2];
-    uint8_t serializedTopicLength[2];
-    uint8_t serializedPayloadLength[2];
-    uint8_t serializedUsernameLength[2];
-    uint8_t serializedPasswordLength[2];
-    size_t vectorsAdded;
-
-#if (!MQTT_VERSION_5_ENABLED)
-    /* Maximum number of bytes required by the 'fixed' part of the CONNECT
-     * packet header according to the MQTT specification.
-     * MQTT Control Byte      0 + 1 = 1
-     * Remaining length (max)   + 4 = 5
-     * Protocol Name Length     + 2 = 7
-     * Protocol Name (MQTT)     + 4 = 11
-     * Protocol level           + 1 = 12
-     * Connect flags            + 1 = 13
-     * Keep alive               + 2 = 15 */
-    uint8_t connectPacketHeader[15U];
-    uint8_t serializedUserKeyLength[2];
-    uint8_t userId = MQTT_USER_PROPERTY_ID;
-    uint8_t serializedUserValueLength[2];
-    uint8_t serializedAuthMethodLength[2];
-    uint8_t authMethodId = MQTT_AUTH_METHOD_ID;
-    uint8_t serializedAuthDataLength[2];
-    uint8_t authDataId = MQTT_AUTH_DATA_ID;
-    uint8_t serializedContentTypeLength[2];
-    uint8_t contentTypeId = MQTT_CONTENT_TYPE_ID;
-    uint8_t serializedResponseTopicLength[2];
-    uint8_t responseTopicId = MQTT_RESPONSE_TOPIC_ID;
-    uint8_t serailizedCorrelationLength[2];
-    uint8_t correlationDataId = MQTT_CORRELATION_DATA_ID;
-
-#else
-    /*Properties
-     * Properties length- max- 4
-     *Session Expiry - 5
-     * receive Maximum - 3
-     * Max packet Size 5
-     * Topic Alias Maximum - 3
-     * Request response Information- 2
-     * Request problem Information-2
-     * User property- MAX USER PROPERTY- separate vector
-     * Authentication Data- UTF-8 so separate vector for method and data.
-     * Total- 24
-     */
-    
-    uint8_t connectPacketHeader[39U];
-    uint8_t fixedSizeProperties[20U];
-
-
-#endif
-    /* The maximum vectors required to encode and send a connect packet. The
-     * breakdown is shown below.
-     * Fixed header      0 + 1 = 1
-     * Client ID           + 2 = 3
-     * Will topic          + 2 = 5
-     * Will payload        + 2 = 7
-     * Username            + 2 = 9
-     * Password            + 2 = 11 */
-#if (MQTT_VERSION_5_ENABLED == 0)
-    TransportOutVector_t pIoVector[11U];
-#else
-    /*
-     *
-     * User Property- 5* Max userProperty
-     * Authentication- 6
-     * 10 + 5*Max user for wiill properties
-     *
-     */
-    TransportOutVector_t pIoVector[27 + 10 * MAX_USER_PROPERTY];
-#endif
-
-    iterator = pIoVector;
-    pIndex = connectPacketHeader;
 
-    /* Validate arguments. */
-    if ((pWillInfo != NULL) && (pWillInfo->pTopicName == NULL))
+    if (pContext == NULL)
     {
-        LogError(("pWillInfo->pTopicName cannot be NULL if Will is present."));
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitRingBufferReceive must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
         status = MQTTBadParameter;
     }
     else
     {
-        pIndex = MQTT_SerializeConnectFixedHeader(pIndex,
-                                                  pConnectInfo,
-                                                  pWillInfo,
-                                                  remainingLength);
+        pContext->ringBufferReceive = true;
+    }
 
-#if (MQTT_VERSION_5_ENABLED)
+    return status;
+}
 
-        pIndex = MQTT_SerializeConnectProperties(pIndex, pContext->connectProperties);
+/*-----------------------------------------------------------*/
 
-#endif
-        assert(((size_t)(pIndex - connectPacketHeader)) <= sizeof(connectPacketHeader));
+MQTTStatus_t MQTT_InitReceiveDrain(MQTTContext_t *pContext,
+                                   size_t packetBudget,
+                                   size_t byteBudget)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-        /* The header gets sent first. */
-        iterator->iov_base = connectPacketHeader;
-        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-182 */
-        /* More details at: https://github.com/FreeRTOS/coreMQTT/blob/main/MISRA.md#rule-108 */
-        /* coverity[misra_c_2012_rule_18_2_violation] */
-        /* coverity[misra_c_2012_rule_10_8_violation] */
-        iterator->iov_len = (size_t)(pIndex - connectPacketHeader);
-        totalMessageLength += iterator->iov_len;
-        iterator++;
-        ioVectorLength++;
+    if (pContext == NULL)
+    {
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
+    }
+    else if (packetBudget == 0U)
+    {
+        LogError(("Invalid parameter: packetBudget must be greater than zero."));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitReceiveDrain must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->drainPacketBudget = packetBudget;
+        pContext->drainByteBudget = byteBudget;
+    }
 
-#if (MQTT_VERSION_5_ENABLED)
-        // User Properties
-        if (pContext->connectProperties->outgoingUserPropSize != 0)
-        {
-            
-            uint16_t i = 0;
-            uint16_t size = pContext->connectProperties->outgoingUserPropSize;
-            MQTTUserProperty_t *userProperty = pContext->connectProperties->outgoingUserProperty;
-            for (; i < size; i++)
-            {
-                vectorsAdded = addEncodedStringToVectorWithId(serializedUserKeyLength,
-                                                              userProperty[i].key,
-                                                              userProperty[i].keyLength,
-                                                              iterator,
-                                                              &totalMessageLength,&userId);
-                iterator = &iterator[vectorsAdded];
-                ioVectorLength += vectorsAdded;
+    return status;
+}
 
-                vectorsAdded = addEncodedStringToVector(serializedUserValueLength,
-                                                        userProperty[i].value,
-                                                        userProperty[i].valueLength,
-                                                        iterator,
-                                                        &totalMessageLength);
-                iterator = &iterator[vectorsAdded];
-                ioVectorLength += vectorsAdded;
-            }
+/*-----------------------------------------------------------*/
 
-            
-            MQTTAuthInfo_t *pAuthInfo = pContext->connectProperties->outgoingAuth;
-            if (pAuthInfo != NULL)
-            {
-                /* Serialize the authentication method  string. */
-                vectorsAdded = addEncodedStringToVectorWithId(serializedAuthMethodLength,
-                                                              pAuthInfo->authMethod,
-                                                              pAuthInfo->authMethodLength,
-                                                              iterator,
-                                                              &totalMessageLength, &authMethodId);
+MQTTStatus_t MQTT_InitPublishFragments(MQTTContext_t *pContext,
+                                       MQTTPublishFragmentCallback_t fragmentCallback)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-                /* Update the iterator to point to the next empty slot. */
-                iterator = &iterator[vectorsAdded];
-                ioVectorLength += vectorsAdded;
-                if (pAuthInfo->authDataLength != 0U)
-                {
-                    vectorsAdded = addEncodedStringToVectorWithId(serializedAuthDataLength,
-                                                                  pAuthInfo->authData,
-                                                                  pAuthInfo->authDataLength,
-                                                                  iterator,
-                                                                  &totalMessageLength, &authDataId);
+    if (pContext == NULL)
+    {
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
+    }
+    else if (fragmentCallback == NULL)
+    {
+        LogError(("Invalid parameter: fragmentCallback is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitPublishFragments must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->publishFragmentCallback = fragmentCallback;
+    }
 
-                    /* Update the iterator to point to the next empty slot. */
-                    iterator = &iterator[vectorsAdded];
-                    ioVectorLength += vectorsAdded;
-                }
-            }
+    return status;
+}
 
-            // ioVectorLength += MQTT_SerializeUserProperty(pContext->connectProperties->outgoingUserProperty, pContext->connectProperties->outgoingUserPropSize, iterator, &totalMessageLength);
-        }
+/*-----------------------------------------------------------*/
 
-#endif
+MQTTStatus_t MQTT_InitPayloadDestination(MQTTContext_t *pContext,
+                                         MQTTPayloadDestinationCallback_t destinationCallback)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-        /* Serialize the client ID. */
-        vectorsAdded = addEncodedStringToVector(serializedClientIDLength,
-                                                pConnectInfo->pClientIdentifier,
-                                                pConnectInfo->clientIdentifierLength,
-                                                iterator,
-                                                &totalMessageLength);
+    if (pContext == NULL)
+    {
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
+    }
+    else if (destinationCallback == NULL)
+    {
+        LogError(("Invalid parameter: destinationCallback is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitPayloadDestination must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->payloadDestinationCallback = destinationCallback;
+    }
 
-        /* Update the iterator to point to the next empty slot. */
-        iterator = &iterator[vectorsAdded];
-        ioVectorLength += vectorsAdded;
+    return status;
+}
 
-        if (pWillInfo != NULL)
-        {
-#if (MQTT_VERSION_5_ENABLED)
-            // Add the will properties
-            
-            // 4 byte + 4 byte delay + 2 byte payload format + 6 byte
-            pIndex = fixedSizeProperties;
-            pIndex = MQTT_SerializePublishProperties(pWillInfo, pIndex, pContext->connectProperties->willDelay);
-            iterator->iov_base = fixedSizeProperties;
-            iterator->iov_len = (size_t)(pIndex - fixedSizeProperties);
-            totalMessageLength += iterator->iov_len;
-            iterator++;
-            ioVectorLength++;
+/*-----------------------------------------------------------*/
 
-            if (pWillInfo->contentTypeLength != 0U)
-            {
-                vectorsAdded = addEncodedStringToVectorWithId(serializedContentTypeLength,
-                                                              pWillInfo->contentType,
-                                                              pWillInfo->contentTypeLength,
-                                                              iterator,
-                                                              &totalMessageLength, &contentTypeId);
-                iterator = &iterator[vectorsAdded];
-                ioVectorLength += vectorsAdded;
-            }
-            if (pWillInfo->responseTopicLength != 0U)
-            {
-                vectorsAdded = addEncodedStringToVectorWithId(serializedResponseTopicLength,
-                                                              pWillInfo->responseTopic,
-                                                              pWillInfo->responseTopicLength,
-                                                              iterator,
-                                                              &totalMessageLength, &responseTopicId);
-                iterator = &iterator[vectorsAdded];
-                ioVectorLength += vectorsAdded;
-            }
-            if (pWillInfo->correlationLength != 0U)
-            {
-                vectorsAdded = addEncodedStringToVectorWithId(serailizedCorrelationLength,
-                                                              pWillInfo->correlationData,
-                                                              pWillInfo->correlationLength,
-                                                              iterator,
-                                                              &totalMessageLength, &correlationDataId);
-                iterator = &iterator[vectorsAdded];
-                ioVectorLength += vectorsAdded;
-            }
-            if (pWillInfo->userPropertySize != 0)
-            {
-                    uint16_t i = 0;
-                    uint16_t size = pWillInfo->usePropertySize;
-                    MQTTUserProperty_t* userProperty = pWillInfo->userProperty;
-                    for (; i < size; i++)
-                    {
-                        vectorsAdded = addEncodedStringToVectorWithId(serializedUserKeyLength,
-                            userProperty[i].key,
-                            userProperty[i].keyLength,
-                            iterator,
-                            &totalMessageLength, &userId);
-                        iterator = &iterator[vectorsAdded];
-                        ioVectorLength += vectorsAdded;
+MQTTStatus_t MQTT_InitPublishFilter(MQTTContext_t *pContext,
+                                    MQTTPublishFilterCallback_t filterCallback)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-                        vectorsAdded = addEncodedStringToVector(serializedUserValueLength,
-                            userProperty[i].value,
-                            userProperty[i].valueLength,
-                            iterator,
-                            &totalMessageLength);
-                        iterator = &iterator[vectorsAdded];
-                        ioVectorLength += vectorsAdded;
+    if (pContext == NULL)
+    {
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
+    }
+    else if (filterCallback == NULL)
+    {
+        LogError(("Invalid parameter: filterCallback is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitPublishFilter must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->publishFilterCallback = filterCallback;
+    }
 
-            }
+    return status;
+}
 
-            // vectorsAdded= MQTT_SerializePublishProperties(pWillInfo,iterator,&totalMessageLength,pContext->connectProperties->willDelay);
-#endif
-            /* Serialize the topic. */
-            vectorsAdded = addEncodedStringToVector(serializedTopicLength,
-                                                    pWillInfo->pTopicName,
-                                                    pWillInfo->topicNameLength,
-                                                    iterator,
-                                                    &totalMessageLength);
+/*-----------------------------------------------------------*/
 
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[vectorsAdded];
-            ioVectorLength += vectorsAdded;
+MQTTStatus_t MQTT_InitPublishBatch(MQTTContext_t *pContext,
+                                   MQTTPublishBatchCallback_t batchCallback,
+                                   MQTTPublishBatchEntry_t *pBatchBuffer,
+                                   size_t batchBufferSize)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-            /* Serialize the payload. Payload of last will and testament can be NULL. */
-            vectorsAdded = addEncodedStringToVector(serializedPayloadLength,
-                                                    pWillInfo->pPayload,
-                                                    (uint16_t)pWillInfo->payloadLength,
-                                                    iterator,
-                                                    &totalMessageLength);
+    if ((pContext == NULL) || (pBatchBuffer == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pBatchBuffer=%p\n",
+                  (void *)pContext,
+                  (void *)pBatchBuffer));
+        status = MQTTBadParameter;
+    }
+    else if (batchCallback == NULL)
+    {
+        LogError(("Invalid parameter: batchCallback is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (batchBufferSize == 0U)
+    {
+        LogError(("Invalid parameter: batchBufferSize is 0."));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitPublishBatch must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->publishBatchCallback = batchCallback;
+        pContext->pPublishBatch = pBatchBuffer;
+        pContext->publishBatchSize = batchBufferSize;
+        pContext->publishBatchCount = 0U;
+    }
 
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[vectorsAdded];
-            ioVectorLength += vectorsAdded;
-        }
+    return status;
+}
 
-        /* Encode the user name if provided. */
-        if (pConnectInfo->pUserName != NULL)
-        {
-            /* Serialize the user name string. */
-            vectorsAdded = addEncodedStringToVector(serializedUsernameLength,
-                                                    pConnectInfo->pUserName,
-                                                    pConnectInfo->userNameLength,
-                                                    iterator,
-                                                    &totalMessageLength);
+/*-----------------------------------------------------------*/
 
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[vectorsAdded];
-            ioVectorLength += vectorsAdded;
-        }
+MQTTStatus_t MQTT_InitAckCoalescing(MQTTContext_t *pContext,
+                                    uint8_t *pAckBuffer,
+                                    size_t ackBufferSize)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-        /* Encode the password if provided. */
-        if (pConnectInfo->pPassword != NULL)
-        {
-            /* Serialize the user name string. */
-            vectorsAdded = addEncodedStringToVector(serializedPasswordLength,
-                                                    pConnectInfo->pPassword,
-                                                    pConnectInfo->passwordLength,
-                                                    iterator,
-                                                    &totalMessageLength);
-            /* Update the iterator to point to the next empty slot. */
-            iterator = &iterator[vectorsAdded];
-            ioVectorLength += vectorsAdded;
-        }
+    if ((pContext == NULL) || (pAckBuffer == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pAckBuffer=%p\n",
+                  (void *)pContext,
+                  (void *)pAckBuffer));
+        status = MQTTBadParameter;
+    }
+    else if (ackBufferSize < MQTT_PUBLISH_ACK_PACKET_SIZE)
+    {
+        LogError(("Invalid parameter: ackBufferSize %lu cannot hold an ack.",
+                  (unsigned long)ackBufferSize));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitAckCoalescing must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->pAckBuffer = pAckBuffer;
+        pContext->ackBufferSize = ackBufferSize;
+        pContext->ackBufferIndex = 0U;
+    }
 
-        bytesSentOrError = sendMessageVector(pContext, pIoVector, ioVectorLength);
+    return status;
+}
 
-        if (bytesSentOrError != (int32_t)totalMessageLength)
-        {
-            status = MQTTSendFailed;
-        }
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitTransmitQueue(MQTTContext_t *pContext,
+                                    uint8_t *pQueueBuffer,
+                                    size_t queueBufferSize,
+                                    MQTTTransmitQueueDropCallback_t dropCallback)
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if ((pContext == NULL) || (pQueueBuffer == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pQueueBuffer=%p\n",
+                  (void *)pContext,
+                  (void *)pQueueBuffer));
+        status = MQTTBadParameter;
+    }
+    else if (queueBufferSize == 0U)
+    {
+        LogError(("Invalid parameter: queueBufferSize cannot be 0."));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitTransmitQueue must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->pTransmitQueue = pQueueBuffer;
+        pContext->transmitQueueSize = queueBufferSize;
+        pContext->transmitQueueHead = 0U;
+        pContext->transmitQueueTail = 0U;
+        pContext->transmitQueuePacketStart = 0U;
+        pContext->transmitQueueDropCallback = dropCallback;
     }
 
     return status;
@@ -2550,127 +6842,96 @@ static MQTTStatus_t sendConnectWithoutCopy(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t receiveConnack(const MQTTContext_t *pContext,
-                                   uint32_t timeoutMs,
-                                   bool cleanSession,
-                                   MQTTPacketInfo_t *pIncomingPacket,
-                                   bool *pSessionPresent)
+MQTTStatus_t MQTT_InitSendStaging(MQTTContext_t *pContext,
+                                  uint8_t *pStagingBuffer,
+                                  size_t stagingBufferSize)
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTGetCurrentTimeFunc_t getTimeStamp = NULL;
-    uint32_t entryTimeMs = 0U, remainingTimeMs = 0U, timeTakenMs = 0U;
-    bool breakFromLoop = false;
-    uint16_t loopCount = 0U;
-
-    assert(pContext != NULL);
-    assert(pIncomingPacket != NULL);
-    assert(pContext->getTime != NULL);
-
-    getTimeStamp = pContext->getTime;
-
-    /* Get the entry time for the function. */
-    entryTimeMs = getTimeStamp();
 
-    do
+    if ((pContext == NULL) || (pStagingBuffer == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pStagingBuffer=%p\n",
+                  (void *)pContext,
+                  (void *)pStagingBuffer));
+        status = MQTTBadParameter;
+    }
+    else if (stagingBufferSize == 0U)
+    {
+        LogError(("Invalid parameter: stagingBufferSize cannot be 0."));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitSendStaging must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
     {
-        /* Transport read for incoming CONNACK packet type and length.
-         * MQTT_GetIncomingPacketTypeAndLength is a blocking call and it is
-         * returned after a transport receive timeout, an error, or a successful
-         * receive of packet type and length. */
-        status = MQTT_GetIncomingPacketTypeAndLength(pContext->transportInterface.recv,
-                                                     pContext->transportInterface.pNetworkContext,
-                                                     pIncomingPacket);
+        pContext->pSendStagingBuffer = pStagingBuffer;
+        pContext->sendStagingBufferSize = stagingBufferSize;
+    }
 
-        /* The loop times out based on 2 conditions.
-         * 1. If timeoutMs is greater than 0:
-         *    Loop times out based on the timeout calculated by getTime()
-         *    function.
-         * 2. If timeoutMs is 0:
-         *    Loop times out based on the maximum number of retries config
-         *    MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT. This config will control
-         *    maximum the number of retry attempts to read the CONNACK packet.
-         *    A value of 0 for the config will try once to read CONNACK. */
-        if (timeoutMs > 0U)
-        {
-            breakFromLoop = calculateElapsedTime(getTimeStamp(), entryTimeMs) >= timeoutMs;
-        }
-        else
-        {
-            breakFromLoop = loopCount >= MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT;
-            loopCount++;
-        }
+    return status;
+}
 
-        /* Loop until there is data to read or if we have exceeded the timeout/retries. */
-    } while ((status == MQTTNoDataAvailable) && (breakFromLoop == false));
+/*-----------------------------------------------------------*/
 
-    if (status == MQTTSuccess)
+MQTTStatus_t MQTT_InitCoarseClock(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if (pContext == NULL)
     {
-        /* Time taken in this function so far. */
-        timeTakenMs = calculateElapsedTime(getTimeStamp(), entryTimeMs);
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitCoarseClock must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->coarseClock = true;
+    }
 
-        if (timeTakenMs < timeoutMs)
-        {
-            /* Calculate remaining time for receiving the remainder of
-             * the packet. */
-            remainingTimeMs = timeoutMs - timeTakenMs;
-        }
+    return status;
+}
 
-        /* Reading the remainder of the packet by transport recv.
-         * Attempt to read once even if the timeout has expired.
-         * Invoking receivePacket with remainingTime as 0 would attempt to
-         * recv from network once. If using retries, the remainder of the
-         * CONNACK packet is tried to be read only once. Reading once would be
-         * good as the packet type and remaining length was already read. Hence,
-         * the probability of the remaining 2 bytes available to read is very high. */
-        if (pIncomingPacket->type == MQTT_PACKET_TYPE_CONNACK)
-        {
-            status = receivePacket(pContext,
-                                   *pIncomingPacket,
-                                   remainingTimeMs);
-        }
-        else
-        {
-            LogError(("Incorrect packet type %X received while expecting"
-                      " CONNACK(%X).",
-                      (unsigned int)pIncomingPacket->type,
-                      MQTT_PACKET_TYPE_CONNACK));
-            status = MQTTBadResponse;
-        }
-    }
+/*-----------------------------------------------------------*/
 
-    if (status == MQTTSuccess)
-    {
-        /* Update the packet info pointer to the buffer read. */
-        pIncomingPacket->pRemainingData = pContext->networkBuffer.pBuffer;
+MQTTStatus_t MQTT_InitPublishCompletion(MQTTContext_t *pContext,
+                                        MQTTPublishCompletion_t *pCompletions,
+                                        size_t completionCount)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-        /* Deserialize CONNACK. */
-#if (MQTT_VERSION_5_ENABLED == 0)
-        status = MQTT_DeserializeAck(pIncomingPacket, NULL, pSessionPresent);
-#else
-        status = MQTTV5_DeserializeConnack(pContext->connectProperties, pIncomingPacket, pSessionPresent);
-#endif
+    if ((pContext == NULL) || (pCompletions == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pCompletions=%p\n",
+                  (void *)pContext,
+                  (void *)pCompletions));
+        status = MQTTBadParameter;
     }
-
-    /* If a clean session is requested, a session present should not be set by
-     * broker. */
-    if (status == MQTTSuccess)
+    else if (completionCount == 0U)
     {
-        if ((cleanSession == true) && (*pSessionPresent == true))
-        {
-            LogError(("Unexpected session present flag in CONNACK response from broker."
-                      " CONNECT request with clean session was made with broker."));
-            status = MQTTBadResponse;
-        }
+        LogError(("Invalid parameter: completionCount cannot be 0."));
+        status = MQTTBadParameter;
     }
-
-    if (status == MQTTSuccess)
+    else if (pContext->appCallback == NULL)
     {
-        LogDebug(("Received MQTT CONNACK successfully from broker."));
+        LogError(("MQTT_InitPublishCompletion must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
     }
     else
     {
-        LogError(("CONNACK recv failed with status = %s.",
-                  MQTT_Status_strerror(status)));
+        (void)memset(pCompletions, 0x00, completionCount * sizeof(*pCompletions));
+        pContext->pPublishCompletions = pCompletions;
+        pContext->publishCompletionCount = completionCount;
     }
 
     return status;
@@ -2678,94 +6939,192 @@ static MQTTStatus_t receiveConnack(const MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t handleSessionResumption(MQTTContext_t *pContext,
-                                            bool sessionPresent)
+MQTTStatus_t MQTT_InitQoS1Dedup(MQTTContext_t *pContext,
+                                MQTTQoS1DedupEntry_t *pCache,
+                                size_t cacheSize,
+                                uint32_t windowMs)
 {
     MQTTStatus_t status = MQTTSuccess;
-    MQTTStateCursor_t cursor = MQTT_STATE_CURSOR_INITIALIZER;
-    uint16_t packetId = MQTT_PACKET_ID_INVALID;
-    MQTTPublishState_t state = MQTTStateNull;
 
-    assert(pContext != NULL);
+    if ((pContext == NULL) || (pCache == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pCache=%p\n",
+                  (void *)pContext,
+                  (void *)pCache));
+        status = MQTTBadParameter;
+    }
+    else if (cacheSize == 0U)
+    {
+        LogError(("Invalid parameter: cacheSize is 0."));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitQoS1Dedup must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        (void)memset(pCache, 0x00, cacheSize * sizeof(*pCache));
 
-    /* Reset the index and clear the buffer when a new session is established. */
-    pContext->index = 0;
-    (void)memset(pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size);
+        pContext->pQoS1DedupCache = pCache;
+        pContext->qos1DedupCacheSize = cacheSize;
+        pContext->qos1DedupCacheNext = 0U;
+        pContext->qos1DedupWindowMs = windowMs;
+    }
 
-    if (sessionPresent == true)
-    {
-        /* Get the next packet ID for which a PUBREL need to be resent. */
-        packetId = MQTT_PubrelToResend(pContext, &cursor, &state);
+    return status;
+}
 
-        /* Resend all the PUBREL acks after session is reestablished. */
-        while ((packetId != MQTT_PACKET_ID_INVALID) &&
-               (status == MQTTSuccess))
-        {
-            status = sendPublishAcks(pContext, packetId, state);
+/*-----------------------------------------------------------*/
 
-            packetId = MQTT_PubrelToResend(pContext, &cursor, &state);
-        }
+MQTTStatus_t MQTT_InitReceiveBufferPool(MQTTContext_t *pContext,
+                                        MQTTFixedBuffer_t *pBuffers,
+                                        size_t bufferCount)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t i = 0U;
+
+    if ((pContext == NULL) || (pBuffers == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pBuffers=%p\n",
+                  (void *)pContext,
+                  (void *)pBuffers));
+        status = MQTTBadParameter;
+    }
+    else if (bufferCount == 0U)
+    {
+        LogError(("Invalid parameter: bufferCount is 0."));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->appCallback == NULL)
+    {
+        LogError(("MQTT_InitReceiveBufferPool must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
     }
     else
     {
-        /* Clear any existing records if a new session is established. */
-        if (pContext->outgoingPublishRecordMaxCount > 0U)
+        for (i = 0U; i < bufferCount; i++)
         {
-            (void)memset(pContext->outgoingPublishRecords,
-                         0x00,
-                         pContext->outgoingPublishRecordMaxCount * sizeof(*pContext->outgoingPublishRecords));
+            if ((pBuffers[i].pBuffer == NULL) ||
+                (pBuffers[i].size != pContext->networkBuffer.size))
+            {
+                LogError(("Invalid receive buffer at index %lu: pBuffer=%p, Size=%lu, "
+                          "NetworkBufferSize=%lu.",
+                          (unsigned long)i,
+                          (void *)pBuffers[i].pBuffer,
+                          (unsigned long)pBuffers[i].size,
+                          (unsigned long)pContext->networkBuffer.size));
+                status = MQTTBadParameter;
+                break;
+            }
         }
+    }
 
-        if (pContext->incomingPublishRecordMaxCount > 0U)
-        {
-            (void)memset(pContext->incomingPublishRecords,
-                         0x00,
-                         pContext->incomingPublishRecordMaxCount * sizeof(*pContext->incomingPublishRecords));
-        }
+    if (status == MQTTSuccess)
+    {
+        pContext->pReceiveBufferPool = pBuffers;
+        pContext->receiveBufferPoolSize = bufferCount;
     }
 
     return status;
 }
 
-static MQTTStatus_t validatePublishParams(const MQTTContext_t *pContext,
-                                          const MQTTPublishInfo_t *pPublishInfo,
-                                          uint16_t packetId)
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_InitOverflowBufferPool(MQTTContext_t *pContext,
+                                         MQTTOverflowBufferPool_t *pPool)
 {
     MQTTStatus_t status = MQTTSuccess;
 
-    /* Validate arguments. */
-    if ((pContext == NULL) || (pPublishInfo == NULL))
+    if ((pContext == NULL) || (pPool == NULL))
     {
-        LogError(("Argument cannot be NULL: pContext=%p, "
-                  "pPublishInfo=%p.",
+        LogError(("Argument cannot be NULL: pContext=%p, pPool=%p\n",
                   (void *)pContext,
-                  (void *)pPublishInfo));
+                  (void *)pPool));
         status = MQTTBadParameter;
     }
-    else if ((pPublishInfo->qos != MQTTQoS0) && (packetId == 0U))
+    else if ((pPool->pBuffers == NULL) || (pPool->bufferCount == 0U))
     {
-        LogError(("Packet Id is 0 for PUBLISH with QoS=%u.",
-                  (unsigned int)pPublishInfo->qos));
+        LogError(("Invalid overflow buffer pool: pBuffers=%p, BufferCount=%lu.",
+                  (void *)pPool->pBuffers,
+                  (unsigned long)pPool->bufferCount));
         status = MQTTBadParameter;
     }
-    else if ((pPublishInfo->payloadLength > 0U) && (pPublishInfo->pPayload == NULL))
+    else if (pContext->appCallback == NULL)
     {
-        LogError(("A nonzero payload length requires a non-NULL payload: "
-                  "payloadLength=%lu, pPayload=%p.",
-                  (unsigned long)pPublishInfo->payloadLength,
-                  pPublishInfo->pPayload));
+        LogError(("MQTT_InitOverflowBufferPool must be called only after MQTT_Init has"
+                  " been called successfully.\n"));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->pOverflowBufferPool = pPool;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_LoanReceiveBuffer(MQTTContext_t *pContext,
+                                    MQTTFixedBuffer_t *pLoanedBuffer)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t i = 0U;
+
+    if ((pContext == NULL) || (pLoanedBuffer == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pLoanedBuffer=%p\n",
+                  (void *)pContext,
+                  (void *)pLoanedBuffer));
         status = MQTTBadParameter;
     }
-    else if ((pContext->outgoingPublishRecords == NULL) && (pPublishInfo->qos > MQTTQoS0))
+    else if (pContext->pReceiveBufferPool == NULL)
     {
-        LogError(("Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
-                  "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
-                  "to initialize and enable the use of QoS1/QoS2 publishes."));
+        LogError(("MQTT_LoanReceiveBuffer must be called only after "
+                  "MQTT_InitReceiveBufferPool has been called successfully.\n"));
         status = MQTTBadParameter;
     }
+    else if ((pContext->receiveBufferLoanable == false) ||
+             (pContext->receiveBufferLoaned == true))
+    {
+        LogError(("The network buffer can only be taken once, from the event "
+                  "callback of a received packet or the batch callback."));
+        status = MQTTIllegalState;
+    }
     else
     {
-        /* MISRA else */
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+        status = MQTTNoMemory;
+
+        for (i = 0U; i < pContext->receiveBufferPoolSize; i++)
+        {
+            if (pContext->pReceiveBufferPool[i].pBuffer != NULL)
+            {
+                /* The network buffer is replaced with this one once the
+                 * callback returns. */
+                pContext->spareReceiveBuffer = pContext->pReceiveBufferPool[i];
+                pContext->pReceiveBufferPool[i].pBuffer = NULL;
+                status = MQTTSuccess;
+                break;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        if (status == MQTTSuccess)
+        {
+            *pLoanedBuffer = pContext->networkBuffer;
+            pContext->receiveBufferLoaned = true;
+        }
+        else
+        {
+            LogWarn(("All the buffers of the receive buffer pool are in use."));
+        }
     }
 
     return status;
@@ -2773,58 +7132,57 @@ static MQTTStatus_t validatePublishParams(const MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Init(MQTTContext_t *pContext,
-                       const TransportInterface_t *pTransportInterface,
-                       MQTTGetCurrentTimeFunc_t getTimeFunction,
-                       MQTTEventCallback_t userCallback,
-                       const MQTTFixedBuffer_t *pNetworkBuffer)
+MQTTStatus_t MQTT_ReturnReceiveBuffer(MQTTContext_t *pContext,
+                                      const MQTTFixedBuffer_t *pBuffer)
 {
     MQTTStatus_t status = MQTTSuccess;
+    size_t i = 0U;
 
-    /* Validate arguments. */
-    if ((pContext == NULL) || (pTransportInterface == NULL) ||
-        (pNetworkBuffer == NULL))
+    if ((pContext == NULL) || (pBuffer == NULL))
     {
-        LogError(("Argument cannot be NULL: pContext=%p, "
-                  "pTransportInterface=%p, "
-                  "pNetworkBuffer=%p",
+        LogError(("Argument cannot be NULL: pContext=%p, pBuffer=%p\n",
                   (void *)pContext,
-                  (void *)pTransportInterface,
-                  (void *)pNetworkBuffer));
-        status = MQTTBadParameter;
-    }
-    else if (getTimeFunction == NULL)
-    {
-        LogError(("Invalid parameter: getTimeFunction is NULL"));
-        status = MQTTBadParameter;
-    }
-    else if (userCallback == NULL)
-    {
-        LogError(("Invalid parameter: userCallback is NULL"));
+                  (void *)pBuffer));
         status = MQTTBadParameter;
     }
-    else if (pTransportInterface->recv == NULL)
+    else if (pContext->pReceiveBufferPool == NULL)
     {
-        LogError(("Invalid parameter: pTransportInterface->recv is NULL"));
+        LogError(("MQTT_ReturnReceiveBuffer must be called only after "
+                  "MQTT_InitReceiveBufferPool has been called successfully.\n"));
         status = MQTTBadParameter;
     }
-    else if (pTransportInterface->send == NULL)
+    else if ((pBuffer->pBuffer == NULL) ||
+             (pBuffer->size != pContext->networkBuffer.size))
     {
-        LogError(("Invalid parameter: pTransportInterface->send is NULL"));
+        LogError(("Invalid parameter: pBuffer is not a receive buffer: "
+                  "pBuffer=%p, Size=%lu.",
+                  (void *)pBuffer->pBuffer,
+                  (unsigned long)pBuffer->size));
         status = MQTTBadParameter;
     }
     else
     {
-        (void)memset(pContext, 0x00, sizeof(MQTTContext_t));
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
 
-        pContext->connectStatus = MQTTNotConnected;
-        pContext->transportInterface = *pTransportInterface;
-        pContext->getTime = getTimeFunction;
-        pContext->appCallback = userCallback;
-        pContext->networkBuffer = *pNetworkBuffer;
+        status = MQTTBadParameter;
 
-        /* Zero is not a valid packet ID per MQTT spec. Start from 1. */
-        pContext->nextPacketId = 1;
+        for (i = 0U; i < pContext->receiveBufferPoolSize; i++)
+        {
+            /* The slot of a buffer taken from the pool is free. */
+            if (pContext->pReceiveBufferPool[i].pBuffer == NULL)
+            {
+                pContext->pReceiveBufferPool[i] = *pBuffer;
+                status = MQTTSuccess;
+                break;
+            }
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        if (status != MQTTSuccess)
+        {
+            LogError(("No receive buffer is on loan."));
+        }
     }
 
     return status;
@@ -2832,11 +7190,7 @@ MQTTStatus_t MQTT_Init(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_InitStatefulQoS(MQTTContext_t *pContext,
-                                  MQTTPubAckInfo_t *pOutgoingPublishRecords,
-                                  size_t outgoingPublishCount,
-                                  MQTTPubAckInfo_t *pIncomingPublishRecords,
-                                  size_t incomingPublishCount)
+MQTTStatus_t MQTT_PauseReceive(MQTTContext_t *pContext)
 {
     MQTTStatus_t status = MQTTSuccess;
 
@@ -2846,42 +7200,53 @@ MQTTStatus_t MQTT_InitStatefulQoS(MQTTContext_t *pContext,
                   (void *)pContext));
         status = MQTTBadParameter;
     }
-
-    /* Check whether the arguments make sense. Not equal here behaves
-     * like an exclusive-or operator for boolean values. */
-    else if ((outgoingPublishCount == 0U) !=
-             (pOutgoingPublishRecords == NULL))
+    else
     {
-        LogError(("Arguments do not match: pOutgoingPublishRecords=%p, "
-                  "outgoingPublishCount=%lu",
-                  (void *)pOutgoingPublishRecords,
-                  (unsigned long)outgoingPublishCount));
-        status = MQTTBadParameter;
-    }
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
 
-    /* Check whether the arguments make sense. Not equal here behaves
-     * like an exclusive-or operator for boolean values. */
-    else if ((incomingPublishCount == 0U) !=
-             (pIncomingPublishRecords == NULL))
-    {
-        LogError(("Arguments do not match: pIncomingPublishRecords=%p, "
-                  "incomingPublishCount=%lu",
-                  (void *)pIncomingPublishRecords,
-                  (unsigned long)incomingPublishCount));
-        status = MQTTBadParameter;
+        pContext->receivePaused = true;
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
     }
-    else if (pContext->appCallback == NULL)
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_ResumeReceive(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if (pContext == NULL)
     {
-        LogError(("MQTT_InitStatefulQoS must be called only after MQTT_Init has"
-                  " been called successfully.\n"));
+        LogError(("Argument cannot be NULL: pContext=%p\n",
+                  (void *)pContext));
         status = MQTTBadParameter;
     }
     else
     {
-        pContext->incomingPublishRecordMaxCount = incomingPublishCount;
-        pContext->incomingPublishRecords = pIncomingPublishRecords;
-        pContext->outgoingPublishRecordMaxCount = outgoingPublishCount;
-        pContext->outgoingPublishRecords = pOutgoingPublishRecords;
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+
+        pContext->receivePaused = false;
+
+        /* The PINGRESP could not be received while paused, so its timeout
+         * starts now. The time of the loop pass can only be used from an
+         * application callback, which runs on the loop thread. */
+        if (pContext->waitingForPingResp == false)
+        {
+            /* No PINGREQ is outstanding. */
+        }
+        else if (pContext->callbackRunning == true)
+        {
+            pContext->pingReqSendTimeMs = getCurrentTime(pContext);
+        }
+        else
+        {
+            pContext->pingReqSendTimeMs = pContext->getTime();
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
     }
 
     return status;
@@ -2928,6 +7293,7 @@ MQTTStatus_t MQTT_Connect(MQTTContext_t *pContext,
                           bool *pSessionPresent)
 {
     size_t remainingLength = 0UL, packetSize = 0UL;
+    size_t droppedPublishCount = 0U;
     MQTTStatus_t status = MQTTSuccess;
     MQTTPacketInfo_t incomingPacket = {0};
 
@@ -2991,6 +7357,19 @@ MQTTStatus_t MQTT_Connect(MQTTContext_t *pContext,
 
     if (status == MQTTSuccess)
     {
+        /* Publishes queued for an earlier connection are not sent on this
+         * one. They are resent with the rest of the session, if it resumes. */
+        MQTT_PRE_SEND_HOOK(pContext);
+        droppedPublishCount = dropTransmitQueue(pContext);
+        MQTT_POST_SEND_HOOK(pContext);
+
+        /* QoS 0 publishes are lost, so the application is told of them. */
+        if ((droppedPublishCount > 0U) &&
+            (pContext->transmitQueueDropCallback != NULL))
+        {
+            pContext->transmitQueueDropCallback(pContext, droppedPublishCount);
+        }
+
         MQTT_PRE_SEND_HOOK(pContext);
 
         status = sendConnectWithoutCopy(pContext,
@@ -3088,8 +7467,6 @@ MQTTStatus_t MQTT_Publish(MQTTContext_t *pContext,
     size_t headerSize = 0UL;
     size_t remainingLength = 0UL;
     size_t packetSize = 0UL;
-    MQTTPublishState_t publishStatus = MQTTStateNull;
-    bool stateUpdateHookExecuted = false;
 
     /* Maximum number of bytes required by the 'fixed' part of the PUBLISH
      * packet header according to the MQTT specifications.
@@ -3114,77 +7491,309 @@ MQTTStatus_t MQTT_Publish(MQTTContext_t *pContext,
                                            &remainingLength,
                                            &packetSize);
     }
-
-    if (status == MQTTSuccess)
+
+    if (status == MQTTSuccess)
+    {
+        status = MQTT_SerializePublishHeaderWithoutTopic(pPublishInfo,
+                                                         remainingLength,
+                                                         mqttHeader,
+                                                         &headerSize);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        status = sendSerializedPublish(pContext,
+                                       pPublishInfo,
+                                       mqttHeader,
+                                       headerSize,
+                                       packetId);
+    }
+
+    if (status != MQTTSuccess)
+    {
+        LogError(("MQTT PUBLISH failed with status %s.",
+                  MQTT_Status_strerror(status)));
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_PublishBatch(MQTTContext_t *pContext,
+                               const MQTTPublishInfo_t *pPublishInfo,
+                               const uint16_t *pPacketIds,
+                               size_t publishCount,
+                               MQTTStatus_t *pStatuses)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t sendStatus = MQTTSuccess;
+    size_t index;
+    size_t chunkStart = 0U;
+    size_t chunkCount = 0U;
+    size_t ioVectorLength = 0U;
+    size_t totalMessageLength = 0U;
+    size_t remainingLength = 0UL;
+    size_t packetSize = 0UL;
+
+    /* Header, packet Id and vectors of every packet in the current chunk.
+     * See MQTT_Publish and sendPublishWithoutCopy for their sizes. */
+    uint8_t mqttHeader[MQTT_PUBLISH_BATCH_MAX_VECTORS / 4U][7U];
+    uint8_t serializedPacketId[MQTT_PUBLISH_BATCH_MAX_VECTORS / 4U][2U];
+    TransportOutVector_t pIoVector[MQTT_PUBLISH_BATCH_MAX_VECTORS];
+
+    if ((pContext == NULL) || (pPublishInfo == NULL) ||
+        (pPacketIds == NULL) || (pStatuses == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, "
+                  "pPublishInfo=%p, pPacketIds=%p, pStatuses=%p",
+                  (void *)pContext,
+                  (const void *)pPublishInfo,
+                  (const void *)pPacketIds,
+                  (void *)pStatuses));
+        status = MQTTBadParameter;
+    }
+    else if (publishCount == 0U)
+    {
+        LogError(("publishCount must be greater than 0."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Both hooks are taken once for the whole batch, in the same order
+         * as MQTT_Publish takes them. */
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+        MQTT_PRE_SEND_HOOK(pContext);
+
+        for (index = 0U; index < publishCount; index++)
+        {
+            pStatuses[index] = sendStatus;
+
+            if (pStatuses[index] == MQTTSuccess)
+            {
+                pStatuses[index] = validatePublishParams(pContext,
+                                                         &pPublishInfo[index],
+                                                         pPacketIds[index]);
+            }
+
+            if (pStatuses[index] == MQTTSuccess)
+            {
+                pStatuses[index] = MQTT_GetPublishPacketSize(&pPublishInfo[index],
+                                                             &remainingLength,
+                                                             &packetSize);
+            }
+
+            /* Send what has been gathered so far if this packet does not fit
+             * in the chunk. */
+            if ((pStatuses[index] == MQTTSuccess) &&
+                ((chunkCount == (MQTT_PUBLISH_BATCH_MAX_VECTORS / 4U)) ||
+                 (totalMessageLength > ((size_t)INT32_MAX - packetSize))))
+            {
+                sendStatus = sendPublishBatchChunk(pContext,
+                                                   pIoVector,
+                                                   ioVectorLength,
+                                                   totalMessageLength,
+                                                   &pPublishInfo[chunkStart],
+                                                   &pPacketIds[chunkStart],
+                                                   &pStatuses[chunkStart],
+                                                   index - chunkStart);
+                chunkStart = index;
+                chunkCount = 0U;
+                ioVectorLength = 0U;
+                totalMessageLength = 0U;
+                pStatuses[index] = sendStatus;
+            }
+
+            if (pStatuses[index] == MQTTSuccess)
+            {
+                pStatuses[index] = addPublishToBatch(pContext,
+                                                     &pPublishInfo[index],
+                                                     pPacketIds[index],
+                                                     remainingLength,
+                                                     mqttHeader[chunkCount],
+                                                     serializedPacketId[chunkCount],
+                                                     pIoVector,
+                                                     &ioVectorLength,
+                                                     &totalMessageLength);
+            }
+
+            if (pStatuses[index] == MQTTSuccess)
+            {
+                chunkCount++;
+            }
+        }
+
+        if (sendStatus == MQTTSuccess)
+        {
+            (void)sendPublishBatchChunk(pContext,
+                                        pIoVector,
+                                        ioVectorLength,
+                                        totalMessageLength,
+                                        &pPublishInfo[chunkStart],
+                                        &pPacketIds[chunkStart],
+                                        &pStatuses[chunkStart],
+                                        publishCount - chunkStart);
+        }
+
+        MQTT_POST_SEND_HOOK(pContext);
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        for (index = 0U; (index < publishCount) && (status == MQTTSuccess); index++)
+        {
+            status = pStatuses[index];
+        }
+    }
+
+    if (status != MQTTSuccess)
+    {
+        LogError(("MQTT PUBLISH batch failed with status %s.",
+                  MQTT_Status_strerror(status)));
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_PreparePublish(const MQTTContext_t *pContext,
+                                 const MQTTPublishInfo_t *pPublishInfo,
+                                 MQTTPreparedPublish_t *pPrepared)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t remainingLength = 0UL;
+    size_t packetSize = 0UL;
+    MQTTPublishInfo_t publishInfo;
+
+    /* The payload and the packet ID are only known, and checked, when
+     * publishing with the handle. */
+    if ((pContext == NULL) || (pPublishInfo == NULL) || (pPrepared == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, "
+                  "pPublishInfo=%p, pPrepared=%p",
+                  (const void *)pContext,
+                  (const void *)pPublishInfo,
+                  (void *)pPrepared));
+        status = MQTTBadParameter;
+    }
+    else if ((pContext->outgoingPublishRecords == NULL) && (pPublishInfo->qos > MQTTQoS0))
+    {
+        LogError(("Trying to prepare a QoS > MQTTQoS0 publish when outgoing publishes "
+                  "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
+                  "to initialize and enable the use of QoS1/QoS2 publishes."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The DUP flag is set per packet. */
+        publishInfo = *pPublishInfo;
+        publishInfo.dup = false;
+
+        status = MQTT_GetPublishPacketSize(&publishInfo,
+                                           &remainingLength,
+                                           &packetSize);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        status = MQTT_SerializePublishHeaderWithoutTopic(&publishInfo,
+                                                         remainingLength,
+                                                         pPrepared->header,
+                                                         &pPrepared->headerSize);
+    }
+
+    if (status == MQTTSuccess)
+    {
+        pPrepared->pTopicName = publishInfo.pTopicName;
+        pPrepared->topicNameLength = publishInfo.topicNameLength;
+        pPrepared->qos = publishInfo.qos;
+        pPrepared->retain = publishInfo.retain;
+        pPrepared->payloadLength = publishInfo.payloadLength;
+    }
+    else if (pPrepared != NULL)
+    {
+        /* Make MQTT_PublishPrepared reject the handle. */
+        pPrepared->headerSize = 0U;
+    }
+    else
     {
-        status = MQTT_SerializePublishHeaderWithoutTopic(pPublishInfo,
-                                                         remainingLength,
-                                                         mqttHeader,
-                                                         &headerSize);
+        /* MISRA Empty body */
     }
 
-    if ((status == MQTTSuccess) && (pPublishInfo->qos > MQTTQoS0))
-    {
-        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+    return status;
+}
 
-        /* Set the flag so that the corresponding hook can be called later. */
-        stateUpdateHookExecuted = true;
+/*-----------------------------------------------------------*/
 
-        status = MQTT_ReserveState(pContext,
-                                   packetId,
-                                   pPublishInfo->qos);
+MQTTStatus_t MQTT_PublishPrepared(MQTTContext_t *pContext,
+                                  const MQTTPreparedPublish_t *pPrepared,
+                                  const void *pPayload,
+                                  uint16_t packetId,
+                                  bool dup)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishInfo_t publishInfo = {0};
+    uint8_t mqttHeader[7U];
 
-        /* State already exists for a duplicate packet.
-         * If a state doesn't exist, it will be handled as a new publish in
-         * state engine. */
-        if ((status == MQTTStateCollision) && (pPublishInfo->dup == true))
-        {
-            status = MQTTSuccess;
-        }
+    if ((pContext == NULL) || (pPrepared == NULL))
+    {
+        LogError(("Argument cannot be NULL: pContext=%p, pPrepared=%p",
+                  (void *)pContext,
+                  (const void *)pPrepared));
+        status = MQTTBadParameter;
     }
-
-    if (status == MQTTSuccess)
+    else if ((pPrepared->headerSize == 0U) || (pPrepared->headerSize > sizeof(mqttHeader)))
     {
-        /* Take the mutex as multiple send calls are required for sending this
-         * packet. */
-        MQTT_PRE_SEND_HOOK(pContext);
-
-        status = sendPublishWithoutCopy(pContext,
-                                        pPublishInfo,
-                                        mqttHeader,
-                                        headerSize,
-                                        packetId);
-
-        /* Give the mutex away for the next taker. */
-        MQTT_POST_SEND_HOOK(pContext);
+        LogError(("pPrepared has not been set up by MQTT_PreparePublish."));
+        status = MQTTBadParameter;
     }
-
-    if ((status == MQTTSuccess) &&
-        (pPublishInfo->qos > MQTTQoS0))
+    else if ((pPrepared->payloadLength > 0U) && (pPayload == NULL))
     {
-        /* Update state machine after PUBLISH is sent.
-         * Only to be done for QoS1 or QoS2. */
-        status = MQTT_UpdateStatePublish(pContext,
-                                         packetId,
-                                         MQTT_SEND,
-                                         pPublishInfo->qos,
-                                         &publishStatus);
+        LogError(("A nonzero payload length requires a non-NULL payload: "
+                  "payloadLength=%lu.",
+                  (unsigned long)pPrepared->payloadLength));
+        status = MQTTBadParameter;
+    }
+    else if ((pPrepared->qos != MQTTQoS0) && (packetId == 0U))
+    {
+        LogError(("Packet Id is 0 for PUBLISH with QoS=%u.",
+                  (unsigned int)pPrepared->qos));
+        status = MQTTBadParameter;
+    }
+    else if ((pPrepared->qos != MQTTQoS0) && (pContext->outgoingPublishRecords == NULL))
+    {
+        LogError(("QoS1/QoS2 is not initialized for use. Please, "
+                  "call MQTT_InitStatefulQoS to enable QoS1 and QoS2 "
+                  "publishes."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        publishInfo.qos = pPrepared->qos;
+        publishInfo.retain = pPrepared->retain;
+        publishInfo.dup = dup;
+        publishInfo.pTopicName = pPrepared->pTopicName;
+        publishInfo.topicNameLength = pPrepared->topicNameLength;
+        publishInfo.pPayload = pPayload;
+        publishInfo.payloadLength = pPrepared->payloadLength;
 
-        if (status != MQTTSuccess)
+        /* Only the DUP flag differs between two packets of a handle, as the
+         * packet ID is sent after the topic. */
+        (void)memcpy(mqttHeader, pPrepared->header, pPrepared->headerSize);
+
+        if (dup == true)
         {
-            LogError(("Update state for publish failed with status %s."
-                      " However PUBLISH packet was sent to the broker."
-                      " Any further handling of ACKs for the packet Id"
-                      " will fail.",
-                      MQTT_Status_strerror(status)));
+            mqttHeader[0] |= (uint8_t)CORE_MQTT_PUBLISH_DUP_FLAG;
+        }
+        else
+        {
+            mqttHeader[0] &= (uint8_t)~CORE_MQTT_PUBLISH_DUP_FLAG;
         }
-    }
 
-    if (stateUpdateHookExecuted == true)
-    {
-        /* Regardless of the status, if the mutex was taken due to the
-         * packet being of QoS > QoS0, then it should be relinquished. */
-        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        status = sendSerializedPublish(pContext,
+                                       &publishInfo,
+                                       mqttHeader,
+                                       pPrepared->headerSize,
+                                       packetId);
     }
 
     if (status != MQTTSuccess)
@@ -3198,77 +7807,112 @@ MQTTStatus_t MQTT_Publish(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
-MQTTStatus_t MQTT_Ping(MQTTContext_t *pContext)
+MQTTStatus_t MQTT_PublishWithCompletion(MQTTContext_t *pContext,
+                                        const MQTTPublishInfo_t *pPublishInfo,
+                                        uint16_t packetId,
+                                        MQTTPublishCompleteCallback_t completeCallback,
+                                        void *pUserContext)
 {
-    int32_t sendResult = 0;
     MQTTStatus_t status = MQTTSuccess;
-    size_t packetSize = 0U;
-    /* MQTT ping packets are of fixed length. */
-    uint8_t pingreqPacket[2U];
-    MQTTFixedBuffer_t localBuffer;
-
-    localBuffer.pBuffer = pingreqPacket;
-    localBuffer.size = sizeof(pingreqPacket);
+    MQTTPublishCompletion_t *pCompletion = NULL;
+    bool registered = false;
 
-    if (pContext == NULL)
+    if ((pContext == NULL) || (pPublishInfo == NULL))
     {
-        LogError(("pContext is NULL."));
+        LogError(("Argument cannot be NULL: pContext=%p, pPublishInfo=%p.",
+                  (void *)pContext,
+                  (const void *)pPublishInfo));
         status = MQTTBadParameter;
     }
-
-    if (status == MQTTSuccess)
+    else if (completeCallback == NULL)
+    {
+        LogError(("Invalid parameter: completeCallback is NULL"));
+        status = MQTTBadParameter;
+    }
+    else if (pContext->pPublishCompletions == NULL)
+    {
+        LogError(("MQTT_InitPublishCompletion must be called before "
+                  "MQTT_PublishWithCompletion."));
+        status = MQTTBadParameter;
+    }
+    else if (pPublishInfo->qos == MQTTQoS0)
+    {
+        LogError(("A QoS 0 PUBLISH is not acknowledged and has no completion."));
+        status = MQTTBadParameter;
+    }
+    else if (packetId == MQTT_PACKET_ID_INVALID)
+    {
+        LogError(("Packet Id is 0 for PUBLISH with QoS=%u.",
+                  (unsigned int)pPublishInfo->qos));
+        status = MQTTBadParameter;
+    }
+    else
     {
-        /* Get MQTT PINGREQ packet size. */
-        status = MQTT_GetPingreqPacketSize(&packetSize);
+        /* The completion is registered before the PUBLISH is sent, since its
+         * ack may be handled by another thread before MQTT_Publish returns. */
+        MQTT_PRE_STATE_UPDATE_HOOK(pContext);
 
-        if (status == MQTTSuccess)
+        /* A resend of the PUBLISH keeps the time of its first send. */
+        pCompletion = findPublishCompletion(pContext, packetId);
+
+        if (pCompletion == NULL)
         {
-            assert(packetSize == localBuffer.size);
-            LogDebug(("MQTT PINGREQ packet size is %lu.",
-                      (unsigned long)packetSize));
+            pCompletion = findPublishCompletion(pContext, MQTT_PACKET_ID_INVALID);
+
+            if (pCompletion != NULL)
+            {
+                pCompletion->packetId = packetId;
+                pCompletion->sendTimeMs = pContext->getTime();
+                registered = true;
+            }
         }
-        else
+
+        if (pCompletion != NULL)
+        {
+            pCompletion->completeCallback = completeCallback;
+            pCompletion->pUserContext = pUserContext;
+        }
+
+        MQTT_POST_STATE_UPDATE_HOOK(pContext);
+
+        if (pCompletion == NULL)
         {
-            LogError(("Failed to get the PINGREQ packet size."));
+            LogError(("No free entry for the completion of packet %hu.",
+                      (unsigned short)packetId));
+            status = MQTTNoMemory;
         }
     }
 
     if (status == MQTTSuccess)
     {
-        /* Serialize MQTT PINGREQ. */
-        status = MQTT_SerializePingreq(&localBuffer);
+        status = MQTT_Publish(pContext, pPublishInfo, packetId);
+
+        /* A PUBLISH which was not sent is never acknowledged. */
+        if ((status != MQTTSuccess) && (registered == true))
+        {
+            MQTT_PRE_STATE_UPDATE_HOOK(pContext);
+            pCompletion->packetId = MQTT_PACKET_ID_INVALID;
+            MQTT_POST_STATE_UPDATE_HOOK(pContext);
+        }
     }
 
-    if (status == MQTTSuccess)
-    {
-        /* Take the mutex as the send call should not be interrupted in
-         * between. */
-        MQTT_PRE_SEND_HOOK(pContext);
+    return status;
+}
 
-        /* Send the serialized PINGREQ packet to transport layer.
-         * Here, we do not use the vectored IO approach for efficiency as the
-         * Ping packet does not have numerous fields which need to be copied
-         * from the user provided buffers. Thus it can be sent directly. */
-        sendResult = sendBuffer(pContext,
-                                localBuffer.pBuffer,
-                                packetSize);
+/*-----------------------------------------------------------*/
 
-        /* Give the mutex away. */
-        MQTT_POST_SEND_HOOK(pContext);
+MQTTStatus_t MQTT_Ping(MQTTContext_t *pContext)
+{
+    MQTTStatus_t status = MQTTSuccess;
 
-        /* It is an error to not send the entire PINGREQ packet. */
-        if (sendResult < (int32_t)packetSize)
-        {
-            LogError(("Transport send failed for PINGREQ packet."));
-            status = MQTTSendFailed;
-        }
-        else
-        {
-            pContext->pingReqSendTimeMs = pContext->lastPacketTxTime;
-            pContext->waitingForPingResp = true;
-            LogDebug(("Sent %ld bytes of PINGREQ packet.",
-                      (long int)sendResult));
-        }
+    if (pContext == NULL)
+    {
+        LogError(("pContext is NULL."));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = sendPingreq(pContext, false);
     }
 
     return status;
@@ -3321,6 +7965,46 @@ MQTTStatus_t MQTT_Unsubscribe(MQTTContext_t *pContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_SubscribeBulk(MQTTContext_t *pContext,
+                                const MQTTSubscribeInfo_t *pSubscriptionList,
+                                size_t subscriptionCount,
+                                const MQTTFixedBuffer_t *pBuffer,
+                                MQTTBulkPacket_t *pPackets,
+                                size_t maxPackets,
+                                size_t *pPacketCount)
+{
+    return sendSubscribeUnsubscribeBulk(pContext,
+                                        pSubscriptionList,
+                                        subscriptionCount,
+                                        pBuffer,
+                                        true,
+                                        pPackets,
+                                        maxPackets,
+                                        pPacketCount);
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_UnsubscribeBulk(MQTTContext_t *pContext,
+                                  const MQTTSubscribeInfo_t *pSubscriptionList,
+                                  size_t subscriptionCount,
+                                  const MQTTFixedBuffer_t *pBuffer,
+                                  MQTTBulkPacket_t *pPackets,
+                                  size_t maxPackets,
+                                  size_t *pPacketCount)
+{
+    return sendSubscribeUnsubscribeBulk(pContext,
+                                        pSubscriptionList,
+                                        subscriptionCount,
+                                        pBuffer,
+                                        false,
+                                        pPackets,
+                                        maxPackets,
+                                        pPacketCount);
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_Disconnect(MQTTContext_t *pContext)
 {
     size_t packetSize = 0U;
@@ -3363,7 +8047,8 @@ MQTTStatus_t MQTT_Disconnect(MQTTContext_t *pContext)
          * using a simple send call. */
         sendResult = sendBuffer(pContext,
                                 localBuffer.pBuffer,
-                                packetSize);
+                                packetSize,
+                                false);
 
         /* Give the mutex away. */
         MQTT_POST_SEND_HOOK(pContext);
@@ -3387,6 +8072,10 @@ MQTTStatus_t MQTT_Disconnect(MQTTContext_t *pContext)
 
         /* Reset the index and clean the buffer on a successful disconnect. */
         pContext->index = 0;
+        pContext->readIndex = 0;
+        pContext->pendingPacketLength = 0U;
+        pContext->discardRemaining = 0U;
+        pContext->ackBufferIndex = 0U;
         (void)memset(pContext->networkBuffer.pBuffer, 0, pContext->networkBuffer.size);
     }
 
@@ -3398,6 +8087,55 @@ MQTTStatus_t MQTT_Disconnect(MQTTContext_t *pContext)
 MQTTStatus_t MQTT_ProcessLoop(MQTTContext_t *pContext)
 {
     MQTTStatus_t status = MQTTBadParameter;
+    size_t packetLength = 0U;
+
+    if (pContext == NULL)
+    {
+        LogError(("Invalid input parameter: MQTT Context cannot be NULL."));
+    }
+    else if (pContext->getTime == NULL)
+    {
+        LogError(("Invalid input parameter: MQTT Context must have valid getTime."));
+    }
+    else if (pContext->networkBuffer.pBuffer == NULL)
+    {
+        LogError(("Invalid input parameter: The MQTT context's networkBuffer must not be NULL."));
+    }
+    else
+    {
+        pContext->controlPacketSent = false;
+
+        /* The time supplied to MQTT_ProcessLoopAt is kept. */
+        if (pContext->coarseTimeValid == false)
+        {
+            startCoarseTimePass(pContext);
+        }
+
+        if (pContext->drainPacketBudget > 0U)
+        {
+            status = receiveDrain(pContext, true, &packetLength);
+        }
+        else
+        {
+            status = receiveSingleIteration(pContext, true, true, &packetLength);
+        }
+
+        status = completeReceiveLoop(pContext, status);
+
+        pContext->coarseTimePass = false;
+        pContext->coarseTimeValid = false;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_ProcessLoopUntil(MQTTContext_t *pContext,
+                                   uint32_t deadlineMs)
+{
+    MQTTStatus_t status = MQTTBadParameter;
+    size_t packetLength = 0U;
 
     if (pContext == NULL)
     {
@@ -3414,7 +8152,59 @@ MQTTStatus_t MQTT_ProcessLoop(MQTTContext_t *pContext)
     else
     {
         pContext->controlPacketSent = false;
-        status = receiveSingleIteration(pContext, true);
+        pContext->loopDeadlineMs = deadlineMs;
+        pContext->loopDeadlineSet = true;
+
+        /* The first packet is always handled, the following ones only until
+         * the deadline. The loop also ends once a pass handles no packet, so
+         * an idle connection does not keep polling the transport. */
+        do
+        {
+            startCoarseTimePass(pContext);
+
+            if (pContext->drainPacketBudget > 0U)
+            {
+                status = receiveDrain(pContext, true, &packetLength);
+            }
+            else
+            {
+                status = receiveSingleIteration(pContext, true, true, &packetLength);
+            }
+        } while ((status == MQTTSuccess) &&
+                 (packetLength > 0U) &&
+                 (loopDeadlinePassed(pContext) == false));
+
+        pContext->loopDeadlineSet = false;
+
+        status = completeReceiveLoop(pContext, status);
+
+        pContext->coarseTimePass = false;
+        pContext->coarseTimeValid = false;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_ProcessLoopAt(MQTTContext_t *pContext,
+                                uint32_t nowMs)
+{
+    MQTTStatus_t status;
+
+    if (pContext != NULL)
+    {
+        pContext->coarseTimeMs = nowMs;
+        pContext->coarseTimePass = true;
+        pContext->coarseTimeValid = true;
+    }
+
+    status = MQTT_ProcessLoop(pContext);
+
+    if (pContext != NULL)
+    {
+        pContext->coarseTimePass = false;
+        pContext->coarseTimeValid = false;
     }
 
     return status;
@@ -3425,6 +8215,7 @@ MQTTStatus_t MQTT_ProcessLoop(MQTTContext_t *pContext)
 MQTTStatus_t MQTT_ReceiveLoop(MQTTContext_t *pContext)
 {
     MQTTStatus_t status = MQTTBadParameter;
+    size_t packetLength = 0U;
 
     if (pContext == NULL)
     {
@@ -3440,7 +8231,21 @@ MQTTStatus_t MQTT_ReceiveLoop(MQTTContext_t *pContext)
     }
     else
     {
-        status = receiveSingleIteration(pContext, false);
+        startCoarseTimePass(pContext);
+
+        if (pContext->drainPacketBudget > 0U)
+        {
+            status = receiveDrain(pContext, false, &packetLength);
+        }
+        else
+        {
+            status = receiveSingleIteration(pContext, false, true, &packetLength);
+        }
+
+        status = completeReceiveLoop(pContext, status);
+
+        pContext->coarseTimePass = false;
+        pContext->coarseTimeValid = false;
     }
 
     return status;
@@ -3520,6 +3520,78 @@ MQTTStatus_t MQTT_GetIncomingPacketTypeAndLength(TransportRecv_t readFunc,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_GetIncomingPacketTypeAndLengthBuffered(TransportRecv_t readFunc,
+    NetworkContext_t* pNetworkContext,
+    uint8_t* pBuffer,
+    size_t bufferSize,
+    size_t* pIndex,
+    MQTTPacketInfo_t* pIncomingPacket)
+{
+    MQTTStatus_t status = MQTTSuccess;
+    int32_t bytesReceived = 0;
+
+    if ((pIncomingPacket == NULL) || (pBuffer == NULL) || (pIndex == NULL))
+    {
+        LogError(("Argument cannot be NULL: pIncomingPacket=%p, "
+            "pBuffer=%p, pIndex=%p.",
+            (void*)pIncomingPacket,
+            (void*)pBuffer,
+            (void*)pIndex));
+        status = MQTTBadParameter;
+    }
+    else if (*pIndex > bufferSize)
+    {
+        LogError(("Buffered bytes exceed the buffer size: Index=%lu, "
+            "BufferSize=%lu.",
+            (unsigned long)*pIndex,
+            (unsigned long)bufferSize));
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The header may already be complete in the bytes kept from a
+         * previous read. */
+        status = MQTT_ProcessIncomingPacketTypeAndLength(pBuffer,
+            pIndex,
+            pIncomingPacket);
+    }
+
+    if (((status == MQTTNoDataAvailable) || (status == MQTTNeedMoreBytes)) &&
+        (*pIndex < bufferSize))
+    {
+        /* Read as much as fits in the buffer in one call rather than one byte
+         * per call. Bytes past the fixed header stay in the buffer for the
+         * caller. */
+        bytesReceived = readFunc(pNetworkContext,
+            &(pBuffer[*pIndex]),
+            bufferSize - *pIndex);
+
+        if (bytesReceived > 0)
+        {
+            *pIndex += (size_t)bytesReceived;
+
+            status = MQTT_ProcessIncomingPacketTypeAndLength(pBuffer,
+                pIndex,
+                pIncomingPacket);
+        }
+        else if (bytesReceived < 0)
+        {
+            LogError(("Transport receive failed: transportStatus=%ld.",
+                (long int)bytesReceived));
+            status = MQTTRecvFailed;
+        }
+        else
+        {
+            /* Nothing was received; the status of the kept bytes is
+             * returned. */
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_ProcessIncomingPacketTypeAndLength(const uint8_t* pBuffer,
     const size_t* pIndex,
     MQTTPacketInfo_t* pIncomingPacket)
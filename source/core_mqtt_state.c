@@ -1002,6 +1002,50 @@ MQTTStatus_t MQTT_RemoveStateRecord( const MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_RemoveIncomingStateRecord( const MQTTContext_t * pMqttContext,
+                                             uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPubAckInfo_t * records;
+    size_t recordIndex;
+    /* Current state is updated by the findInRecord function. */
+    MQTTPublishState_t currentState;
+    MQTTQoS_t qos = MQTTQoS0;
+
+    if( ( pMqttContext == NULL ) || ( pMqttContext->incomingPublishRecords == NULL ) )
+    {
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        records = pMqttContext->incomingPublishRecords;
+
+        recordIndex = findInRecord( records,
+                                    pMqttContext->incomingPublishRecordMaxCount,
+                                    packetId,
+                                    &qos,
+                                    &currentState );
+
+        /* Only a publish whose ack has not been sent yet is removed. */
+        if( ( currentState != MQTTPubAckSend ) && ( currentState != MQTTPubRecSend ) )
+        {
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            /* Delete the record. */
+            updateRecord( records,
+                          recordIndex,
+                          MQTTStateNull,
+                          true );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
                                   uint16_t packetId,
                                   MQTTPubAckType_t packetType,
@@ -63,6 +63,7 @@
 struct MQTTPubAckInfo;
 struct MQTTContext;
 struct MQTTDeserializedInfo;
+struct MQTTPublishBatchEntry;
 
 /**
  * @ingroup mqtt_callback_types
@@ -101,6 +102,143 @@ typedef void (* MQTTEventCallback_t )( struct MQTTContext * pContext,
                                        struct MQTTPacketInfo * pPacketInfo,
                                        struct MQTTDeserializedInfo * pDeserializedInfo );
 
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for receiving the payload of an incoming PUBLISH
+ * which is larger than the network buffer, one fragment at a time.
+ *
+ * The callback is invoked for consecutive fragments of the payload, in order.
+ * The first fragment has a @p payloadOffset of 0 and may be empty. The last
+ * fragment is the one for which @p payloadOffset + @p fragmentLength equals the
+ * payload length of the publish info.
+ *
+ * If the rest of the payload cannot be received, the callback is invoked one
+ * last time with a NULL @p pFragment, a @p fragmentLength of 0 and the error in
+ * the deserialization result of @p pDeserializedInfo. The publish is not
+ * acknowledged, and the broker delivers it again after a reconnection.
+ *
+ * @note The topic name of the publish info is only valid for the first
+ * fragment, and is NULL for the following ones. The payload pointer of the
+ * publish info is always NULL, and its payload length is the length of the
+ * whole payload. @p pFragment is only valid until the callback returns.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pDeserializedInfo Deserialized information from the PUBLISH.
+ * @param[in] pFragment Bytes of this fragment of the payload.
+ * @param[in] fragmentLength Length of this fragment.
+ * @param[in] payloadOffset Offset of this fragment in the payload.
+ */
+typedef void (* MQTTPublishFragmentCallback_t )( struct MQTTContext * pContext,
+                                                 struct MQTTDeserializedInfo * pDeserializedInfo,
+                                                 const uint8_t * pFragment,
+                                                 size_t fragmentLength,
+                                                 size_t payloadOffset );
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for supplying the buffer into which the payload
+ * of an incoming PUBLISH is received.
+ *
+ * The callback is invoked once the fixed header, topic name and packet
+ * identifier of a PUBLISH have been received, but not all of its payload. The
+ * payload pointer of the publish info is NULL and its payload length is the
+ * length of the whole payload. The returned buffer must hold at least that many
+ * bytes. Once the payload has been received into it, the #MQTTEventCallback_t
+ * is invoked with the payload pointer set to the returned buffer.
+ *
+ * @note The callback is not invoked for duplicates found by the state engine.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pDeserializedInfo Deserialized information from the PUBLISH.
+ *
+ * @return The buffer to receive the payload into, or NULL to receive it as if
+ * no callback had been set.
+ */
+typedef uint8_t * (* MQTTPayloadDestinationCallback_t )( struct MQTTContext * pContext,
+                                                         struct MQTTDeserializedInfo * pDeserializedInfo );
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for deciding whether an incoming PUBLISH is
+ * given to the application, from its topic name and other header fields.
+ *
+ * The callback is invoked as soon as the fixed header, topic name and packet
+ * identifier of a PUBLISH have been received. The payload of the publish info
+ * must not be accessed, since it may not have been received yet; its payload
+ * length is the length of the whole payload.
+ *
+ * @note The callback is not invoked for duplicates found by the state engine.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pDeserializedInfo Deserialized information from the PUBLISH.
+ *
+ * @return true to receive the PUBLISH as usual; false to drop it.
+ */
+typedef bool (* MQTTPublishFilterCallback_t )( struct MQTTContext * pContext,
+                                               const struct MQTTDeserializedInfo * pDeserializedInfo );
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for receiving the incoming PUBLISH packets which
+ * were parsed in one pass of the receive loop.
+ *
+ * The PUBACK or PUBREC for each QoS 1 or QoS 2 PUBLISH of the batch is sent after
+ * the callback returns.
+ *
+ * @note The topic names and payloads of the batch point into the network
+ * buffer, and are only valid until the callback returns, unless the callback
+ * takes the buffer with #MQTT_LoanReceiveBuffer. The entries of @p pBatch are
+ * reused for the next batch in either case.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pBatch The PUBLISH packets, in the order they were received.
+ * @param[in] batchLength Number of PUBLISH packets in @p pBatch.
+ */
+typedef void (* MQTTPublishBatchCallback_t )( struct MQTTContext * pContext,
+                                              struct MQTTPublishBatchEntry * pBatch,
+                                              size_t batchLength );
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for the completion of a QoS 1 or QoS 2 PUBLISH
+ * sent with #MQTT_PublishWithCompletion.
+ *
+ * The callback is invoked once the PUBACK or PUBCOMP of the PUBLISH has been
+ * received, after the #MQTTEventCallback_t for the ack, with a @p status of
+ * #MQTTSuccess. It is invoked with #MQTTIllegalState by #MQTT_Connect for the
+ * publishes which will not be acknowledged because the broker did not resume
+ * the session.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] packetId Packet ID of the PUBLISH.
+ * @param[in] status Final status of the PUBLISH.
+ * @param[in] latencyMs Time from the first send of the PUBLISH to its
+ * completion, in milliseconds.
+ * @param[in] pUserContext The user context given to #MQTT_PublishWithCompletion.
+ */
+typedef void (* MQTTPublishCompleteCallback_t )( struct MQTTContext * pContext,
+                                                 uint16_t packetId,
+                                                 MQTTStatus_t status,
+                                                 uint32_t latencyMs,
+                                                 void * pUserContext );
+
+/**
+ * @ingroup mqtt_callback_types
+ * @brief Application callback for the QoS 0 publishes which were queued by
+ * #MQTT_Publish but not sent before the connection was lost.
+ *
+ * The callback is invoked by #MQTT_Connect, which drops the unsent bytes of
+ * the transmit queue set by #MQTT_InitTransmitQueue. #MQTT_Publish returned
+ * #MQTTSuccess for these publishes, and they are not resent. A publish which
+ * was partly sent is counted as dropped. It is not invoked if no QoS 0 publish
+ * was dropped.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] droppedPublishCount Number of QoS 0 publishes dropped.
+ */
+typedef void (* MQTTTransmitQueueDropCallback_t )( struct MQTTContext * pContext,
+                                                   size_t droppedPublishCount );
+
 /**
  * @ingroup mqtt_enum_types
  * @brief Values indicating if an MQTT connection exists.
@@ -165,6 +303,81 @@ typedef struct MQTTPubAckInfo
     MQTTPublishState_t publishState; /**< @brief The current state of the publish process. */
 } MQTTPubAckInfo_t;
 
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An element of the cache of received QoS 1 publishes used to suppress
+ * their redeliveries. See #MQTT_InitQoS1Dedup.
+ */
+typedef struct MQTTQoS1DedupEntry
+{
+    uint16_t packetId;       /**< @brief The packet ID of the PUBLISH, or 0 for an unused entry. */
+    uint32_t hash;           /**< @brief Hash of the topic name and payload of the PUBLISH. */
+    uint32_t receiveTimeMs;  /**< @brief Time, from #MQTTContext_t.getTime, the PUBLISH was received. */
+} MQTTQoS1DedupEntry_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A pool of large receive buffers which MQTT contexts borrow for the
+ * packets larger than their network buffer. See #MQTT_InitOverflowBufferPool.
+ */
+typedef struct MQTTOverflowBufferPool
+{
+    /**
+     * @brief The buffers of the pool. Entries with a NULL
+     * #MQTTFixedBuffer_t.pBuffer are in use.
+     */
+    MQTTFixedBuffer_t * pBuffers;
+
+    size_t bufferCount; /**< @brief The number of entries in #MQTTOverflowBufferPool_t.pBuffers. */
+} MQTTOverflowBufferPool_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief A PUBLISH packet with its header serialized ahead of time, for a topic
+ * which is published to repeatedly with payloads of one length. See
+ * #MQTT_PreparePublish.
+ */
+typedef struct MQTTPreparedPublish
+{
+    /**
+     * @brief Header byte, remaining length and topic length of the packet, as
+     * serialized by #MQTT_SerializePublishHeaderWithoutTopic.
+     */
+    uint8_t header[ 7U ];
+
+    size_t headerSize;        /**< @brief Number of bytes used in #MQTTPreparedPublish_t.header. */
+    const char * pTopicName;  /**< @brief Topic name of the packet. Not copied. */
+    uint16_t topicNameLength; /**< @brief Length of #MQTTPreparedPublish_t.pTopicName. */
+    MQTTQoS_t qos;            /**< @brief Quality of Service of the packet. */
+    bool retain;              /**< @brief Whether the packet is retained. */
+    size_t payloadLength;     /**< @brief Length of every payload sent with this handle. */
+} MQTTPreparedPublish_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief One of the packets sent by #MQTT_SubscribeBulk or
+ * #MQTT_UnsubscribeBulk, and the topic filters it carries.
+ */
+typedef struct MQTTBulkPacket
+{
+    uint16_t packetId; /**< @brief Packet ID of the SUBSCRIBE or UNSUBSCRIBE packet. */
+    size_t firstIndex; /**< @brief Index of the first topic filter of the packet in the subscription list. */
+    size_t count;      /**< @brief Number of topic filters in the packet. */
+} MQTTBulkPacket_t;
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief The completion of an outgoing QoS 1 or QoS 2 PUBLISH, as registered
+ * by #MQTT_PublishWithCompletion. See #MQTT_InitPublishCompletion.
+ */
+typedef struct MQTTPublishCompletion
+{
+    uint16_t packetId;                              /**< @brief Packet ID of the PUBLISH, or 0 if the entry is free. */
+    MQTTPublishCompleteCallback_t completeCallback; /**< @brief Callback invoked on completion. */
+    void * pUserContext;                            /**< @brief User context given to the callback. */
+    uint32_t sendTimeMs;                            /**< @brief Time of the first send of the PUBLISH. */
+} MQTTPublishCompletion_t;
+
 
 /**
  * @ingroup mqtt_struct_types
@@ -243,6 +456,298 @@ typedef struct MQTTContext
      */
     size_t index;
 
+    /**
+     * @brief Offset in network buffer of the first byte which has not been
+     * processed yet. This is always zero unless the ring buffer receive mode
+     * is enabled with #MQTT_InitRingBufferReceive.
+     */
+    size_t readIndex;
+
+    /**
+     * @brief Type and length of the incomplete packet at
+     * #MQTTContext_t.readIndex, decoded by an earlier receive loop call.
+     */
+    MQTTPacketInfo_t pendingPacket;
+
+    /**
+     * @brief Total length of #MQTTContext_t.pendingPacket, or zero if no
+     * incomplete packet has been decoded.
+     */
+    size_t pendingPacketLength;
+
+    /**
+     * @brief Whether received packets are consumed in place by advancing
+     * #MQTTContext_t.readIndex rather than by moving the remaining bytes to the
+     * front of the network buffer.
+     */
+    bool ringBufferReceive;
+
+    /**
+     * @brief Maximum number of packets handled by one call of #MQTT_ProcessLoop
+     * or #MQTT_ReceiveLoop. Zero unless the drain receive mode is enabled with
+     * #MQTT_InitReceiveDrain.
+     */
+    size_t drainPacketBudget;
+
+    /**
+     * @brief Number of packet bytes after which a drain batch stops. Zero means
+     * that only #MQTTContext_t.drainPacketBudget limits a batch.
+     */
+    size_t drainByteBudget;
+
+    /**
+     * @brief Whether a drain batch is in progress.
+     */
+    bool drainInProgress;
+
+    /**
+     * @brief Time, from #MQTTContext_t.getTime, after which #MQTT_ProcessLoopUntil
+     * does not start new work.
+     */
+    uint32_t loopDeadlineMs;
+
+    /**
+     * @brief Whether #MQTTContext_t.loopDeadlineMs applies, which is only the
+     * case during #MQTT_ProcessLoopUntil.
+     */
+    bool loopDeadlineSet;
+
+    /**
+     * @brief Number of bytes of an oversized packet which are still to be
+     * discarded from the transport interface.
+     */
+    size_t discardRemaining;
+
+    /**
+     * @brief Packet ID of a PUBLISH rejected by the filter whose ack is sent
+     * once #MQTTContext_t.discardRemaining reaches zero.
+     */
+    uint16_t discardAckPacketId;
+
+    /**
+     * @brief State of the record of the PUBLISH in
+     * #MQTTContext_t.discardAckPacketId, used to send its ack.
+     */
+    MQTTPublishState_t discardAckState;
+
+    /**
+     * @brief Callback function used to give the payload of PUBLISH packets
+     * larger than the network buffer to the application in fragments. If NULL,
+     * such packets are discarded.
+     */
+    MQTTPublishFragmentCallback_t publishFragmentCallback;
+
+    /**
+     * @brief Callback function used to get the buffer into which the payload of
+     * a PUBLISH packet is received, if it is not yet in the network buffer.
+     */
+    MQTTPayloadDestinationCallback_t payloadDestinationCallback;
+
+    /**
+     * @brief Callback function used to drop incoming PUBLISH packets before
+     * their payload is received. Set by #MQTT_InitPublishFilter.
+     */
+    MQTTPublishFilterCallback_t publishFilterCallback;
+
+    /**
+     * @brief Callback function used to give incoming PUBLISH packets to the
+     * application in batches. Set by #MQTT_InitPublishBatch.
+     */
+    MQTTPublishBatchCallback_t publishBatchCallback;
+
+    /**
+     * @brief The PUBLISH packets parsed and not yet given to
+     * #MQTTContext_t.publishBatchCallback.
+     */
+    struct MQTTPublishBatchEntry * pPublishBatch;
+
+    /**
+     * @brief The maximum number of entries in #MQTTContext_t.pPublishBatch.
+     */
+    size_t publishBatchSize;
+
+    /**
+     * @brief The number of entries in #MQTTContext_t.pPublishBatch.
+     */
+    size_t publishBatchCount;
+
+    /**
+     * @brief Buffer in which outgoing PUBACK, PUBREC, PUBREL and PUBCOMP packets
+     * are collected to be sent together. Set by #MQTT_InitAckCoalescing.
+     */
+    uint8_t * pAckBuffer;
+
+    /**
+     * @brief Size of #MQTTContext_t.pAckBuffer.
+     */
+    size_t ackBufferSize;
+
+    /**
+     * @brief Number of bytes of acks in #MQTTContext_t.pAckBuffer which have not
+     * been sent yet.
+     */
+    size_t ackBufferIndex;
+
+    /**
+     * @brief Buffer into which #MQTT_Publish serializes PUBLISH packets instead
+     * of sending them. Set by #MQTT_InitTransmitQueue.
+     */
+    uint8_t * pTransmitQueue;
+
+    /**
+     * @brief Size of #MQTTContext_t.pTransmitQueue.
+     */
+    size_t transmitQueueSize;
+
+    /**
+     * @brief Offset in #MQTTContext_t.pTransmitQueue of the first byte which
+     * has not been sent yet.
+     */
+    size_t transmitQueueHead;
+
+    /**
+     * @brief Offset in #MQTTContext_t.pTransmitQueue right after the last
+     * queued byte.
+     */
+    size_t transmitQueueTail;
+
+    /**
+     * @brief Offset in #MQTTContext_t.pTransmitQueue of the first packet which
+     * has not been completely sent. The queue is compacted from there, so that
+     * its packets can be walked.
+     */
+    size_t transmitQueuePacketStart;
+
+    /**
+     * @brief Callback function told of the QoS 0 publishes dropped from the
+     * transmit queue by #MQTT_Connect. Set by #MQTT_InitTransmitQueue.
+     */
+    MQTTTransmitQueueDropCallback_t transmitQueueDropCallback;
+
+    /**
+     * @brief Buffer into which small vectors are gathered when the transport
+     * has no writev function. Set by #MQTT_InitSendStaging.
+     */
+    uint8_t * pSendStagingBuffer;
+
+    /**
+     * @brief Size of #MQTTContext_t.pSendStagingBuffer.
+     */
+    size_t sendStagingBufferSize;
+
+    /**
+     * @brief Whether the loop functions read #MQTTContext_t.getTime once per
+     * pass. Set by #MQTT_InitCoarseClock.
+     */
+    bool coarseClock;
+
+    /**
+     * @brief Whether a loop pass is running in the coarse clock mode, or with
+     * the time supplied to #MQTT_ProcessLoopAt.
+     */
+    bool coarseTimePass;
+
+    /**
+     * @brief Time of the current loop pass, used in place of
+     * #MQTTContext_t.getTime while #MQTTContext_t.coarseTimeValid is set.
+     * Only the thread running the loop functions reads and writes it.
+     */
+    uint32_t coarseTimeMs;
+
+    /**
+     * @brief Whether #MQTTContext_t.coarseTimeMs holds the time of the current
+     * loop pass.
+     */
+    bool coarseTimeValid;
+
+    /**
+     * @brief Completions of the outgoing publishes sent with
+     * #MQTT_PublishWithCompletion. Set by #MQTT_InitPublishCompletion.
+     */
+    MQTTPublishCompletion_t * pPublishCompletions;
+
+    /**
+     * @brief The number of entries in #MQTTContext_t.pPublishCompletions.
+     */
+    size_t publishCompletionCount;
+
+    /**
+     * @brief Cache of the QoS 1 publishes received recently. Set by
+     * #MQTT_InitQoS1Dedup.
+     */
+    MQTTQoS1DedupEntry_t * pQoS1DedupCache;
+
+    /**
+     * @brief Number of entries in #MQTTContext_t.pQoS1DedupCache.
+     */
+    size_t qos1DedupCacheSize;
+
+    /**
+     * @brief Index of the entry of #MQTTContext_t.pQoS1DedupCache which is
+     * replaced by the next publish received.
+     */
+    size_t qos1DedupCacheNext;
+
+    /**
+     * @brief Time after which a publish in #MQTTContext_t.pQoS1DedupCache is no
+     * longer considered, or zero if entries are only replaced by newer ones.
+     */
+    uint32_t qos1DedupWindowMs;
+
+    /**
+     * @brief Buffers which replace the network buffer when the application
+     * takes ownership of it. Entries with a NULL #MQTTFixedBuffer_t.pBuffer are
+     * in use. Set by #MQTT_InitReceiveBufferPool.
+     */
+    MQTTFixedBuffer_t * pReceiveBufferPool;
+
+    /**
+     * @brief The number of entries in #MQTTContext_t.pReceiveBufferPool.
+     */
+    size_t receiveBufferPoolSize;
+
+    /**
+     * @brief The buffer taken from the pool to replace the network buffer once
+     * the packet in it has been handled.
+     */
+    MQTTFixedBuffer_t spareReceiveBuffer;
+
+    /**
+     * @brief Whether the application callback for a received packet or a batch
+     * is running, which is the only time #MQTT_LoanReceiveBuffer may be called.
+     */
+    bool receiveBufferLoanable;
+
+    /**
+     * @brief Whether a received packet is being handled on the loop thread, so
+     * that an API called now is called from an application callback.
+     */
+    bool callbackRunning;
+
+    /**
+     * @brief Whether the application has taken ownership of the network buffer
+     * during the current application callback.
+     */
+    bool receiveBufferLoaned;
+
+    /**
+     * @brief Whether the application has paused the reception of packets with
+     * #MQTT_PauseReceive.
+     */
+    bool receivePaused;
+
+    /**
+     * @brief Pool of buffers borrowed for packets larger than the network
+     * buffer. Set by #MQTT_InitOverflowBufferPool.
+     */
+    MQTTOverflowBufferPool_t * pOverflowBufferPool;
+
+    /**
+     * @brief The network buffer, while a buffer borrowed from
+     * #MQTTContext_t.pOverflowBufferPool replaces it.
+     */
+    MQTTFixedBuffer_t primaryNetworkBuffer;
+
     /* Keep alive members. */
     uint16_t keepAliveIntervalSec; /**< @brief Keep Alive interval. */
     uint32_t pingReqSendTimeMs;    /**< @brief Timestamp of the last sent PINGREQ. */
@@ -264,6 +769,17 @@ typedef struct MQTTDeserializedInfo
     MQTTStatus_t deserializationResult; /**< @brief Return code of deserialization. */
 } MQTTDeserializedInfo_t;
 
+/**
+ * @ingroup mqtt_struct_types
+ * @brief An incoming PUBLISH given to an #MQTTPublishBatchCallback_t callback.
+ */
+typedef struct MQTTPublishBatchEntry
+{
+    MQTTPublishInfo_t publishInfo;           /**< @brief Deserialized PUBLISH. */
+    MQTTDeserializedInfo_t deserializedInfo; /**< @brief Deserialized information, pointing to publishInfo. */
+    MQTTPublishState_t publishRecordState;   /**< @brief State of the publish record, used to send the ack after the batch. */
+} MQTTPublishBatchEntry_t;
+
 /**
  * @brief Initialize an MQTT context.
  *
@@ -379,44 +895,946 @@ MQTTStatus_t MQTT_Init( MQTTContext_t * pContext,
  * // Network receive.
  * int32_t networkRecv( NetworkContext_t * pContext, void * pBuffer, size_t bytes );
  *
- * MQTTContext_t mqttContext;
- * TransportInterface_t transport;
- * MQTTFixedBuffer_t fixedBuffer;
- * uint8_t buffer[ 1024 ];
- * const size_t outgoingPublishCount = 30;
- * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+ * MQTTContext_t mqttContext;
+ * TransportInterface_t transport;
+ * MQTTFixedBuffer_t fixedBuffer;
+ * uint8_t buffer[ 1024 ];
+ * const size_t outgoingPublishCount = 30;
+ * MQTTPubAckInfo_t outgoingPublishes[ outgoingPublishCount ];
+ *
+ * // Clear context.
+ * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
+ *
+ * // Set transport interface members.
+ * transport.pNetworkContext = &someTransportContext;
+ * transport.send = networkSend;
+ * transport.recv = networkRecv;
+ *
+ * // Set buffer members.
+ * fixedBuffer.pBuffer = buffer;
+ * fixedBuffer.size = 1024;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      // We do not expect any incoming publishes in this example, therefore the incoming
+ *      // publish pointer is NULL and the count is zero.
+ *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+ *
+ *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initstatefulqos] */
+MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
+                                   MQTTPubAckInfo_t * pOutgoingPublishRecords,
+                                   size_t outgoingPublishCount,
+                                   MQTTPubAckInfo_t * pIncomingPublishRecords,
+                                   size_t incomingPublishCount );
+/* @[declare_mqtt_initstatefulqos] */
+
+/**
+ * @brief Enable the ring buffer receive mode of an MQTT context.
+ *
+ * By default, every packet handled by #MQTT_ProcessLoop or #MQTT_ReceiveLoop
+ * is followed by moving all the bytes still held in the network buffer to its
+ * front. With many small packets buffered, this copies most of the buffer for
+ * each packet. In the ring buffer receive mode, packets are processed in place
+ * and the library only advances a read offset past each one. New data is
+ * received after the unprocessed bytes, and the receive window wraps around to
+ * the front of the buffer only when it reaches the end of the buffer. At that
+ * point, only the bytes of the last partially received packet are moved.
+ *
+ * A packet is never split across the end of the buffer, so the
+ * #MQTTPacketInfo_t and #MQTTPublishInfo_t given to the application callback
+ * always describe contiguous memory, exactly as in the default mode.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitRingBufferReceive( &mqttContext );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initringbufferreceive] */
+MQTTStatus_t MQTT_InitRingBufferReceive( MQTTContext_t * pContext );
+/* @[declare_mqtt_initringbufferreceive] */
+
+/**
+ * @brief Enable the drain receive mode of an MQTT context.
+ *
+ * By default, each call of #MQTT_ProcessLoop or #MQTT_ReceiveLoop makes one
+ * transport receive call and handles at most one packet, even if the network
+ * buffer already holds many complete packets. In the drain receive mode, these
+ * functions keep handling the complete packets held in the network buffer and
+ * call the transport receive function again only once the buffer holds no
+ * complete packet. A call returns once @p packetBudget packets or at least
+ * @p byteBudget bytes of packets have been handled, or once no more data is
+ * available from the network.
+ *
+ * The state update hook, #MQTT_PRE_STATE_UPDATE_HOOK and
+ * #MQTT_POST_STATE_UPDATE_HOOK, is taken around each update of the state
+ * records, as for a single packet. It is not held while the transport is
+ * called or while the callbacks run, so the #MQTTEventCallback_t callback can
+ * call functions such as #MQTT_Publish, and other threads do not wait for the
+ * whole batch.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] packetBudget Maximum number of packets to handle in one call.
+ * Must be greater than zero.
+ * @param[in] byteBudget Number of packet bytes after which a call stops
+ * handling packets, or zero to only limit a call by @p packetBudget.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      // Handle up to 64 packets, or about 16 KB, per call of MQTT_ProcessLoop.
+ *      status = MQTT_InitReceiveDrain( &mqttContext, 64, 16 * 1024 );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initreceivedrain] */
+MQTTStatus_t MQTT_InitReceiveDrain( MQTTContext_t * pContext,
+                                    size_t packetBudget,
+                                    size_t byteBudget );
+/* @[declare_mqtt_initreceivedrain] */
+
+/**
+ * @brief Receive PUBLISH packets larger than the network buffer in fragments.
+ *
+ * By default, #MQTT_ProcessLoop and #MQTT_ReceiveLoop discard any packet which
+ * does not fit in the network buffer. Once this function has been called, an
+ * incoming PUBLISH which does not fit is instead given to @p fragmentCallback:
+ * the topic name and the start of the payload first, then the rest of the
+ * payload in fragments of at most the size of the network buffer, as they are
+ * received. The PUBACK or PUBREC for a QoS 1 or QoS 2 PUBLISH is only sent after
+ * the last fragment has been given to the application. As for other PUBLISH
+ * packets, duplicates found by the state engine are not given to the application.
+ *
+ * The fixed header, topic name and packet identifier of the PUBLISH must fit in
+ * the network buffer. Otherwise the packet is discarded.
+ *
+ * @note The whole payload is received by a single call of #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop. If the transport fails in the meantime, the last fragment is
+ * not given to the application and the function returns #MQTTRecvFailed.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] fragmentCallback The callback to give payload fragments to.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Callback function for receiving payload fragments of large publishes.
+ * void fragmentCallback( MQTTContext_t * pContext,
+ *                        MQTTDeserializedInfo_t * pDeserializedInfo,
+ *                        const uint8_t * pFragment,
+ *                        size_t fragmentLength,
+ *                        size_t payloadOffset );
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitPublishFragments( &mqttContext, fragmentCallback );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initpublishfragments] */
+MQTTStatus_t MQTT_InitPublishFragments( MQTTContext_t * pContext,
+                                        MQTTPublishFragmentCallback_t fragmentCallback );
+/* @[declare_mqtt_initpublishfragments] */
+
+/**
+ * @brief Let the application supply the buffer into which the payload of an
+ * incoming PUBLISH is received.
+ *
+ * By default, a PUBLISH packet is received into the network buffer and the
+ * application copies its payload out in the #MQTTEventCallback_t. With this
+ * function, the library instead calls @p destinationCallback as soon as the
+ * fixed header, topic name and packet identifier of a PUBLISH are in the network
+ * buffer but the rest of the payload is not. The payload bytes received so far
+ * are copied to the returned buffer, and the rest of the payload is received
+ * from the transport straight into it. This also applies to PUBLISH packets
+ * larger than the network buffer.
+ *
+ * If the transport interface has a #TransportReadv_t function, the rest of the
+ * payload and the data which follows it on the network are received with one
+ * call, into the returned buffer and the network buffer respectively.
+ *
+ * If @p destinationCallback returns NULL, the PUBLISH is given to the
+ * #MQTTEventCallback_t from the network buffer when it fits in it, or to the
+ * callback set with #MQTT_InitPublishFragments when it does not. When neither
+ * is possible, the payload is discarded.
+ *
+ * @note Like fragments, the rest of the payload is received by a single call
+ * of #MQTT_ProcessLoop or #MQTT_ReceiveLoop.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] destinationCallback The callback which supplies payload buffers.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Callback function which returns a buffer for the payload of a publish.
+ * uint8_t * destinationCallback( MQTTContext_t * pContext,
+ *                                MQTTDeserializedInfo_t * pDeserializedInfo )
+ * {
+ *      return allocatePayloadBuffer( pDeserializedInfo->pPublishInfo->payloadLength );
+ * }
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitPayloadDestination( &mqttContext, destinationCallback );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initpayloaddestination] */
+MQTTStatus_t MQTT_InitPayloadDestination( MQTTContext_t * pContext,
+                                          MQTTPayloadDestinationCallback_t destinationCallback );
+/* @[declare_mqtt_initpayloaddestination] */
+
+/**
+ * @brief Drop unwanted incoming PUBLISH packets without receiving their
+ * payload into a buffer.
+ *
+ * @p filterCallback is invoked for each incoming PUBLISH once its fixed header,
+ * topic name and packet identifier are available. If it returns false, the
+ * PUBLISH is not given to the #MQTTEventCallback_t, and the part of its
+ * payload which has not been received yet is discarded from the transport, with
+ * its #TransportSkip_t function if it has one. The PUBLISH is still
+ * acknowledged according to its QoS, once its payload has been discarded. When
+ * #MQTT_ProcessLoopUntil stops the discard at its deadline, the ack is sent by
+ * the receive loop call which completes it. If the discard fails, the record of
+ * the PUBLISH is removed, so that its redelivery is filtered again.
+ *
+ * @note When a filter is set, a PUBLISH which is not complete in the network
+ * buffer is received by a single call of #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop, as with #MQTT_InitPayloadDestination. An accepted PUBLISH
+ * is then checked against the cache of #MQTT_InitQoS1Dedup and given to the
+ * callback of #MQTT_InitPublishBatch like any other, but its batch is delivered
+ * before the call returns. A PUBLISH larger than the network buffer which can
+ * be received into a buffer of #MQTT_InitOverflowBufferPool is filtered once it
+ * has been received. An accepted PUBLISH larger than the network buffer for
+ * which no other callback or pool buffer is available is discarded and
+ * acknowledged.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] filterCallback The callback which accepts or rejects publishes.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Callback function which only accepts publishes on "sensors/" topics.
+ * bool filterCallback( MQTTContext_t * pContext,
+ *                      const MQTTDeserializedInfo_t * pDeserializedInfo )
+ * {
+ *      const MQTTPublishInfo_t * pPublishInfo = pDeserializedInfo->pPublishInfo;
+ *
+ *      return ( pPublishInfo->topicNameLength >= 8U ) &&
+ *             ( memcmp( pPublishInfo->pTopicName, "sensors/", 8U ) == 0 );
+ * }
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitPublishFilter( &mqttContext, filterCallback );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initpublishfilter] */
+MQTTStatus_t MQTT_InitPublishFilter( MQTTContext_t * pContext,
+                                     MQTTPublishFilterCallback_t filterCallback );
+/* @[declare_mqtt_initpublishfilter] */
+
+/**
+ * @brief Give incoming PUBLISH packets to the application in batches instead
+ * of one call of the #MQTTEventCallback_t per packet.
+ *
+ * Incoming PUBLISH packets are parsed and checked by the state engine as usual,
+ * then stored in @p pBatchBuffer instead of being given to the event callback.
+ * The batch is given to @p batchCallback, and the PUBACK or PUBREC for its QoS 1
+ * and QoS 2 packets are sent, when it is full, before the data of the next
+ * transport read is received, and at the end of #MQTT_ProcessLoop or
+ * #MQTT_ReceiveLoop. It is also delivered early when the network buffer is about
+ * to be reused, and before a duplicate PUBLISH is acknowledged, so that acks are
+ * always sent in the order the PUBLISH packets were received.
+ *
+ * Batches can only hold more than one PUBLISH when the receive loop handles more
+ * than one packet per call, which is the case with #MQTT_InitReceiveDrain.
+ * Acks and other packets are still given to the event callback as they are
+ * received, as are PUBLISH packets received with #MQTT_InitPublishFragments or
+ * #MQTT_InitPayloadDestination.
+ *
+ * @note @p batchCallback may call #MQTT_LoanReceiveBuffer to hand the whole
+ * batch to another task. The context then continues receiving into a buffer
+ * from the pool while that task handles the batch, and the buffer is given back
+ * with #MQTT_ReturnReceiveBuffer once it is done.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] batchCallback The callback to give batches of PUBLISH packets to.
+ * @param[in] pBatchBuffer Storage for the entries of a batch.
+ * @param[in] batchBufferSize The maximum number of entries in a batch.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Callback function for receiving batches of publishes.
+ * void batchCallback( MQTTContext_t * pContext,
+ *                     MQTTPublishBatchEntry_t * pBatch,
+ *                     size_t batchLength );
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTPublishBatchEntry_t batchBuffer[ 16 ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitReceiveDrain( &mqttContext, 16, 0 );
+ * }
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitPublishBatch( &mqttContext, batchCallback, batchBuffer, 16 );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initpublishbatch] */
+MQTTStatus_t MQTT_InitPublishBatch( MQTTContext_t * pContext,
+                                    MQTTPublishBatchCallback_t batchCallback,
+                                    MQTTPublishBatchEntry_t * pBatchBuffer,
+                                    size_t batchBufferSize );
+/* @[declare_mqtt_initpublishbatch] */
+
+/**
+ * @brief Collect the acks sent by the receive loop and send them with one
+ * transport send call instead of one call per ack.
+ *
+ * The PUBACK, PUBREC, PUBREL and PUBCOMP packets sent in response to incoming
+ * packets are serialized into @p pAckBuffer. The buffer is sent when it is full,
+ * and at the end of #MQTT_ProcessLoop, #MQTT_ProcessLoopUntil and
+ * #MQTT_ReceiveLoop, so that no ack is delayed past the call which received the
+ * packet it acknowledges.
+ *
+ * The state of a publish is only updated once its ack has been sent. If the
+ * buffer cannot be sent, the acks in it are dropped and the publishes keep the
+ * state they had before, as when a single ack cannot be sent.
+ *
+ * The incoming publish records of the acks waiting in the buffer stay in use,
+ * so the buffer is also sent when an incoming QoS 1 or QoS 2 PUBLISH finds no
+ * free record.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pAckBuffer Buffer for the acks waiting to be sent.
+ * @param[in] ackBufferSize Size of @p pAckBuffer. It must hold at least one
+ * ack of #MQTT_PUBLISH_ACK_PACKET_SIZE bytes.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * // Room for 32 acks.
+ * uint8_t ackBuffer[ 32 * MQTT_PUBLISH_ACK_PACKET_SIZE ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitAckCoalescing( &mqttContext, ackBuffer, sizeof( ackBuffer ) );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initackcoalescing] */
+MQTTStatus_t MQTT_InitAckCoalescing( MQTTContext_t * pContext,
+                                     uint8_t * pAckBuffer,
+                                     size_t ackBufferSize );
+/* @[declare_mqtt_initackcoalescing] */
+
+/**
+ * @brief Make #MQTT_Publish queue its packets instead of sending them, so that
+ * a full socket never blocks the publishing task.
+ *
+ * Once a transmit queue is set, #MQTT_Publish serializes the whole PUBLISH
+ * packet into @p pQueueBuffer and returns without calling the transport. If the
+ * packet does not fit in the free space of the queue, #MQTT_Publish returns
+ * #MQTTNoMemory and the publish is not recorded, so that it can be retried
+ * with the same packet ID. The state of a queued QoS > 0 publish is updated as
+ * if it had been sent.
+ *
+ * #MQTT_ProcessLoop, #MQTT_ProcessLoopUntil and #MQTT_ReceiveLoop send as many
+ * queued bytes as the transport accepts without waiting, and resume a partly
+ * sent packet on their next call. The acks and PINGREQs which these functions
+ * send go through the queue in the same way, so the loop never waits on a
+ * full socket. If the queue has no room for them, they are sent like the other
+ * packets below.
+ *
+ * Any other packet, such as a SUBSCRIBE or an #MQTT_Ping from the
+ * application, first waits for the queued bytes to be sent so that packets
+ * never interleave on the connection. The wait ends when the transport takes
+ * no bytes for MQTT_SEND_TIMEOUT_MS; that packet then fails with
+ * #MQTTSendFailed and the unsent bytes stay in the queue. #MQTT_PublishBatch
+ * does not use the queue: it waits for it in the same way, then sends its
+ * packets directly.
+ *
+ * The queue is emptied by #MQTT_Connect. QoS > 0 publishes queued but not
+ * sent before a disconnection are resent, like any unacknowledged publish,
+ * when the session is resumed. QoS 0 publishes queued but not sent are
+ * dropped, even though #MQTT_Publish returned #MQTTSuccess for them; their
+ * number is given to @p dropCallback.
+ *
+ * The queue is guarded by #MQTT_PRE_SEND_HOOK and #MQTT_POST_SEND_HOOK.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pQueueBuffer Buffer for the packets waiting to be sent. It must
+ * remain valid for as long as the context is used.
+ * @param[in] queueBufferSize Size of @p pQueueBuffer. A publish larger than
+ * this can never be queued.
+ * @param[in] dropCallback Callback told of the QoS 0 publishes dropped by
+ * #MQTT_Connect. May be NULL.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * uint8_t transmitQueue[ 4096 ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitTransmitQueue( &mqttContext, transmitQueue, sizeof( transmitQueue ), NULL );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_inittransmitqueue] */
+MQTTStatus_t MQTT_InitTransmitQueue( MQTTContext_t * pContext,
+                                     uint8_t * pQueueBuffer,
+                                     size_t queueBufferSize,
+                                     MQTTTransmitQueueDropCallback_t dropCallback );
+/* @[declare_mqtt_inittransmitqueue] */
+
+/**
+ * @brief Send the small fields of a packet with one transport send call when
+ * the transport has no writev function.
+ *
+ * Without writev, every field of a packet, such as the header, topic, packet
+ * ID and payload of a PUBLISH, is sent by its own call to
+ * #TransportInterface_t.send. Once a staging buffer is set, consecutive
+ * vectors of at most #MQTT_SEND_STAGING_THRESHOLD bytes are copied into it
+ * and sent together, while larger vectors are still sent from the
+ * application's memory. Vectors which no longer fit in the buffer are sent
+ * as they are.
+ *
+ * The buffer is only used while a packet is sent, under #MQTT_PRE_SEND_HOOK,
+ * and is not used at all when the transport implements writev.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pStagingBuffer Scratch buffer for the small vectors.
+ * @param[in] stagingBufferSize Size of @p pStagingBuffer.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * uint8_t stagingBuffer[ 512 ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitSendStaging( &mqttContext, stagingBuffer, sizeof( stagingBuffer ) );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initsendstaging] */
+MQTTStatus_t MQTT_InitSendStaging( MQTTContext_t * pContext,
+                                   uint8_t * pStagingBuffer,
+                                   size_t stagingBufferSize );
+/* @[declare_mqtt_initsendstaging] */
+
+/**
+ * @brief Read the clock once per pass of the loop functions instead of at
+ * every timestamp.
+ *
+ * By default, #MQTTContext_t.getTime is called for every timestamp the
+ * library keeps: before and after each transport send, after each received
+ * packet and for the keep alive and duplicate checks. In the coarse clock
+ * mode, #MQTT_ProcessLoop, #MQTT_ReceiveLoop and each packet of
+ * #MQTT_ProcessLoopUntil read the clock at most once, the first time it is
+ * needed, and this time is used for the timestamps which only the loop
+ * functions keep: the time of the received packets, the keep alive checks,
+ * the QoS 1 duplicate window and the ack latency of
+ * #MQTT_PublishWithCompletion. The acks and PINGREQs sent by the loop
+ * functions are stamped with the time of the pass too.
+ *
+ * The time of the pass is not shared with other threads, so it is not used
+ * by the sends which other threads can make during the pass: publishes,
+ * subscribes, unsubscribes, #MQTT_Ping and #MQTT_Disconnect read the clock
+ * as in the default mode. Every send reads the clock again only when the
+ * transport does not take the whole packet at once, for the timeout between
+ * its bytes. The deadline of #MQTT_ProcessLoopUntil is also checked against
+ * the clock, as it is shorter than a pass can be.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitCoarseClock( &mqttContext );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initcoarseclock] */
+MQTTStatus_t MQTT_InitCoarseClock( MQTTContext_t * pContext );
+/* @[declare_mqtt_initcoarseclock] */
+
+/**
+ * @brief Set the table in which #MQTT_PublishWithCompletion registers the
+ * completion callbacks of outgoing publishes.
+ *
+ * Each QoS 1 or QoS 2 PUBLISH sent with #MQTT_PublishWithCompletion takes an
+ * entry of the table until it is acknowledged, so the table needs as many
+ * entries as the publishes of this kind which can be outstanding at once, at
+ * most the number of outgoing publish records given to
+ * #MQTT_InitStatefulQoS.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pCompletions Array of completion entries. Their contents are
+ * cleared.
+ * @param[in] completionCount Number of entries in @p pCompletions.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTPublishCompletion_t completions[ OUTGOING_PUBLISH_RECORD_COUNT ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitPublishCompletion( &mqttContext, completions, OUTGOING_PUBLISH_RECORD_COUNT );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initpublishcompletion] */
+MQTTStatus_t MQTT_InitPublishCompletion( MQTTContext_t * pContext,
+                                         MQTTPublishCompletion_t * pCompletions,
+                                         size_t completionCount );
+/* @[declare_mqtt_initpublishcompletion] */
+
+/**
+ * @brief Suppress the redeliveries of QoS 1 publishes which have already been
+ * given to the application.
+ *
+ * The state record of an incoming QoS 1 PUBLISH is removed once its PUBACK has
+ * been sent, so a PUBLISH redelivered by the broker, for example after a
+ * reconnection when the PUBACK was lost, is given to the application again.
+ * With this function, the packet ID of each incoming QoS 1 PUBLISH is kept in
+ * @p pCache along with a hash of its topic name and payload. A PUBLISH with the
+ * DUP flag set which matches an entry of the cache is acknowledged, but not
+ * given to the application.
+ *
+ * The cache holds the last @p cacheSize QoS 1 publishes received. Entries older
+ * than @p windowMs are ignored, unless it is zero. A PUBLISH without the DUP
+ * flag is never suppressed, so a new message which reuses the packet ID and the
+ * content of an earlier one is still delivered.
+ *
+ * @note As with any hash, a redelivery can be missed if it is no longer in the
+ * cache, and a different PUBLISH can in rare cases be taken for a redelivery.
+ * This gives fewer duplicates than QoS 1 alone, but is not a replacement for
+ * QoS 2 when exactly once delivery is required. PUBLISH packets received with
+ * #MQTT_InitPublishFragments or #MQTT_InitPayloadDestination are not checked,
+ * since their payload is not received in the network buffer.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pCache Storage for the cache.
+ * @param[in] cacheSize Number of entries in @p pCache.
+ * @param[in] windowMs Time, in milliseconds, during which a publish is kept in
+ * the cache, or zero to keep it until it is replaced by a newer one.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * MQTTContext_t mqttContext;
+ * MQTTQoS1DedupEntry_t dedupCache[ 32 ];
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      // Remember the publishes received in the last minute.
+ *      status = MQTT_InitQoS1Dedup( &mqttContext, dedupCache, 32, 60000U );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initqos1dedup] */
+MQTTStatus_t MQTT_InitQoS1Dedup( MQTTContext_t * pContext,
+                                 MQTTQoS1DedupEntry_t * pCache,
+                                 size_t cacheSize,
+                                 uint32_t windowMs );
+/* @[declare_mqtt_initqos1dedup] */
+
+/**
+ * @brief Give the context a pool of receive buffers so that the application can
+ * keep received packets without copying them.
+ *
+ * Once this function has been called, the application may call
+ * #MQTT_LoanReceiveBuffer from its event callback to take ownership of the
+ * network buffer holding the packet being handled. The pointers in the
+ * #MQTTPublishInfo_t given to the callback then stay valid until the buffer is
+ * given back with #MQTT_ReturnReceiveBuffer. The context continues with a buffer
+ * from the pool, and only copies the bytes received after the loaned packet.
+ *
+ * Every buffer in the pool must have the same size as the network buffer given
+ * to #MQTT_Init. The context keeps using @p pBuffers to track the free buffers,
+ * so the array must remain in scope for the lifetime of the context.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pBuffers Array of spare receive buffers.
+ * @param[in] bufferCount The number of entries in @p pBuffers.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Network buffer and spare buffers of the same size.
+ * uint8_t buffers[ 5 ][ BUFFER_SIZE ];
+ * MQTTFixedBuffer_t fixedBuffer = { buffers[ 0 ], BUFFER_SIZE };
+ * MQTTFixedBuffer_t receiveBufferPool[ 4 ];
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ * size_t i;
+ *
+ * for( i = 0; i < 4; i++ )
+ * {
+ *      receiveBufferPool[ i ].pBuffer = buffers[ i + 1 ];
+ *      receiveBufferPool[ i ].size = BUFFER_SIZE;
+ * }
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitReceiveBufferPool( &mqttContext, receiveBufferPool, 4 );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initreceivebufferpool] */
+MQTTStatus_t MQTT_InitReceiveBufferPool( MQTTContext_t * pContext,
+                                         MQTTFixedBuffer_t * pBuffers,
+                                         size_t bufferCount );
+/* @[declare_mqtt_initreceivebufferpool] */
+
+/**
+ * @brief Take ownership of the network buffer holding the packet given to the
+ * event callback.
+ *
+ * This function may only be called from the event callback of a received
+ * packet, at most once per packet, or from the callback set with
+ * #MQTT_InitPublishBatch, at most once per batch. The buffer, and all the
+ * pointers into it given to the callback, remain valid until the buffer is given
+ * back with #MQTT_ReturnReceiveBuffer. After the callback returns, the context
+ * continues with a buffer from the pool set by #MQTT_InitReceiveBufferPool.
+ *
+ * Taking the buffer of each batch, and giving it back from the task which
+ * handles the batch, forms a receive pipeline: with a pool of one buffer, the
+ * context receives into one buffer while the application handles the packets of
+ * the other.
+ *
+ * @note The pool is updated with the state update hook taken.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[out] pLoanedBuffer The buffer the application now owns.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the buffer pool
+ * has not been set;
+ * #MQTTIllegalState if not called from the event callback of a received packet
+ * or from the batch callback, or if the buffer has already been taken;
+ * #MQTTNoMemory if all the buffers of the pool are in use;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * void eventCallback( MQTTContext_t * pContext,
+ *                     MQTTPacketInfo_t * pPacketInfo,
+ *                     MQTTDeserializedInfo_t * pDeserializedInfo )
+ * {
+ *      MQTTFixedBuffer_t loanedBuffer;
+ *
+ *      if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+ *      {
+ *          if( MQTT_LoanReceiveBuffer( pContext, &loanedBuffer ) == MQTTSuccess )
+ *          {
+ *              // The payload can be used by another task without copying. It
+ *              // calls MQTT_ReturnReceiveBuffer with loanedBuffer when done.
+ *              queuePublish( pDeserializedInfo->pPublishInfo, &loanedBuffer );
+ *          }
+ *      }
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_loanreceivebuffer] */
+MQTTStatus_t MQTT_LoanReceiveBuffer( MQTTContext_t * pContext,
+                                     MQTTFixedBuffer_t * pLoanedBuffer );
+/* @[declare_mqtt_loanreceivebuffer] */
+
+/**
+ * @brief Give back a buffer taken with #MQTT_LoanReceiveBuffer.
+ *
+ * The buffer is added to the pool set by #MQTT_InitReceiveBufferPool, and may be
+ * used by the context again for receiving packets.
+ *
+ * @note The pool is updated with the state update hook taken.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pBuffer The buffer given by #MQTT_LoanReceiveBuffer.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed, the buffer pool
+ * has not been set, or no buffer is on loan;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_returnreceivebuffer] */
+MQTTStatus_t MQTT_ReturnReceiveBuffer( MQTTContext_t * pContext,
+                                       const MQTTFixedBuffer_t * pBuffer );
+/* @[declare_mqtt_returnreceivebuffer] */
+
+/**
+ * @brief Give the context a pool of large buffers to receive the packets which
+ * do not fit in its network buffer, instead of discarding them.
+ *
+ * When a packet larger than the network buffer is received, the context
+ * borrows the first free buffer of @p pPool which can hold it. The bytes of the
+ * packet already received are copied to it, and the rest of the packet is
+ * received into it by the same call of #MQTT_ProcessLoop or #MQTT_ReceiveLoop.
+ * The packet is then handled as usual, and the buffer is given back to the pool
+ * before the call returns. If no buffer of the pool is free or large enough, the
+ * packet is discarded.
+ *
+ * The buffers of the pool may have different sizes, and the same pool may be
+ * shared by many contexts, so that memory is needed for the large packets being
+ * received at the same time rather than for every connection. The pool is
+ * updated with #MQTT_PRE_OVERFLOW_POOL_HOOK and #MQTT_POST_OVERFLOW_POOL_HOOK
+ * taken, which must be defined to lock a mutex when contexts sharing the pool
+ * run in different tasks.
+ *
+ * @note Packets which are given to the application with
+ * #MQTT_InitPublishFragments or #MQTT_InitPayloadDestination do not use the
+ * pool. A packet received into the pool is given to the filter of
+ * #MQTT_InitPublishFilter once it has been received, so its payload is not
+ * skipped when it is rejected. The buffer of a packet received into the pool
+ * cannot be taken with #MQTT_LoanReceiveBuffer.
+ *
+ * This function must be called on an #MQTTContext_t after #MQTT_Init.
+ *
+ * @param[in] pContext The context to configure.
+ * @param[in] pPool The pool of buffers, which must remain in scope for the
+ * lifetime of the context.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Two large buffers shared by all the connections.
+ * uint8_t largeBuffers[ 2 ][ LARGE_BUFFER_SIZE ];
+ * MQTTFixedBuffer_t overflowBuffers[ 2 ] =
+ * {
+ *      { largeBuffers[ 0 ], LARGE_BUFFER_SIZE },
+ *      { largeBuffers[ 1 ], LARGE_BUFFER_SIZE }
+ * };
+ * MQTTOverflowBufferPool_t overflowPool = { overflowBuffers, 2 };
+ * MQTTContext_t mqttContext;
+ * MQTTStatus_t status;
+ *
+ * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &smallFixedBuffer );
+ *
+ * if( status == MQTTSuccess )
+ * {
+ *      status = MQTT_InitOverflowBufferPool( &mqttContext, &overflowPool );
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_initoverflowbufferpool] */
+MQTTStatus_t MQTT_InitOverflowBufferPool( MQTTContext_t * pContext,
+                                          MQTTOverflowBufferPool_t * pPool );
+/* @[declare_mqtt_initoverflowbufferpool] */
+
+/**
+ * @brief Stop receiving packets until #MQTT_ResumeReceive is called, so that
+ * the application is not given more packets than it can handle.
+ *
+ * While reception is paused, #MQTT_ProcessLoop and #MQTT_ReceiveLoop do not call
+ * the transport receive function, and do not handle the packets already in the
+ * network buffer. They return #MQTTNoDataAvailable. The data left in the
+ * transport slows the broker down through the flow control of the transport,
+ * such as the TCP receive window, and no QoS 1 or QoS 2 PUBLISH is dropped.
  *
- * // Clear context.
- * memset( ( void * ) &mqttContext, 0x00, sizeof( MQTTContext_t ) );
+ * Acks for the packets handled before the pause have already been sent.
+ * #MQTT_ProcessLoop still sends a PINGREQ every keep alive interval, so that the
+ * broker keeps the connection open. The PINGRESP cannot be received while
+ * reception is paused, so its timeout only starts when reception is resumed.
  *
- * // Set transport interface members.
- * transport.pNetworkContext = &someTransportContext;
- * transport.send = networkSend;
- * transport.recv = networkRecv;
+ * This function may be called from the #MQTTEventCallback_t, in which case the
+ * packets following the current one are not handled.
  *
- * // Set buffer members.
- * fixedBuffer.pBuffer = buffer;
- * fixedBuffer.size = 1024;
+ * @note The flag is set with the state update hook taken. The hook is not
+ * held while the application callbacks run, so it may be taken from them.
  *
- * status = MQTT_Init( &mqttContext, &transport, getTimeStampMs, eventCallback, &fixedBuffer );
+ * @param[in] pContext Initialized MQTT context.
  *
- * if( status == MQTTSuccess )
+ * @return #MQTTBadParameter if the context is NULL;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * void eventCallback( MQTTContext_t * pContext,
+ *                     MQTTPacketInfo_t * pPacketInfo,
+ *                     MQTTDeserializedInfo_t * pDeserializedInfo )
  * {
- *      // We do not expect any incoming publishes in this example, therefore the incoming
- *      // publish pointer is NULL and the count is zero.
- *      status = MQTT_InitStatefulQoS( &mqttContext, outgoingPublishes, outgoingPublishCount, NULL, 0 );
+ *      if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+ *      {
+ *          queuePublish( pDeserializedInfo->pPublishInfo );
  *
- *      // Now QoS1 and/or QoS2 publishes can be sent with this context.
+ *          if( queueIsFull() )
+ *          {
+ *              // MQTT_ResumeReceive is called once the queue has room again.
+ *              ( void ) MQTT_PauseReceive( pContext );
+ *          }
+ *      }
  * }
  * @endcode
  */
-/* @[declare_mqtt_initstatefulqos] */
-MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
-                                   MQTTPubAckInfo_t * pOutgoingPublishRecords,
-                                   size_t outgoingPublishCount,
-                                   MQTTPubAckInfo_t * pIncomingPublishRecords,
-                                   size_t incomingPublishCount );
-/* @[declare_mqtt_initstatefulqos] */
+/* @[declare_mqtt_pausereceive] */
+MQTTStatus_t MQTT_PauseReceive( MQTTContext_t * pContext );
+/* @[declare_mqtt_pausereceive] */
+
+/**
+ * @brief Resume the reception of packets paused with #MQTT_PauseReceive.
+ *
+ * This function may be called from an application callback or from another
+ * thread. The PINGRESP timeout restarts at the time of the loop pass when it
+ * is called from a callback, and at #MQTTContext_t.getTime otherwise.
+ *
+ * @note The flag is cleared with the state update hook taken.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ *
+ * @return #MQTTBadParameter if the context is NULL;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_resumereceive] */
+MQTTStatus_t MQTT_ResumeReceive( MQTTContext_t * pContext );
+/* @[declare_mqtt_resumereceive] */
 
 /**
  * @brief Establish an MQTT session.
@@ -475,6 +1893,19 @@ MQTTStatus_t MQTT_InitStatefulQoS( MQTTContext_t * pContext,
  *    2 bytes. In the worst case, it can happen that the remaining 2 bytes are never
  *    received and this API will end up spending timeoutMs + transport receive timeout.
  *
+ * @note The receive state of the earlier connection is reset before the
+ * CONNACK is received. Bytes left in the network buffer are dropped, an
+ * overflow buffer in use is returned to its pool, the reception is no longer
+ * paused, and the publishes of an undelivered batch are dropped. The records
+ * of those publishes are removed, so that their redelivery is not taken as a
+ * duplicate.
+ *
+ * @note If a transmit queue was set with #MQTT_InitTransmitQueue, its unsent
+ * bytes are dropped, as they belong to the earlier connection. This includes
+ * QoS 0 publishes for which #MQTT_Publish returned #MQTTSuccess; they are not
+ * resent, and their number is given to the #MQTTTransmitQueueDropCallback_t
+ * of the queue before the CONNECT is sent.
+ *
  * <b>Example</b>
  * @code{c}
  *
@@ -593,7 +2024,8 @@ MQTTStatus_t MQTT_Subscribe( MQTTContext_t * pContext,
  * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
  * @param[in] packetId packet ID generated by #MQTT_GetPacketId.
  *
- * @return #MQTTNoMemory if pBuffer is too small to hold the MQTT packet;
+ * @return #MQTTNoMemory if pBuffer is too small to hold the MQTT packet, or
+ * if the transmit queue set by #MQTT_InitTransmitQueue is full;
  * #MQTTBadParameter if invalid parameters are passed;
  * #MQTTSendFailed if transport write failed;
  * #MQTTSuccess otherwise.
@@ -633,6 +2065,208 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
                            uint16_t packetId );
 /* @[declare_mqtt_publish] */
 
+/**
+ * @brief Publishes several messages with as few transport calls as possible.
+ *
+ * The packets are validated and their state reserved in one pass, and their
+ * vectors are chained so that up to #MQTT_PUBLISH_BATCH_MAX_VECTORS / 4
+ * packets go out in a single writev call. The send and state update hooks are
+ * taken once for the whole batch instead of once per message.
+ *
+ * Each message gets its own status in @p pStatuses. A message that fails
+ * validation or state reservation is skipped and the rest of the batch is
+ * still sent. If the transport fails, the messages of the failed chunk and
+ * all messages after it get #MQTTSendFailed. As with #MQTT_Publish, a QoS > 0
+ * message of the failed chunk keeps its reserved state and must be resent
+ * with the dup flag set; the messages after it were never reserved.
+ *
+ * @note The transmit queue set by #MQTT_InitTransmitQueue is not used. The
+ * queued bytes are sent first, waiting for the transport as for a SUBSCRIBE,
+ * and the batch is then sent directly.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo Array of MQTT PUBLISH packet parameters.
+ * @param[in] pPacketIds Array of packet IDs generated by #MQTT_GetPacketId,
+ * one per message. The entries of QoS0 messages are ignored.
+ * @param[in] publishCount Number of messages in @p pPublishInfo and
+ * @p pPacketIds.
+ * @param[out] pStatuses Array of @p publishCount statuses, one per message.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * the status of the first message that failed if any did;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPublishInfo_t publishInfo[ 3 ] = { 0 };
+ * uint16_t packetIds[ 3 ];
+ * MQTTStatus_t statuses[ 3 ];
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * for( int i = 0; i < 3; i++ )
+ * {
+ *      publishInfo[ i ].qos = MQTTQoS1;
+ *      publishInfo[ i ].pTopicName = "/some/topic/name";
+ *      publishInfo[ i ].topicNameLength = strlen( publishInfo[ i ].pTopicName );
+ *      publishInfo[ i ].pPayload = samples[ i ];
+ *      publishInfo[ i ].payloadLength = sampleLengths[ i ];
+ *      packetIds[ i ] = MQTT_GetPacketId( pContext );
+ * }
+ *
+ * status = MQTT_PublishBatch( pContext, publishInfo, packetIds, 3, statuses );
+ *
+ * if( status != MQTTSuccess )
+ * {
+ *      // Check statuses[ i ] to find out which messages were not sent.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_publishbatch] */
+MQTTStatus_t MQTT_PublishBatch( MQTTContext_t * pContext,
+                                const MQTTPublishInfo_t * pPublishInfo,
+                                const uint16_t * pPacketIds,
+                                size_t publishCount,
+                                MQTTStatus_t * pStatuses );
+/* @[declare_mqtt_publishbatch] */
+
+/**
+ * @brief Validate a PUBLISH and serialize its header once, for use by any
+ * number of #MQTT_PublishPrepared calls.
+ *
+ * The topic name, QoS, retain flag and payload length of @p pPublishInfo are
+ * fixed in @p pPrepared. Its payload pointer, dup flag and packet ID are given
+ * to each #MQTT_PublishPrepared call instead. The topic name is not copied and
+ * must stay valid for as long as @p pPrepared is used.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters. Its pPayload and dup
+ * fields are ignored.
+ * @param[out] pPrepared The handle to fill.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPublishInfo_t publishInfo = { 0 };
+ * MQTTPreparedPublish_t temperature;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * publishInfo.qos = MQTTQoS1;
+ * publishInfo.pTopicName = "/sensors/temperature";
+ * publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+ * publishInfo.payloadLength = sizeof( TemperatureSample_t );
+ *
+ * status = MQTT_PreparePublish( pContext, &publishInfo, &temperature );
+ *
+ * // Then for every sample:
+ * status = MQTT_PublishPrepared( pContext, &temperature, &sample,
+ *                                MQTT_GetPacketId( pContext ), false );
+ * @endcode
+ */
+/* @[declare_mqtt_preparepublish] */
+MQTTStatus_t MQTT_PreparePublish( const MQTTContext_t * pContext,
+                                  const MQTTPublishInfo_t * pPublishInfo,
+                                  MQTTPreparedPublish_t * pPrepared );
+/* @[declare_mqtt_preparepublish] */
+
+/**
+ * @brief Publishes a message with a handle set up by #MQTT_PreparePublish.
+ *
+ * Only the packet ID and the dup flag are written into the prepared header;
+ * the packet is then reserved and sent, or queued, as by #MQTT_Publish.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPrepared Handle set up by #MQTT_PreparePublish.
+ * @param[in] pPayload Payload of #MQTTPreparedPublish_t.payloadLength bytes.
+ * @param[in] packetId packet ID generated by #MQTT_GetPacketId. Ignored for
+ * QoS0.
+ * @param[in] dup Whether this is a resend of an earlier PUBLISH.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTNoMemory if the transmit queue set by #MQTT_InitTransmitQueue is full;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_publishprepared] */
+MQTTStatus_t MQTT_PublishPrepared( MQTTContext_t * pContext,
+                                   const MQTTPreparedPublish_t * pPrepared,
+                                   const void * pPayload,
+                                   uint16_t packetId,
+                                   bool dup );
+/* @[declare_mqtt_publishprepared] */
+
+/**
+ * @brief Publishes a QoS 1 or QoS 2 message to a given topic, as
+ * #MQTT_Publish, and invokes a callback once it has been acknowledged.
+ *
+ * The callback and its user context are registered in the table set by
+ * #MQTT_InitPublishCompletion before the PUBLISH is sent, and are given the
+ * time from the send to the PUBACK or PUBCOMP. A resend of the PUBLISH with
+ * the same packet ID replaces the callback and user context, and the latency
+ * is still measured from the first send.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters.
+ * @param[in] packetId packet ID generated by #MQTT_GetPacketId.
+ * @param[in] completeCallback Callback invoked on completion.
+ * @param[in] pUserContext User context given to @p completeCallback.
+ *
+ * @return #MQTTNoMemory if the completion table is full, or for the same
+ * reasons as #MQTT_Publish;
+ * #MQTTBadParameter if invalid parameters are passed, including a QoS 0
+ * PUBLISH, or if #MQTT_InitPublishCompletion has not been called;
+ * the status of #MQTT_Publish otherwise. The callback is only invoked if
+ * #MQTTSuccess is returned.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Invoked from MQTT_ProcessLoop once the PUBACK has been received.
+ * void publishComplete( MQTTContext_t * pContext,
+ *                       uint16_t packetId,
+ *                       MQTTStatus_t status,
+ *                       uint32_t latencyMs,
+ *                       void * pUserContext )
+ * {
+ *      // Release the message held in pUserContext.
+ * }
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPublishInfo_t publishInfo = { 0 };
+ * // This context is assumed to be initialized and connected, and to have a
+ * // completion table.
+ * MQTTContext_t * pContext;
+ * // The message which is released on completion.
+ * void * pMessage;
+ *
+ * publishInfo.qos = MQTTQoS1;
+ * publishInfo.pTopicName = "/some/topic/name";
+ * publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+ * publishInfo.pPayload = "Hello World!";
+ * publishInfo.payloadLength = strlen( "Hello World!" );
+ *
+ * status = MQTT_PublishWithCompletion( pContext, &publishInfo, MQTT_GetPacketId( pContext ),
+ *                                      publishComplete, pMessage );
+ * @endcode
+ */
+/* @[declare_mqtt_publishwithcompletion] */
+MQTTStatus_t MQTT_PublishWithCompletion( MQTTContext_t * pContext,
+                                         const MQTTPublishInfo_t * pPublishInfo,
+                                         uint16_t packetId,
+                                         MQTTPublishCompleteCallback_t completeCallback,
+                                         void * pUserContext );
+/* @[declare_mqtt_publishwithcompletion] */
+
 /**
  * @brief Cancels an outgoing publish callback (only for QoS > QoS0) by
  * removing it from the pending ACK list.
@@ -724,6 +2358,122 @@ MQTTStatus_t MQTT_Unsubscribe( MQTTContext_t * pContext,
                                uint16_t packetId );
 /* @[declare_mqtt_unsubscribe] */
 
+/**
+ * @brief Sends MQTT SUBSCRIBE for a list of topic filters which may be too long
+ * for a single packet, splitting it into as many SUBSCRIBE packets as needed.
+ *
+ * Each packet is serialized into @p pBuffer and sent with a single transport
+ * send, so that no packet is larger than @p pBuffer nor, with MQTT v5, than the
+ * maximum packet size of the broker. The packet IDs are obtained with
+ * #MQTT_GetPacketId, and the filters carried by each packet are reported in
+ * @p pPackets, in the order of the packets.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in pSubscriptionList.
+ * @param[in] pBuffer Buffer the packets are serialized into.
+ * @param[out] pPackets The packets which were sent.
+ * @param[in] maxPackets The number of elements in pPackets.
+ * @param[out] pPacketCount The number of packets which were sent.
+ *
+ * @return #MQTTNoMemory if a topic filter does not fit in a packet or
+ * @p maxPackets packets cannot hold all of the topic filters;
+ * #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTSuccess otherwise. The packets reported in @p pPackets were sent even
+ * if an error is returned.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTSubscribeInfo_t subscriptionList[ NUMBER_OF_SUBSCRIPTIONS ] = { 0 };
+ * MQTTBulkPacket_t packets[ MAX_PACKETS ];
+ * size_t packetCount = 0;
+ * uint8_t buffer[ 1024 ];
+ * MQTTFixedBuffer_t fixedBuffer = { buffer, sizeof( buffer ) };
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ * // This is assumed to be a list of filters we want to subscribe to.
+ * const char * filters[ NUMBER_OF_SUBSCRIPTIONS ];
+ *
+ * for( int i = 0; i < NUMBER_OF_SUBSCRIPTIONS; i++ )
+ * {
+ *      subscriptionList[ i ].qos = MQTTQoS0;
+ *      subscriptionList[ i ].pTopicFilter = filters[ i ];
+ *      subscriptionList[ i ].topicFilterLength = strlen( filters[ i ] );
+ * }
+ *
+ * status = MQTT_SubscribeBulk( pContext, &subscriptionList[ 0 ], NUMBER_OF_SUBSCRIPTIONS,
+ *                              &fixedBuffer, &packets[ 0 ], MAX_PACKETS, &packetCount );
+ *
+ * for( size_t i = 0; i < packetCount; i++ )
+ * {
+ *      // The SUBACK with ID packets[ i ].packetId acknowledges the filters
+ *      // packets[ i ].firstIndex to packets[ i ].firstIndex + packets[ i ].count - 1.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_subscribebulk] */
+MQTTStatus_t MQTT_SubscribeBulk( MQTTContext_t * pContext,
+                                 const MQTTSubscribeInfo_t * pSubscriptionList,
+                                 size_t subscriptionCount,
+                                 const MQTTFixedBuffer_t * pBuffer,
+                                 MQTTBulkPacket_t * pPackets,
+                                 size_t maxPackets,
+                                 size_t * pPacketCount );
+/* @[declare_mqtt_subscribebulk] */
+
+/**
+ * @brief Sends MQTT UNSUBSCRIBE for a list of topic filters which may be too
+ * long for a single packet, splitting it into as many UNSUBSCRIBE packets as
+ * needed. See #MQTT_SubscribeBulk.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pSubscriptionList List of MQTT subscription info.
+ * @param[in] subscriptionCount The number of elements in pSubscriptionList.
+ * @param[in] pBuffer Buffer the packets are serialized into.
+ * @param[out] pPackets The packets which were sent.
+ * @param[in] maxPackets The number of elements in pPackets.
+ * @param[out] pPacketCount The number of packets which were sent.
+ *
+ * @return #MQTTNoMemory if a topic filter does not fit in a packet or
+ * @p maxPackets packets cannot hold all of the topic filters;
+ * #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTSuccess otherwise. The packets reported in @p pPackets were sent even
+ * if an error is returned.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTSubscribeInfo_t unsubscribeList[ NUMBER_OF_SUBSCRIPTIONS ] = { 0 };
+ * MQTTBulkPacket_t packets[ MAX_PACKETS ];
+ * size_t packetCount = 0;
+ * uint8_t buffer[ 1024 ];
+ * MQTTFixedBuffer_t fixedBuffer = { buffer, sizeof( buffer ) };
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * // unsubscribeList is assumed to hold the filters to unsubscribe from.
+ *
+ * status = MQTT_UnsubscribeBulk( pContext, &unsubscribeList[ 0 ], NUMBER_OF_SUBSCRIPTIONS,
+ *                                &fixedBuffer, &packets[ 0 ], MAX_PACKETS, &packetCount );
+ * @endcode
+ */
+/* @[declare_mqtt_unsubscribebulk] */
+MQTTStatus_t MQTT_UnsubscribeBulk( MQTTContext_t * pContext,
+                                   const MQTTSubscribeInfo_t * pSubscriptionList,
+                                   size_t subscriptionCount,
+                                   const MQTTFixedBuffer_t * pBuffer,
+                                   MQTTBulkPacket_t * pPackets,
+                                   size_t maxPackets,
+                                   size_t * pPacketCount );
+/* @[declare_mqtt_unsubscribebulk] */
+
 /**
  * @brief Disconnect an MQTT session.
  *
@@ -797,6 +2547,113 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext );
 MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext );
 /* @[declare_mqtt_processloop] */
 
+/**
+ * @brief Loop to receive packets from the transport interface until a deadline.
+ * Handles keep alive.
+ *
+ * Unlike #MQTT_ProcessLoop, this function keeps handling the packets which are
+ * available until @p deadlineMs, but does not start to handle a new packet, or a
+ * new read of the drain receive mode, once it has passed. The first packet is
+ * always handled so that the connection makes progress. The function returns
+ * before the deadline once no more data is available.
+ *
+ * Packets larger than the network buffer which cannot be given to the
+ * application are discarded with the data which is available before the
+ * deadline. The rest is discarded, without blocking, by the next calls of this
+ * function, #MQTT_ProcessLoop or #MQTT_ReceiveLoop, which return
+ * #MQTTNeedMoreBytes until the whole packet has been discarded.
+ *
+ * @note The deadline is checked between packets, so a single packet can still
+ * take until #MQTT_RECV_POLLING_TIMEOUT_MS to be received.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ * @param[in] deadlineMs The time, as returned by the #MQTTGetCurrentTimeFunc_t
+ * of the context, after which no new work is started.
+ *
+ * @return #MQTTBadParameter if context is NULL;
+ * #MQTTRecvFailed if a network error occurs during reception;
+ * #MQTTSendFailed if a network error occurs while sending an ACK or PINGREQ;
+ * #MQTTBadResponse if an invalid packet is received;
+ * #MQTTKeepAliveTimeout if the server has not sent a PINGRESP before
+ * #MQTT_PINGRESP_TIMEOUT_MS milliseconds;
+ * #MQTTIllegalState if an incoming QoS 1/2 publish or ack causes an
+ * invalid transition for the internal state machine;
+ * #MQTTNeedMoreBytes if incomplete data has been received, or an oversized
+ * packet is still being discarded;
+ * #MQTTSuccess on success.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * while( true )
+ * {
+ *      // Spend at most about 5 ms on MQTT before the other work of this loop.
+ *      status = MQTT_ProcessLoopUntil( pContext, pContext->getTime() + 5U );
+ *
+ *      if( ( status != MQTTSuccess ) && ( status != MQTTNeedMoreBytes ) &&
+ *          ( status != MQTTNoDataAvailable ) )
+ *      {
+ *          // Determine the error. It's possible we might need to disconnect
+ *          // the underlying transport connection.
+ *      }
+ *
+ *      // Other application functions.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_processloopuntil] */
+MQTTStatus_t MQTT_ProcessLoopUntil( MQTTContext_t * pContext,
+                                    uint32_t deadlineMs );
+/* @[declare_mqtt_processloopuntil] */
+
+/**
+ * @brief #MQTT_ProcessLoop with the current time supplied by the caller.
+ *
+ * @p nowMs is used for the timestamps which only the loop functions keep, as
+ * in the coarse clock mode of #MQTT_InitCoarseClock, so that an application
+ * which already read the clock for its own loop does not pay for another read.
+ * The acks and PINGREQs sent by the pass are stamped with @p nowMs as well;
+ * the sends made by other threads still read #MQTTContext_t.getTime. The
+ * context does not need to be in the coarse clock mode.
+ *
+ * @note @p nowMs must come from the same clock as #MQTTContext_t.getTime,
+ * which is still read when the transport stalls.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ * @param[in] nowMs The current time, as returned by the
+ * #MQTTGetCurrentTimeFunc_t of the context.
+ *
+ * @return The same values as #MQTT_ProcessLoop.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * uint32_t now;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * while( true )
+ * {
+ *      now = pContext->getTime();
+ *
+ *      status = MQTT_ProcessLoopAt( pContext, now );
+ *
+ *      // Other application functions, which use the same time.
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_processloopat] */
+MQTTStatus_t MQTT_ProcessLoopAt( MQTTContext_t * pContext,
+                                 uint32_t nowMs );
+/* @[declare_mqtt_processloopat] */
+
 /**
  * @brief Loop to receive packets from the transport interface. Does not handle
  * keep alive.
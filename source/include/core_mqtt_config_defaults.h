@@ -87,6 +87,38 @@
     #define MQTT_SUB_UNSUB_MAX_VECTORS    ( 4U )
 #endif
 
+/**
+ * @ingroup mqtt_constants
+ * @brief Maximum number of vectors handed to the transport in one call by
+ * #MQTT_PublishBatch.
+ *
+ * Each PUBLISH packet takes up to 4 vectors, so a batch is sent in chunks of
+ * MQTT_PUBLISH_BATCH_MAX_VECTORS / 4 packets. Keep this at or below the
+ * IOV_MAX of the platform when the transport implements writev.
+ *
+ * <b>Possible values:</b> Any multiple of 4 greater than 0. <br>
+ * <b>Default value:</b> `64`
+ */
+#ifndef MQTT_PUBLISH_BATCH_MAX_VECTORS
+    #define MQTT_PUBLISH_BATCH_MAX_VECTORS    ( 64U )
+#endif
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Largest vector which is copied into the staging buffer set by
+ * #MQTT_InitSendStaging instead of being sent by its own transport call.
+ *
+ * Vectors longer than this are sent without a copy. Raise it for transports
+ * where each send call is expensive, such as TLS where every call becomes a
+ * record.
+ *
+ * <b>Possible values:</b> Any positive integer. <br>
+ * <b>Default value:</b> `128`
+ */
+#ifndef MQTT_SEND_STAGING_THRESHOLD
+    #define MQTT_SEND_STAGING_THRESHOLD    ( 128U )
+#endif
+
 /**
  * @brief The number of retries for receiving CONNACK.
  *
@@ -1294,6 +1294,76 @@ MQTTStatus_t MQTT_GetIncomingPacketTypeAndLength( TransportRecv_t readFunc,
                                                   MQTTPacketInfo_t * pIncomingPacket );
 /* @[declare_mqtt_getincomingpackettypeandlength] */
 
+/**
+ * @brief Receive the type and remaining length of an incoming packet into a
+ * buffer and decode them from it.
+ *
+ * Unlike #MQTT_GetIncomingPacketTypeAndLength, which calls @p readFunc once
+ * for every byte of the fixed header, this function asks for as many bytes as
+ * fit in @p pBuffer with a single call. The received bytes, including those
+ * past the fixed header, are kept in @p pBuffer and counted in @p pIndex, so
+ * that the caller can continue receiving the packet after them.
+ *
+ * No read is done if the bytes already in @p pBuffer hold a complete fixed
+ * header. On success, #MQTTPacketInfo_t.headerLength is set, and the remaining
+ * data of the packet starts at that offset in @p pBuffer.
+ *
+ * @param[in] readFunc Transport layer read function pointer.
+ * @param[in] pNetworkContext The network context pointer provided by the
+ * application.
+ * @param[in] pBuffer Buffer to receive the packet into. It must hold the bytes
+ * received by previous calls for the same packet.
+ * @param[in] bufferSize Size of @p pBuffer.
+ * @param[in,out] pIndex Number of bytes in @p pBuffer. It is updated with the
+ * bytes received.
+ * @param[out] pIncomingPacket Pointer to MQTTPacketInfo_t structure. This is
+ * where type, remaining length and header length are stored.
+ *
+ * @return #MQTTSuccess on successful extraction of type and length,
+ * #MQTTBadParameter if any of the parameters is invalid,
+ * #MQTTRecvFailed on transport receive failure,
+ * #MQTTBadResponse if an invalid packet is read,
+ * #MQTTNeedMoreBytes if only a part of the fixed header was received, and
+ * #MQTTNoDataAvailable if there is nothing to read.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Struct to hold the incoming packet information.
+ * MQTTPacketInfo_t incomingPacket;
+ * MQTTStatus_t status = MQTTSuccess;
+ * // Buffer to hold the incoming packet, and the number of bytes in it.
+ * uint8_t buffer[ BUFFER_SIZE ];
+ * size_t index = 0;
+ *
+ * // Loop until the fixed header has been received.
+ * do{
+ *      status = MQTT_GetIncomingPacketTypeAndLengthBuffered(
+ *          socket_recv,
+ *          &networkContext,
+ *          buffer,
+ *          BUFFER_SIZE,
+ *          &index,
+ *          &incomingPacket
+ *      );
+ * } while( ( status == MQTTNoDataAvailable ) || ( status == MQTTNeedMoreBytes ) );
+ *
+ * assert( status == MQTTSuccess );
+ *
+ * // The remaining data starts after the fixed header. Some or all of it may
+ * // already be in the buffer.
+ * incomingPacket.pRemainingData = &buffer[ incomingPacket.headerLength ];
+ * @endcode
+ */
+/* @[declare_mqtt_getincomingpackettypeandlengthbuffered] */
+MQTTStatus_t MQTT_GetIncomingPacketTypeAndLengthBuffered( TransportRecv_t readFunc,
+                                                          NetworkContext_t * pNetworkContext,
+                                                          uint8_t * pBuffer,
+                                                          size_t bufferSize,
+                                                          size_t * pIndex,
+                                                          MQTTPacketInfo_t * pIncomingPacket );
+/* @[declare_mqtt_getincomingpackettypeandlengthbuffered] */
+
 /**
  * @brief Extract the MQTT packet type and length from incoming packet.
  *
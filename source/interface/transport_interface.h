@@ -177,6 +177,74 @@
  *     return bytesSent;
  * }
  * @endcode
+ * <br>
+ * -# Implementing @ref TransportWait_t (optional)<br><br>
+ * @snippet this define_transportwait
+ * <br>
+ * This function is expected to block until the transport can receive or send
+ * data, or until the timeout expires. It is called by the protocol library
+ * after @ref TransportRecv_t or @ref TransportSend_t returned zero in the middle
+ * of a packet, so that it does not have to call them in a busy loop. If it is
+ * not implemented, the function pointer must be set to NULL.
+ * <br><br>
+ * <b>Example code:</b>
+ * @code{c}
+ * int32_t myNetworkWaitImplementation( NetworkContext_t * pNetworkContext,
+ *                                      TransportWaitEvent_t event,
+ *                                      uint32_t timeoutMs )
+ * {
+ *     struct pollfd pollFd;
+ *     int32_t result = 1;
+ *
+ *     // Data already decrypted by the TLS layer can be received right away.
+ *     if( ( event != TransportWaitRecv ) ||
+ *         ( TLSRecvCount( pNetworkContext->tlsContext ) == 0 ) )
+ *     {
+ *         pollFd.fd = pNetworkContext->tcpSocketContext.socket;
+ *         pollFd.events = ( event == TransportWaitRecv ) ? POLLIN : POLLOUT;
+ *         pollFd.revents = 0;
+ *
+ *         // Returns 0 on timeout and a negative value on error.
+ *         result = poll( &pollFd, 1, ( int ) timeoutMs );
+ *     }
+ *
+ *     return result;
+ * }
+ * @endcode
+ * <br>
+ * -# Implementing @ref TransportSkip_t (optional)<br><br>
+ * @snippet this define_transportskip
+ * <br>
+ * This function is expected to drop up to the requested number of bytes
+ * from the network without copying them. It is called by the protocol library
+ * to discard packets which are larger than its buffer. If it is not
+ * implemented, the function pointer must be set to NULL.
+ * <br><br>
+ * <b>Example code:</b>
+ * @code{c}
+ * int32_t myNetworkSkipImplementation( NetworkContext_t * pNetworkContext,
+ *                                      size_t bytesToSkip )
+ * {
+ *     ssize_t bytesSkipped;
+ *
+ *     // With MSG_TRUNC, Linux drops the data without copying it to a buffer.
+ *     bytesSkipped = recv( pNetworkContext->tcpSocketContext.socket, NULL,
+ *                          bytesToSkip, MSG_TRUNC | MSG_DONTWAIT );
+ *
+ *     if( bytesSkipped < 0 )
+ *     {
+ *         // No data is available yet.
+ *         bytesSkipped = ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) ? 0 : -1;
+ *     }
+ *     else if( bytesSkipped == 0 )
+ *     {
+ *         // The peer closed the connection.
+ *         bytesSkipped = -1;
+ *     }
+ *
+ *     return ( int32_t ) bytesSkipped;
+ * }
+ * @endcode
  */
 
 /**
@@ -290,6 +358,116 @@ typedef int32_t ( * TransportWritev_t )( NetworkContext_t * pNetworkContext,
                                          size_t ioVecCount );
 /* @[define_transportwritev] */
 
+/**
+ * @brief Transport vector structure for receiving into multiple buffers.
+ */
+typedef struct TransportInVector
+{
+    /**
+     * @brief Base address of the buffer.
+     */
+    void * iov_base;
+
+    /**
+     * @brief Length of the buffer.
+     */
+    size_t iov_len;
+} TransportInVector_t;
+
+/**
+ * @transportcallback
+ * @brief Transport interface function for "vectored" / scatter based reads.
+ * This function is expected to fill the buffers in the list of vectors pIoVec
+ * having ioVecCount entries in order, for example with readv() on a socket,
+ * moving to the next buffer only once the previous one is full.
+ *
+ * coreMQTT uses it to receive the payload of an incoming PUBLISH straight into
+ * the buffer supplied by the application, together with any data following
+ * the PUBLISH, with a single call.
+ *
+ * @note This function is optional. If it is NULL, @ref TransportRecv_t is used.
+ *
+ * @param[in] pNetworkContext Implementation-defined network context.
+ * @param[in] pIoVec An array of TransportInVector_t structs.
+ * @param[in] ioVecCount Number of TransportInVector_t in pIoVec.
+ *
+ * @return The total number of bytes received or a negative value to indicate
+ * error.
+ *
+ * @note If no data is available on the network to read and no error has
+ * occurred, zero MUST be the return value. Zero MUST NOT be returned if a
+ * network disconnection has occurred.
+ */
+/* @[define_transportreadv] */
+typedef int32_t ( * TransportReadv_t )( NetworkContext_t * pNetworkContext,
+                                        TransportInVector_t * pIoVec,
+                                        size_t ioVecCount );
+/* @[define_transportreadv] */
+
+/**
+ * @transportcallback
+ * @brief Transport interface function for dropping received data without
+ * copying it, for example with recv() and MSG_TRUNC on a socket, or by
+ * splicing it to /dev/null.
+ *
+ * coreMQTT uses it to discard packets which do not fit in its network buffer
+ * and payloads which are not given to the application.
+ *
+ * @note This function is optional. If it is NULL, the data is received into
+ * the network buffer with @ref TransportRecv_t and then dropped.
+ *
+ * @param[in] pNetworkContext Implementation-defined network context.
+ * @param[in] bytesToSkip Number of bytes to drop from the network.
+ *
+ * @return The number of bytes dropped or a negative value to indicate error.
+ *
+ * @note If no data is available on the network to drop and no error has
+ * occurred, zero MUST be the return value. Zero MUST NOT be returned if a
+ * network disconnection has occurred.
+ */
+/* @[define_transportskip] */
+typedef int32_t ( * TransportSkip_t )( NetworkContext_t * pNetworkContext,
+                                       size_t bytesToSkip );
+/* @[define_transportskip] */
+
+/**
+ * @transportstruct
+ * @brief The condition to wait for with #TransportWait_t.
+ */
+/* @[define_transportwaitevent] */
+typedef enum TransportWaitEvent
+{
+    TransportWaitRecv, /**< Wait until data can be received. */
+    TransportWaitSend  /**< Wait until data can be sent. */
+} TransportWaitEvent_t;
+/* @[define_transportwaitevent] */
+
+/**
+ * @transportcallback
+ * @brief Transport interface function for blocking until data can be received
+ * or sent, for example with poll() or select() on a socket.
+ *
+ * When a transport receive or send function returns zero in the middle of a
+ * packet, coreMQTT calls it again until the packet is complete or a timeout
+ * expires. If this function is provided, coreMQTT blocks in it between those
+ * calls instead of calling the receive or send function in a busy loop.
+ *
+ * @note This function is optional. If it is NULL, the receive and send
+ * functions are polled as before.
+ *
+ * @param[in] pNetworkContext Implementation-defined network context.
+ * @param[in] event Whether to wait until data can be received or sent.
+ * @param[in] timeoutMs The maximum time to block, in milliseconds.
+ *
+ * @return A positive value if the transport is ready, zero if the timeout
+ * expired, or a negative value to indicate error.
+ */
+/* @[define_transportwait] */
+typedef int32_t ( * TransportWait_t )( NetworkContext_t * pNetworkContext,
+                                       TransportWaitEvent_t event,
+                                       uint32_t timeoutMs );
+/* @[define_transportwait] */
+
 /**
  * @transportstruct
  * @brief The transport layer interface.
@@ -301,6 +479,9 @@ typedef struct TransportInterface
     TransportSend_t send;               /**< Transport send function pointer. */
     TransportWritev_t writev;           /**< Transport writev function pointer. */
     NetworkContext_t * pNetworkContext; /**< Implementation-defined network context. */
+    TransportWait_t wait;               /**< Transport wait function pointer. */
+    TransportReadv_t readv;             /**< Transport readv function pointer. */
+    TransportSkip_t skip;               /**< Transport skip function pointer. */
 } TransportInterface_t;
 /* @[define_transportinterface] */
 
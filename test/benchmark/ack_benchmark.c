@@ -0,0 +1,251 @@
+/*
+ * coreMQTT v2.3.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ack_benchmark.c
+ * @brief Measures the time taken by #MQTT_ReceiveLoop to handle PUBACK and
+ * PINGRESP packets.
+ *
+ * The packets are read from memory, so the result is the cost of the library
+ * alone. A batch of packets is handled as one drain batch, see
+ * #MQTT_InitReceiveDrain. The PUBACKs acknowledge publishes whose state
+ * records are added before the timed part of the batch.
+ */
+
+#define _POSIX_C_SOURCE    199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core_mqtt.h"
+#include "core_mqtt_state.h"
+
+/**
+ * @brief Number of packets in a batch, all handled by one call to
+ * #MQTT_ReceiveLoop.
+ */
+#define ACKS_PER_BATCH         ( 64U )
+
+/**
+ * @brief Number of batches run for each packet type.
+ */
+#define BATCH_COUNT            ( 4000U )
+
+/**
+ * @brief Size of the network buffer, which holds a whole batch.
+ */
+#define NETWORK_BUFFER_SIZE    ( ACKS_PER_BATCH * 4U )
+
+/**
+ * @brief The transport is read from this stream of packets.
+ */
+struct NetworkContext
+{
+    uint8_t stream[ NETWORK_BUFFER_SIZE ];
+    size_t length;
+    size_t position;
+};
+
+static uint8_t networkBufferMemory[ NETWORK_BUFFER_SIZE ];
+static MQTTPubAckInfo_t outgoingRecords[ ACKS_PER_BATCH ];
+static MQTTPubAckInfo_t incomingRecords[ 1 ];
+static uint32_t clockMs = 0U;
+
+/*-----------------------------------------------------------*/
+
+static int32_t streamRecv( NetworkContext_t * pNetworkContext,
+                           void * pBuffer,
+                           size_t bytesToRecv )
+{
+    size_t bytesLeft = pNetworkContext->length - pNetworkContext->position;
+
+    if( bytesToRecv > bytesLeft )
+    {
+        bytesToRecv = bytesLeft;
+    }
+
+    ( void ) memcpy( pBuffer, &( pNetworkContext->stream[ pNetworkContext->position ] ), bytesToRecv );
+    pNetworkContext->position += bytesToRecv;
+
+    return ( int32_t ) bytesToRecv;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t streamSend( NetworkContext_t * pNetworkContext,
+                           const void * pBuffer,
+                           size_t bytesToSend )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+
+    return ( int32_t ) bytesToSend;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t getTime( void )
+{
+    return clockMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static void eventCallback( MQTTContext_t * pContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000U ) + ( uint64_t ) now.tv_nsec;
+}
+
+/*-----------------------------------------------------------*/
+
+static void fail( const char * pMessage )
+{
+    ( void ) fprintf( stderr, "ack_benchmark: %s\n", pMessage );
+    exit( EXIT_FAILURE );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint64_t runBatches( MQTTContext_t * pContext,
+                            NetworkContext_t * pNetworkContext,
+                            uint8_t packetType )
+{
+    MQTTPublishState_t state = MQTTStateNull;
+    uint64_t elapsedNs = 0U;
+    uint64_t startNs = 0U;
+    uint16_t packetId = 0U;
+    size_t batch = 0U;
+    size_t i = 0U;
+
+    for( batch = 0U; batch < BATCH_COUNT; batch++ )
+    {
+        pNetworkContext->length = 0U;
+        pNetworkContext->position = 0U;
+
+        for( i = 0U; i < ACKS_PER_BATCH; i++ )
+        {
+            packetId = ( uint16_t ) ( i + 1U );
+            pNetworkContext->stream[ pNetworkContext->length++ ] = packetType;
+
+            if( packetType == MQTT_PACKET_TYPE_PUBACK )
+            {
+                if( ( MQTT_ReserveState( pContext, packetId, MQTTQoS1 ) != MQTTSuccess ) ||
+                    ( MQTT_UpdateStatePublish( pContext, packetId, MQTT_SEND, MQTTQoS1, &state ) != MQTTSuccess ) )
+                {
+                    fail( "Could not add the publish record." );
+                }
+
+                pNetworkContext->stream[ pNetworkContext->length++ ] = 2U;
+                pNetworkContext->stream[ pNetworkContext->length++ ] = ( uint8_t ) ( packetId >> 8 );
+                pNetworkContext->stream[ pNetworkContext->length++ ] = ( uint8_t ) packetId;
+            }
+            else
+            {
+                pNetworkContext->stream[ pNetworkContext->length++ ] = 0U;
+            }
+        }
+
+        startNs = nowNs();
+
+        while( pNetworkContext->position < pNetworkContext->length )
+        {
+            if( MQTT_ReceiveLoop( pContext ) != MQTTSuccess )
+            {
+                fail( "MQTT_ReceiveLoop failed." );
+            }
+        }
+
+        /* Packets left in the network buffer once the stream is read. */
+        while( pContext->index > 0U )
+        {
+            if( MQTT_ReceiveLoop( pContext ) != MQTTSuccess )
+            {
+                fail( "MQTT_ReceiveLoop failed." );
+            }
+        }
+
+        elapsedNs += nowNs() - startNs;
+    }
+
+    return elapsedNs;
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    static NetworkContext_t networkContext;
+    MQTTContext_t context;
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer;
+    uint64_t pubackNs = 0U;
+    uint64_t pingrespNs = 0U;
+    const double packetCount = ( double ) ACKS_PER_BATCH * ( double ) BATCH_COUNT;
+
+    ( void ) memset( &context, 0x00, sizeof( context ) );
+    ( void ) memset( &transport, 0x00, sizeof( transport ) );
+
+    transport.pNetworkContext = &networkContext;
+    transport.recv = streamRecv;
+    transport.send = streamSend;
+    networkBuffer.pBuffer = networkBufferMemory;
+    networkBuffer.size = sizeof( networkBufferMemory );
+
+    if( ( MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer ) != MQTTSuccess ) ||
+        ( MQTT_InitStatefulQoS( &context,
+                                outgoingRecords, ACKS_PER_BATCH,
+                                incomingRecords, 1U ) != MQTTSuccess ) ||
+        ( MQTT_InitReceiveDrain( &context, ACKS_PER_BATCH, 0U ) != MQTTSuccess ) )
+    {
+        fail( "Could not initialize the context." );
+    }
+
+    context.connectStatus = MQTTConnected;
+    context.waitingForPingResp = true;
+
+    pubackNs = runBatches( &context, &networkContext, MQTT_PACKET_TYPE_PUBACK );
+    pingrespNs = runBatches( &context, &networkContext, MQTT_PACKET_TYPE_PINGRESP );
+
+    ( void ) printf( "PUBACK:   %.1f ns/packet\n", ( double ) pubackNs / packetCount );
+    ( void ) printf( "PINGRESP: %.1f ns/packet\n", ( double ) pingrespNs / packetCount );
+
+    return EXIT_SUCCESS;
+}
@@ -223,6 +223,9 @@ MQTTContext_t * allocateMqttContext( MQTTContext_t * pContext )
         pTransportInterface->recv = NetworkInterfaceReceiveStub;
         pTransportInterface->send = NetworkInterfaceSendStub;
         pTransportInterface->writev = NULL;
+        pTransportInterface->wait = NULL;
+        pTransportInterface->readv = NULL;
+        pTransportInterface->skip = NULL;
     }
 
     pNetworkBuffer = allocateMqttFixedBuffer( NULL );
@@ -1926,6 +1926,126 @@ void test_MQTT_GetIncomingPacketTypeAndLength( void )
 
 /* ========================================================================== */
 
+/**
+ * @brief Tests that MQTT_GetIncomingPacketTypeAndLengthBuffered works as intended.
+ */
+void test_MQTT_GetIncomingPacketTypeAndLengthBuffered( void )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPacketInfo_t mqttPacket;
+    NetworkContext_t networkContext;
+    uint8_t buffer[ 10 ];
+    uint8_t * bufPtr = buffer;
+    uint8_t packetBuffer[ 8 ];
+    size_t index = 0;
+
+    /* Dummy network context - pointer to pointer to a buffer. */
+    networkContext.buffer = &bufPtr;
+
+    /* Test NULL parameters. */
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          NULL, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          NULL, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* Test an index past the end of the buffer. */
+    index = sizeof( packetBuffer ) + 1U;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* A CONNACK followed by the start of a PUBLISH is received with a single
+     * call, and the bytes after the fixed header are kept. */
+    memset( buffer, 0x00, sizeof( buffer ) );
+    buffer[ 0 ] = 0x20; /* CONN ACK */
+    buffer[ 1 ] = 0x02; /* Remaining length. */
+    buffer[ 4 ] = MQTT_PACKET_TYPE_PUBLISH;
+    buffer[ 5 ] = 0x80;
+    buffer[ 6 ] = 0x01;
+    index = 0;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_INT( 0x20, mqttPacket.type );
+    TEST_ASSERT_EQUAL_INT( 0x02, mqttPacket.remainingLength );
+    TEST_ASSERT_EQUAL_INT( 2, mqttPacket.headerLength );
+    TEST_ASSERT_EQUAL_INT( sizeof( packetBuffer ), index );
+    TEST_ASSERT_EQUAL_MEMORY( buffer, packetBuffer, sizeof( packetBuffer ) );
+
+    /* A complete fixed header in the buffer is decoded without a read. */
+    memmove( packetBuffer, &packetBuffer[ 4 ], 4 );
+    index = 4;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveFailure, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_INT( MQTT_PACKET_TYPE_PUBLISH, mqttPacket.type );
+    TEST_ASSERT_EQUAL_INT( 128, mqttPacket.remainingLength );
+    TEST_ASSERT_EQUAL_INT( 3, mqttPacket.headerLength );
+    TEST_ASSERT_EQUAL_INT( 4, index );
+
+    /* A partial fixed header is completed by a read. */
+    bufPtr = buffer;
+    buffer[ 0 ] = 0x01;
+    packetBuffer[ 0 ] = MQTT_PACKET_TYPE_PUBLISH;
+    packetBuffer[ 1 ] = 0x80;
+    index = 2;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_INT( 128, mqttPacket.remainingLength );
+    TEST_ASSERT_EQUAL_INT( sizeof( packetBuffer ), index );
+
+    /* A partial fixed header with nothing more to read. */
+    index = 2;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveNoData, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTNeedMoreBytes, status );
+    TEST_ASSERT_EQUAL_INT( 2, index );
+
+    /* A partial fixed header filling the whole buffer is not read into. */
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, 2,
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTNeedMoreBytes, status );
+
+    /* Test if no data is available. */
+    index = 0;
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveNoData, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTNoDataAvailable, status );
+
+    /* Check when network receive fails. */
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceiveFailure, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
+    TEST_ASSERT_EQUAL_INT( 0, index );
+
+    /* Test with incorrect packet type. */
+    bufPtr = buffer;
+    buffer[ 0 ] = 0x10; /* INVALID */
+    status = MQTT_GetIncomingPacketTypeAndLengthBuffered( mockReceive, &networkContext,
+                                                          packetBuffer, sizeof( packetBuffer ),
+                                                          &index, &mqttPacket );
+    TEST_ASSERT_EQUAL_INT( MQTTBadResponse, status );
+}
+
+/* ========================================================================== */
+
 /**
  * @brief Tests that MQTT_SerializePublishHeaderWithoutTopic works as intended.
  */
@@ -363,6 +363,76 @@ void test_MQTT_RemoveStateRecord_RemoveQoS2Record( void )
 
 /* ========================================================================== */
 
+void test_MQTT_RemoveIncomingStateRecord_InvalidParams( void )
+{
+    MQTTStatus_t status;
+    MQTTContext_t context;
+
+    status = MQTT_RemoveIncomingStateRecord( NULL, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    memset( &context, 0, sizeof( MQTTContext_t ) );
+
+    status = MQTT_RemoveIncomingStateRecord( &context, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+}
+
+/* ========================================================================== */
+
+void test_MQTT_RemoveIncomingStateRecord_AckedOrMissing( void )
+{
+    MQTTStatus_t status;
+    MQTTContext_t context;
+    MQTTPubAckInfo_t incomingRecords[ 5 ];
+    const uint16_t packetID = 12;
+
+    memset( &context, 0, sizeof( MQTTContext_t ) );
+    memset( incomingRecords, 0, sizeof( incomingRecords ) );
+
+    context.incomingPublishRecords = incomingRecords;
+    context.incomingPublishRecordMaxCount = 5;
+
+    status = MQTT_RemoveIncomingStateRecord( &context, packetID );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* The PUBREC of this publish has been sent, so it is kept. */
+    context.incomingPublishRecords[ 0 ].packetId = packetID;
+    context.incomingPublishRecords[ 0 ].publishState = MQTTPubRelPending;
+    context.incomingPublishRecords[ 0 ].qos = MQTTQoS2;
+
+    status = MQTT_RemoveIncomingStateRecord( &context, packetID );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    TEST_ASSERT_EQUAL( packetID, context.incomingPublishRecords[ 0 ].packetId );
+}
+
+/* ========================================================================== */
+
+void test_MQTT_RemoveIncomingStateRecord_RemoveRecord( void )
+{
+    MQTTStatus_t status;
+    MQTTContext_t context;
+    MQTTPubAckInfo_t incomingRecords[ 5 ];
+    const uint16_t packetID = 12;
+
+    memset( &context, 0, sizeof( MQTTContext_t ) );
+    memset( incomingRecords, 0, sizeof( incomingRecords ) );
+
+    context.incomingPublishRecords = incomingRecords;
+    context.incomingPublishRecordMaxCount = 5;
+
+    context.incomingPublishRecords[ 1 ].packetId = packetID;
+    context.incomingPublishRecords[ 1 ].publishState = MQTTPubAckSend;
+    context.incomingPublishRecords[ 1 ].qos = MQTTQoS1;
+
+    status = MQTT_RemoveIncomingStateRecord( &context, packetID );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, context.incomingPublishRecords[ 1 ].packetId );
+    TEST_ASSERT_EQUAL( MQTTStateNull, context.incomingPublishRecords[ 1 ].publishState );
+}
+
+/* ========================================================================== */
+
 void test_MQTT_ReserveState_compactRecords( void )
 {
     MQTTContext_t mqttContext = { 0 };
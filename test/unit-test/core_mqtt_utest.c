@@ -1582,9 +1582,9 @@ void test_MQTT_Connect_sendConnect5( void )
     MQTT_GetConnectPacketSize_ReturnThruPtr_pPacketSize( &packetSize );
     MQTT_GetConnectPacketSize_ReturnThruPtr_pRemainingLength( &remainingLength );
 
-    /* We know the send was successful if MQTT_GetIncomingPacketTypeAndLength()
+    /* We know the send was successful if MQTT_GetIncomingPacketTypeAndLengthBuffered()
      * is called. */
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTRecvFailed );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTRecvFailed );
 
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
 
@@ -1615,7 +1615,7 @@ void test_MQTT_Connect_sendConnect6( void )
 
     MQTT_GetConnectPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( 2 );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( 2 );
 
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
 
@@ -1649,8 +1649,8 @@ void test_MQTT_Connect_receiveConnack( void )
 
     /* Nothing received from transport interface. Set timeout to 2 for branch coverage. */
     timeout = 2;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTNoDataAvailable, status );
@@ -1658,8 +1658,8 @@ void test_MQTT_Connect_receiveConnack( void )
     /* Did not receive a CONNACK. */
     incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
     incomingPacket.remainingLength = 0;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTBadResponse, status );
 
@@ -1668,15 +1668,15 @@ void test_MQTT_Connect_receiveConnack( void )
     incomingPacket.remainingLength = 2;
     timeout = 2;
     mqttContext.transportInterface.recv = transportRecvFailure;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
 
     /* Bad response when deserializing CONNACK. */
     mqttContext.transportInterface.recv = transportRecvSuccess;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTBadResponse );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTBadResponse, status );
@@ -1686,8 +1686,8 @@ void test_MQTT_Connect_receiveConnack( void )
     mqttContext.transportInterface.recv = transportRecvSuccess;
     connectInfo.cleanSession = true;
     sessionPresentExpected = true;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresentExpected );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
@@ -1721,10 +1721,10 @@ void test_MQTT_Connect_receiveConnack_retries( void )
 
     /* Test with retries. MQTT_MAX_CONNACK_RECEIVE_RETRY_COUNT is 2.
      * Nothing received from transport interface. */
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
     /* 2 retries. */
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTNoDataAvailable, status );
@@ -1732,23 +1732,23 @@ void test_MQTT_Connect_receiveConnack_retries( void )
     /* Did not receive a CONNACK. */
     incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
     incomingPacket.remainingLength = 0;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTBadResponse, status );
 
     /* Transport receive failure when receiving rest of packet. */
     incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
     incomingPacket.remainingLength = 2;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
 
     /* Bad response when deserializing CONNACK. */
     mqttContext.transportInterface.recv = transportRecvSuccess;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTBadResponse );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTBadResponse, status );
@@ -1784,8 +1784,8 @@ void test_MQTT_Connect_partial_receive( void )
 
     /* Timeout in receiving entire packet, for branch coverage. This is due to the fact that the mocked
      * receive function always returns 0 bytes read. */
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
@@ -1798,8 +1798,8 @@ void test_MQTT_Connect_partial_receive( void )
     /* Not enough space for packet, discard it. */
     mqttContext.networkBuffer.size = 2;
     incomingPacket.remainingLength = 3;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTNoDataAvailable, status );
 
@@ -1807,8 +1807,8 @@ void test_MQTT_Connect_partial_receive( void )
      * iterations of the discard loop are required to discard the packet, but only
      * one will run. */
     mqttContext.transportInterface.recv = transportRecvSuccess;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
 
@@ -1816,8 +1816,8 @@ void test_MQTT_Connect_partial_receive( void )
     /* (Mocked) read only one byte at a time to ensure timeout will occur. */
     mqttContext.transportInterface.recv = transportRecvOneByte;
     incomingPacket.remainingLength = 20;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
 
@@ -1825,8 +1825,8 @@ void test_MQTT_Connect_partial_receive( void )
     mqttContext.transportInterface.recv = transportRecvFailure;
     /* Test with dummy get time function to make sure there are no infinite loops. */
     mqttContext.getTime = getTimeDummy;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, MQTT_NO_TIMEOUT_MS, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
 }
@@ -1862,8 +1862,8 @@ void test_MQTT_Connect_resendPendingAcks( void )
     /* successful receive CONNACK packet. */
     incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
     incomingPacket.remainingLength = 2;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     /* Return with a session present flag. */
     sessionPresent = true;
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
@@ -1881,8 +1881,8 @@ void test_MQTT_Connect_resendPendingAcks( void )
     sessionPresentResult = false;
     mqttContext.connectStatus = MQTTNotConnected;
     mqttContext.keepAliveIntervalSec = 0;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
     MQTT_PubrelToResend_ExpectAnyArgsAndReturn( packetIdentifier );
@@ -1897,8 +1897,8 @@ void test_MQTT_Connect_resendPendingAcks( void )
 
     /* Test 3. One packet found in ack pending state, Sent
      * PUBREL successfully. */
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
     MQTT_PubrelToResend_ExpectAnyArgsAndReturn( packetIdentifier );
@@ -1917,8 +1917,8 @@ void test_MQTT_Connect_resendPendingAcks( void )
      * for first and failed for second and no attempt for third. */
     mqttContext.keepAliveIntervalSec = 0;
     mqttContext.connectStatus = MQTTNotConnected;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
     /* First packet. */
@@ -1940,8 +1940,8 @@ void test_MQTT_Connect_resendPendingAcks( void )
 
     /* Test 5. Two packets found in ack pending state. Sent PUBREL successfully
      * for first and failed for second. */
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresent );
     /* First packet. */
@@ -1996,8 +1996,8 @@ void test_MQTT_Connect_happy_path1()
     MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
     MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_IgnoreAndReturn( MQTTSuccess );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
@@ -2033,8 +2033,8 @@ void test_MQTT_Connect_happy_path2()
     /* Success. */
     incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
     incomingPacket.remainingLength = 2;
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_IgnoreAndReturn( MQTTSuccess );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
     TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
@@ -2077,8 +2077,8 @@ void test_MQTT_Connect_happy_path3()
     MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
     MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
 
     status = MQTT_Connect( &mqttContext, &connectInfo, &willInfo, timeout, &sessionPresent );
@@ -2136,8 +2136,8 @@ void test_MQTT_Connect_happy_path4()
     MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
     MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresentExpected );
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, timeout, &sessionPresent );
@@ -2189,8 +2189,8 @@ void test_MQTT_Connect_happy_path5()
     MQTT_SerializeConnect_IgnoreAndReturn( MQTTSuccess );
     MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
     MQTT_DeserializeAck_ReturnThruPtr_pSessionPresent( &sessionPresentExpected );
     MQTT_PubrelToResend_ExpectAnyArgsAndReturn( MQTT_PACKET_TYPE_INVALID );
@@ -2224,7 +2224,7 @@ void test_MQTT_Connect_happy_path6()
     MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
 
     /* CONNACK receive with timeoutMs=0. Retry logic will  be used.
-     * #MQTTNoDataAvailable for first #MQTT_GetIncomingPacketTypeAndLength
+     * #MQTTNoDataAvailable for first #MQTT_GetIncomingPacketTypeAndLengthBuffered
      * and success in the second time. */
     mqttContext.connectStatus = MQTTNotConnected;
     mqttContext.keepAliveIntervalSec = 0;
@@ -2233,9 +2233,9 @@ void test_MQTT_Connect_happy_path6()
 
     MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
     MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
-    MQTT_GetIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
-    MQTT_GetIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
     MQTT_DeserializeAck_IgnoreAndReturn( MQTTSuccess );
 
     status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
@@ -2246,6 +2246,133 @@ void test_MQTT_Connect_happy_path6()
     TEST_ASSERT_FALSE( mqttContext.waitingForPingResp );
 }
 
+/**
+ * @brief Stub for MQTT_GetIncomingPacketTypeAndLengthBuffered which receives a
+ * CONNACK followed by the first 6 bytes of a PUBLISH.
+ */
+static MQTTStatus_t MQTT_GetIncomingPacketTypeAndLengthBuffered_cb( TransportRecv_t readFunc,
+                                                                    NetworkContext_t * pNetworkContext,
+                                                                    uint8_t * pBuffer,
+                                                                    size_t bufferSize,
+                                                                    size_t * pIndex,
+                                                                    MQTTPacketInfo_t * pIncomingPacket,
+                                                                    int numcallbacks )
+{
+    ( void ) readFunc;
+    ( void ) pNetworkContext;
+    ( void ) bufferSize;
+    ( void ) numcallbacks;
+
+    pBuffer[ 4 ] = MQTT_PACKET_TYPE_PUBLISH;
+    *pIndex = 10U;
+    pIncomingPacket->type = MQTT_PACKET_TYPE_CONNACK;
+    pIncomingPacket->remainingLength = 2U;
+    pIncomingPacket->headerLength = 2U;
+
+    return MQTTSuccess;
+}
+
+/**
+ * @brief Test that the bytes received after the CONNACK are kept in the
+ * network buffer for the receive loop.
+ */
+void test_MQTT_Connect_KeepsBytesAfterConnack( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = false;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    /* The whole CONNACK is received along with its fixed header, so the
+     * transport is not read again. */
+    transport.recv = transportRecvFailure;
+
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* Bytes left from an earlier connection are dropped. */
+    mqttContext.index = 20U;
+
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_Stub( MQTT_GetIncomingPacketTypeAndLengthBuffered_cb );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_INT( MQTTConnected, mqttContext.connectStatus );
+    /* The 6 bytes after the 4 byte CONNACK are moved to the front. */
+    TEST_ASSERT_EQUAL( 6U, mqttContext.index );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBLISH, mqttBuffer[ 0 ] );
+}
+
+/**
+ * @brief Test that the receive state left by an earlier connection is reset
+ * before the CONNACK is received.
+ */
+void test_MQTT_Connect_ResetsReceiveState( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = false;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishBatchEntry_t batch[ 2 ] = { 0 };
+    uint8_t overflowMemory[ 256 ];
+    MQTTFixedBuffer_t overflowBuffers[ 1 ] = { { NULL, 0U } };
+    MQTTOverflowBufferPool_t pool = { overflowBuffers, 1U };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    /* The connection was lost while a packet was in the overflow buffer, with
+     * a batch of publishes not yet delivered and the reception paused. */
+    mqttContext.pOverflowBufferPool = &pool;
+    mqttContext.primaryNetworkBuffer = mqttContext.networkBuffer;
+    mqttContext.networkBuffer.pBuffer = overflowMemory;
+    mqttContext.networkBuffer.size = sizeof( overflowMemory );
+    mqttContext.pPublishBatch = batch;
+    mqttContext.publishBatchSize = 2U;
+    mqttContext.publishBatchCount = 2U;
+    batch[ 0 ].publishInfo.qos = MQTTQoS1;
+    batch[ 0 ].deserializedInfo.packetIdentifier = 1U;
+    batch[ 1 ].publishInfo.qos = MQTTQoS0;
+    mqttContext.receivePaused = true;
+    mqttContext.index = 20U;
+    mqttContext.readIndex = 4U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
+    incomingPacket.remainingLength = 2;
+
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    /* Only the record of the QoS 1 publish is removed. */
+    MQTT_RemoveIncomingStateRecord_ExpectAndReturn( &mqttContext, 1U, MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( mqttBuffer, mqttContext.networkBuffer.pBuffer );
+    TEST_ASSERT_NULL( mqttContext.primaryNetworkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL_PTR( overflowMemory, overflowBuffers[ 0 ].pBuffer );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.publishBatchCount );
+    TEST_ASSERT_FALSE( mqttContext.receivePaused );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+}
+
 /* ========================================================================== */
 
 /**
@@ -3311,6 +3438,91 @@ void test_MQTT_ReceiveLoop_KeepAliveACK( void )
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
+/**
+ * @brief Test that a publish ack holding only a packet identifier is decoded
+ * without MQTT_DeserializeAck.
+ */
+void test_MQTT_ReceiveLoop_SimpleAckDecodedInline( void )
+{
+    MQTTContext_t context = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t stateAfterAck = MQTTPublishDone;
+    MQTTStatus_t mqttStatus;
+
+    setUPContext( &context );
+    isEventCallbackInvoked = false;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBACK;
+    incomingPacket.remainingLength = 2U;
+    incomingPacket.headerLength = 2U;
+    mqttBuffer[ 2 ] = 0x12U;
+    mqttBuffer[ 3 ] = 0x34U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_UpdateStateAck_ExpectAndReturn( &context, 0x1234U, MQTTPuback, MQTT_RECEIVE, NULL, MQTTSuccess );
+    MQTT_UpdateStateAck_IgnoreArg_pNewState();
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &stateAfterAck );
+
+    mqttStatus = MQTT_ReceiveLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+}
+
+/**
+ * @brief Test that a publish ack with a packet identifier of zero is rejected
+ * by the inline decoding.
+ */
+void test_MQTT_ReceiveLoop_SimpleAckZeroPacketId( void )
+{
+    MQTTContext_t context = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setUPContext( &context );
+    isEventCallbackInvoked = false;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBCOMP;
+    incomingPacket.remainingLength = 2U;
+    incomingPacket.headerLength = 2U;
+    mqttBuffer[ 2 ] = 0U;
+    mqttBuffer[ 3 ] = 0U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ReceiveLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+}
+
+/**
+ * @brief Test that a PINGRESP is handled without MQTT_DeserializeAck.
+ */
+void test_MQTT_ReceiveLoop_PingrespDecodedInline( void )
+{
+    MQTTContext_t context = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setUPContext( &context );
+    context.waitingForPingResp = true;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( context.waitingForPingResp );
+}
+
 void test_MQTT_ProcessLoop_discardPacket_second_recv_fail( void )
 {
     MQTTContext_t context = { 0 };
@@ -6007,3 +6219,3138 @@ void test_MQTT_InitStatefulQoS_callback_is_null( void )
     TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
 }
 /* ========================================================================== */
+
+void test_MQTT_InitRingBufferReceive_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_InitRingBufferReceive( NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitRingBufferReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_FALSE( mqttContext.ringBufferReceive );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitRingBufferReceive_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitRingBufferReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( mqttContext.ringBufferReceive );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that in the ring buffer receive mode a handled packet is consumed
+ * by advancing the read index instead of moving the remaining bytes.
+ */
+void test_MQTT_ReceiveLoop_RingBuffer_ConsumesInPlace( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitRingBufferReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ReceiveLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 2U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the ring buffer receive window wraps around to the front
+ * of the buffer once it reaches the end of the buffer.
+ */
+void test_MQTT_ReceiveLoop_RingBuffer_WrapAtEnd( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    const uint8_t pendingBytes[ 8 ] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitRingBufferReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Unprocessed bytes sit at the end of the buffer. */
+    mqttContext.readIndex = MQTT_TEST_BUFFER_LENGTH - sizeof( pendingBytes );
+    mqttContext.index = sizeof( pendingBytes );
+    memcpy( &mqttBuffer[ mqttContext.readIndex ], pendingBytes, sizeof( pendingBytes ) );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ReceiveLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_UINT8_ARRAY( pendingBytes, mqttBuffer, sizeof( pendingBytes ) );
+    TEST_ASSERT_EQUAL( 2U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 2U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the ring buffer receive window wraps around when the rest
+ * of a partially received packet would not fit before the end of the buffer.
+ */
+void test_MQTT_ReceiveLoop_RingBuffer_WrapPartialPacket( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitRingBufferReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttContext.readIndex = 100U;
+    mqttContext.index = 10U;
+    mqttBuffer[ 100 ] = MQTT_PACKET_TYPE_PUBLISH;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ReceiveLoop( &mqttContext );
+
+    /* 18 bytes were received to fill up the end of the buffer. */
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( 28U, mqttContext.index );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBLISH, mqttBuffer[ 0 ] );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitReceiveDrain_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_InitReceiveDrain( NULL, 10, 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 10, 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    /* The packet budget cannot be zero. */
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 0, 100 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.drainPacketBudget );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitReceiveDrain_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 10, 100 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 10U, mqttContext.drainPacketBudget );
+    TEST_ASSERT_EQUAL( 100U, mqttContext.drainByteBudget );
+    TEST_ASSERT_FALSE( mqttContext.drainInProgress );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the drain receive mode handles the packets held in the
+ * buffer without receiving again, and stops at the packet budget.
+ */
+void test_MQTT_ProcessLoop_Drain_PacketBudget( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 2, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 0U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( mqttContext.drainInProgress );
+    /* The remaining bytes are moved to the front once for the batch. */
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 4U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the drain receive mode stops at the byte budget.
+ */
+void test_MQTT_ProcessLoop_Drain_ByteBudget( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 10, 4 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 2U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 4U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the drain receive mode calls the transport receive function
+ * again when the buffer only holds a part of the next packet.
+ */
+void test_MQTT_ReceiveLoop_Drain_ReadsForPartialPacket( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 10, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 2U;
+    incomingPacket.headerLength = 2U;
+
+    isEventCallbackInvoked = false;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    /* The buffer holds a partial packet. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+    /* The transport is read again, and the packet is still incomplete. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+
+    mqttStatus = MQTT_ReceiveLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    /* The window was wrapped to receive the 4 bytes which fit at the end. */
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH, mqttContext.index );
+}
+/* ========================================================================== */
+
+static size_t fragmentCallbackCount = 0U;
+static size_t fragmentBytesReceived = 0U;
+static size_t fragmentAbortCount = 0U;
+
+static void publishFragmentCallback( MQTTContext_t * pContext,
+                                     MQTTDeserializedInfo_t * pDeserializedInfo,
+                                     const uint8_t * pFragment,
+                                     size_t fragmentLength,
+                                     size_t payloadOffset )
+{
+    ( void ) pContext;
+
+    /* The payload was cut off. */
+    if( pFragment == NULL )
+    {
+        TEST_ASSERT_EQUAL( 0U, fragmentLength );
+        TEST_ASSERT_EQUAL( fragmentBytesReceived, payloadOffset );
+        TEST_ASSERT_NOT_EQUAL( MQTTSuccess, pDeserializedInfo->deserializationResult );
+        fragmentAbortCount++;
+        return;
+    }
+
+    TEST_ASSERT_NULL( pDeserializedInfo->pPublishInfo->pPayload );
+    TEST_ASSERT_EQUAL( fragmentBytesReceived, payloadOffset );
+
+    /* Only the first fragment carries the topic name. */
+    if( payloadOffset == 0U )
+    {
+        TEST_ASSERT_NOT_NULL( pDeserializedInfo->pPublishInfo->pTopicName );
+    }
+    else
+    {
+        TEST_ASSERT_NULL( pDeserializedInfo->pPublishInfo->pTopicName );
+    }
+
+    fragmentCallbackCount++;
+    fragmentBytesReceived += fragmentLength;
+}
+/* ========================================================================== */
+
+void test_MQTT_InitPublishFragments_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_InitPublishFragments( NULL, publishFragmentCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitPublishFragments( &mqttContext, publishFragmentCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPublishFragments( &mqttContext, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_NULL( mqttContext.publishFragmentCallback );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitPublishFragments_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPublishFragments( &mqttContext, publishFragmentCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( publishFragmentCallback, mqttContext.publishFragmentCallback );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a PUBLISH larger than the network buffer is given to the
+ * fragment callback instead of being discarded.
+ */
+void test_MQTT_ProcessLoop_PublishFragments_LargePublish( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t publishState = MQTTStateNull;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitPublishFragments( &mqttContext, publishFragmentCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* A QoS 0 PUBLISH of 200 bytes with a 4 byte topic name. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+    mqttBuffer[ 2 ] = 0U;
+    mqttBuffer[ 3 ] = 4U;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "test";
+    publishInfo.topicNameLength = 4U;
+    publishInfo.payloadLength = 192U;
+
+    fragmentCallbackCount = 0U;
+    fragmentBytesReceived = 0U;
+    isEventCallbackInvoked = false;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    /* 120 bytes fit after the header, the other 72 are received afterwards. */
+    TEST_ASSERT_EQUAL( 2U, fragmentCallbackCount );
+    TEST_ASSERT_EQUAL( 192U, fragmentBytesReceived );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+}
+/* ========================================================================== */
+
+static size_t recvByteBudget = 0U;
+
+/**
+ * @brief Mocked transport receive that returns up to #recvByteBudget bytes in
+ * total, and then fails.
+ */
+static int32_t transportRecvUpToBudget( NetworkContext_t * pNetworkContext,
+                                        void * pBuffer,
+                                        size_t bytesToRead )
+{
+    int32_t bytesRead = -1;
+
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+
+    if( recvByteBudget > 0U )
+    {
+        bytesRead = ( int32_t ) ( ( bytesToRead < recvByteBudget ) ? bytesToRead : recvByteBudget );
+        recvByteBudget -= ( size_t ) bytesRead;
+    }
+
+    return bytesRead;
+}
+
+/**
+ * @brief Test that a streamed QoS 1 PUBLISH whose payload is cut off is not
+ * acknowledged, that its state record is removed, and that the fragment
+ * callback is told.
+ */
+void test_MQTT_ProcessLoop_PublishFragments_CutOff( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvUpToBudget;
+    mqttStatus = MQTT_InitPublishFragments( &mqttContext, publishFragmentCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* A QoS 1 PUBLISH of 200 bytes with a 4 byte topic name. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+    mqttBuffer[ 2 ] = 0U;
+    mqttBuffer[ 3 ] = 4U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "test";
+    publishInfo.topicNameLength = 4U;
+    publishInfo.payloadLength = 190U;
+
+    /* Only the bytes which fit in the network buffer arrive. */
+    recvByteBudget = MQTT_TEST_BUFFER_LENGTH;
+    fragmentCallbackCount = 0U;
+    fragmentBytesReceived = 0U;
+    fragmentAbortCount = 0U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_RemoveIncomingStateRecord_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTRecvFailed, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, fragmentCallbackCount );
+    TEST_ASSERT_EQUAL( 118U, fragmentBytesReceived );
+    TEST_ASSERT_EQUAL( 1U, fragmentAbortCount );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a PUBLISH whose header does not fit in the network buffer
+ * is discarded even when a fragment callback is registered.
+ */
+void test_MQTT_ProcessLoop_PublishFragments_HeaderTooLarge( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitPublishFragments( &mqttContext, publishFragmentCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The 150 byte topic name does not fit in the buffer. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+    mqttBuffer[ 2 ] = 0U;
+    mqttBuffer[ 3 ] = 150U;
+
+    fragmentCallbackCount = 0U;
+    fragmentBytesReceived = 0U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, fragmentCallbackCount );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+}
+/* ========================================================================== */
+
+static MQTTFixedBuffer_t loanedBuffer = { 0 };
+static MQTTStatus_t loanStatus = MQTTSuccess;
+
+/**
+ * @brief Event callback which takes ownership of the network buffer.
+ */
+static void eventCallbackLoanBuffer( MQTTContext_t * pContext,
+                                     MQTTPacketInfo_t * pPacketInfo,
+                                     MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pPacketInfo;
+    ( void ) pDeserializedInfo;
+
+    isEventCallbackInvoked = true;
+    loanStatus = MQTT_LoanReceiveBuffer( pContext, &loanedBuffer );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitReceiveBufferPool_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t poolBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t pool[ 1 ] = { { poolBuffer, MQTT_TEST_BUFFER_LENGTH } };
+
+    mqttStatus = MQTT_InitReceiveBufferPool( NULL, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, NULL, 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 0 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The buffers must be the same size as the network buffer. */
+    pool[ 0 ].size = MQTT_TEST_BUFFER_LENGTH - 1;
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    pool[ 0 ].size = MQTT_TEST_BUFFER_LENGTH;
+    pool[ 0 ].pBuffer = NULL;
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_NULL( mqttContext.pReceiveBufferPool );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitReceiveBufferPool_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t poolBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t pool[ 1 ] = { { poolBuffer, MQTT_TEST_BUFFER_LENGTH } };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( pool, mqttContext.pReceiveBufferPool );
+    TEST_ASSERT_EQUAL( 1U, mqttContext.receiveBufferPoolSize );
+}
+/* ========================================================================== */
+
+void test_MQTT_LoanReceiveBuffer_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTFixedBuffer_t buffer = { 0 };
+    uint8_t poolBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t pool[ 1 ] = { { poolBuffer, MQTT_TEST_BUFFER_LENGTH } };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_LoanReceiveBuffer( NULL, &buffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_LoanReceiveBuffer( &mqttContext, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The pool has not been set. */
+    mqttStatus = MQTT_LoanReceiveBuffer( &mqttContext, &buffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Not called from the callback of a received packet. */
+    mqttStatus = MQTT_LoanReceiveBuffer( &mqttContext, &buffer );
+    TEST_ASSERT_EQUAL( MQTTIllegalState, mqttStatus );
+    TEST_ASSERT_NOT_NULL( pool[ 0 ].pBuffer );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the application can take the network buffer from the event
+ * callback, and that the context continues with a buffer from the pool.
+ */
+void test_MQTT_ReceiveLoop_LoanReceiveBuffer( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    uint8_t poolBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t pool[ 1 ] = { { poolBuffer, MQTT_TEST_BUFFER_LENGTH } };
+
+    setUPContext( &mqttContext );
+    mqttContext.appCallback = eventCallbackLoanBuffer;
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PINGRESP;
+    incomingPacket.remainingLength = 2U;
+    incomingPacket.headerLength = 2U;
+    mqttBuffer[ 4 ] = 0xA5U;
+    loanedBuffer.pBuffer = NULL;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ReceiveLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTSuccess, loanStatus );
+    TEST_ASSERT_EQUAL_PTR( mqttBuffer, loanedBuffer.pBuffer );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH, loanedBuffer.size );
+    TEST_ASSERT_FALSE( mqttContext.receiveBufferLoaned );
+    TEST_ASSERT_NULL( pool[ 0 ].pBuffer );
+
+    /* The bytes after the packet were copied to the new network buffer. */
+    TEST_ASSERT_EQUAL_PTR( poolBuffer, mqttContext.networkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 4U, mqttContext.index );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( 0xA5U, poolBuffer[ 0 ] );
+
+    /* No buffer is left in the pool for the next packet. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ReceiveLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, loanStatus );
+    TEST_ASSERT_EQUAL_PTR( poolBuffer, mqttContext.networkBuffer.pBuffer );
+}
+/* ========================================================================== */
+
+void test_MQTT_ReturnReceiveBuffer( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t poolBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    uint8_t returnedBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t pool[ 1 ] = { { poolBuffer, MQTT_TEST_BUFFER_LENGTH } };
+    MQTTFixedBuffer_t buffer = { returnedBuffer, MQTT_TEST_BUFFER_LENGTH };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_ReturnReceiveBuffer( NULL, &buffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_ReturnReceiveBuffer( &mqttContext, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The pool has not been set. */
+    mqttStatus = MQTT_ReturnReceiveBuffer( &mqttContext, &buffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* No buffer is on loan. */
+    mqttStatus = MQTT_ReturnReceiveBuffer( &mqttContext, &buffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The buffer taken from the pool to replace a loaned buffer. */
+    pool[ 0 ].pBuffer = NULL;
+
+    buffer.size = MQTT_TEST_BUFFER_LENGTH - 1;
+    mqttStatus = MQTT_ReturnReceiveBuffer( &mqttContext, &buffer );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    buffer.size = MQTT_TEST_BUFFER_LENGTH;
+    mqttStatus = MQTT_ReturnReceiveBuffer( &mqttContext, &buffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( returnedBuffer, pool[ 0 ].pBuffer );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH, pool[ 0 ].size );
+}
+/* ========================================================================== */
+
+static uint32_t transportWaitCalls = 0U;
+
+/**
+ * @brief Mocked transport wait function which reports the transport as ready.
+ */
+static int32_t transportWaitReady( NetworkContext_t * pNetworkContext,
+                                   TransportWaitEvent_t event,
+                                   uint32_t timeoutMs )
+{
+    TEST_ASSERT_EQUAL( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+    TEST_ASSERT_EQUAL( TransportWaitSend, event );
+    TEST_ASSERT_GREATER_THAN( 0U, timeoutMs );
+    transportWaitCalls++;
+    return 1;
+}
+
+/**
+ * @brief Mocked transport wait function which fails.
+ */
+static int32_t transportWaitFailure( NetworkContext_t * pNetworkContext,
+                                     TransportWaitEvent_t event,
+                                     uint32_t timeoutMs )
+{
+    ( void ) pNetworkContext;
+    ( void ) event;
+    ( void ) timeoutMs;
+    transportWaitCalls++;
+    return -1;
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the transport wait function is called when the transport
+ * send function sends nothing.
+ */
+void test_MQTT_Ping_TransportWait( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.send = transportSendNoBytes;
+    transport.wait = transportWaitReady;
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The send times out, blocking in the wait function between attempts. */
+    transportWaitCalls = 0U;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+    mqttStatus = MQTT_Ping( &context );
+    TEST_ASSERT_EQUAL( MQTTSendFailed, mqttStatus );
+    TEST_ASSERT_GREATER_THAN( 0U, transportWaitCalls );
+
+    /* A wait failure stops the send. */
+    context.transportInterface.wait = transportWaitFailure;
+    transportWaitCalls = 0U;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+    mqttStatus = MQTT_Ping( &context );
+    TEST_ASSERT_EQUAL( MQTTSendFailed, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, transportWaitCalls );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the transport wait function is called when the transport
+ * receive function receives nothing in the middle of a packet.
+ */
+void test_MQTT_Connect_TransportWait( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = false;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.recv = transportRecvNoData;
+    transport.wait = transportWaitFailure;
+
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
+    incomingPacket.remainingLength = 2;
+    transportWaitCalls = 0U;
+
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
+
+    TEST_ASSERT_EQUAL_INT( MQTTRecvFailed, status );
+    TEST_ASSERT_EQUAL( 1U, transportWaitCalls );
+}
+/* ========================================================================== */
+
+static uint8_t payloadDestination[ 200 ];
+static size_t payloadDestinationCalls = 0U;
+static size_t transportReadvCalls = 0U;
+
+static uint8_t * payloadDestinationCallback( MQTTContext_t * pContext,
+                                             MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+
+    TEST_ASSERT_NULL( pDeserializedInfo->pPublishInfo->pPayload );
+    TEST_ASSERT_NOT_NULL( pDeserializedInfo->pPublishInfo->pTopicName );
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( payloadDestination ),
+                               pDeserializedInfo->pPublishInfo->payloadLength );
+
+    payloadDestinationCalls++;
+
+    return payloadDestination;
+}
+
+static int32_t transportReadvSuccess( NetworkContext_t * pNetworkContext,
+                                      TransportInVector_t * pIoVec,
+                                      size_t ioVecCount )
+{
+    TEST_ASSERT_EQUAL( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+    TEST_ASSERT_EQUAL( 2U, ioVecCount );
+    TEST_ASSERT_EQUAL_PTR( &payloadDestination[ MQTT_TEST_BUFFER_LENGTH - 8U ], pIoVec[ 0 ].iov_base );
+
+    transportReadvCalls++;
+
+    /* The payload and 3 bytes of the next packet. */
+    return ( int32_t ) pIoVec[ 0 ].iov_len + 3;
+}
+/* ========================================================================== */
+
+void test_MQTT_InitPayloadDestination_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_InitPayloadDestination( NULL, payloadDestinationCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitPayloadDestination( &mqttContext, payloadDestinationCallback );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPayloadDestination( &mqttContext, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_NULL( mqttContext.payloadDestinationCallback );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitPayloadDestination_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPayloadDestination( &mqttContext, payloadDestinationCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( payloadDestinationCallback, mqttContext.payloadDestinationCallback );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the payload of a PUBLISH is received into the buffer
+ * supplied by the application, with the transport readv function when there
+ * is one.
+ */
+void test_MQTT_ProcessLoop_PayloadDestination( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t publishState = MQTTStateNull;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitPayloadDestination( &mqttContext, payloadDestinationCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* A QoS 0 PUBLISH of 200 bytes with a 4 byte topic name. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+    mqttBuffer[ 2 ] = 0U;
+    mqttBuffer[ 3 ] = 4U;
+
+    publishInfo.qos = MQTTQoS0;
+    publishInfo.pTopicName = "test";
+    publishInfo.topicNameLength = 4U;
+    publishInfo.payloadLength = 192U;
+
+    /* Without a readv function, the rest of the payload is received with the
+     * transport receive function. */
+    payloadDestinationCalls = 0U;
+    isEventCallbackInvoked = false;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( 1U, payloadDestinationCalls );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+
+    /* With a readv function, the bytes after the PUBLISH stay in the network
+     * buffer. */
+    mqttContext.transportInterface.readv = transportReadvSuccess;
+    payloadDestinationCalls = 0U;
+    transportReadvCalls = 0U;
+    isEventCallbackInvoked = false;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( 1U, payloadDestinationCalls );
+    TEST_ASSERT_EQUAL( 1U, transportReadvCalls );
+    TEST_ASSERT_EQUAL( 3U, mqttContext.index );
+}
+/* ========================================================================== */
+
+static size_t publishBatchCallbackCount = 0U;
+static size_t publishBatchLength = 0U;
+
+static void publishBatchCallback( MQTTContext_t * pContext,
+                                  MQTTPublishBatchEntry_t * pBatch,
+                                  size_t batchLength )
+{
+    size_t i;
+
+    ( void ) pContext;
+
+    for( i = 0U; i < batchLength; i++ )
+    {
+        TEST_ASSERT_EQUAL_PTR( &( pBatch[ i ].publishInfo ),
+                               pBatch[ i ].deserializedInfo.pPublishInfo );
+    }
+
+    publishBatchCallbackCount++;
+    publishBatchLength = batchLength;
+}
+/* ========================================================================== */
+
+void test_MQTT_InitPublishBatch_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishBatchEntry_t batch[ 2 ];
+
+    mqttStatus = MQTT_InitPublishBatch( NULL, publishBatchCallback, batch, 2U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallback, batch, 2U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, NULL, batch, 2U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallback, NULL, 2U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallback, batch, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_NULL( mqttContext.publishBatchCallback );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitPublishBatch_Happy_Path( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishBatchEntry_t batch[ 2 ];
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallback, batch, 2U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( publishBatchCallback, mqttContext.publishBatchCallback );
+    TEST_ASSERT_EQUAL_PTR( batch, mqttContext.pPublishBatch );
+    TEST_ASSERT_EQUAL( 2U, mqttContext.publishBatchSize );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.publishBatchCount );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the PUBLISH packets of a drain batch are given to the batch
+ * callback together, and acknowledged after it returns.
+ */
+void test_MQTT_ProcessLoop_PublishBatch( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishBatchEntry_t batch[ 4 ];
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 2, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallback, batch, 4U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 8U;
+    incomingPacket.headerLength = 2U;
+
+    publishBatchCallbackCount = 0U;
+    publishBatchLength = 0U;
+    isEventCallbackInvoked = false;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    /* Both PUBACKs are sent after the batch callback. */
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( 1U, publishBatchCallbackCount );
+    TEST_ASSERT_EQUAL( 2U, publishBatchLength );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.publishBatchCount );
+}
+/* ========================================================================== */
+
+void test_MQTT_ProcessLoopUntil_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_ProcessLoopUntil( NULL, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_ProcessLoopUntil( &mqttContext, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+    mqttContext.networkBuffer.pBuffer = NULL;
+
+    mqttStatus = MQTT_ProcessLoopUntil( &mqttContext, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the discard of an oversized packet stops at the deadline of
+ * MQTT_ProcessLoopUntil and is finished by the next receive loop call.
+ */
+void test_MQTT_ProcessLoopUntil_DiscardResumes( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+
+    /* The packet does not fit in the network buffer. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    /* The deadline has already passed, so only one more byte is discarded. */
+    mqttStatus = MQTT_ProcessLoopUntil( &mqttContext, globalEntryTime );
+
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_FALSE( mqttContext.loopDeadlineSet );
+    TEST_ASSERT_EQUAL( 198U, mqttContext.discardRemaining );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+
+    /* Without a deadline, the rest of the packet is discarded. */
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.discardRemaining );
+}
+
+/**
+ * @brief Test that a discard left by MQTT_ProcessLoopUntil is dropped by
+ * MQTT_Disconnect, so it does not consume the data of the next connection.
+ */
+void test_MQTT_Disconnect_DiscardPending( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    size_t disconnectSize = 2;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoopUntil( &mqttContext, globalEntryTime );
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_NOT_EQUAL( 0U, mqttContext.discardRemaining );
+
+    mqttContext.connectStatus = MQTTConnected;
+    mqttContext.transportInterface.send = mockSend;
+    MQTT_GetDisconnectPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetDisconnectPacketSize_ReturnThruPtr_pPacketSize( &disconnectSize );
+    MQTT_SerializeDisconnect_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializeDisconnect_Stub( MQTT_SerializeDisconnect_stub );
+
+    mqttStatus = MQTT_Disconnect( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.discardRemaining );
+}
+
+static size_t recvNoDataCount = 0U;
+
+/**
+ * @brief Mocked transport returning zero bytes, which counts its calls.
+ */
+static int32_t transportRecvNoDataCounted( NetworkContext_t * pNetworkContext,
+                                           void * pBuffer,
+                                           size_t bytesToRead )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+    ( void ) bytesToRead;
+    recvNoDataCount++;
+    return 0;
+}
+
+/**
+ * @brief Test that MQTT_ProcessLoopUntil returns before the deadline when no
+ * data is available.
+ */
+void test_MQTT_ProcessLoopUntil_Idle( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvNoDataCounted;
+    mqttContext.keepAliveIntervalSec = 0U;
+    recvNoDataCount = 0U;
+
+    mqttStatus = MQTT_ProcessLoopUntil( &mqttContext, globalEntryTime + 1000U );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, recvNoDataCount );
+}
+/* ========================================================================== */
+
+void test_MQTT_PauseReceive_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+
+    mqttStatus = MQTT_PauseReceive( NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_ResumeReceive( NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_ProcessLoop does not read from the transport nor time
+ * out the PINGRESP while the reception is paused.
+ */
+void test_MQTT_ProcessLoop_ReceivePaused( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvFailure;
+    mqttContext.keepAliveIntervalSec = 0U;
+    mqttContext.waitingForPingResp = true;
+    mqttContext.pingReqSendTimeMs = globalEntryTime;
+    globalEntryTime += MQTT_PINGRESP_TIMEOUT_MS + 1U;
+
+    mqttStatus = MQTT_PauseReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( mqttContext.receivePaused );
+
+    /* The failing receive function is not called. */
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The PINGRESP timeout starts again when the reception is resumed. */
+    mqttStatus = MQTT_ResumeReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( mqttContext.receivePaused );
+    TEST_ASSERT_EQUAL( globalEntryTime - 1U, mqttContext.pingReqSendTimeMs );
+}
+
+/**
+ * @brief Test that MQTT_PauseReceive and MQTT_ResumeReceive can be called from
+ * an application callback of a drain batch, and that the PINGRESP timeout
+ * restarts at the time of the receive loop pass.
+ */
+void test_MQTT_ResumeReceive_DuringDrain( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.drainInProgress = true;
+    mqttContext.callbackRunning = true;
+    mqttContext.waitingForPingResp = true;
+    mqttContext.coarseTimePass = true;
+    mqttContext.coarseTimeValid = true;
+    mqttContext.coarseTimeMs = 1234U;
+
+    mqttStatus = MQTT_PauseReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( mqttContext.receivePaused );
+
+    mqttStatus = MQTT_ResumeReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( mqttContext.receivePaused );
+    TEST_ASSERT_EQUAL( 1234U, mqttContext.pingReqSendTimeMs );
+}
+
+/**
+ * @brief Test that MQTT_ResumeReceive called from another thread during a drain
+ * batch restarts the PINGRESP timeout at the time read from the clock.
+ */
+void test_MQTT_ResumeReceive_OtherThreadDuringDrain( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.drainInProgress = true;
+    mqttContext.waitingForPingResp = true;
+    mqttContext.coarseTimePass = true;
+    mqttContext.coarseTimeValid = true;
+    mqttContext.coarseTimeMs = 1234U;
+
+    mqttStatus = MQTT_ResumeReceive( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( mqttContext.receivePaused );
+    TEST_ASSERT_EQUAL( globalEntryTime - 1U, mqttContext.pingReqSendTimeMs );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the header of a partially received packet is decoded only
+ * once while the rest of the packet is received.
+ */
+void test_MQTT_ProcessLoop_PendingPacketHeaderReused( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 20U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 22U, mqttContext.pendingPacketLength );
+
+    /* The packet is not decoded again. */
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, mqttContext.index );
+    TEST_ASSERT_EQUAL( 22U, mqttContext.pendingPacketLength );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of calls to #transportSendCounted.
+ */
+static size_t transportSendCount = 0U;
+
+/**
+ * @brief Mocked successful transport send which counts its calls.
+ */
+static int32_t transportSendCounted( NetworkContext_t * pNetworkContext,
+                                     const void * pBuffer,
+                                     size_t bytesToWrite )
+{
+    ( void ) pNetworkContext;
+    ( void ) pBuffer;
+    transportSendCount++;
+    return ( int32_t ) bytesToWrite;
+}
+
+/**
+ * @brief Callback for MQTT_SerializeAck which serializes the ack.
+ */
+static MQTTStatus_t MQTT_SerializeAck_cb( const MQTTFixedBuffer_t * pFixedBuffer,
+                                          uint8_t packetType,
+                                          uint16_t packetId,
+                                          int numcallbacks )
+{
+    ( void ) numcallbacks;
+
+    pFixedBuffer->pBuffer[ 0 ] = packetType;
+    pFixedBuffer->pBuffer[ 1 ] = 2U;
+    pFixedBuffer->pBuffer[ 2 ] = ( uint8_t ) ( packetId >> 8 );
+    pFixedBuffer->pBuffer[ 3 ] = ( uint8_t ) ( packetId & 0x00FFU );
+
+    return MQTTSuccess;
+}
+
+void test_MQTT_InitAckCoalescing_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t ackBuffer[ MQTT_PUBLISH_ACK_PACKET_SIZE ];
+
+    mqttStatus = MQTT_InitAckCoalescing( NULL, ackBuffer, sizeof( ackBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitAckCoalescing( &mqttContext, NULL, sizeof( ackBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitAckCoalescing( &mqttContext, ackBuffer, sizeof( ackBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitAckCoalescing( &mqttContext, ackBuffer, MQTT_PUBLISH_ACK_PACKET_SIZE - 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitAckCoalescing( &mqttContext, ackBuffer, sizeof( ackBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( ackBuffer, mqttContext.pAckBuffer );
+    TEST_ASSERT_EQUAL( sizeof( ackBuffer ), mqttContext.ackBufferSize );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the acks of a drain batch are sent with one transport send
+ * call, and the state of their publishes updated afterwards.
+ */
+void test_MQTT_ProcessLoop_AckCoalescing( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    uint8_t ackBuffer[ 4U * MQTT_PUBLISH_ACK_PACKET_SIZE ];
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId1 = 1U;
+    uint16_t packetId2 = 2U;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 2, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitAckCoalescing( &mqttContext, ackBuffer, sizeof( ackBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttContext.transportInterface.send = transportSendCounted;
+    transportSendCount = 0U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 8U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_SerializeAck_Stub( MQTT_SerializeAck_cb );
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId1 );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId2 );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    /* The states are updated once both PUBACKs are sent. */
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, transportSendCount );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.ackBufferIndex );
+}
+
+/**
+ * @brief Test that the staged acks are sent to free the incoming publish
+ * records when a PUBLISH finds none.
+ */
+void test_MQTT_ProcessLoop_AckCoalescing_RecordsFull( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    uint8_t ackBuffer[ 4U * MQTT_PUBLISH_ACK_PACKET_SIZE ];
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId1 = 1U;
+    uint16_t packetId2 = 2U;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 2, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitAckCoalescing( &mqttContext, ackBuffer, sizeof( ackBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttContext.transportInterface.send = transportSendCounted;
+    transportSendCount = 0U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 8U;
+    incomingPacket.headerLength = 2U;
+
+    MQTT_SerializeAck_Stub( MQTT_SerializeAck_cb );
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId1 );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId2 );
+
+    /* The record table is full until the first PUBACK is sent. */
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTNoMemory );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, transportSendCount );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.ackBufferIndex );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitQoS1Dedup_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTQoS1DedupEntry_t cache[ 2 ];
+
+    mqttStatus = MQTT_InitQoS1Dedup( NULL, cache, 2U, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitQoS1Dedup( &mqttContext, NULL, 2U, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitQoS1Dedup( &mqttContext, cache, 2U, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitQoS1Dedup( &mqttContext, cache, 0U, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitQoS1Dedup( &mqttContext, cache, 2U, 1000U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( cache, mqttContext.pQoS1DedupCache );
+    TEST_ASSERT_EQUAL( 2U, mqttContext.qos1DedupCacheSize );
+    TEST_ASSERT_EQUAL( 1000U, mqttContext.qos1DedupWindowMs );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a redelivered QoS 1 PUBLISH is acknowledged but not given to
+ * the application when it is in the cache.
+ */
+void test_MQTT_ProcessLoop_QoS1Dedup( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTQoS1DedupEntry_t cache[ 2 ];
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId = 1U;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitQoS1Dedup( &mqttContext, cache, 2U, 0U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 8U;
+    incomingPacket.headerLength = 2U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "x";
+    publishInfo.payloadLength = 1U;
+
+    /* The first delivery is given to the application. */
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+
+    /* The redelivery is only acknowledged. */
+    publishInfo.dup = true;
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of bytes dropped by #transportSkipSuccess.
+ */
+static size_t transportSkipTotal = 0U;
+
+/**
+ * @brief Mocked transport skip which drops all the requested bytes.
+ */
+static int32_t transportSkipSuccess( NetworkContext_t * pNetworkContext,
+                                     size_t bytesToSkip )
+{
+    ( void ) pNetworkContext;
+    transportSkipTotal += bytesToSkip;
+    return ( int32_t ) bytesToSkip;
+}
+
+/**
+ * @brief Test that an oversized packet is discarded with the transport skip
+ * function, in one call and without clearing the network buffer.
+ */
+void test_MQTT_ProcessLoop_discardPacket_Skip( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+    mqttContext.transportInterface.skip = transportSkipSuccess;
+    mqttContext.networkBuffer.pBuffer[ 10 ] = 0xABU;
+    transportSkipTotal = 0U;
+
+    /* The packet does not fit in the network buffer. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    /* One byte was received before the packet was found to be too large. */
+    TEST_ASSERT_EQUAL( 199U, transportSkipTotal );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+    TEST_ASSERT_EQUAL( 0xABU, mqttContext.networkBuffer.pBuffer[ 10 ] );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Publish filter which rejects every PUBLISH.
+ */
+static bool publishFilterReject( MQTTContext_t * pContext,
+                                 const MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pDeserializedInfo;
+    return false;
+}
+
+void test_MQTT_InitPublishFilter_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_InitPublishFilter( NULL, publishFilterReject );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterReject );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterReject );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( publishFilterReject, mqttContext.publishFilterCallback );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a PUBLISH in the network buffer which is rejected by the
+ * filter is acknowledged but not given to the application.
+ */
+void test_MQTT_ProcessLoop_PublishFilterRejects( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId = 1U;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterReject );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 8U;
+    incomingPacket.headerLength = 2U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.pPayload = "x";
+    publishInfo.payloadLength = 1U;
+
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the payload of a PUBLISH which is rejected by the filter
+ * before it is complete is skipped rather than received.
+ */
+void test_MQTT_ProcessLoop_PublishFilterSkipsPayload( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId = 1U;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+    mqttContext.transportInterface.skip = transportSkipSuccess;
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterReject );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    transportSkipTotal = 0U;
+
+    /* Topic name length of 3, read from the network buffer. */
+    mqttContext.networkBuffer.pBuffer[ 2 ] = 0U;
+    mqttContext.networkBuffer.pBuffer[ 3 ] = 3U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    incomingPacket.remainingLength = 100U;
+    incomingPacket.headerLength = 2U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.payloadLength = 93U;
+
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    /* Only the header and topic name were received. */
+    TEST_ASSERT_EQUAL( 93U, transportSkipTotal );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+}
+
+/**
+ * @brief Test that the ack of a PUBLISH rejected by the filter is sent only
+ * once its payload has been discarded, when the discard is left unfinished at
+ * the deadline of MQTT_ProcessLoopUntil.
+ */
+void test_MQTT_ProcessLoopUntil_PublishFilterAckAfterDiscard( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId = 1U;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterReject );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* Topic name length of 3, read from the network buffer. */
+    mqttContext.networkBuffer.pBuffer[ 2 ] = 0U;
+    mqttContext.networkBuffer.pBuffer[ 3 ] = 3U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    incomingPacket.remainingLength = 100U;
+    incomingPacket.headerLength = 2U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.payloadLength = 93U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+
+    /* The deadline has already passed, so the payload is not yet discarded
+     * and no ack is sent. */
+    mqttStatus = MQTT_ProcessLoopUntil( &mqttContext, globalEntryTime );
+
+    TEST_ASSERT_NOT_EQUAL( 0U, mqttContext.discardRemaining );
+    TEST_ASSERT_EQUAL( packetId, mqttContext.discardAckPacketId );
+
+    /* The PUBACK follows the rest of the payload. */
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.discardRemaining );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.discardAckPacketId );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Publish filter which accepts every PUBLISH.
+ */
+static bool publishFilterAccept( MQTTContext_t * pContext,
+                                 const MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    ( void ) pContext;
+    ( void ) pDeserializedInfo;
+    return true;
+}
+
+/**
+ * @brief Test that a PUBLISH accepted by the filter before it is complete is
+ * given to the batch callback, as when it is complete in the network buffer.
+ */
+void test_MQTT_ProcessLoop_PublishFilterAcceptsIntoBatch( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishBatchEntry_t batch[ 4 ];
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint16_t packetId = 1U;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvOneByte;
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterAccept );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallback, batch, 4U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    publishBatchCallbackCount = 0U;
+
+    /* Topic name length of 3, read from the network buffer. */
+    mqttContext.networkBuffer.pBuffer[ 2 ] = 0U;
+    mqttContext.networkBuffer.pBuffer[ 3 ] = 3U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+    incomingPacket.remainingLength = 100U;
+    incomingPacket.headerLength = 2U;
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "a/b";
+    publishInfo.topicNameLength = 3U;
+    publishInfo.payloadLength = 93U;
+
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializePublish_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_DeserializePublish_ReturnThruPtr_pPublishInfo( &publishInfo );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL( 1U, publishBatchCallbackCount );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.publishBatchCount );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Batch callback which takes ownership of the network buffer.
+ */
+static void publishBatchCallbackLoanBuffer( MQTTContext_t * pContext,
+                                            MQTTPublishBatchEntry_t * pBatch,
+                                            size_t batchLength )
+{
+    publishBatchCallback( pContext, pBatch, batchLength );
+    loanStatus = MQTT_LoanReceiveBuffer( pContext, &loanedBuffer );
+}
+
+/**
+ * @brief Test that the batch callback can take the network buffer holding the
+ * batch, and that the context continues with a buffer from the pool.
+ */
+void test_MQTT_ProcessLoop_PublishBatchLoanBuffer( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishBatchEntry_t batch[ 4 ];
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint8_t poolBuffer[ MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t pool[ 1 ] = { { poolBuffer, MQTT_TEST_BUFFER_LENGTH } };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitReceiveDrain( &mqttContext, 2, 0 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishBatch( &mqttContext, publishBatchCallbackLoanBuffer, batch, 4U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitReceiveBufferPool( &mqttContext, pool, 1 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.remainingLength = 8U;
+    incomingPacket.headerLength = 2U;
+    mqttBuffer[ 20 ] = 0xA5U;
+    loanedBuffer.pBuffer = NULL;
+    publishBatchCallbackCount = 0U;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, publishBatchCallbackCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, loanStatus );
+    TEST_ASSERT_EQUAL_PTR( mqttBuffer, loanedBuffer.pBuffer );
+    TEST_ASSERT_FALSE( mqttContext.receiveBufferLoaned );
+    TEST_ASSERT_FALSE( mqttContext.receiveBufferLoanable );
+
+    /* The bytes after the batch were copied to the new network buffer. */
+    TEST_ASSERT_EQUAL_PTR( poolBuffer, mqttContext.networkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL( MQTT_TEST_BUFFER_LENGTH - 20U, mqttContext.index );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.readIndex );
+    TEST_ASSERT_EQUAL( 0xA5U, poolBuffer[ 0 ] );
+}
+/* ========================================================================== */
+
+void test_MQTT_InitOverflowBufferPool_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t overflowBuffer[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t buffers[ 1 ] = { { overflowBuffer, sizeof( overflowBuffer ) } };
+    MQTTOverflowBufferPool_t pool = { buffers, 1U };
+    MQTTOverflowBufferPool_t emptyPool = { buffers, 0U };
+
+    mqttStatus = MQTT_InitOverflowBufferPool( NULL, &pool );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitOverflowBufferPool( &mqttContext, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitOverflowBufferPool( &mqttContext, &pool );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitOverflowBufferPool( &mqttContext, &emptyPool );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitOverflowBufferPool( &mqttContext, &pool );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( &pool, mqttContext.pOverflowBufferPool );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a packet larger than the network buffer is received into a
+ * buffer borrowed from the overflow pool, and that the buffer is given back.
+ */
+void test_MQTT_ProcessLoop_OverflowBuffer( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint8_t overflowBuffer[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t buffers[ 1 ] = { { overflowBuffer, sizeof( overflowBuffer ) } };
+    MQTTOverflowBufferPool_t pool = { buffers, 1U };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitOverflowBufferPool( &mqttContext, &pool );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The packet does not fit in the network buffer. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+
+    /* The network buffer is used again, and the pool is full. */
+    TEST_ASSERT_EQUAL_PTR( mqttBuffer, mqttContext.networkBuffer.pBuffer );
+    TEST_ASSERT_NULL( mqttContext.primaryNetworkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL_PTR( overflowBuffer, buffers[ 0 ].pBuffer );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a PUBLISH larger than the network buffer is received into
+ * the overflow pool, and given to the filter, when a filter is also set.
+ */
+void test_MQTT_ProcessLoop_OverflowBufferWithFilter( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t publishState = MQTTPubAckSend;
+    MQTTPublishState_t ackState = MQTTPublishDone;
+    uint8_t overflowBuffer[ 2 * MQTT_TEST_BUFFER_LENGTH ];
+    MQTTFixedBuffer_t buffers[ 1 ] = { { overflowBuffer, sizeof( overflowBuffer ) } };
+    MQTTOverflowBufferPool_t pool = { buffers, 1U };
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitOverflowBufferPool( &mqttContext, &pool );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttStatus = MQTT_InitPublishFilter( &mqttContext, publishFilterAccept );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The packet does not fit in the network buffer. */
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBLISH;
+    incomingPacket.headerLength = 2U;
+    incomingPacket.remainingLength = 198U;
+
+    isEventCallbackInvoked = false;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ReturnThruPtr_pNewState( &publishState );
+    MQTT_SerializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &ackState );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    /* The payload is given to the application instead of being discarded. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    TEST_ASSERT_EQUAL_PTR( mqttBuffer, mqttContext.networkBuffer.pBuffer );
+    TEST_ASSERT_EQUAL_PTR( overflowBuffer, buffers[ 0 ].pBuffer );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.index );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of calls made to #transportWritevCount.
+ */
+static size_t writevCallCount = 0;
+
+/**
+ * @brief Mocked transport writev that accepts everything and counts its calls.
+ */
+static int32_t transportWritevCount( NetworkContext_t * pNetworkContext,
+                                     TransportOutVector_t * pIoVectorIterator,
+                                     size_t vectorsToBeSent )
+{
+    writevCallCount++;
+
+    return transportWritevSuccess( pNetworkContext, pIoVectorIterator, vectorsToBeSent );
+}
+
+void test_MQTT_PublishBatch_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo[ 2 ] = { 0 };
+    uint16_t packetIds[ 2 ] = { 1U, 2U };
+    MQTTStatus_t statuses[ 2 ];
+
+    mqttStatus = MQTT_PublishBatch( NULL, publishInfo, packetIds, 2U, statuses );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishBatch( &mqttContext, NULL, packetIds, 2U, statuses );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishBatch( &mqttContext, publishInfo, NULL, 2U, statuses );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishBatch( &mqttContext, publishInfo, packetIds, 2U, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishBatch( &mqttContext, publishInfo, packetIds, 0U, statuses );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* A QoS1 publish without a packet ID fails on its own; the QoS0 publish
+     * is still sent. */
+    setUPContext( &mqttContext );
+    publishInfo[ 0 ].qos = MQTTQoS1;
+    packetIds[ 0 ] = 0U;
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_PublishBatch( &mqttContext, publishInfo, packetIds, 2U, statuses );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, statuses[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, statuses[ 1 ] );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_PublishBatch sends a chunk of publishes with a single
+ * writev call and reports the status of each publish.
+ */
+void test_MQTT_PublishBatch_SingleWritev( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPubAckInfo_t outgoingPublishRecord[ 10 ];
+    MQTTPublishInfo_t publishInfo[ 3 ] = { 0 };
+    uint16_t packetIds[ 3 ] = { 1U, 2U, 3U };
+    MQTTStatus_t statuses[ 3 ];
+    size_t headerLen = 5;
+    size_t i;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.writev = transportWritevCount;
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+    mqttContext.outgoingPublishRecordMaxCount = 10;
+    mqttContext.outgoingPublishRecords = outgoingPublishRecord;
+
+    for( i = 0; i < 3U; i++ )
+    {
+        publishInfo[ i ].qos = MQTTQoS1;
+        publishInfo[ i ].pPayload = "TestPublish";
+        publishInfo[ i ].payloadLength = strlen( publishInfo[ i ].pPayload );
+        publishInfo[ i ].pTopicName = "TestTopic";
+        publishInfo[ i ].topicNameLength = strlen( publishInfo[ i ].pTopicName );
+    }
+
+    /* The second publish collides with an existing state. */
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTStateCollision );
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    writevCallCount = 0;
+    mqttStatus = MQTT_PublishBatch( &mqttContext, publishInfo, packetIds, 3U, statuses );
+
+    TEST_ASSERT_EQUAL( MQTTStateCollision, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTSuccess, statuses[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTStateCollision, statuses[ 1 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, statuses[ 2 ] );
+    TEST_ASSERT_EQUAL( 1U, writevCallCount );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that every publish of a chunk is marked as failed when the
+ * transport fails.
+ */
+void test_MQTT_PublishBatch_SendFailed( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPublishInfo_t publishInfo[ 2 ] = { 0 };
+    uint16_t packetIds[ 2 ] = { 0U, 0U };
+    MQTTStatus_t statuses[ 2 ];
+    size_t headerLen = 5;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    transport.writev = transportWritevError;
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    publishInfo[ 0 ].pPayload = "Test";
+    publishInfo[ 0 ].payloadLength = 4;
+    publishInfo[ 1 ].pPayload = "Test";
+    publishInfo[ 1 ].payloadLength = 4;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+
+    mqttStatus = MQTT_PublishBatch( &mqttContext, publishInfo, packetIds, 2U, statuses );
+
+    TEST_ASSERT_EQUAL( MQTTSendFailed, mqttStatus );
+    TEST_ASSERT_EQUAL( MQTTSendFailed, statuses[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTSendFailed, statuses[ 1 ] );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of bytes #transportSendUpToCapacity accepts before the
+ * transport is full.
+ */
+static size_t sendCapacity = 0;
+
+/**
+ * @brief Mocked transport send that accepts up to #sendCapacity bytes and then
+ * returns 0, as a full non-blocking socket does.
+ */
+static int32_t transportSendUpToCapacity( NetworkContext_t * pNetworkContext,
+                                          const void * pBuffer,
+                                          size_t bytesToWrite )
+{
+    size_t bytesWritten = ( bytesToWrite < sendCapacity ) ? bytesToWrite : sendCapacity;
+
+    TEST_ASSERT_EQUAL( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+    ( void ) pBuffer;
+    sendCapacity -= bytesWritten;
+
+    return ( int32_t ) bytesWritten;
+}
+
+void test_MQTT_InitTransmitQueue_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t queue[ 64 ];
+
+    mqttStatus = MQTT_InitTransmitQueue( NULL, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, NULL, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, 0U, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( queue, mqttContext.pTransmitQueue );
+    TEST_ASSERT_EQUAL( sizeof( queue ), mqttContext.transmitQueueSize );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_Publish queues the packet without calling the
+ * transport, and gives the packet ID back when the queue is full.
+ */
+void test_MQTT_Publish_TransmitQueue( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t queue[ 30 ];
+    size_t headerLen = 4;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.send = transportSendFailure;
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pPayload = "TestPublish";
+    publishInfo.payloadLength = strlen( publishInfo.pPayload );
+    publishInfo.pTopicName = "TestTopic";
+    publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Publish( &mqttContext, &publishInfo, 1 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 26U, mqttContext.transmitQueueTail );
+    TEST_ASSERT_EQUAL_MEMORY( "TestTopic", &queue[ 4 ], 9U );
+    TEST_ASSERT_EQUAL( 0U, queue[ 13 ] );
+    TEST_ASSERT_EQUAL( 1U, queue[ 14 ] );
+    TEST_ASSERT_EQUAL_MEMORY( "TestPublish", &queue[ 15 ], 11U );
+
+    /* The second publish does not fit, and its state is removed. */
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_RemoveStateRecord_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Publish( &mqttContext, &publishInfo, 2 );
+
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+    TEST_ASSERT_EQUAL( 26U, mqttContext.transmitQueueTail );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_ProcessLoop sends as much of the transmit queue as the
+ * transport takes without waiting, and resumes on the next call.
+ */
+void test_MQTT_ProcessLoop_FlushTransmitQueue( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t queue[ 30 ];
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvNoData;
+    mqttContext.transportInterface.send = transportSendUpToCapacity;
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttContext.transmitQueueTail = 10U;
+
+    sendCapacity = 4U;
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 4U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 10U, mqttContext.transmitQueueTail );
+
+    sendCapacity = 100U;
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueTail );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a packet sent while the transport stops taking the
+ * transmit queue fails, and that the unsent bytes stay in the queue.
+ */
+void test_MQTT_Ping_TransmitQueueTimeout( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t queue[ 30 ];
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.send = transportSendUpToCapacity;
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttContext.transmitQueueTail = 10U;
+
+    sendCapacity = 4U;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Ping( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSendFailed, mqttStatus );
+    TEST_ASSERT_EQUAL( 4U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 10U, mqttContext.transmitQueueTail );
+    TEST_ASSERT_FALSE( mqttContext.waitingForPingResp );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a keep alive PINGREQ sent by the loop is queued behind the
+ * transmit queue instead of waiting for the transport.
+ */
+void test_MQTT_ProcessLoop_KeepAliveQueuedBehindTransmitQueue( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t queue[ 30 ];
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvNoData;
+    mqttContext.transportInterface.send = transportSendUpToCapacity;
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttContext.transmitQueueTail = 10U;
+    mqttContext.keepAliveIntervalSec = 1;
+    globalEntryTime = MQTT_PINGRESP_TIMEOUT_MS;
+
+    sendCapacity = 4U;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 4U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 10U + MQTT_PACKET_PINGREQ_SIZE, mqttContext.transmitQueueTail );
+    TEST_ASSERT_TRUE( mqttContext.waitingForPingResp );
+    /* The loop did not wait for the send timeout. */
+    TEST_ASSERT_LESS_THAN( MQTT_PINGRESP_TIMEOUT_MS + 100U, globalEntryTime );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of calls made to #transportSendSlowly.
+ */
+static size_t slowSendCallCount = 0;
+
+/**
+ * @brief Mocked transport send that takes one byte every other call, and lets
+ * most of the send timeout pass on the calls in between.
+ */
+static int32_t transportSendSlowly( NetworkContext_t * pNetworkContext,
+                                    const void * pBuffer,
+                                    size_t bytesToWrite )
+{
+    int32_t bytesWritten = 0;
+
+    TEST_ASSERT_EQUAL( MQTT_SAMPLE_NETWORK_CONTEXT, pNetworkContext );
+    ( void ) pBuffer;
+
+    if( ( slowSendCallCount % 2U ) == 0U )
+    {
+        globalEntryTime += ( MQTT_SEND_TIMEOUT_MS * 3U ) / 5U;
+    }
+    else if( bytesToWrite > 0U )
+    {
+        bytesWritten = 1;
+    }
+
+    slowSendCallCount++;
+
+    return bytesWritten;
+}
+
+/**
+ * @brief Test that the transmit queue is not timed out while the transport
+ * keeps taking bytes, however slowly.
+ */
+void test_MQTT_Ping_TransmitQueueSlowTransport( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t queue[ 30 ];
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.send = transportSendSlowly;
+    mqttStatus = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), NULL );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    mqttContext.transmitQueueTail = 5U;
+
+    slowSendCallCount = 0U;
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_Ping( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueTail );
+    TEST_ASSERT_TRUE( mqttContext.waitingForPingResp );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of publishes given to #transmitQueueDropCallback.
+ */
+static size_t droppedPublishCount = 0;
+
+/**
+ * @brief Transmit queue drop callback that counts the dropped publishes.
+ */
+static void transmitQueueDropCallback( MQTTContext_t * pContext,
+                                       size_t droppedCount )
+{
+    ( void ) pContext;
+    droppedPublishCount += droppedCount;
+}
+
+/**
+ * @brief Test that MQTT_Connect gives the number of QoS 0 publishes it drops
+ * from the transmit queue to the drop callback.
+ */
+void test_MQTT_Connect_ReportsDroppedPublishes( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTConnectInfo_t connectInfo = { 0 };
+    bool sessionPresent = false;
+    MQTTStatus_t status;
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    /* A QoS 0 publish partly sent, a QoS 1 publish, a QoS 0 publish and a
+     * PINGREQ. */
+    uint8_t queue[ 30 ] =
+    {
+        MQTT_PACKET_TYPE_PUBLISH,        3U, 0U, 1U, 'a',
+        MQTT_PACKET_TYPE_PUBLISH | 0x02U, 5U, 0U, 1U, 'a', 0U, 1U,
+        MQTT_PACKET_TYPE_PUBLISH,        4U, 0U, 1U, 'a', 'b',
+        MQTT_PACKET_TYPE_PINGREQ,        0U
+    };
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    memset( &mqttContext, 0x0, sizeof( mqttContext ) );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+    status = MQTT_InitTransmitQueue( &mqttContext, queue, sizeof( queue ), transmitQueueDropCallback );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    mqttContext.transmitQueueHead = 2U;
+    mqttContext.transmitQueueTail = 20U;
+
+    incomingPacket.type = MQTT_PACKET_TYPE_CONNACK;
+    incomingPacket.remainingLength = 2;
+
+    MQTT_GetConnectPacketSize_IgnoreAndReturn( MQTTSuccess );
+    MQTT_SerializeConnectFixedHeader_Stub( MQTT_SerializeConnectFixedHeader_cb );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetIncomingPacketTypeAndLengthBuffered_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    droppedPublishCount = 0U;
+    status = MQTT_Connect( &mqttContext, &connectInfo, NULL, 0U, &sessionPresent );
+
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( 2U, droppedPublishCount );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueHead );
+    TEST_ASSERT_EQUAL( 0U, mqttContext.transmitQueueTail );
+}
+/* ========================================================================== */
+
+void test_MQTT_PreparePublish_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPreparedPublish_t prepared = { 0 };
+
+    mqttStatus = MQTT_PreparePublish( NULL, &publishInfo, &prepared );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PreparePublish( &mqttContext, NULL, &prepared );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PreparePublish( &mqttContext, &publishInfo, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* QoS1 has not been enabled. */
+    publishInfo.qos = MQTTQoS1;
+    mqttStatus = MQTT_PreparePublish( &mqttContext, &publishInfo, &prepared );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, prepared.headerSize );
+
+    /* A handle which was not prepared is rejected. */
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 1, false );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishPrepared( NULL, &prepared, "Test", 1, false );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishPrepared( &mqttContext, NULL, "Test", 1, false );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* QoS1 without a packet ID, and a payload length without a payload. */
+    prepared.headerSize = 5U;
+    prepared.qos = MQTTQoS1;
+    prepared.payloadLength = 4U;
+    mqttStatus = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 0, false );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishPrepared( &mqttContext, &prepared, NULL, 1, false );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a prepared publish is serialized once and then sent with
+ * only the packet ID and DUP flag set per packet.
+ */
+void test_MQTT_PublishPrepared( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPreparedPublish_t prepared = { 0 };
+    size_t headerLen = 5;
+
+    setUPContext( &mqttContext );
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = "TestTopic";
+    publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+    publishInfo.payloadLength = 4U;
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+
+    mqttStatus = MQTT_PreparePublish( &mqttContext, &publishInfo, &prepared );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( headerLen, prepared.headerSize );
+    TEST_ASSERT_EQUAL_PTR( publishInfo.pTopicName, prepared.pTopicName );
+    TEST_ASSERT_EQUAL( 4U, prepared.payloadLength );
+
+    prepared.header[ 0 ] = MQTT_PACKET_TYPE_PUBLISH | 0x02U;
+
+    /* Nothing is serialized again. */
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    mqttStatus = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 1, false );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTStateCollision );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+    mqttStatus = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 1, true );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The DUP flag is only set on the copy sent. */
+    TEST_ASSERT_EQUAL( MQTT_PACKET_TYPE_PUBLISH | 0x02U, prepared.header[ 0 ] );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of calls made to #transportSendCount.
+ */
+static size_t sendCallCount = 0;
+
+/**
+ * @brief Mocked transport send that accepts everything and counts its calls.
+ */
+static int32_t transportSendCount( NetworkContext_t * pNetworkContext,
+                                   const void * pBuffer,
+                                   size_t bytesToWrite )
+{
+    sendCallCount++;
+
+    return transportSendSuccess( pNetworkContext, pBuffer, bytesToWrite );
+}
+
+void test_MQTT_InitSendStaging_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    uint8_t stagingBuffer[ 64 ];
+
+    mqttStatus = MQTT_InitSendStaging( NULL, stagingBuffer, sizeof( stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitSendStaging( &mqttContext, NULL, sizeof( stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitSendStaging( &mqttContext, stagingBuffer, sizeof( stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitSendStaging( &mqttContext, stagingBuffer, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitSendStaging( &mqttContext, stagingBuffer, sizeof( stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL_PTR( stagingBuffer, mqttContext.pSendStagingBuffer );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the fields of a PUBLISH are sent with one send call when
+ * the transport has no writev and a staging buffer is set.
+ */
+void test_MQTT_Publish_SendStaging( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    uint8_t stagingBuffer[ 64 ];
+    size_t headerLen = 5;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.writev = NULL;
+    mqttContext.transportInterface.send = transportSendCount;
+    mqttStatus = MQTT_InitSendStaging( &mqttContext, stagingBuffer, sizeof( stagingBuffer ) );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pPayload = "TestPublish";
+    publishInfo.payloadLength = strlen( publishInfo.pPayload );
+    publishInfo.pTopicName = "TestTopic";
+    publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    sendCallCount = 0;
+    mqttStatus = MQTT_Publish( &mqttContext, &publishInfo, 10 );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, sendCallCount );
+    TEST_ASSERT_EQUAL_MEMORY( "TestTopic", &stagingBuffer[ headerLen ], 9U );
+    TEST_ASSERT_EQUAL_MEMORY( "TestPublish", &stagingBuffer[ headerLen + 11U ], 11U );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test the parameter validation of MQTT_SubscribeBulk and
+ * MQTT_UnsubscribeBulk.
+ */
+void test_MQTT_SubscribeBulk_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTSubscribeInfo_t subscribeInfo = { 0 };
+    MQTTBulkPacket_t packets[ 2 ];
+    uint8_t buffer[ 16 ];
+    MQTTFixedBuffer_t fixedBuffer = { buffer, sizeof( buffer ) };
+    size_t packetCount = 0U;
+
+    setUPContext( &mqttContext );
+
+    subscribeInfo.qos = MQTTQoS0;
+    subscribeInfo.pTopicFilter = "TopicFilterTooLong";
+    subscribeInfo.topicFilterLength = strlen( subscribeInfo.pTopicFilter );
+
+    mqttStatus = MQTT_SubscribeBulk( NULL, &subscribeInfo, 1U, &fixedBuffer, packets, 2U, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_SubscribeBulk( &mqttContext, &subscribeInfo, 1U, NULL, packets, 2U, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_SubscribeBulk( &mqttContext, &subscribeInfo, 1U, &fixedBuffer, NULL, 2U, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_SubscribeBulk( &mqttContext, &subscribeInfo, 1U, &fixedBuffer, packets, 0U, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_UnsubscribeBulk( &mqttContext, &subscribeInfo, 0U, &fixedBuffer, packets, 2U, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The topic filter does not fit in the buffer. */
+    mqttStatus = MQTT_SubscribeBulk( &mqttContext, &subscribeInfo, 1U, &fixedBuffer, packets, 2U, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+    TEST_ASSERT_EQUAL( 0U, packetCount );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_SubscribeBulk splits the topic filters into packets
+ * which fit in the buffer and reports the filters of each packet.
+ */
+void test_MQTT_SubscribeBulk_Split( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTSubscribeInfo_t subscribeInfo[ 3 ];
+    MQTTBulkPacket_t packets[ 4 ];
+    uint8_t buffer[ 33 ];
+    MQTTFixedBuffer_t fixedBuffer = { buffer, sizeof( buffer ) };
+    size_t packetCount = 0U;
+    size_t remainingLength = 28U;
+    size_t packetSize = 30U;
+    size_t i;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.send = transportSendCounted;
+    transportSendCount = 0U;
+
+    for( i = 0; i < 3U; i++ )
+    {
+        subscribeInfo[ i ].qos = MQTTQoS0;
+        subscribeInfo[ i ].pTopicFilter = "TopicOfTen";
+        subscribeInfo[ i ].topicFilterLength = 10U;
+    }
+
+    /* Two filters of 13 bytes each fit with the 7 bytes of the header. */
+    MQTT_GetSubscribePacketSize_ExpectAndReturn( &subscribeInfo[ 0 ], 2U, NULL, NULL, MQTTSuccess );
+    MQTT_GetSubscribePacketSize_IgnoreArg_pRemainingLength();
+    MQTT_GetSubscribePacketSize_IgnoreArg_pPacketSize();
+    MQTT_GetSubscribePacketSize_ReturnThruPtr_pRemainingLength( &remainingLength );
+    MQTT_GetSubscribePacketSize_ReturnThruPtr_pPacketSize( &packetSize );
+    MQTT_SerializeSubscribe_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetSubscribePacketSize_ExpectAndReturn( &subscribeInfo[ 2 ], 1U, NULL, NULL, MQTTSuccess );
+    MQTT_GetSubscribePacketSize_IgnoreArg_pRemainingLength();
+    MQTT_GetSubscribePacketSize_IgnoreArg_pPacketSize();
+    MQTT_GetSubscribePacketSize_ReturnThruPtr_pRemainingLength( &remainingLength );
+    MQTT_GetSubscribePacketSize_ReturnThruPtr_pPacketSize( &packetSize );
+    MQTT_SerializeSubscribe_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_SubscribeBulk( &mqttContext, subscribeInfo, 3U, &fixedBuffer, packets, 4U, &packetCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2U, packetCount );
+    TEST_ASSERT_EQUAL( 2U, transportSendCount );
+    TEST_ASSERT_EQUAL( 1U, packets[ 0 ].packetId );
+    TEST_ASSERT_EQUAL( 0U, packets[ 0 ].firstIndex );
+    TEST_ASSERT_EQUAL( 2U, packets[ 0 ].count );
+    TEST_ASSERT_EQUAL( 2U, packets[ 1 ].packetId );
+    TEST_ASSERT_EQUAL( 2U, packets[ 1 ].firstIndex );
+    TEST_ASSERT_EQUAL( 1U, packets[ 1 ].count );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test the parameter validation of MQTT_InitCoarseClock.
+ */
+void test_MQTT_InitCoarseClock_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+
+    mqttStatus = MQTT_InitCoarseClock( NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitCoarseClock( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+
+    mqttStatus = MQTT_InitCoarseClock( &mqttContext );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( mqttContext.coarseClock );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that MQTT_ProcessLoopAt checks the keep alive against the
+ * supplied time rather than the time of the context.
+ */
+void test_MQTT_ProcessLoopAt_SuppliedTime( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTimeDummy, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.waitingForPingResp = true;
+    context.pingReqSendTimeMs = 0U;
+
+    /* The context's own clock stays at 0, so the PINGRESP is not late. */
+    mqttStatus = MQTT_ProcessLoop( &context );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_ProcessLoopAt( &context, MQTT_PINGRESP_TIMEOUT_MS + 1U );
+    TEST_ASSERT_EQUAL( MQTTKeepAliveTimeout, mqttStatus );
+    TEST_ASSERT_FALSE( context.coarseTimeValid );
+
+    mqttStatus = MQTT_ProcessLoopAt( NULL, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a PINGREQ sent by another thread during a loop pass, and so
+ * stamped later than the time of the pass, is not taken as late by the keep
+ * alive check.
+ */
+void test_MQTT_ProcessLoopAt_SendStampedAfterPass( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTimeDummy, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.waitingForPingResp = true;
+    context.pingReqSendTimeMs = 100U;
+
+    mqttStatus = MQTT_ProcessLoopAt( &context, 50U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that a keep alive PINGREQ sent by MQTT_ProcessLoopAt is stamped
+ * with the supplied time rather than the time of the context.
+ */
+void test_MQTT_ProcessLoopAt_PingreqStampedWithSuppliedTime( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setUPContext( &mqttContext );
+    mqttContext.transportInterface.recv = transportRecvNoData;
+    mqttContext.keepAliveIntervalSec = 1;
+    globalEntryTime = 0U;
+
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    mqttStatus = MQTT_ProcessLoopAt( &mqttContext, MQTT_PINGRESP_TIMEOUT_MS );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( mqttContext.waitingForPingResp );
+    TEST_ASSERT_EQUAL( MQTT_PINGRESP_TIMEOUT_MS, mqttContext.pingReqSendTimeMs );
+    TEST_ASSERT_EQUAL( MQTT_PINGRESP_TIMEOUT_MS, mqttContext.lastPacketTxTime );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Number of calls to #publishComplete.
+ */
+static size_t publishCompleteCount = 0U;
+
+/**
+ * @brief Latency given to the last call of #publishComplete.
+ */
+static uint32_t publishCompleteLatency = 0U;
+
+/**
+ * @brief Completion callback which records its calls.
+ */
+static void publishComplete( MQTTContext_t * pContext,
+                             uint16_t packetId,
+                             MQTTStatus_t status,
+                             uint32_t latencyMs,
+                             void * pUserContext )
+{
+    ( void ) pContext;
+    TEST_ASSERT_EQUAL( 10U, packetId );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &publishCompleteCount, pUserContext );
+    publishCompleteLatency = latencyMs;
+    publishCompleteCount++;
+}
+
+/**
+ * @brief Test the parameter validation of MQTT_InitPublishCompletion and
+ * MQTT_PublishWithCompletion.
+ */
+void test_MQTT_PublishWithCompletion_Invalid_Params( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishCompletion_t completions[ 1 ];
+
+    mqttStatus = MQTT_InitPublishCompletion( NULL, completions, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishCompletion( &mqttContext, NULL, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* MQTT_Init has not been called. */
+    mqttStatus = MQTT_InitPublishCompletion( &mqttContext, completions, 1U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setUPContext( &mqttContext );
+    publishInfo.qos = MQTTQoS1;
+
+    /* MQTT_InitPublishCompletion has not been called. */
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, &publishInfo, 10U, publishComplete, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishCompletion( &mqttContext, completions, 0U );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_InitPublishCompletion( &mqttContext, completions, 1U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_PublishWithCompletion( NULL, &publishInfo, 10U, publishComplete, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, NULL, 10U, publishComplete, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, &publishInfo, 10U, NULL, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, &publishInfo, 0U, publishComplete, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    publishInfo.qos = MQTTQoS0;
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, &publishInfo, 10U, publishComplete, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* The table is full. */
+    publishInfo.qos = MQTTQoS1;
+    completions[ 0 ].packetId = 5U;
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, &publishInfo, 10U, publishComplete, NULL );
+    TEST_ASSERT_EQUAL( MQTTNoMemory, mqttStatus );
+}
+/* ========================================================================== */
+
+/**
+ * @brief Test that the completion of a QoS 1 publish is invoked with its
+ * latency once its PUBACK is received.
+ */
+void test_MQTT_PublishWithCompletion_Puback( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPublishInfo_t publishInfo = { 0 };
+    MQTTPublishCompletion_t completions[ 2 ];
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPublishState_t publishDone = MQTTPublishDone;
+    uint16_t packetId = 10U;
+    size_t headerLen = 5;
+
+    setUPContext( &mqttContext );
+    mqttStatus = MQTT_InitPublishCompletion( &mqttContext, completions, 2U );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pPayload = "TestPublish";
+    publishInfo.payloadLength = strlen( publishInfo.pPayload );
+    publishInfo.pTopicName = "TestTopic";
+    publishInfo.topicNameLength = strlen( publishInfo.pTopicName );
+
+    MQTT_GetPublishPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePublishHeaderWithoutTopic_ReturnThruPtr_headerSize( &headerLen );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    globalEntryTime = 100U;
+    publishCompleteCount = 0U;
+    mqttStatus = MQTT_PublishWithCompletion( &mqttContext, &publishInfo, packetId,
+                                             publishComplete, &publishCompleteCount );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( packetId, completions[ 0 ].packetId );
+    TEST_ASSERT_EQUAL( 100U, completions[ 0 ].sendTimeMs );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBACK;
+    incomingPacket.remainingLength = MQTT_SAMPLE_REMAINING_LENGTH;
+    incomingPacket.headerLength = MQTT_SAMPLE_REMAINING_LENGTH;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pPacketId( &packetId );
+    MQTT_UpdateStateAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStateAck_ReturnThruPtr_pNewState( &publishDone );
+
+    globalEntryTime = 1000U;
+    mqttStatus = MQTT_ProcessLoop( &mqttContext );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 1U, publishCompleteCount );
+    TEST_ASSERT_GREATER_OR_EQUAL( 900U, publishCompleteLatency );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, completions[ 0 ].packetId );
+}
+/* ========================================================================== */